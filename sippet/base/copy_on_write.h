@@ -0,0 +1,63 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_BASE_COPY_ON_WRITE_H_
+#define SIPPET_BASE_COPY_ON_WRITE_H_
+
+#include "base/lazy_instance.h"
+#include "base/memory/ref_counted.h"
+
+namespace sippet {
+
+// Holds a value of type |T| that is shared between copies until one of them
+// is modified. Copying a |CopyOnWrite| only increments a reference count;
+// |get_mutable()| makes a private copy of the value first, if it is shared.
+//
+// A default constructed |CopyOnWrite| allocates nothing, and reads as a
+// default constructed |T|.
+//
+// References and iterators obtained from |get()| are invalidated by a
+// subsequent call to |get_mutable()|, as the value may be detached.
+template <typename T>
+class CopyOnWrite {
+ public:
+  CopyOnWrite() {}
+  CopyOnWrite(const CopyOnWrite& other) : data_(other.data_) {}
+  ~CopyOnWrite() {}
+
+  CopyOnWrite& operator=(const CopyOnWrite& other) {
+    data_ = other.data_;
+    return *this;
+  }
+
+  const T& get() const {
+    return data_.get() ? data_->data : Empty();
+  }
+
+  T& get_mutable() {
+    if (!data_.get())
+      data_ = new base::RefCountedData<T>;
+    else if (!data_->HasOneRef())
+      data_ = new base::RefCountedData<T>(data_->data);
+    return data_->data;
+  }
+
+  // Whether the value is currently shared with another |CopyOnWrite|.
+  bool is_shared() const {
+    return data_.get() && !data_->HasOneRef();
+  }
+
+ private:
+  static const T& Empty() {
+    static typename base::LazyInstance<T>::Leaky empty =
+        LAZY_INSTANCE_INITIALIZER;
+    return empty.Get();
+  }
+
+  scoped_refptr<base::RefCountedData<T> > data_;
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_BASE_COPY_ON_WRITE_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/memory_usage.h"
+
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/trace_event/memory_allocator_dump.h"
+#include "base/trace_event/memory_dump_manager.h"
+#include "base/trace_event/process_memory_dump.h"
+
+namespace sippet {
+
+MemoryUsageDump::MemoryUsageDump() {
+}
+
+MemoryUsageDump::~MemoryUsageDump() {
+}
+
+void MemoryUsageDump::Add(const std::string &name, size_t object_count,
+                          size_t bytes) {
+  MemoryUsage &usage = usages_[name];
+  usage.object_count += object_count;
+  usage.bytes += bytes;
+}
+
+MemoryUsage MemoryUsageDump::GetTotal() const {
+  MemoryUsage total;
+  for (const auto &entry : usages_) {
+    total.object_count += entry.second.object_count;
+    total.bytes += entry.second.bytes;
+  }
+  return total;
+}
+
+std::string MemoryUsageDump::ToString() const {
+  std::string output;
+  for (const auto &entry : usages_) {
+    base::StringAppendF(&output, "%s: %" PRIuS " objects, %" PRIuS " bytes\n",
+                        entry.first.c_str(), entry.second.object_count,
+                        entry.second.bytes);
+  }
+  return output;
+}
+
+MemoryUsageDumpProvider::MemoryUsageDumpProvider(
+    const DumpCallback &dump_callback)
+  : dump_callback_(dump_callback),
+    registered_(false) {
+  DCHECK(!dump_callback_.is_null());
+}
+
+MemoryUsageDumpProvider::~MemoryUsageDumpProvider() {
+  Unregister();
+}
+
+void MemoryUsageDumpProvider::Register() {
+  if (registered_)
+    return;
+  base::trace_event::MemoryDumpManager::GetInstance()->RegisterDumpProvider(
+      this, base::ThreadTaskRunnerHandle::Get());
+  registered_ = true;
+}
+
+void MemoryUsageDumpProvider::Unregister() {
+  if (!registered_)
+    return;
+  base::trace_event::MemoryDumpManager::GetInstance()->UnregisterDumpProvider(
+      this);
+  registered_ = false;
+}
+
+bool MemoryUsageDumpProvider::OnMemoryDump(
+    const base::trace_event::MemoryDumpArgs &args,
+    base::trace_event::ProcessMemoryDump *pmd) {
+  using base::trace_event::MemoryAllocatorDump;
+  MemoryUsageDump dump;
+  dump_callback_.Run(&dump);
+  for (const auto &entry : dump.usages()) {
+    MemoryAllocatorDump *allocator_dump =
+        pmd->CreateAllocatorDump("sippet/" + entry.first);
+    allocator_dump->AddScalar(MemoryAllocatorDump::kNameSize,
+                              MemoryAllocatorDump::kUnitsBytes,
+                              entry.second.bytes);
+    allocator_dump->AddScalar(MemoryAllocatorDump::kNameObjectsCount,
+                              MemoryAllocatorDump::kUnitsObjects,
+                              entry.second.object_count);
+  }
+  return true;
+}
+
+} // namespace sippet
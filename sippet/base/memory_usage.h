@@ -0,0 +1,109 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_BASE_MEMORY_USAGE_H_
+#define SIPPET_BASE_MEMORY_USAGE_H_
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/trace_event/memory_dump_provider.h"
+
+namespace sippet {
+
+// Memory taken by each node of a std::map or std::set besides its value:
+// three links and a color.
+const size_t kTreeNodeOverhead = 4 * sizeof(void*);
+
+// Memory taken by each node of a std::list besides its value.
+const size_t kListNodeOverhead = 2 * sizeof(void*);
+
+// Memory taken by each node of a base::hash_map besides its value, counting
+// its bucket.
+const size_t kHashNodeOverhead = 2 * sizeof(void*);
+
+// Approximate memory allocated by |s| out of the string object itself.
+inline size_t EstimateStringMemoryUsage(const std::string &s) {
+  return s.capacity() + 1;
+}
+
+// The memory held by a subsystem of the stack: the number of objects and
+// an estimate of the bytes they take, containers included.
+struct MemoryUsage {
+  MemoryUsage() : object_count(0), bytes(0) {}
+
+  size_t object_count;
+  size_t bytes;
+};
+
+// A dump of the memory held by the stack, by subsystem. Subsystems are named
+// by paths, such as "transport/client_transactions". Usages added to the
+// same subsystem add up, so that several instances are reported together.
+//
+// The estimates are meant to track growth and leaks rather than to match the
+// allocator: they count the objects, their containers and the buffers they
+// own, but not memory shared among objects, such as interned URLs.
+class MemoryUsageDump {
+ public:
+  typedef std::map<std::string, MemoryUsage> UsageMap;
+
+  MemoryUsageDump();
+  ~MemoryUsageDump();
+
+  void Add(const std::string &name, size_t object_count, size_t bytes);
+
+  // Usages by subsystem, sorted by name.
+  const UsageMap &usages() const { return usages_; }
+
+  // Sum of the usages of all subsystems.
+  MemoryUsage GetTotal() const;
+
+  // One line per subsystem, as in "transport/channels: 2 objects, 66000
+  // bytes", for logging.
+  std::string ToString() const;
+
+ private:
+  UsageMap usages_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryUsageDump);
+};
+
+// Reports the usages collected by a callback to Chromium's memory-infra, so
+// that they show up in chrome://tracing when the memory-infra category is
+// enabled. Each subsystem becomes an allocator dump under "sippet/", with
+// its size and object count.
+//
+// The callback runs on the thread that registered the provider, which must
+// be the thread owning the dumped objects. Only one provider should be
+// registered at a time, as dump names can't repeat.
+class MemoryUsageDumpProvider
+    : public base::trace_event::MemoryDumpProvider {
+ public:
+  typedef base::Callback<void(MemoryUsageDump*)> DumpCallback;
+
+  explicit MemoryUsageDumpProvider(const DumpCallback &dump_callback);
+  ~MemoryUsageDumpProvider() override;
+
+  // Registers to the |MemoryDumpManager|, for dumps on the current thread.
+  void Register();
+
+  // Unregisters, on the thread that registered. Also done on destruction.
+  void Unregister();
+
+  // base::trace_event::MemoryDumpProvider methods:
+  bool OnMemoryDump(const base::trace_event::MemoryDumpArgs &args,
+                    base::trace_event::ProcessMemoryDump *pmd) override;
+
+ private:
+  DumpCallback dump_callback_;
+  bool registered_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryUsageDumpProvider);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_BASE_MEMORY_USAGE_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/memory_usage.h"
+
+#include "base/bind.h"
+#include "base/trace_event/memory_allocator_dump.h"
+#include "base/trace_event/memory_dump_request_args.h"
+#include "base/trace_event/process_memory_dump.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+void DumpUsages(MemoryUsageDump *dump) {
+  dump->Add("transport/channels", 2, 4096);
+  dump->Add("ua/dialogs", 1, 300);
+}
+
+}  // namespace
+
+TEST(MemoryUsageDumpTest, AddsUp) {
+  MemoryUsageDump dump;
+  dump.Add("transport/client_transactions", 2, 1000);
+  dump.Add("ua/dialogs", 1, 300);
+  dump.Add("transport/client_transactions", 1, 500);
+
+  ASSERT_EQ(2u, dump.usages().size());
+  const MemoryUsage &transactions =
+      dump.usages().find("transport/client_transactions")->second;
+  EXPECT_EQ(3u, transactions.object_count);
+  EXPECT_EQ(1500u, transactions.bytes);
+
+  MemoryUsage total = dump.GetTotal();
+  EXPECT_EQ(4u, total.object_count);
+  EXPECT_EQ(1800u, total.bytes);
+}
+
+TEST(MemoryUsageDumpTest, ToString) {
+  MemoryUsageDump dump;
+  dump.Add("ua/dialogs", 1, 300);
+  dump.Add("transport/channels", 2, 4096);
+  EXPECT_EQ("transport/channels: 2 objects, 4096 bytes\n"
+            "ua/dialogs: 1 objects, 300 bytes\n", dump.ToString());
+}
+
+TEST(MemoryUsageDumpTest, EstimatesStrings) {
+  std::string s(100, 'x');
+  EXPECT_LE(101u, EstimateStringMemoryUsage(s));
+}
+
+TEST(MemoryUsageDumpProviderTest, OnMemoryDump) {
+  MemoryUsageDumpProvider provider(base::Bind(&DumpUsages));
+  base::trace_event::ProcessMemoryDump pmd(nullptr);
+  base::trace_event::MemoryDumpArgs args =
+      base::trace_event::MemoryDumpArgs();
+  EXPECT_TRUE(provider.OnMemoryDump(args, &pmd));
+
+  // One allocator dump per subsystem, under "sippet/".
+  EXPECT_EQ(2u, pmd.allocator_dumps().size());
+  EXPECT_TRUE(pmd.GetAllocatorDump("sippet/transport/channels"));
+  EXPECT_TRUE(pmd.GetAllocatorDump("sippet/ua/dialogs"));
+  EXPECT_FALSE(pmd.GetAllocatorDump("transport/channels"));
+}
+
+} // namespace sippet
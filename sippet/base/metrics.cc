@@ -0,0 +1,317 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/metrics.h"
+
+#include <algorithm>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace sippet {
+
+namespace {
+
+// Cells available to metrics. Each counter or gauge takes one cell, and
+// each histogram one per bound plus three. Every thread updating metrics
+// allocates a shard of this many words.
+const size_t kMaxCells = 4096;
+
+static base::LazyInstance<MetricsRegistry>::Leaky
+  g_metrics_registry = LAZY_INSTANCE_INITIALIZER;
+
+std::string AppendLabel(const std::string &labels, const std::string &label) {
+  return labels.empty() ? label : labels + "," + label;
+}
+
+void AppendSample(const std::string &name, const std::string &labels,
+                  const std::string &value, std::string *output) {
+  output->append(name);
+  if (!labels.empty())
+    output->append("{" + labels + "}");
+  output->append(" " + value + "\n");
+}
+
+}  // namespace
+
+struct MetricsRegistry::Metric {
+  MetricSnapshot::Type type;
+  std::string name;
+  std::string help;
+  std::string labels;
+  std::vector<base::TimeDelta> bounds;
+  size_t cell;
+  scoped_ptr<Counter> counter;
+  scoped_ptr<Gauge> gauge;
+  scoped_ptr<Histogram> histogram;
+};
+
+// The cells updated by a thread. Only that thread writes to them, so they
+// are updated without atomic read-modify-write operations.
+class MetricsRegistry::Shard {
+ public:
+  Shard()
+    : cells_(new base::subtle::AtomicWord[kMaxCells]()),
+      sequence_(0) {}
+
+  void Add(size_t cell, int64 value) {
+    DCHECK_LT(cell, kMaxCells);
+    base::subtle::AtomicWord *word = &cells_[cell];
+    base::subtle::NoBarrier_Store(word, base::subtle::NoBarrier_Load(word)
+        + static_cast<base::subtle::AtomicWord>(value));
+  }
+
+  int64 Get(size_t cell) const {
+    return base::subtle::NoBarrier_Load(&cells_[cell]);
+  }
+
+  // Adds |value| to the 64-bit sum kept in |cell| and the next one, as its
+  // low and high 32-bit halves, so that it doesn't wrap on 32-bit
+  // platforms. The sequence is odd while the halves are being written.
+  void AddToSum(size_t cell, int64 value) {
+    DCHECK_LT(cell + 1, kMaxCells);
+    base::subtle::AtomicWord sequence =
+        base::subtle::NoBarrier_Load(&sequence_);
+    base::subtle::NoBarrier_Store(&sequence_, sequence + 1);
+    base::subtle::MemoryBarrier();
+    uint64 sum = static_cast<uint64>(LoadSum(cell) + value);
+    base::subtle::NoBarrier_Store(&cells_[cell],
+        static_cast<base::subtle::AtomicWord>(static_cast<uint32>(sum)));
+    base::subtle::NoBarrier_Store(&cells_[cell + 1],
+        static_cast<base::subtle::AtomicWord>(static_cast<uint32>(sum >> 32)));
+    base::subtle::Release_Store(&sequence_, sequence + 2);
+  }
+
+  // Reads a sum written by |AddToSum|, retrying until both halves come
+  // from the same update.
+  int64 GetSum(size_t cell) const {
+    for (;;) {
+      base::subtle::AtomicWord sequence =
+          base::subtle::Acquire_Load(&sequence_);
+      if (sequence & 1)
+        continue;
+      int64 sum = LoadSum(cell);
+      base::subtle::MemoryBarrier();
+      if (base::subtle::NoBarrier_Load(&sequence_) == sequence)
+        return sum;
+    }
+  }
+
+ private:
+  int64 LoadSum(size_t cell) const {
+    uint64 low = static_cast<uint32>(base::subtle::NoBarrier_Load(
+        &cells_[cell]));
+    uint64 high = static_cast<uint32>(base::subtle::NoBarrier_Load(
+        &cells_[cell + 1]));
+    return static_cast<int64>((high << 32) | low);
+  }
+
+  scoped_ptr<base::subtle::AtomicWord[]> cells_;
+  base::subtle::AtomicWord sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(Shard);
+};
+
+Counter::Counter(MetricsRegistry *registry, size_t cell)
+  : registry_(registry), cell_(cell) {
+}
+
+void Counter::Add(int64 value) {
+  DCHECK_GE(value, 0);
+  registry_->AddToCell(cell_, value);
+}
+
+Gauge::Gauge(MetricsRegistry *registry, size_t cell)
+  : registry_(registry), cell_(cell) {
+}
+
+void Gauge::Add(int64 delta) {
+  registry_->AddToCell(cell_, delta);
+}
+
+Histogram::Histogram(MetricsRegistry *registry, size_t cell,
+                     const std::vector<base::TimeDelta> &bounds)
+  : registry_(registry), cell_(cell), bounds_(bounds) {
+}
+
+void Histogram::AddTime(base::TimeDelta time) {
+  // Buckets count the values up to their bound, included.
+  size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), time)
+      - bounds_.begin();
+  MetricsRegistry::Shard *shard = registry_->GetShard();
+  shard->Add(cell_ + bucket, 1);
+  shard->AddToSum(cell_ + bounds_.size() + 1, time.InMicroseconds());
+}
+
+MetricSnapshot::MetricSnapshot()
+  : type(TYPE_COUNTER), value(0) {
+}
+
+MetricSnapshot::~MetricSnapshot() {
+}
+
+MetricsRegistry::MetricsRegistry()
+  : cell_count_(0) {
+}
+
+MetricsRegistry::~MetricsRegistry() {
+}
+
+MetricsRegistry *MetricsRegistry::GetInstance() {
+  return g_metrics_registry.Pointer();
+}
+
+Counter *MetricsRegistry::GetCounter(const std::string &name,
+                                     const std::string &help,
+                                     const std::string &labels) {
+  return GetMetric(MetricSnapshot::TYPE_COUNTER, name, help, labels,
+                   std::vector<base::TimeDelta>())->counter.get();
+}
+
+Gauge *MetricsRegistry::GetGauge(const std::string &name,
+                                 const std::string &help,
+                                 const std::string &labels) {
+  return GetMetric(MetricSnapshot::TYPE_GAUGE, name, help, labels,
+                   std::vector<base::TimeDelta>())->gauge.get();
+}
+
+Histogram *MetricsRegistry::GetHistogram(
+    const std::string &name, const std::string &help,
+    const std::string &labels, const std::vector<base::TimeDelta> &bounds) {
+  DCHECK(std::is_sorted(bounds.begin(), bounds.end()));
+  return GetMetric(MetricSnapshot::TYPE_HISTOGRAM, name, help, labels,
+                   bounds)->histogram.get();
+}
+
+void MetricsRegistry::TakeSnapshot(
+    std::vector<MetricSnapshot> *snapshot) const {
+  base::AutoLock lock(lock_);
+  snapshot->clear();
+  snapshot->reserve(metrics_.size());
+  for (const auto &entry : metrics_) {
+    const Metric *metric = entry.second;
+    snapshot->push_back(MetricSnapshot());
+    MetricSnapshot &value = snapshot->back();
+    value.type = metric->type;
+    value.name = metric->name;
+    value.help = metric->help;
+    value.labels = metric->labels;
+    if (MetricSnapshot::TYPE_HISTOGRAM != metric->type) {
+      for (const Shard *shard : shards_)
+        value.value += shard->Get(metric->cell);
+      continue;
+    }
+    value.bounds = metric->bounds;
+    value.counts.resize(metric->bounds.size() + 1);
+    int64 sum = 0;
+    for (const Shard *shard : shards_) {
+      for (size_t i = 0; i < value.counts.size(); ++i)
+        value.counts[i] += shard->Get(metric->cell + i);
+      sum += shard->GetSum(metric->cell + value.counts.size());
+    }
+    value.sum = base::TimeDelta::FromMicroseconds(sum);
+  }
+}
+
+// static
+std::string MetricsRegistry::FormatPrometheusText(
+    const std::vector<MetricSnapshot> &snapshot) {
+  std::string output;
+  std::string name;
+  for (const MetricSnapshot &metric : snapshot) {
+    if (metric.name != name) {
+      name = metric.name;
+      const char *type = "counter";
+      if (MetricSnapshot::TYPE_GAUGE == metric.type)
+        type = "gauge";
+      else if (MetricSnapshot::TYPE_HISTOGRAM == metric.type)
+        type = "histogram";
+      output.append("# HELP " + name + " " + metric.help + "\n");
+      output.append("# TYPE " + name + " " + type + "\n");
+    }
+    if (MetricSnapshot::TYPE_HISTOGRAM != metric.type) {
+      AppendSample(name, metric.labels, base::Int64ToString(metric.value),
+                   &output);
+      continue;
+    }
+    // Prometheus buckets are cumulative.
+    int64 count = 0;
+    for (size_t i = 0; i < metric.counts.size(); ++i) {
+      count += metric.counts[i];
+      std::string bound(i < metric.bounds.size()
+          ? base::DoubleToString(metric.bounds[i].InSecondsF()) : "+Inf");
+      AppendSample(name + "_bucket",
+                   AppendLabel(metric.labels, "le=\"" + bound + "\""),
+                   base::Int64ToString(count), &output);
+    }
+    AppendSample(name + "_sum", metric.labels,
+                 base::DoubleToString(metric.sum.InSecondsF()), &output);
+    AppendSample(name + "_count", metric.labels, base::Int64ToString(count),
+                 &output);
+  }
+  return output;
+}
+
+std::string MetricsRegistry::ToPrometheusText() const {
+  std::vector<MetricSnapshot> snapshot;
+  TakeSnapshot(&snapshot);
+  return FormatPrometheusText(snapshot);
+}
+
+MetricsRegistry::Metric *MetricsRegistry::GetMetric(
+    MetricSnapshot::Type type, const std::string &name,
+    const std::string &help, const std::string &labels,
+    const std::vector<base::TimeDelta> &bounds) {
+  std::string key(name + "{" + labels + "}");
+  base::AutoLock lock(lock_);
+  std::map<std::string, Metric*>::iterator i = metrics_.find(key);
+  if (metrics_.end() != i) {
+    DCHECK_EQ(type, i->second->type) << name << " registered twice";
+    return i->second;
+  }
+
+  size_t cells = MetricSnapshot::TYPE_HISTOGRAM == type
+      ? bounds.size() + 3 : 1;
+  CHECK_LE(cell_count_ + cells, kMaxCells) << "Too many metrics";
+  Metric *metric = new Metric;
+  metric->type = type;
+  metric->name = name;
+  metric->help = help;
+  metric->labels = labels;
+  metric->bounds = bounds;
+  metric->cell = cell_count_;
+  cell_count_ += cells;
+  switch (type) {
+    case MetricSnapshot::TYPE_COUNTER:
+      metric->counter.reset(new Counter(this, metric->cell));
+      break;
+    case MetricSnapshot::TYPE_GAUGE:
+      metric->gauge.reset(new Gauge(this, metric->cell));
+      break;
+    case MetricSnapshot::TYPE_HISTOGRAM:
+      metric->histogram.reset(new Histogram(this, metric->cell, bounds));
+      break;
+  }
+  owned_metrics_.push_back(metric);
+  metrics_.insert(std::make_pair(key, metric));
+  return metric;
+}
+
+void MetricsRegistry::AddToCell(size_t cell, int64 value) {
+  GetShard()->Add(cell, value);
+}
+
+MetricsRegistry::Shard *MetricsRegistry::GetShard() {
+  Shard *shard = current_shard_.Get();
+  if (!shard) {
+    shard = new Shard;
+    current_shard_.Set(shard);
+    base::AutoLock lock(lock_);
+    shards_.push_back(shard);
+  }
+  return shard;
+}
+
+} // namespace sippet
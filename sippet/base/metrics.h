@@ -0,0 +1,174 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_BASE_METRICS_H_
+#define SIPPET_BASE_METRICS_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local.h"
+#include "base/time/time.h"
+
+namespace sippet {
+
+class MetricsRegistry;
+
+// A count that only goes up, such as of the messages sent.
+class Counter {
+ public:
+  void Increment() { Add(1); }
+  void Add(int64 value);
+
+ private:
+  friend class MetricsRegistry;
+  Counter(MetricsRegistry *registry, size_t cell);
+
+  MetricsRegistry *registry_;
+  size_t cell_;
+
+  DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+// A value that goes up and down, such as the number of live transactions.
+// It can be raised on a thread and lowered on another.
+class Gauge {
+ public:
+  void Increment() { Add(1); }
+  void Decrement() { Add(-1); }
+  void Add(int64 delta);
+
+ private:
+  friend class MetricsRegistry;
+  Gauge(MetricsRegistry *registry, size_t cell);
+
+  MetricsRegistry *registry_;
+  size_t cell_;
+
+  DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
+// A distribution of durations, such as transaction latencies, counted in
+// buckets of fixed upper bounds.
+class Histogram {
+ public:
+  void AddTime(base::TimeDelta time);
+
+ private:
+  friend class MetricsRegistry;
+  Histogram(MetricsRegistry *registry, size_t cell,
+            const std::vector<base::TimeDelta> &bounds);
+
+  MetricsRegistry *registry_;
+  // The first of the bucket cells, followed by the two cells of the sum,
+  // in microseconds.
+  size_t cell_;
+  std::vector<base::TimeDelta> bounds_;
+
+  DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+// The value of a metric at the time of a snapshot.
+struct MetricSnapshot {
+  enum Type {
+    TYPE_COUNTER,
+    TYPE_GAUGE,
+    TYPE_HISTOGRAM,
+  };
+
+  MetricSnapshot();
+  ~MetricSnapshot();
+
+  Type type;
+  std::string name;
+  std::string help;
+  std::string labels;
+  // The value of counters and gauges.
+  int64 value;
+  // Histograms only: the upper bounds of the buckets, with the count of
+  // each bucket, plus the count of the values above the last bound.
+  std::vector<base::TimeDelta> bounds;
+  std::vector<int64> counts;
+  // Histograms only: the sum of the values.
+  base::TimeDelta sum;
+};
+
+// MetricsRegistry holds the counters, gauges and histograms of the stack.
+//
+// Updating a metric is cheap and lock-free: each thread updates a shard of
+// its own, which only that thread writes to, and the shards are summed when
+// the metrics are read. Shards of exited threads are kept, so that counts
+// never go down.
+//
+// Metrics are registered once, usually at startup, and the returned
+// pointers are kept by the code updating them. Metrics sharing a name make
+// a family, told apart by their labels, such as method="INVITE". Values are
+// machine words in each shard: on 32-bit platforms, a counter updated by a
+// single thread wraps around at 2^31. Histogram sums take 64 bits on every
+// platform.
+class MetricsRegistry {
+ public:
+  MetricsRegistry();
+  ~MetricsRegistry();
+
+  // The registry the stack registers its metrics in.
+  static MetricsRegistry *GetInstance();
+
+  // Returns the metric of |name| and |labels|, registering it the first
+  // time. |labels| is a comma-separated list of name="value" pairs, or
+  // empty.
+  Counter *GetCounter(const std::string &name, const std::string &help,
+                      const std::string &labels);
+  Gauge *GetGauge(const std::string &name, const std::string &help,
+                  const std::string &labels);
+  Histogram *GetHistogram(const std::string &name, const std::string &help,
+                          const std::string &labels,
+                          const std::vector<base::TimeDelta> &bounds);
+
+  // Reads all the metrics, sorted by name and labels.
+  void TakeSnapshot(std::vector<MetricSnapshot> *snapshot) const;
+
+  // Formats |snapshot| in the Prometheus text exposition format, version
+  // 0.0.4. Durations are given in seconds.
+  static std::string FormatPrometheusText(
+      const std::vector<MetricSnapshot> &snapshot);
+
+  // Shortcut of the two above, for serving the metrics.
+  std::string ToPrometheusText() const;
+
+ private:
+  friend class Counter;
+  friend class Gauge;
+  friend class Histogram;
+
+  struct Metric;
+  class Shard;
+
+  Metric *GetMetric(MetricSnapshot::Type type, const std::string &name,
+                    const std::string &help, const std::string &labels,
+                    const std::vector<base::TimeDelta> &bounds);
+
+  void AddToCell(size_t cell, int64 value);
+  Shard *GetShard();
+
+  mutable base::Lock lock_;
+  // Metrics by name and labels.
+  std::map<std::string, Metric*> metrics_;
+  ScopedVector<Metric> owned_metrics_;
+  size_t cell_count_;
+  ScopedVector<Shard> shards_;
+  base::ThreadLocalPointer<Shard> current_shard_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_BASE_METRICS_H_
@@ -0,0 +1,150 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/metrics.h"
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/single_thread_task_runner.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+void AddToCounter(Counter *counter, int times) {
+  for (int i = 0; i < times; ++i)
+    counter->Increment();
+}
+
+}  // namespace
+
+TEST(MetricsRegistryTest, SumsThreads) {
+  MetricsRegistry registry;
+  Counter *counter = registry.GetCounter("requests_total", "Requests.", "");
+  Gauge *gauge = registry.GetGauge("transactions", "Transactions.", "");
+  counter->Add(5);
+  gauge->Add(3);
+
+  base::Thread thread("MetricsRegistryTest");
+  ASSERT_TRUE(thread.Start());
+  thread.task_runner()->PostTask(FROM_HERE,
+      base::Bind(&AddToCounter, counter, 10));
+  // Lowered on a thread other than the one that raised it.
+  thread.task_runner()->PostTask(FROM_HERE, base::Bind(&Gauge::Add,
+      base::Unretained(gauge), static_cast<int64>(-2)));
+  thread.Stop();
+
+  std::vector<MetricSnapshot> snapshot;
+  registry.TakeSnapshot(&snapshot);
+  ASSERT_EQ(2u, snapshot.size());
+  EXPECT_EQ("requests_total", snapshot[0].name);
+  EXPECT_EQ(MetricSnapshot::TYPE_COUNTER, snapshot[0].type);
+  EXPECT_EQ(15, snapshot[0].value);
+  EXPECT_EQ("transactions", snapshot[1].name);
+  EXPECT_EQ(MetricSnapshot::TYPE_GAUGE, snapshot[1].type);
+  EXPECT_EQ(1, snapshot[1].value);
+}
+
+TEST(MetricsRegistryTest, RegistersOnce) {
+  MetricsRegistry registry;
+  Counter *invite = registry.GetCounter("requests_total", "Requests.",
+                                        "method=\"INVITE\"");
+  Counter *bye = registry.GetCounter("requests_total", "Requests.",
+                                     "method=\"BYE\"");
+  EXPECT_NE(invite, bye);
+  EXPECT_EQ(invite, registry.GetCounter("requests_total", "Requests.",
+                                        "method=\"INVITE\""));
+}
+
+TEST(MetricsRegistryTest, Histogram) {
+  MetricsRegistry registry;
+  std::vector<base::TimeDelta> bounds;
+  bounds.push_back(base::TimeDelta::FromMilliseconds(10));
+  bounds.push_back(base::TimeDelta::FromMilliseconds(100));
+  Histogram *histogram = registry.GetHistogram("latency_seconds",
+      "Latency.", "", bounds);
+  histogram->AddTime(base::TimeDelta::FromMilliseconds(5));
+  histogram->AddTime(base::TimeDelta::FromMilliseconds(10));
+  histogram->AddTime(base::TimeDelta::FromMilliseconds(50));
+  histogram->AddTime(base::TimeDelta::FromSeconds(1));
+
+  std::vector<MetricSnapshot> snapshot;
+  registry.TakeSnapshot(&snapshot);
+  ASSERT_EQ(1u, snapshot.size());
+  ASSERT_EQ(3u, snapshot[0].counts.size());
+  EXPECT_EQ(2, snapshot[0].counts[0]);
+  EXPECT_EQ(1, snapshot[0].counts[1]);
+  EXPECT_EQ(1, snapshot[0].counts[2]);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(1065), snapshot[0].sum);
+}
+
+TEST(MetricsRegistryTest, HistogramSumDoesNotWrap) {
+  MetricsRegistry registry;
+  std::vector<base::TimeDelta> bounds;
+  bounds.push_back(base::TimeDelta::FromSeconds(1));
+  Histogram *histogram = registry.GetHistogram("latency_seconds",
+      "Latency.", "", bounds);
+  // Past 2^32 microseconds with the first value.
+  histogram->AddTime(base::TimeDelta::FromDays(30));
+  histogram->AddTime(base::TimeDelta::FromDays(30));
+  histogram->AddTime(base::TimeDelta::FromMilliseconds(5));
+
+  std::vector<MetricSnapshot> snapshot;
+  registry.TakeSnapshot(&snapshot);
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ(1, snapshot[0].counts[0]);
+  EXPECT_EQ(2, snapshot[0].counts[1]);
+  EXPECT_EQ(base::TimeDelta::FromDays(60) +
+            base::TimeDelta::FromMilliseconds(5), snapshot[0].sum);
+}
+
+TEST(MetricsRegistryTest, HistogramSumKeepsMicroseconds) {
+  MetricsRegistry registry;
+  std::vector<base::TimeDelta> bounds;
+  bounds.push_back(base::TimeDelta::FromMilliseconds(1));
+  Histogram *histogram = registry.GetHistogram("latency_seconds",
+      "Latency.", "", bounds);
+  histogram->AddTime(base::TimeDelta::FromMicroseconds(250));
+  histogram->AddTime(base::TimeDelta::FromMicroseconds(400));
+  histogram->AddTime(base::TimeDelta::FromMicroseconds(900));
+
+  std::vector<MetricSnapshot> snapshot;
+  registry.TakeSnapshot(&snapshot);
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ(3, snapshot[0].counts[0]);
+  EXPECT_EQ(base::TimeDelta::FromMicroseconds(1550), snapshot[0].sum);
+}
+
+TEST(MetricsRegistryTest, PrometheusText) {
+  MetricsRegistry registry;
+  registry.GetCounter("requests_total", "Requests.", "method=\"INVITE\"")
+      ->Add(2);
+  registry.GetCounter("requests_total", "Requests.", "method=\"BYE\"")
+      ->Increment();
+  registry.GetGauge("dialogs", "Dialogs.", "")->Add(4);
+  std::vector<base::TimeDelta> bounds;
+  bounds.push_back(base::TimeDelta::FromMilliseconds(500));
+  registry.GetHistogram("latency_seconds", "Latency.", "type=\"invite\"",
+                        bounds)->AddTime(base::TimeDelta::FromSeconds(2));
+
+  EXPECT_EQ(
+      "# HELP dialogs Dialogs.\n"
+      "# TYPE dialogs gauge\n"
+      "dialogs 4\n"
+      "# HELP latency_seconds Latency.\n"
+      "# TYPE latency_seconds histogram\n"
+      "latency_seconds_bucket{type=\"invite\",le=\"0.5\"} 0\n"
+      "latency_seconds_bucket{type=\"invite\",le=\"+Inf\"} 1\n"
+      "latency_seconds_sum{type=\"invite\"} 2\n"
+      "latency_seconds_count{type=\"invite\"} 1\n"
+      "# HELP requests_total Requests.\n"
+      "# TYPE requests_total counter\n"
+      "requests_total{method=\"BYE\"} 1\n"
+      "requests_total{method=\"INVITE\"} 2\n",
+      registry.ToPrometheusText());
+}
+
+} // namespace sippet
@@ -420,4 +420,19 @@ void raw_string_ostream::write_impl(const char *Ptr, size_t Size) {
   OS.append(Ptr, Size);
 }
 
+//===----------------------------------------------------------------------===//
+//  raw_null_ostream
+//===----------------------------------------------------------------------===//
+
+raw_null_ostream::~raw_null_ostream() {
+}
+
+uint64 raw_null_ostream::current_pos() const {
+  return Count;
+}
+
+void raw_null_ostream::write_impl(const char *Ptr, size_t Size) {
+  Count += Size;
+}
+
 }  // namespace sippet
@@ -289,6 +289,23 @@ public:
   }
 };
 
+/// raw_null_ostream - A raw_ostream that discards all output, counting the
+/// bytes written to it, as returned by tell().
+class raw_null_ostream : public raw_ostream {
+  uint64 Count;
+
+  /// write_impl - See raw_ostream::write_impl.
+  void write_impl(const char *Ptr, size_t Size) override;
+
+  /// current_pos - Return the current position within the stream, not
+  /// counting the bytes currently in the buffer.
+  uint64 current_pos() const override;
+
+public:
+  raw_null_ostream() : raw_ostream(true), Count(0) {}
+  ~raw_null_ostream() override;
+};
+
 } // End of sippet namespace
 
 #endif // SIPPET_BASE_RAW_OSTREAM_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/timer_wheel.h"
+
+#include "base/logging.h"
+
+namespace sippet {
+
+TimerWheel::TimerWheel(size_t slot_count)
+  : slots_(slot_count),
+    current_(0),
+    size_(0) {
+  DCHECK_GT(slot_count, 0u);
+}
+
+TimerWheel::~TimerWheel() {
+}
+
+void TimerWheel::Schedule(uint32 id, uint32 ticks) {
+  Cancel(id);
+  if (ticks == 0)
+    ticks = 1;
+  size_t slot_count = slots_.size();
+  size_t distance = ticks % slot_count;
+  if (distance == 0)
+    distance = slot_count;
+  Entry entry;
+  entry.id = id;
+  entry.rounds = static_cast<uint32>((ticks - distance) / slot_count);
+  size_t slot = (current_ + distance) % slot_count;
+  if (id >= locations_.size()) {
+    Location unused = { kNotScheduled, 0 };
+    locations_.resize(id + 1, unused);
+  }
+  locations_[id].slot = static_cast<uint32>(slot);
+  locations_[id].index = static_cast<uint32>(slots_[slot].size());
+  slots_[slot].push_back(entry);
+  ++size_;
+}
+
+void TimerWheel::Cancel(uint32 id) {
+  if (!IsScheduled(id))
+    return;
+  Remove(locations_[id].slot, locations_[id].index);
+}
+
+bool TimerWheel::IsScheduled(uint32 id) const {
+  return id < locations_.size() && locations_[id].slot != kNotScheduled;
+}
+
+void TimerWheel::Advance(std::vector<uint32> *expired) {
+  current_ = (current_ + 1) % slots_.size();
+  std::vector<Entry> &entries = slots_[current_];
+  for (size_t i = 0; i < entries.size();) {
+    if (entries[i].rounds > 0) {
+      --entries[i].rounds;
+      ++i;
+      continue;
+    }
+    expired->push_back(entries[i].id);
+    Remove(static_cast<uint32>(current_), static_cast<uint32>(i));
+  }
+}
+
+void TimerWheel::Remove(uint32 slot, uint32 index) {
+  std::vector<Entry> &entries = slots_[slot];
+  locations_[entries[index].id].slot = kNotScheduled;
+  if (index + 1 != entries.size()) {
+    entries[index] = entries.back();
+    locations_[entries[index].id].index = index;
+  }
+  entries.pop_back();
+  --size_;
+}
+
+} // End of sippet namespace
@@ -0,0 +1,72 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_BASE_TIMER_WHEEL_H_
+#define SIPPET_BASE_TIMER_WHEEL_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace sippet {
+
+// A hashed timing wheel, for large numbers of timers that don't need more
+// precision than a tick, such as registration refreshes or binding expiries.
+// Timers are identified by small integers, typically indexes into a table
+// owned by the user, and are driven by a single periodic timer calling
+// |Advance|.
+//
+// Scheduling, rescheduling and cancelling a timer are O(1), and advancing the
+// wheel only looks at the timers hashed to the current slot.
+class TimerWheel {
+ public:
+  explicit TimerWheel(size_t slot_count);
+  ~TimerWheel();
+
+  // Schedules |id| to expire after |ticks| calls to |Advance|, replacing any
+  // previous schedule of |id|. Zero is the same as one tick.
+  void Schedule(uint32 id, uint32 ticks);
+
+  // Cancels the timer of |id|, if scheduled.
+  void Cancel(uint32 id);
+
+  bool IsScheduled(uint32 id) const;
+
+  // Moves the wheel one tick forward, appending the expired timers to
+  // |expired|.
+  void Advance(std::vector<uint32> *expired);
+
+  // Number of scheduled timers.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  struct Entry {
+    uint32 id;
+    // Full turns of the wheel left before the timer expires.
+    uint32 rounds;
+  };
+
+  struct Location {
+    uint32 slot;
+    uint32 index;
+  };
+
+  enum { kNotScheduled = 0xffffffff };
+
+  void Remove(uint32 slot, uint32 index);
+
+  std::vector<std::vector<Entry> > slots_;
+  // Where each id is stored in |slots_|, indexed by id.
+  std::vector<Location> locations_;
+  size_t current_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_BASE_TIMER_WHEEL_H_
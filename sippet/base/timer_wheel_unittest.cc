@@ -0,0 +1,79 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/base/timer_wheel.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+// Advances |wheel| |ticks| times, returning the timers expired in the last
+// tick.
+std::vector<uint32> AdvanceBy(TimerWheel *wheel, int ticks) {
+  std::vector<uint32> expired;
+  for (int i = 0; i < ticks; ++i) {
+    expired.clear();
+    wheel->Advance(&expired);
+  }
+  return expired;
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, ExpiresAfterTicks) {
+  TimerWheel wheel(8);
+  wheel.Schedule(1, 3);
+  wheel.Schedule(2, 3);
+  wheel.Schedule(3, 5);
+  EXPECT_EQ(3u, wheel.size());
+
+  EXPECT_TRUE(AdvanceBy(&wheel, 2).empty());
+  std::vector<uint32> expired(AdvanceBy(&wheel, 1));
+  ASSERT_EQ(2u, expired.size());
+  EXPECT_FALSE(wheel.IsScheduled(1));
+  EXPECT_FALSE(wheel.IsScheduled(2));
+  EXPECT_TRUE(wheel.IsScheduled(3));
+
+  EXPECT_TRUE(AdvanceBy(&wheel, 1).empty());
+  expired = AdvanceBy(&wheel, 1);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(3u, expired[0]);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, LongerThanOneTurn) {
+  TimerWheel wheel(8);
+  wheel.Schedule(1, 8);
+  wheel.Schedule(2, 20);
+  EXPECT_TRUE(AdvanceBy(&wheel, 7).empty());
+  std::vector<uint32> expired(AdvanceBy(&wheel, 1));
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(1u, expired[0]);
+  EXPECT_TRUE(AdvanceBy(&wheel, 11).empty());
+  expired = AdvanceBy(&wheel, 1);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(2u, expired[0]);
+}
+
+TEST(TimerWheelTest, RescheduleAndCancel) {
+  TimerWheel wheel(8);
+  wheel.Schedule(1, 2);
+  wheel.Schedule(2, 2);
+  wheel.Schedule(3, 2);
+  wheel.Cancel(1);
+  wheel.Schedule(2, 4);
+  EXPECT_EQ(2u, wheel.size());
+
+  std::vector<uint32> expired(AdvanceBy(&wheel, 2));
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(3u, expired[0]);
+  expired = AdvanceBy(&wheel, 2);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(2u, expired[0]);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+} // namespace sippet
@@ -0,0 +1,95 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_BASE_TRACING_H_
+#define SIPPET_BASE_TRACING_H_
+
+// Trace events of the SIP stack, recorded by the Chromium tracing
+// infrastructure in the "sippet" category and viewable in chrome://tracing.
+//
+// Spans cover the hot paths: parsing and serializing, transactions, channels,
+// dialogs, digests and the call setup of the phone. Spans handling a message
+// of a transaction carry the flow of that transaction, identified by
+// |Message::GetTransactionTraceId|, so that a request can be followed across
+// the spans and threads that processed it, from the transaction creation to
+// its termination. Spans nested in a span carrying a flow are shown within it.
+//
+// When the category is disabled, each macro costs a load and a test of a
+// cached flag, and their arguments aren't evaluated. Building with
+// sippet_enable_tracing=0 compiles them out.
+
+#if defined(SIPPET_ENABLE_TRACING)
+
+#include "base/trace_event/trace_event.h"
+
+#define SIPPET_TRACE_CATEGORY "sippet"
+
+// The name of the flows of transactions.
+#define SIPPET_TRACE_TRANSACTION_FLOW "SipTransaction"
+
+// Records a span of |name| until the end of the enclosing scope.
+#define SIPPET_TRACE_EVENT0(name) \
+  TRACE_EVENT0(SIPPET_TRACE_CATEGORY, name)
+#define SIPPET_TRACE_EVENT1(name, arg_name, arg_value) \
+  TRACE_EVENT1(SIPPET_TRACE_CATEGORY, name, arg_name, arg_value)
+
+// Records spans that begin and end in different scopes, such as connects,
+// possibly on different threads. |id| tells apart concurrent spans of the
+// same |name|, and steps split them into stages.
+#define SIPPET_TRACE_ASYNC_BEGIN0(name, id) \
+  TRACE_EVENT_ASYNC_BEGIN0(SIPPET_TRACE_CATEGORY, name, id)
+#define SIPPET_TRACE_ASYNC_STEP_INTO0(name, id, step) \
+  TRACE_EVENT_ASYNC_STEP_INTO0(SIPPET_TRACE_CATEGORY, name, id, step)
+#define SIPPET_TRACE_ASYNC_END1(name, id, arg_name, arg_value) \
+  TRACE_EVENT_ASYNC_END1(SIPPET_TRACE_CATEGORY, name, id, arg_name, \
+                         arg_value)
+
+// Attach the enclosing span to the flow of the transaction |id|. The flow
+// begins with the transaction and ends with it. Zero ids are ignored.
+#define SIPPET_TRACE_FLOW_BEGIN(id) \
+  INTERNAL_SIPPET_TRACE_FLOW(TRACE_EVENT_FLOW_BEGIN0, id)
+#define SIPPET_TRACE_FLOW_STEP(id) \
+  INTERNAL_SIPPET_TRACE_FLOW(INTERNAL_SIPPET_TRACE_FLOW_STEP0, id)
+#define SIPPET_TRACE_FLOW_END(id) \
+  INTERNAL_SIPPET_TRACE_FLOW(TRACE_EVENT_FLOW_END_BIND_TO_ENCLOSING0, id)
+
+// Shortcut for a span of |name| in the flow of the transaction |id|.
+#define SIPPET_TRACE_EVENT_WITH_FLOW0(name, id) \
+  SIPPET_TRACE_EVENT0(name);                    \
+  SIPPET_TRACE_FLOW_STEP(id)
+
+// Implementation details, not to be used directly.
+#define INTERNAL_SIPPET_TRACE_FLOW_STEP0(category, name, id) \
+  TRACE_EVENT_FLOW_STEP0(category, name, id, "")
+
+#define INTERNAL_SIPPET_TRACE_FLOW(flow_macro, id)                      \
+  do {                                                                  \
+    bool sippet_trace_enabled;                                          \
+    TRACE_EVENT_CATEGORY_GROUP_ENABLED(SIPPET_TRACE_CATEGORY,           \
+                                       &sippet_trace_enabled);          \
+    if (sippet_trace_enabled) {                                         \
+      uint64 sippet_trace_id = (id);                                    \
+      if (sippet_trace_id) {                                            \
+        flow_macro(SIPPET_TRACE_CATEGORY,                               \
+                   SIPPET_TRACE_TRANSACTION_FLOW, sippet_trace_id);     \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+#else  // !defined(SIPPET_ENABLE_TRACING)
+
+#define SIPPET_TRACE_EVENT0(name) static_cast<void>(0)
+#define SIPPET_TRACE_EVENT1(name, arg_name, arg_value) static_cast<void>(0)
+#define SIPPET_TRACE_ASYNC_BEGIN0(name, id) static_cast<void>(0)
+#define SIPPET_TRACE_ASYNC_STEP_INTO0(name, id, step) static_cast<void>(0)
+#define SIPPET_TRACE_ASYNC_END1(name, id, arg_name, arg_value) \
+  static_cast<void>(0)
+#define SIPPET_TRACE_FLOW_BEGIN(id) static_cast<void>(0)
+#define SIPPET_TRACE_FLOW_STEP(id) static_cast<void>(0)
+#define SIPPET_TRACE_FLOW_END(id) static_cast<void>(0)
+#define SIPPET_TRACE_EVENT_WITH_FLOW0(name, id) static_cast<void>(0)
+
+#endif  // defined(SIPPET_ENABLE_TRACING)
+
+#endif  // SIPPET_BASE_TRACING_H_
@@ -0,0 +1,102 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/examples/loadgen/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/logging.h"
+
+namespace {
+
+// 3 significant digits need 2048 sub-buckets per bucket; the first half of
+// each bucket but the first overlaps the previous one, so it isn't stored.
+const int kSubBucketHalfCountMagnitude = 10;
+const int64 kSubBucketHalfCount = 1 << kSubBucketHalfCountMagnitude;
+const int64 kSubBucketMask = kSubBucketHalfCount * 2 - 1;
+
+// An hour, in microseconds.
+const int64 kHighestTrackableValue = 3600LL * 1000 * 1000;
+
+int Log2Floor(uint64 n) {
+  DCHECK_NE(0u, n);
+  int log = 0;
+  for (int shift = 32; shift > 0; shift >>= 1) {
+    if (n >> shift) {
+      n >>= shift;
+      log += shift;
+    }
+  }
+  return log;
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+  : total_count_(0),
+    max_value_(0) {
+  int bucket_count = 1;
+  for (int64 smallest_untrackable = kSubBucketMask + 1;
+       smallest_untrackable <= kHighestTrackableValue;
+       smallest_untrackable <<= 1) {
+    ++bucket_count;
+  }
+  counts_.resize((bucket_count + 1) * kSubBucketHalfCount);
+}
+
+LatencyHistogram::~LatencyHistogram() {
+}
+
+void LatencyHistogram::Record(base::TimeDelta latency) {
+  int64 value = std::min(latency.InMicroseconds(), kHighestTrackableValue);
+  value = std::max(value, static_cast<int64>(0));
+  ++counts_[GetIndex(value)];
+  ++total_count_;
+  max_value_ = std::max(max_value_, value);
+}
+
+base::TimeDelta LatencyHistogram::GetPercentile(double percentile) const {
+  if (0 == total_count_)
+    return base::TimeDelta();
+  int64 target = static_cast<int64>(
+      std::ceil(std::min(percentile, 100.0) / 100 * total_count_));
+  target = std::max(target, static_cast<int64>(1));
+  int64 running_count = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    running_count += counts_[i];
+    if (running_count >= target) {
+      return base::TimeDelta::FromMicroseconds(
+          std::min(GetHighestEquivalentValue(i), max_value_));
+    }
+  }
+  return max();
+}
+
+base::TimeDelta LatencyHistogram::max() const {
+  return base::TimeDelta::FromMicroseconds(max_value_);
+}
+
+size_t LatencyHistogram::GetIndex(int64 value) const {
+  int bucket_index = Log2Floor(value | kSubBucketMask)
+      - kSubBucketHalfCountMagnitude;
+  int64 sub_bucket_index = value >> bucket_index;
+  return static_cast<size_t>(
+      ((bucket_index + 1) << kSubBucketHalfCountMagnitude)
+          + (sub_bucket_index - kSubBucketHalfCount));
+}
+
+int64 LatencyHistogram::GetHighestEquivalentValue(size_t index) const {
+  int bucket_index = static_cast<int>(index >> kSubBucketHalfCountMagnitude)
+      - 1;
+  int64 sub_bucket_index = (index & (kSubBucketHalfCount - 1))
+      + kSubBucketHalfCount;
+  if (bucket_index < 0) {
+    sub_bucket_index -= kSubBucketHalfCount;
+    bucket_index = 0;
+  }
+  int64 lowest_equivalent_value = sub_bucket_index << bucket_index;
+  int64 equivalent_range = static_cast<int64>(1) << bucket_index;
+  return lowest_equivalent_value + equivalent_range - 1;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_EXAMPLES_LOADGEN_LATENCY_HISTOGRAM_H_
+#define SIPPET_EXAMPLES_LOADGEN_LATENCY_HISTOGRAM_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// A high dynamic range histogram of latencies, in the layout of
+// HdrHistogram: values are kept with 3 significant digits, from 1
+// microsecond up to an hour, in buckets whose width doubles with the
+// magnitude. Recording is O(1) and doesn't allocate, so it can be done for
+// every transaction, and the memory used doesn't depend on their number.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  // Latencies beyond an hour are recorded as an hour.
+  void Record(base::TimeDelta latency);
+
+  int64 count() const { return total_count_; }
+
+  // The latency at or below which |percentile| percent of the values are,
+  // within the precision of the histogram. Zero if empty.
+  base::TimeDelta GetPercentile(double percentile) const;
+
+  base::TimeDelta max() const;
+
+ private:
+  size_t GetIndex(int64 value) const;
+  int64 GetHighestEquivalentValue(size_t index) const;
+
+  std::vector<int64> counts_;
+  int64 total_count_;
+  int64 max_value_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+#endif // SIPPET_EXAMPLES_LOADGEN_LATENCY_HISTOGRAM_H_
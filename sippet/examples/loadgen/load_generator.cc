@@ -0,0 +1,338 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/examples/loadgen/load_generator.h"
+
+#include "base/bind.h"
+#include "base/callback_helpers.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "net/base/net_errors.h"
+#include "sippet/base/tags.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+
+namespace {
+
+const int64 kTickMilliseconds = 1;
+const size_t kWheelSlots = 1024;
+
+// Time given to the outstanding operations to complete once the load has
+// been generated: enough for INVITE and BYE transactions to time out.
+const int64 kDrainSeconds = 64;
+
+const char *kScenarioNames[] = { "register", "call" };
+const char *kTransactionNames[] = { "REGISTER", "INVITE", "BYE" };
+
+base::TimeDelta Tick() {
+  return base::TimeDelta::FromMilliseconds(kTickMilliseconds);
+}
+
+}  // namespace
+
+LoadGenerator::Settings::Settings()
+  : register_rate(0),
+    call_rate(0),
+    max_outstanding(100000) {
+}
+
+LoadGenerator::Settings::~Settings() {
+}
+
+LoadGenerator::Stream::Stream()
+  : rate(0),
+    scheduled(0),
+    skipped(0) {
+}
+
+LoadGenerator::Stream::~Stream() {
+}
+
+LoadGenerator::Operation::Operation() {
+}
+
+LoadGenerator::Operation::~Operation() {
+}
+
+LoadGenerator::LoadGenerator(sippet::ua::UserAgent *user_agent,
+                             const Settings &settings)
+  : user_agent_(user_agent),
+    settings_(settings),
+    hangup_wheel_(kWheelSlots),
+    weak_factory_(this) {
+  for (int i = 0; i < TRANSACTION_MAX; ++i)
+    errors_[i] = 0;
+
+  // The headers common to all operations of a scenario are printed once.
+  streams_[SCENARIO_REGISTER].rate = settings_.register_rate;
+  streams_[SCENARIO_REGISTER].request_template =
+      user_agent_->CreateRequestTemplate(sippet::Method::REGISTER,
+          settings_.registrar_uri, settings_.local_uri, settings_.local_uri);
+  streams_[SCENARIO_CALL].rate = settings_.call_rate;
+  streams_[SCENARIO_CALL].request_template =
+      user_agent_->CreateRequestTemplate(sippet::Method::INVITE,
+          settings_.call_uri, settings_.local_uri, settings_.call_uri);
+}
+
+LoadGenerator::~LoadGenerator() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+}
+
+void LoadGenerator::Start(const base::Closure &done) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(done_.is_null());
+  done_ = done;
+  start_time_ = base::TimeTicks::Now();
+  end_time_ = start_time_ + settings_.duration;
+  drain_deadline_ = end_time_ + settings_.call_duration
+      + base::TimeDelta::FromSeconds(kDrainSeconds);
+  wheel_time_ = start_time_;
+  tick_timer_.Start(FROM_HERE, Tick(), this, &LoadGenerator::OnTick);
+}
+
+void LoadGenerator::PrintReport(std::ostream &os) const {
+  os << base::StringPrintf("%-10s %10s %10s %10s\n",
+      "scenario", "offered/s", "started", "skipped");
+  for (int i = 0; i < SCENARIO_MAX; ++i) {
+    const Stream &stream = streams_[i];
+    if (stream.rate <= 0)
+      continue;
+    os << base::StringPrintf("%-10s %10.1f %10lld %10lld\n",
+        kScenarioNames[i], stream.rate,
+        static_cast<long long>(stream.scheduled - stream.skipped),
+        static_cast<long long>(stream.skipped));
+  }
+  os << "\n";
+  os << base::StringPrintf("%-10s %10s %8s %9s %9s %9s %9s %9s\n",
+      "latency", "count", "errors", "p50 ms", "p90 ms", "p99 ms",
+      "p99.9 ms", "max ms");
+  for (int i = 0; i < TRANSACTION_MAX; ++i) {
+    const LatencyHistogram &histogram = histograms_[i];
+    if (0 == histogram.count() && 0 == errors_[i])
+      continue;
+    os << base::StringPrintf(
+        "%-10s %10lld %8lld %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+        kTransactionNames[i],
+        static_cast<long long>(histogram.count()),
+        static_cast<long long>(errors_[i]),
+        histogram.GetPercentile(50).InMillisecondsF(),
+        histogram.GetPercentile(90).InMillisecondsF(),
+        histogram.GetPercentile(99).InMillisecondsF(),
+        histogram.GetPercentile(99.9).InMillisecondsF(),
+        histogram.max().InMillisecondsF());
+  }
+}
+
+void LoadGenerator::OnChannelConnected(const sippet::EndPoint &destination,
+                                       int err) {
+  if (net::OK != err) {
+    LOG(WARNING) << "Couldn't connect to " << destination.ToString()
+                 << ": " << net::ErrorToString(err);
+  }
+}
+
+void LoadGenerator::OnChannelClosed(const sippet::EndPoint &destination) {
+}
+
+void LoadGenerator::OnIncomingRequest(
+    const scoped_refptr<sippet::Request> &incoming_request,
+    const scoped_refptr<sippet::Dialog> &dialog) {
+  // Calls are only hung up by the generator; requests from the server,
+  // such as early BYEs, are left to time out on its side.
+}
+
+void LoadGenerator::OnIncomingResponse(
+    const scoped_refptr<sippet::Response> &incoming_response,
+    const scoped_refptr<sippet::Dialog> &dialog) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (incoming_response->response_code() < 200)
+    return;
+  uint32 slot;
+  if (!FindSlot(incoming_response->get<sippet::CallId>()->value(), &slot))
+    return;
+  Operation &operation = operations_[slot];
+  bool success = incoming_response->response_code() < 300;
+  sippet::Method method(incoming_response->get<sippet::Cseq>()->method());
+
+  if (sippet::Method::INVITE == method) {
+    // Retransmissions of the 2xx are ignored.
+    if (!operation.invite)
+      return;
+    if (!success || !dialog) {
+      ++errors_[TRANSACTION_INVITE];
+      ReleaseSlot(slot);
+      return;
+    }
+    RecordLatency(TRANSACTION_INVITE, slot);
+    scoped_refptr<sippet::Request> invite;
+    invite.swap(operation.invite);
+    operation.dialog = dialog;
+    SendRequest(dialog->CreateAck(invite));
+    operation.due = base::TimeTicks::Now() + settings_.call_duration;
+    if (settings_.call_duration < Tick()) {
+      HangUp(slot);
+    } else {
+      hangup_wheel_.Schedule(slot, static_cast<uint32>(
+          settings_.call_duration.InMilliseconds() / kTickMilliseconds));
+    }
+    return;
+  }
+
+  Transaction transaction = sippet::Method::REGISTER == method
+      ? TRANSACTION_REGISTER : TRANSACTION_BYE;
+  if (success)
+    RecordLatency(transaction, slot);
+  else
+    ++errors_[transaction];
+  ReleaseSlot(slot);
+}
+
+void LoadGenerator::OnTimedOut(
+    const scoped_refptr<sippet::Request> &request,
+    const scoped_refptr<sippet::Dialog> &dialog) {
+  FailRequest(request);
+}
+
+void LoadGenerator::OnTransportError(
+    const scoped_refptr<sippet::Request> &request, int error,
+    const scoped_refptr<sippet::Dialog> &dialog) {
+  FailRequest(request);
+}
+
+void LoadGenerator::OnTick() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  base::TimeTicks now = base::TimeTicks::Now();
+
+  // Catch up with the ticks missed while the loop was busy.
+  while (wheel_time_ + Tick() <= now) {
+    wheel_time_ += Tick();
+    hangup_wheel_.Advance(&expired_);
+  }
+  for (size_t i = 0; i < expired_.size(); ++i)
+    HangUp(expired_[i]);
+  expired_.clear();
+
+  if (now < end_time_) {
+    StartDueOperations(SCENARIO_REGISTER, now);
+    StartDueOperations(SCENARIO_CALL, now);
+  } else if (slots_.empty() || now >= drain_deadline_) {
+    tick_timer_.Stop();
+    base::ResetAndReturn(&done_).Run();
+  }
+}
+
+void LoadGenerator::StartDueOperations(Scenario scenario,
+                                       base::TimeTicks now) {
+  Stream &stream = streams_[scenario];
+  if (stream.rate <= 0)
+    return;
+  int64 due_count = static_cast<int64>(
+      (now - start_time_).InSecondsF() * stream.rate);
+  while (stream.scheduled < due_count) {
+    base::TimeTicks due = start_time_ + base::TimeDelta::FromMicroseconds(
+        static_cast<int64>(stream.scheduled
+            * base::Time::kMicrosecondsPerSecond / stream.rate));
+    ++stream.scheduled;
+    if (slots_.size() >= settings_.max_outstanding) {
+      ++stream.skipped;
+      continue;
+    }
+    StartOperation(scenario, due);
+  }
+}
+
+void LoadGenerator::StartOperation(Scenario scenario, base::TimeTicks due) {
+  std::string call_id(sippet::CreateCallId());
+  scoped_refptr<sippet::Request> request;
+  if (SCENARIO_REGISTER == scenario) {
+    request = streams_[scenario].request_template->CreateRequest(
+        sippet::Method::REGISTER, 1, sippet::CreateTag(), call_id);
+  } else {
+    request = streams_[scenario].request_template->CreateRequest(
+        sippet::Method::INVITE, 1, sippet::CreateTag(), call_id);
+  }
+  uint32 slot = AllocateSlot(call_id);
+  operations_[slot].due = due;
+  if (SCENARIO_CALL == scenario)
+    operations_[slot].invite = request;
+  SendRequest(request);
+}
+
+void LoadGenerator::HangUp(uint32 slot) {
+  Operation &operation = operations_[slot];
+  DCHECK(operation.dialog);
+  scoped_refptr<sippet::Dialog> dialog;
+  dialog.swap(operation.dialog);
+  SendRequest(dialog->CreateRequest(sippet::Method::BYE));
+}
+
+void LoadGenerator::SendRequest(
+    const scoped_refptr<sippet::Request> &request) {
+  int rv = user_agent_->Send(request,
+      base::Bind(&LoadGenerator::OnRequestSent,
+                 weak_factory_.GetWeakPtr(), request));
+  if (net::ERR_IO_PENDING != rv)
+    OnRequestSent(request, rv);
+}
+
+void LoadGenerator::OnRequestSent(
+    const scoped_refptr<sippet::Request> &request, int rv) {
+  if (net::OK != rv)
+    FailRequest(request);
+}
+
+void LoadGenerator::FailRequest(
+    const scoped_refptr<sippet::Request> &request) {
+  // A lost ACK shows up as the failure of the BYE that follows.
+  if (sippet::Method::ACK == request->method())
+    return;
+  uint32 slot;
+  if (!FindSlot(request->get<sippet::CallId>()->value(), &slot))
+    return;
+  if (sippet::Method::REGISTER == request->method())
+    ++errors_[TRANSACTION_REGISTER];
+  else if (sippet::Method::INVITE == request->method())
+    ++errors_[TRANSACTION_INVITE];
+  else
+    ++errors_[TRANSACTION_BYE];
+  ReleaseSlot(slot);
+}
+
+bool LoadGenerator::FindSlot(const std::string &call_id,
+                             uint32 *slot) const {
+  SlotsMap::const_iterator i = slots_.find(call_id);
+  if (slots_.end() == i)
+    return false;
+  *slot = i->second;
+  return true;
+}
+
+uint32 LoadGenerator::AllocateSlot(const std::string &call_id) {
+  uint32 slot;
+  if (free_slots_.empty()) {
+    slot = static_cast<uint32>(operations_.size());
+    operations_.push_back(Operation());
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  operations_[slot].call_id = call_id;
+  slots_[call_id] = slot;
+  return slot;
+}
+
+void LoadGenerator::ReleaseSlot(uint32 slot) {
+  hangup_wheel_.Cancel(slot);
+  Operation &operation = operations_[slot];
+  slots_.erase(operation.call_id);
+  operation.call_id.clear();
+  operation.invite = nullptr;
+  operation.dialog = nullptr;
+  free_slots_.push_back(slot);
+}
+
+void LoadGenerator::RecordLatency(Transaction transaction, uint32 slot) {
+  histograms_[transaction].Record(
+      base::TimeTicks::Now() - operations_[slot].due);
+}
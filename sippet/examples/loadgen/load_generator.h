@@ -0,0 +1,169 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_EXAMPLES_LOADGEN_LOAD_GENERATOR_H_
+#define SIPPET_EXAMPLES_LOADGEN_LOAD_GENERATOR_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/containers/hash_tables.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "sippet/base/timer_wheel.h"
+#include "sippet/examples/loadgen/latency_histogram.h"
+#include "sippet/message/request_template.h"
+#include "sippet/ua/ua_user_agent.h"
+#include "url/gurl.h"
+
+// Generates registrations and calls against a SIP server at fixed rates.
+//
+// Scheduling is open-loop: operations start when they are due, whether the
+// previous ones have completed or not, and latencies are measured from the
+// time an operation was due rather than from the time it was sent. A slow
+// server therefore shows up in the latencies, instead of silently lowering
+// the offered load (the so-called coordinated omission).
+//
+// Requests are stamped from a |RequestTemplate| per scenario, calls are
+// kept up for a configurable time on a |TimerWheel|, and latencies are
+// recorded in |LatencyHistogram|s, so thousands of concurrent dialogs cost
+// little more than their own state.
+class LoadGenerator : public sippet::ua::UserAgent::Delegate {
+ public:
+  struct Settings {
+    Settings();
+    ~Settings();
+
+    // The Request-URI of REGISTER requests.
+    GURL registrar_uri;
+    // The Request-URI of INVITE requests.
+    GURL call_uri;
+    // The address of record of the generated requests.
+    GURL local_uri;
+    // Operations per second. Zero disables the scenario.
+    double register_rate;
+    double call_rate;
+    // Time between the ACK and the BYE of each call.
+    base::TimeDelta call_duration;
+    // Time during which new operations are started.
+    base::TimeDelta duration;
+    // Operations due while this many are outstanding are not started, and
+    // are reported as skipped.
+    size_t max_outstanding;
+  };
+
+  LoadGenerator(sippet::ua::UserAgent *user_agent, const Settings &settings);
+  ~LoadGenerator() override;
+
+  // Starts generating load. |done| is run once |Settings::duration| has
+  // elapsed and the outstanding operations have completed or timed out.
+  void Start(const base::Closure &done);
+
+  void PrintReport(std::ostream &os) const;
+
+  // sippet::ua::UserAgent::Delegate methods:
+  void OnChannelConnected(const sippet::EndPoint &destination,
+                          int err) override;
+  void OnChannelClosed(const sippet::EndPoint &destination) override;
+  void OnIncomingRequest(
+      const scoped_refptr<sippet::Request> &incoming_request,
+      const scoped_refptr<sippet::Dialog> &dialog) override;
+  void OnIncomingResponse(
+      const scoped_refptr<sippet::Response> &incoming_response,
+      const scoped_refptr<sippet::Dialog> &dialog) override;
+  void OnTimedOut(
+      const scoped_refptr<sippet::Request> &request,
+      const scoped_refptr<sippet::Dialog> &dialog) override;
+  void OnTransportError(
+      const scoped_refptr<sippet::Request> &request, int error,
+      const scoped_refptr<sippet::Dialog> &dialog) override;
+
+ private:
+  enum Scenario {
+    SCENARIO_REGISTER,
+    SCENARIO_CALL,
+    SCENARIO_MAX,
+  };
+
+  enum Transaction {
+    TRANSACTION_REGISTER,
+    TRANSACTION_INVITE,
+    TRANSACTION_BYE,
+    TRANSACTION_MAX,
+  };
+
+  struct Stream {
+    Stream();
+    ~Stream();
+
+    double rate;
+    scoped_refptr<sippet::RequestTemplate> request_template;
+    // Operations due so far.
+    int64 scheduled;
+    int64 skipped;
+  };
+
+  // Operations are stored in slots, which double as timer ids.
+  struct Operation {
+    Operation();
+    ~Operation();
+
+    std::string call_id;
+    // When the current transaction was due.
+    base::TimeTicks due;
+    // The INVITE of a call, until it is acknowledged.
+    scoped_refptr<sippet::Request> invite;
+    // The dialog of an established call, until it is hung up.
+    scoped_refptr<sippet::Dialog> dialog;
+  };
+
+  typedef base::hash_map<std::string, uint32> SlotsMap;
+
+  void OnTick();
+  void StartDueOperations(Scenario scenario, base::TimeTicks now);
+  void StartOperation(Scenario scenario, base::TimeTicks due);
+  void HangUp(uint32 slot);
+  void SendRequest(const scoped_refptr<sippet::Request> &request);
+  void OnRequestSent(const scoped_refptr<sippet::Request> &request, int rv);
+  void FailRequest(const scoped_refptr<sippet::Request> &request);
+
+  bool FindSlot(const std::string &call_id, uint32 *slot) const;
+  uint32 AllocateSlot(const std::string &call_id);
+  void ReleaseSlot(uint32 slot);
+
+  void RecordLatency(Transaction transaction, uint32 slot);
+
+  sippet::ua::UserAgent *user_agent_;
+  Settings settings_;
+  Stream streams_[SCENARIO_MAX];
+
+  std::vector<Operation> operations_;
+  std::vector<uint32> free_slots_;
+  SlotsMap slots_;
+
+  sippet::TimerWheel hangup_wheel_;
+  base::TimeTicks wheel_time_;
+  std::vector<uint32> expired_;
+
+  base::RepeatingTimer<LoadGenerator> tick_timer_;
+  base::TimeTicks start_time_;
+  base::TimeTicks end_time_;
+  base::TimeTicks drain_deadline_;
+  base::Closure done_;
+
+  LatencyHistogram histograms_[TRANSACTION_MAX];
+  int64 errors_[TRANSACTION_MAX];
+
+  base::ThreadChecker thread_checker_;
+  base::WeakPtrFactory<LoadGenerator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadGenerator);
+};
+
+#endif // SIPPET_EXAMPLES_LOADGEN_LOAD_GENERATOR_H_
@@ -0,0 +1,131 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <iostream>
+
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sippet/examples/loadgen/load_generator.h"
+#include "sippet/examples/program_main/program_main.h"
+
+static void PrintUsage() {
+  std::cout << "sippet_loadgen"
+            << " [--register-rate=per-second]"
+            << " [--call-rate=per-second]"
+            << " \\" << std::endl
+            << "    [--call-duration=milliseconds]"
+            << " [--duration=seconds]"
+            << " [--max-outstanding=count]"
+            << " \\" << std::endl
+            << "    [--server=host[:port]]"
+            << " [--username=user]"
+            << " [--password=pass]"
+            << " [--dial=user]"
+            << " \\" << std::endl
+            << "    [--tcp|--udp|--tls]\n";
+}
+
+static bool GetDoubleSwitch(base::CommandLine* command_line,
+                            const char* name, double* value) {
+  if (!command_line->HasSwitch(name))
+    return true;
+  return base::StringToDouble(command_line->GetSwitchValueASCII(name), value)
+      && *value >= 0;
+}
+
+static void OnLoadGenerated() {
+  base::MessageLoop::current()->Quit();
+}
+
+int main(int argc, char **argv) {
+  ProgramMain program_main(argc, argv);
+  base::CommandLine* command_line = program_main.command_line();
+
+  if (command_line->GetSwitches().empty() ||
+      command_line->HasSwitch("help")) {
+    PrintUsage();
+    return -1;
+  }
+
+  LoadGenerator::Settings settings;
+  double call_duration = 0;
+  double duration = 10;
+  double max_outstanding = static_cast<double>(settings.max_outstanding);
+  if (!GetDoubleSwitch(command_line, "register-rate",
+                       &settings.register_rate)
+      || !GetDoubleSwitch(command_line, "call-rate", &settings.call_rate)
+      || !GetDoubleSwitch(command_line, "call-duration", &call_duration)
+      || !GetDoubleSwitch(command_line, "duration", &duration)
+      || !GetDoubleSwitch(command_line, "max-outstanding",
+                          &max_outstanding)
+      || (0 == settings.register_rate && 0 == settings.call_rate)) {
+    PrintUsage();
+    return -1;
+  }
+  settings.call_duration = base::TimeDelta::FromMilliseconds(
+      static_cast<int64>(call_duration));
+  settings.duration = base::TimeDelta::FromMilliseconds(
+      static_cast<int64>(duration * 1000));
+  settings.max_outstanding = static_cast<size_t>(max_outstanding);
+
+  std::string server("localhost");
+  if (command_line->HasSwitch("server"))
+    server = command_line->GetSwitchValueASCII("server");
+  std::string username("loadgen");
+  if (command_line->HasSwitch("username"))
+    username = command_line->GetSwitchValueASCII("username");
+  std::string password;
+  if (command_line->HasSwitch("password"))
+    password = command_line->GetSwitchValueASCII("password");
+  std::string dial("echo");
+  if (command_line->HasSwitch("dial"))
+    dial = command_line->GetSwitchValueASCII("dial");
+
+  struct {
+    const char *cmd_switch_;
+    const char *scheme_;
+    const char *parameters_;
+  } args[] = {
+    { "udp", "sip", "" },
+    { "tcp", "sip", ";transport=tcp" },
+    { "tls", "sips", "" },
+  };
+
+  size_t transport = 0;  // Defaults to UDP
+  for (size_t i = 0; i < arraysize(args); i++) {
+    if (command_line->HasSwitch(args[i].cmd_switch_)) {
+      transport = i;
+      break;
+    }
+  }
+  settings.registrar_uri = GURL(base::StringPrintf("%s:%s%s",
+      args[transport].scheme_, server.c_str(), args[transport].parameters_));
+  settings.call_uri = GURL(base::StringPrintf("%s:%s@%s%s",
+      args[transport].scheme_, dial.c_str(), server.c_str(),
+      args[transport].parameters_));
+  settings.local_uri = GURL(base::StringPrintf("%s:%s@%s",
+      args[transport].scheme_, username.c_str(), server.c_str()));
+
+  // Logging every message would make the generator the bottleneck.
+  program_main.set_min_log_level(logging::LOG_WARNING);
+  program_main.set_username(base::ASCIIToUTF16(username));
+  program_main.set_password(base::ASCIIToUTF16(password));
+  if (!program_main.Init()) {
+    return -1;
+  }
+  // Only the first request of each kind gets challenged.
+  program_main.user_agent()->set_preemptive_auth_enabled(true);
+
+  LoadGenerator load_generator(program_main.user_agent(), settings);
+  program_main.AppendHandler(&load_generator);
+  load_generator.Start(base::Bind(&OnLoadGenerated));
+
+  program_main.Run();
+
+  load_generator.PrintReport(std::cout);
+  return 0;
+}
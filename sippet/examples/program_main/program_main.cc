@@ -10,7 +10,8 @@
 #include "net/socket/client_socket_factory.h"
 #include "sippet/ua/dialog_controller.h"
 
-ProgramMain::ProgramMain(int argc, char **argv) {
+ProgramMain::ProgramMain(int argc, char **argv)
+  : min_log_level_(-10) {
   // Initialize ICU library
   if (!base::i18n::InitializeICU()) {
     std::cerr << "Couldn't open ICU library, exiting...\n";
@@ -35,6 +36,10 @@ void ProgramMain::set_password(const base::string16& password) {
   password_ = password;
 }
 
+void ProgramMain::set_min_log_level(int min_log_level) {
+  min_log_level_ = min_log_level;
+}
+
 bool ProgramMain::Init() {
   logging::LoggingSettings settings;
   settings.logging_dest = logging::LOG_TO_ALL;
@@ -43,7 +48,7 @@ bool ProgramMain::Init() {
     std::cout << "Error: could not initialize logging. Exiting.\n";
     return false;
   }
-  logging::SetMinLogLevel(-10);
+  logging::SetMinLogLevel(min_log_level_);
 
   request_context_getter_ =
       new URLRequestContextGetter(message_loop_.task_runner());
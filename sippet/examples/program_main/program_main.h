@@ -23,6 +23,8 @@ class ProgramMain {
   base::CommandLine* command_line();
   void set_username(const base::string16& username);
   void set_password(const base::string16& password);
+  // Defaults to the most verbose level.
+  void set_min_log_level(int min_log_level);
   bool Init();
   void AppendHandler(sippet::ua::UserAgent::Delegate *delegate);
   sippet::ua::UserAgent *user_agent();
@@ -32,6 +34,7 @@ class ProgramMain {
  private:
   base::string16 username_;
   base::string16 password_;
+  int min_log_level_;
   base::AtExitManager at_exit_manager_;
   base::MessageLoopForIO message_loop_;
   scoped_refptr<net::URLRequestContextGetter> request_context_getter_;
@@ -35,11 +35,15 @@ namespace {
 }  // namespace
 
 Header::Header(Type type)
-  : type_(type) {
+  : type_(type),
+    raw_offset_(0),
+    raw_size_(0) {
 }
 
 Header::Header(const Header &other)
-  : type_(other.type_) {
+  : type_(other.type_),
+    raw_offset_(0),
+    raw_size_(0) {
 }
 
 Header::~Header() {
@@ -32,8 +32,17 @@ class Header : public ilist_node<Header> {
   };
 
  private:
+  friend class Message;
+  friend class RequestTemplate;
+
   Type type_;
 
+  // Location of the original header line, CRLF included, in the raw text of
+  // the message it was parsed from. |raw_size_| is zero if the header wasn't
+  // parsed as part of a message, or if it may have been modified since.
+  size_t raw_offset_;
+  size_t raw_size_;
+
   Header &operator=(const Header &);
 
  protected:
@@ -53,6 +62,8 @@ class Header : public ilist_node<Header> {
   const char *name() const;
   const char compact_form() const;
 
+  // Clones the header. Parameters are shared with the clone until either one
+  // is modified, so cloning doesn't copy them.
   scoped_ptr<Header> Clone() const { return scoped_ptr<Header>(DoClone()); }
 
   virtual void print(raw_ostream &os) const;
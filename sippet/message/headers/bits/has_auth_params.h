@@ -21,7 +21,8 @@ public:
   has_auth_params(const std::string &scheme)
     : scheme_(scheme), has_scheme_(true) {}
   has_auth_params(const has_auth_params &other)
-    : scheme_(other.scheme_), has_scheme_(other.has_scheme_) {}
+    : has_parameters(other), scheme_(other.scheme_),
+      has_scheme_(other.has_scheme_) {}
   ~has_auth_params() {}
 
   has_auth_params &operator=(const has_auth_params &other) {
@@ -30,7 +30,9 @@ public:
   has_multiple() {}
   ~has_multiple() {}
 
-  // Iterator creation methods.
+  // Iterator creation methods. Items are copied along with the header, but
+  // their parameters are shared with the copy until modified, as done by
+  // |has_parameters|. Reading through non-const accessors never copies.
   iterator begin()             { return items_.begin(); }
   const_iterator begin() const { return items_.begin(); }
   iterator end()               { return items_.end();   }
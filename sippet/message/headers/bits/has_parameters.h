@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <string>
 #include <cassert>
+#include "sippet/base/copy_on_write.h"
 #include "sippet/base/raw_ostream.h"
 
 namespace sippet {
@@ -17,7 +18,6 @@ namespace sippet {
 class has_parameters {
  public:
   typedef std::pair<std::string, std::string> param_type;
-  typedef std::vector<param_type>::iterator param_iterator;
   typedef std::vector<param_type>::const_iterator const_param_iterator;
 
  protected:
@@ -28,27 +28,26 @@ class has_parameters {
   has_parameters();
   ~has_parameters();
 
-  // Iterator creation methods.
-  param_iterator param_begin()             { return params_.begin(); }
-  const_param_iterator param_begin() const { return params_.begin(); }
-  param_iterator param_end()               { return params_.end();   }
-  const_param_iterator param_end() const   { return params_.end();   }
+  // Iterator creation methods. Parameters are shared between copies of a
+  // header until modified, so they can only be read through iterators, and
+  // are only detached by |param_erase|, |param_clear| and |param_set|.
+  const_param_iterator param_begin() const { return params_.get().begin(); }
+  const_param_iterator param_end() const   { return params_.get().end();   }
 
   // Miscellaneous inspection routines.
-  bool param_empty() const { return params_.empty(); }
+  bool param_empty() const { return params_.get().empty(); }
 
   // erase - remove a node from the controlled sequence... and delete it.
-  param_iterator param_erase(param_iterator where) {
-    return params_.erase(where);
+  const_param_iterator param_erase(const_param_iterator where) {
+    size_t index = where - param_begin();
+    std::vector<param_type> &params = params_.get_mutable();
+    return params.erase(params.begin() + index);
   }
 
   // clear everything
-  void param_clear() { params_.clear(); }
+  void param_clear() { params_.get_mutable().clear(); }
 
   // find an existing parameter
-  param_iterator param_find(const std::string &key) {
-    return std::find_if(param_begin(), param_end(), first_equals(key));
-  }
   const_param_iterator param_find(const std::string &key) const {
     return std::find_if(param_begin(), param_end(), first_equals(key));
   }
@@ -57,11 +56,12 @@ class has_parameters {
   void param_set(const std::string &key, const std::string &value) {
     assert(!key.empty() && "Key cannot be empty");
     // TODO: value should be unescaped
-    param_iterator it = param_find(key);
+    const_param_iterator it = param_find(key);
     if (it == param_end()) {
-      params_.push_back(std::make_pair(key, value));
+      params_.get_mutable().push_back(std::make_pair(key, value));
     } else {
-      (*it).second = value;
+      size_t index = it - param_begin();
+      params_.get_mutable()[index].second = value;
     }
   }
 
@@ -75,7 +75,7 @@ class has_parameters {
     }
   }
 private:
-  std::vector<param_type> params_;
+  CopyOnWrite<std::vector<param_type> > params_;
 
   struct first_equals : std::unary_function<const std::string&,bool> {
     first_equals(const std::string &key) : key_(key) {}
@@ -868,4 +868,53 @@ TEST_F(HeaderTest, TortureViaReceivedDelims) {
     via->ToString());
 }
 
+TEST_F(HeaderTest, CloneSharesUntilModified) {
+  scoped_ptr<Header> header(Header::Parse(
+    "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds, "
+    "SIP/2.0/UDP bigbox3.site3.atlanta.com;branch=z9hG4bK77ef4c2312983.1"));
+  Via *via = dyn_cast<Via>(header);
+  ASSERT_TRUE(via);
+  std::string original(via->ToString());
+
+  scoped_ptr<Via> clone(via->Clone());
+  EXPECT_EQ(original, clone->ToString());
+
+  clone->front().set_branch("z9hG4bKnashds8");
+  clone->push_back(ViaParam(Protocol::TCP,
+    net::HostPortPair("192.0.2.4", 5060)));
+  EXPECT_EQ(original, via->ToString());
+  EXPECT_EQ(2u, static_cast<size_t>(via->end() - via->begin()));
+  EXPECT_EQ(3u, static_cast<size_t>(clone->end() - clone->begin()));
+  EXPECT_EQ("z9hG4bK776asdhds", via->front().branch());
+  EXPECT_EQ("z9hG4bKnashds8", clone->front().branch());
+}
+
+TEST_F(HeaderTest, CloneRequestSharesUntilModified) {
+  scoped_refptr<Request> request(dyn_cast<Request>(Message::Parse(
+    "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "Max-Forwards: 70\r\n"
+    "To: Bob <sip:bob@biloxi.com>\r\n"
+    "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n")));
+  ASSERT_TRUE(request.get());
+  std::string original(request->ToString());
+
+  scoped_refptr<Request> clone(request->CloneRequest());
+  clone->get<Via>()->front().set_branch("z9hG4bKnashds8");
+  clone->get<From>()->set_tag("456248");
+  EXPECT_EQ(original, request->ToString());
+  EXPECT_EQ("z9hG4bK776asdhds", request->get<Via>()->front().branch());
+  EXPECT_EQ("1928301774", request->get<From>()->tag());
+
+  scoped_refptr<Response> response(request->CreateResponse(SIP_OK));
+  response->get<To>()->set_tag("a6c85cf");
+  EXPECT_FALSE(request->get<To>()->HasTag());
+  EXPECT_EQ(original, request->ToString());
+}
+
 }  // namespace sippet
@@ -6,8 +6,21 @@
 
 #include <string>
 
+#include "base/hash.h"
+#include "base/logging.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/base/tracing.h"
+
 namespace sippet {
 
+namespace {
+
+// Headers are parsed on demand and may be shared among copies, so their size
+// is estimated from a typical header rather than measured.
+const size_t kEstimatedHeaderSize = 96;
+
+}  // namespace
+
 Message::Message(bool is_request,
                  Direction direction)
   : is_request_(is_request),
@@ -15,14 +28,59 @@ Message::Message(bool is_request,
 
 Message::~Message() {}
 
+scoped_refptr<Message> Message::Copy(Direction direction) const {
+  scoped_refptr<Message> copy;
+  if (is_request_) {
+    const Request *request = static_cast<const Request*>(this);
+    copy = new Request(request->method(), request->request_uri(),
+        direction, request->version());
+  } else {
+    const Response *response = static_cast<const Response*>(this);
+    copy = new Response(response->response_code(),
+        response->reason_phrase(), direction, response->version());
+  }
+  copy->raw_headers_ = raw_headers_;
+  for (const_iterator i = headers_.begin(), ie = headers_.end();
+       i != ie; ++i) {
+    scoped_ptr<Header> header(i->Clone());
+    header->raw_offset_ = i->raw_offset_;
+    header->raw_size_ = i->raw_size_;
+    copy->headers_.push_back(header.release());
+  }
+  copy->content_ = content_;
+  return copy;
+}
+
 void Message::print(raw_ostream &os) const {
+  // Consecutive unmodified headers are written at once, as they are still
+  // contiguous in |raw_headers_|.
+  const char *run_begin = nullptr;
+  const char *run_end = nullptr;
   for (const_iterator i = headers_.begin(), ie = headers_.end();
        i != ie; ++i) {
     if (isa<ContentLength>(i))
       continue;
+    if (i->raw_size_ != 0 && raw_headers_) {
+      const std::string &raw_headers = raw_headers_->data();
+      DCHECK_LE(i->raw_offset_ + i->raw_size_, raw_headers.size());
+      const char *raw = raw_headers.data() + i->raw_offset_;
+      if (raw != run_end) {
+        if (run_begin != run_end)
+          os.write(run_begin, run_end - run_begin);
+        run_begin = raw;
+      }
+      run_end = raw + i->raw_size_;
+      continue;
+    }
+    if (run_begin != run_end) {
+      os.write(run_begin, run_end - run_begin);
+      run_begin = run_end = nullptr;
+    }
     i->print(os);
     os << "\r\n";
   }
+  if (run_begin != run_end)
+    os.write(run_begin, run_end - run_begin);
 
   // Force the Content Length to match the content size
   scoped_ptr<ContentLength> content_length(
@@ -39,10 +97,32 @@ void Message::print(raw_ostream &os) const {
 }
 
 std::string Message::ToString() const {
+  SIPPET_TRACE_EVENT0("Message::ToString");
   std::string output;
   raw_string_ostream os(output);
   print(os);
   return os.str();
 }
 
+uint64 Message::GetTransactionTraceId() const {
+  const Via *via = get<Via>();
+  const Cseq *cseq = get<Cseq>();
+  if (!via || via->empty() || !via->front().HasBranch() || !cseq)
+    return 0;
+  // ACKs of non-2xx responses belong to the INVITE transaction.
+  Method method(cseq->method());
+  if (Method::ACK == method)
+    method = Method::INVITE;
+  return base::Hash(via->front().branch() + ":" + method.str());
+}
+
+size_t Message::EstimateMemoryUsage() const {
+  size_t bytes = is_request_ ? sizeof(Request) : sizeof(Response);
+  bytes += headers_.size() * kEstimatedHeaderSize;
+  bytes += EstimateStringMemoryUsage(content_);
+  if (raw_headers_.get() && raw_headers_->HasOneRef())
+    bytes += EstimateStringMemoryUsage(raw_headers_->data());
+  return bytes;
+}
+
 }  // namespace sippet
@@ -6,11 +6,14 @@
 #define SIPPET_MESSAGE_MESSAGE_H_
 
 #include <algorithm>
+#include <iterator>
 #include <vector>
 #include "sippet/base/ilist.h"
 #include "sippet/base/casting.h"
 #include "sippet/message/header.h"
+#include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/gtest_prod_util.h"
 
@@ -45,8 +48,13 @@ private:
 
 class raw_ostream;
 class Request;
+class RequestTemplate;
 class Response;
 
+namespace proxy {
+class Proxy;
+} // namespace proxy
+
 class Message
   : public base::RefCountedThreadSafe<Message> {
  public:
@@ -57,10 +65,40 @@ class Message
 
   typedef iplist<Header> HeaderListType;
 
+  // Iterates over the headers of a message. A header reached through it may
+  // be modified, so dereferencing it stops printing the header from its
+  // original text; just moving the iterator over headers doesn't.
+  class iterator
+    : public std::iterator<std::bidirectional_iterator_tag, Header> {
+   public:
+    iterator() {}
+
+    Header &operator*() const { return *MarkModified(&*i_); }
+    Header *operator->() const { return &operator*(); }
+    operator Header*() const { return &operator*(); }
+
+    // Reading through a const iterator keeps the original text.
+    operator HeaderListType::const_iterator() const { return i_; }
+
+    bool operator==(const iterator &other) const { return i_ == other.i_; }
+    bool operator!=(const iterator &other) const { return i_ != other.i_; }
+
+    iterator &operator++() { ++i_; return *this; }
+    iterator &operator--() { --i_; return *this; }
+    iterator operator++(int) { iterator tmp(*this); ++i_; return tmp; }
+    iterator operator--(int) { iterator tmp(*this); --i_; return tmp; }
+
+   private:
+    friend class Message;
+
+    explicit iterator(HeaderListType::iterator i) : i_(i) {}
+
+    HeaderListType::iterator i_;
+  };
+
   // Header iterators...
-  typedef HeaderListType::iterator iterator;
   typedef HeaderListType::const_iterator const_iterator;
-  typedef HeaderListType::reverse_iterator reverse_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
   typedef HeaderListType::const_reverse_iterator const_reverse_iterator;
   typedef HeaderListType::reference reference;
   typedef HeaderListType::const_reference const_reference;
@@ -72,10 +110,18 @@ class Message
   std::string content_;
   Direction direction_;
 
+  // Header lines of a parsed message, unfolded and CRLF terminated. Headers
+  // known to be unmodified are printed from here, so forwarded messages keep
+  // their original formatting. Requests created from a |RequestTemplate|
+  // share the text of the template.
+  scoped_refptr<base::RefCountedString> raw_headers_;
+
   DISALLOW_COPY_AND_ASSIGN(Message);
 
  protected:
   friend class base::RefCountedThreadSafe<Message>;
+  friend class RequestTemplate;
+  friend class proxy::Proxy;
 
   Message(bool is_request,
           Direction direction);
@@ -85,6 +131,12 @@ class Message
   // Parse a SIP message. Parsed messages have |Incoming| direction.
   static scoped_refptr<Message> Parse(const std::string &raw_message);
 
+  // Copies the message into a new one with the given |direction|, without
+  // printing or parsing it: headers are shared with the copy until either
+  // one is modified, and unmodified ones keep their original text. Requests
+  // get a new |Request::id|, and responses don't refer to any request.
+  scoped_refptr<Message> Copy(Direction direction) const;
+
   // Returns the message direction.
   Direction direction() const {
     return direction_;
@@ -99,32 +151,40 @@ class Message
   //===--------------------------------------------------------------------===//
   // Header iterator methods
   //
-  iterator       begin()       { return headers_.begin(); }
+  // Parsed headers are printed from their original text until a non-const
+  // iterator or reference to them is dereferenced, including through get<T>()
+  // on a non-const message. Const access keeps the original text.
+  //
+  iterator       begin()       { return iterator(headers_.begin()); }
   const_iterator begin() const { return headers_.begin(); }
-  iterator       end  ()       { return headers_.end();   }
+  iterator       end  ()       { return iterator(headers_.end());   }
   const_iterator end  () const { return headers_.end();   }
 
-  reverse_iterator       rbegin()       { return headers_.rbegin(); }
+  reverse_iterator rbegin()       { return reverse_iterator(end()); }
   const_reverse_iterator rbegin() const { return headers_.rbegin(); }
-  reverse_iterator       rend  ()       { return headers_.rend();   }
+  reverse_iterator       rend  ()       { return reverse_iterator(begin()); }
   const_reverse_iterator rend  () const { return headers_.rend();   }
 
   size_type      size() const { return headers_.size();  }
   bool          empty() const { return headers_.empty(); }
 
-  reference       front()       { return headers_.front(); }
+  reference       front()     { return *begin(); }
   const_reference front() const { return headers_.front(); }
-  reference       back()        { return headers_.back();  }
+  reference       back()      { return *--end(); }
   const_reference back() const  { return headers_.back();  }
 
   // Insert a header before a specific position in the message.
   iterator insert(iterator where, scoped_ptr<Header> header) {
-    return header ? headers_.insert(where, header.release()) : where;
+    if (!header)
+      return where;
+    return iterator(headers_.insert(where.i_, header.release()));
   }
 
   // Insert a header after a specific position in the message.
   iterator insertAfter(iterator where, scoped_ptr<Header> header) {
-    return header ? headers_.insertAfter(where, header.release()) : where;
+    if (!header)
+      return where;
+    return iterator(headers_.insertAfter(where.i_, header.release()));
   }
 
   // Insert a header to the beginning of the message.
@@ -141,12 +201,12 @@ class Message
  
   // Remove an existing header and return an iterator to the next header.
   iterator erase(iterator position) {
-    return headers_.erase(position);
+    return iterator(headers_.erase(position.i_));
   }
 
   // Remove all headers in the given interval.
   void erase(iterator first, iterator last) {
-    headers_.erase(first, last);
+    headers_.erase(first.i_, last.i_);
   }
 
   // Clear all headers.
@@ -169,7 +229,7 @@ class Message
   template<class InIt>
   void insert(iterator where, InIt first, InIt last) {
     for (; first != last; ++first)
-      headers_.insert(where, (*first)->Clone().release());
+      headers_.insert(where.i_, (*first)->Clone().release());
   }
 
   // Erase all headers matching a given predicate.
@@ -180,8 +240,8 @@ class Message
   // Find first header of given type.
   template<class HeaderType>
   iterator find_first() {
-    return std::find_if(headers_.begin(), headers_.end(),
-      equals<HeaderType>());
+    return iterator(std::find_if(headers_.begin(), headers_.end(),
+      equals<HeaderType>()));
   }
   template<class HeaderType>
   const_iterator find_first() const {
@@ -190,8 +250,8 @@ class Message
   }
   template<class HeaderType>
   reverse_iterator rfind_first() {
-    return std::find_if(headers_.rbegin(), headers_.rend(),
-      equals<HeaderType>());
+    return reverse_iterator(iterator(std::find_if(headers_.rbegin(),
+      headers_.rend(), equals<HeaderType>()).base()));
   }
   template<class HeaderType>
   const_reverse_iterator rfind_first() const {
@@ -204,8 +264,8 @@ class Message
   iterator find_next(iterator where) {
     if (where == end())
       return where;
-    return std::find_if(++where, headers_.end(),
-      equals<HeaderType>());
+    return iterator(std::find_if(++where.i_, headers_.end(),
+      equals<HeaderType>()));
   }
   template<class HeaderType>
   const_iterator find_next(const_iterator where) const {
@@ -261,8 +321,8 @@ class Message
 
   // Clone all headers of a given type to another message.
   template<class HeaderType>
-  void CloneTo(Message *message) {
-    for (Message::iterator i = find_first<HeaderType>(),
+  void CloneTo(Message *message) const {
+    for (Message::const_iterator i = find_first<HeaderType>(),
          ie = end(); i != ie; i = find_next<HeaderType>(i)) {
       message->push_back(i->Clone().Pass());
     }
@@ -270,8 +330,8 @@ class Message
 
   // Clone the first matching header, if exists.
   template<class HeaderType>
-  scoped_ptr<HeaderType> Clone() {
-    Message::iterator i = find_first<HeaderType>();
+  scoped_ptr<HeaderType> Clone() const {
+    Message::const_iterator i = find_first<HeaderType>();
     if (i == end())
       return scoped_ptr<HeaderType>();
     Header *clone = i->Clone().release();
@@ -281,10 +341,24 @@ class Message
   // Get a the dialog identifier.
   virtual std::string GetDialogId() const = 0;
 
+  // Identifies the transaction of the message in trace events, by hashing
+  // the topmost Via branch and the CSeq method: a request, its
+  // retransmissions and its responses share it. Returns zero when the
+  // message has no branch yet.
+  uint64 GetTransactionTraceId() const;
+
+  // Approximate bytes taken by the message, its headers and content. Headers
+  // shared with copies of the message are counted by each copy, and the raw
+  // text only when it isn't shared with a template.
+  size_t EstimateMemoryUsage() const;
+
  private:
   friend class AuthControllerTest;
   FRIEND_TEST_ALL_PREFIXES(AuthControllerTest, NoExplicitCredentialsAllowed);
+  FRIEND_TEST_ALL_PREFIXES(AuthControllerTest, PreemptiveAuthFromCache);
   FRIEND_TEST_ALL_PREFIXES(NetworkLayerTest, OutgoingRequest);
+  FRIEND_TEST_ALL_PREFIXES(NetworkLayerTest, StatelessRequests);
+  FRIEND_TEST_ALL_PREFIXES(NetworkLayerTest, ResolvedTargets);
 
   template<class HeaderType>
   struct equals : public std::unary_function<const Header &, bool> {
@@ -296,6 +370,29 @@ class Message
   void set_direction(Direction direction) {
     direction_ = direction;
   }
+
+  // The |header| may be modified: stop printing it from its original text.
+  static Header *MarkModified(Header *header) {
+    header->raw_size_ = 0;
+    return header;
+  }
+};
+
+// Allow message iterators to convert into pointers to a header when used by
+// the dyn_cast, cast, isa mechanisms...
+template<> struct simplify_type<Message::iterator> {
+  typedef Header* SimpleType;
+
+  static SimpleType getSimplifiedValue(Message::iterator &i) {
+    return &*i;
+  }
+};
+template<> struct simplify_type<const Message::iterator> {
+  typedef Header* SimpleType;
+
+  static SimpleType getSimplifiedValue(const Message::iterator &i) {
+    return &*i;
+  }
 };
 
 // isa - Provide some specializations of isa so that we don't have to include
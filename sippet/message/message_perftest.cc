@@ -0,0 +1,185 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "sippet/message/message.h"
+#include "sippet/test/microbenchmark.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+// Messages from the RFC 4475 torture tests...
+const char kWsinv[] =
+  "INVITE sip:vivekg@chair-dnrc.example.com;unknownparam SIP/2.0\r\n"
+  "TO :\r\n"
+  "  sip:vivekg@chair-dnrc.example.com ;   tag    = 1918181833n\r\n"
+  "from   : \"J Rosenberg \\\\\\\"\"       <sip:jdrosen@example.com>\r\n"
+  "  ;\r\n"
+  "  tag = 98asjd8\r\n"
+  "MaX-fOrWaRdS: 0068\r\n"
+  "Call-ID: wsinv.ndaksdj@192.0.2.1\r\n"
+  "Content-Length   : 150\r\n"
+  "cseq: 0009\r\n"
+  "  INVITE\r\n"
+  "Via  : SIP  /   2.0\r\n"
+  "  /UDP\r\n"
+  "    192.0.2.2;branch=390skdjuw\r\n"
+  "s :\r\n"
+  "NewFangledHeader:   newfangled value\r\n"
+  "  continued newfangled value\r\n"
+  "UnknownHeaderWithUnusualValue: ;;,,;;,;\r\n"
+  "Content-Type: application/sdp\r\n"
+  "Route:\r\n"
+  "  <sip:services.example.com;lr;unknownwith=value;unknown-no-value>\r\n"
+  "v:  SIP  / 2.0  / TCP     spindle.example.com   ;\r\n"
+  "  branch  =   z9hG4bK9ikj8  ,\r\n"
+  "  SIP  /    2.0   / UDP  192.168.255.111   ; branch=\r\n"
+  "  z9hG4bK30239\r\n"
+  "m:\"Quoted string \\\"\\\"\" <sip:jdrosen@example.com> ; newparam =\r\n"
+  "      newvalue ;\r\n"
+  "  secondparam ; q = 0.33\r\n"
+  "\r\n";
+
+const char kIntmeth[] =
+  "!interesting-Method0123456789_*+`.%indeed'~ "
+    "sip:1_unusual.URI~(to-be!sure)"
+    "&isn't+it$/crazy?,/;;*:"
+    "&it+has=1,weird!*pas$wo~d_too.(doesn't-it)"
+    "@example.com SIP/2.0\r\n"
+  "Via: SIP/2.0/TCP host1.example.com;branch=z9hG4bK-.!%66*_+`'~\r\n"
+  "To: \"BEL:\\\x07 NUL:\\\x00 DEL:\\\x7f\" "
+    "<sip:1_unusual.URI~(to-be!sure)&isn't+it$/crazy?,/;;*@example.com>\r\n"
+  "From: token1~` token2'+_ token3*%!.- <sip:mundane@example.com>"
+    ";fromParam''~+*_!.-%="
+    "\"\xD1\x80\xD0\xB0\xD0\xB1\xD0\xBE\xD1\x82\xD0\xB0\xD1\x8E\xD1"
+    "\x89\xD0\xB8\xD0\xB9\""
+    ";tag=_token~1'+`*%!-.\r\n"
+  "Call-ID: intmeth.word%ZK-!.*_+'@word`~)(><:\\/\"][?}{\r\n"
+  "CSeq: 139122385 !interesting-Method0123456789_*+`.%indeed'~\r\n"
+  "Max-Forwards: 255\r\n"
+  "extensionHeader-!.%*+_`'~: \xEF\xBB\xBF\xE5\xA4\xA7\xE5\x81\x9C"
+    "\xE9\x9B\xBB\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kEsc01[] =
+  "INVITE sip:sips%3Auser%40example.com@example.net SIP/2.0\r\n"
+  "To: sip:%75se%72@example.com\r\n"
+  "From: <sip:I%20have%20spaces@example.net>;tag=938\r\n"
+  "Contact: "
+    "<sip:cal%6Cer@host5.example.net;%6C%72;n%61me=v%61lue%25%34%31>\r\n"
+  "\r\n";
+
+// ...and messages as they are usually seen on the wire.
+const char kInvite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds;rport\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Allow: INVITE, ACK, CANCEL, BYE, OPTIONS, UPDATE\r\n"
+  "Supported: replaces, timer\r\n"
+  "User-Agent: Sippet\r\n"
+  "Content-Type: application/sdp\r\n"
+  "Content-Length: 142\r\n"
+  "\r\n"
+  "v=0\r\n"
+  "o=alice 2890844526 2890844526 IN IP4 pc33.atlanta.com\r\n"
+  "s=-\r\n"
+  "c=IN IP4 192.0.2.101\r\n"
+  "t=0 0\r\n"
+  "m=audio 49172 RTP/AVP 0\r\n"
+  "a=rtpmap:0 PCMU/8000\r\n";
+
+const char kRegister[] =
+  "REGISTER sip:registrar.biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Bob <sip:bob@biloxi.com>;tag=456248\r\n"
+  "Call-ID: 843817637684230@998sdasdh09\r\n"
+  "CSeq: 1826 REGISTER\r\n"
+  "Contact: <sip:bob@192.0.2.4>;expires=7200\r\n"
+  "Authorization: Digest username=\"bob\", realm=\"biloxi.com\", "
+    "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+    "uri=\"sip:registrar.biloxi.com\", qop=auth, nc=00000001, "
+    "cnonce=\"0a4f113b\", response=\"6629fae49393a05397450978507c4ef1\"\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kOk[] =
+  "SIP/2.0 200 OK\r\n"
+  "Via: SIP/2.0/UDP server10.biloxi.com;branch=z9hG4bK4b43c2ff8.1;"
+    "received=192.0.2.3\r\n"
+  "Via: SIP/2.0/UDP bigbox3.site3.atlanta.com;branch=z9hG4bK77ef4c2312983.1;"
+    "received=192.0.2.2\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds;"
+    "received=192.0.2.1\r\n"
+  "Record-Route: <sip:server10.biloxi.com;lr>, "
+    "<sip:bigbox3.site3.atlanta.com;lr>\r\n"
+  "To: Bob <sip:bob@biloxi.com>;tag=a6c85cf\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:bob@192.0.2.4>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+struct CorpusEntry {
+  const char *name;
+  std::string raw;
+};
+
+// |kIntmeth| has an embedded NUL, so the lengths are taken from the arrays.
+#define CORPUS_ENTRY(name, message) \
+  { name, std::string(message, arraysize(message) - 1) }
+
+const CorpusEntry kCorpus[] = {
+  CORPUS_ENTRY("torture_wsinv", kWsinv),
+  CORPUS_ENTRY("torture_intmeth", kIntmeth),
+  CORPUS_ENTRY("torture_esc01", kEsc01),
+  CORPUS_ENTRY("invite", kInvite),
+  CORPUS_ENTRY("register", kRegister),
+  CORPUS_ENTRY("ok", kOk),
+};
+
+#undef CORPUS_ENTRY
+
+void ParseMessage(const std::string &raw) {
+  scoped_refptr<Message> message(Message::Parse(raw));
+  CHECK(message);
+}
+
+void SerializeMessage(const scoped_refptr<Message> &message) {
+  std::string serialized(message->ToString());
+  CHECK(!serialized.empty());
+}
+
+}  // namespace
+
+TEST(MessagePerfTest, Parse) {
+  for (size_t i = 0; i < arraysize(kCorpus); ++i) {
+    Microbenchmark benchmark("message_parse", kCorpus[i].name);
+    benchmark.Run(base::Bind(&ParseMessage, base::ConstRef(kCorpus[i].raw)));
+  }
+}
+
+TEST(MessagePerfTest, ToString) {
+  for (size_t i = 0; i < arraysize(kCorpus); ++i) {
+    scoped_refptr<Message> message(Message::Parse(kCorpus[i].raw));
+    ASSERT_TRUE(message);
+    Microbenchmark benchmark("message_to_string", kCorpus[i].name);
+    benchmark.Run(base::Bind(&SerializeMessage, message));
+  }
+}
+
+}  // namespace sippet
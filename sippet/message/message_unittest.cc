@@ -15,6 +15,12 @@ using sippet::isa;
 using sippet::dyn_cast;
 using sippet::Request;
 using sippet::Response;
+using sippet::MaxForwards;
+using sippet::To;
+using sippet::From;
+using sippet::CallId;
+using sippet::Cseq;
+using sippet::Subject;
 
 class InstanceOfMessage : public Message {
  public:
@@ -110,6 +116,122 @@ TEST(RequestTest, Basic) {
   scoped_refptr<Request> request = dyn_cast<Request>(message);
 }
 
+TEST(RequestTest, PrintUnmodifiedHeadersVerbatim) {
+  const char *raw_headers =
+    "v: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "Max-Forwards:70\r\n"
+    "To: Bob <sip:bob@biloxi.com>\r\n"
+    "f: \"Alice\" <sip:alice@atlanta.com>;tag=1928301774\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "X-Custom:  some   value\r\n";
+  std::string raw_message("INVITE sip:bob@biloxi.com SIP/2.0\r\n");
+  raw_message += raw_headers;
+  scoped_refptr<Message> message =
+    Message::Parse(raw_message + "Content-Length: 0\r\n\r\n");
+  ASSERT_TRUE(message);
+
+  // Only the Content-Length is generated again.
+  EXPECT_EQ(raw_message + "l: 0\r\n\r\n", message->ToString());
+
+  // Modified headers are printed from their current values.
+  message->get<MaxForwards>()->set_value(69);
+  std::string output(message->ToString());
+  EXPECT_EQ(std::string::npos, output.find("Max-Forwards:70\r\n"));
+  EXPECT_NE(std::string::npos, output.find("Max-Forwards: 69\r\n"));
+  EXPECT_NE(std::string::npos, output.find("X-Custom:  some   value\r\n"));
+
+  // Const access keeps the original text.
+  const Message *const_message = message.get();
+  EXPECT_TRUE(isa<sippet::Via>(const_message->front()));
+  EXPECT_EQ(output, message->ToString());
+
+  // Moving a mutable iterator over headers doesn't touch them.
+  for (Message::iterator i = message->begin(), ie = message->end();
+       i != ie; ++i) {
+  }
+  EXPECT_EQ(output, message->ToString());
+
+  // But headers reached by moving it may be modified.
+  Message::iterator i = message->find_first<To>();
+  ++i;
+  dyn_cast<From>(i)->set_tag("a6c85cf");
+  i = message->insertAfter(message->find_first<CallId>(),
+                           scoped_ptr<Header>(new Subject("Lunch")));
+  ++i;
+  dyn_cast<Cseq>(i)->set_sequence(314160);
+  output = message->ToString();
+  EXPECT_NE(std::string::npos, output.find("tag=a6c85cf"));
+  EXPECT_NE(std::string::npos, output.find("Subject: Lunch\r\n"));
+  EXPECT_NE(std::string::npos, output.find("CSeq: 314160 INVITE\r\n"));
+  EXPECT_NE(std::string::npos, output.find("X-Custom:  some   value\r\n"));
+}
+
+TEST(RequestTest, Copy) {
+  const char *raw_message =
+    "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+    "v: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "Max-Forwards:70\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "l: 4\r\n"
+    "\r\n"
+    "body";
+  scoped_refptr<Message> message = Message::Parse(raw_message);
+  ASSERT_TRUE(message);
+  scoped_refptr<Message> copy = message->Copy(Message::Outgoing);
+
+  ASSERT_TRUE(isa<Request>(copy));
+  EXPECT_EQ(Message::Outgoing, copy->direction());
+  EXPECT_EQ(sippet::Method::INVITE, dyn_cast<Request>(copy)->method());
+  EXPECT_NE(dyn_cast<Request>(message)->id(), dyn_cast<Request>(copy)->id());
+  EXPECT_EQ(message->ToString(), copy->ToString());
+
+  // Modifying the copy leaves the original untouched.
+  copy->get<MaxForwards>()->set_value(69);
+  EXPECT_NE(std::string::npos, message->ToString().find("Max-Forwards:70"));
+  EXPECT_NE(std::string::npos, copy->ToString().find("Max-Forwards: 69"));
+  EXPECT_EQ("body", copy->content());
+}
+
+TEST(RequestTest, TransactionTraceId) {
+  const char *raw_invite =
+    "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+    "v: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "To: Bob <sip:bob@biloxi.com>\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "\r\n";
+  scoped_refptr<Request> invite(dyn_cast<Request>(Message::Parse(raw_invite)));
+  ASSERT_TRUE(invite);
+  uint64 id = invite->GetTransactionTraceId();
+  EXPECT_NE(0u, id);
+  EXPECT_EQ(id, invite->CreateResponse(sippet::SIP_RINGING)
+                    ->GetTransactionTraceId());
+
+  // The ACK of a non-2xx response shares the branch of the INVITE, and so
+  // its transaction, while the CANCEL has a transaction of its own.
+  const char *raw_ack =
+    "ACK sip:bob@biloxi.com SIP/2.0\r\n"
+    "v: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "CSeq: 314159 ACK\r\n"
+    "\r\n";
+  EXPECT_EQ(id, Message::Parse(raw_ack)->GetTransactionTraceId());
+  const char *raw_cancel =
+    "CANCEL sip:bob@biloxi.com SIP/2.0\r\n"
+    "v: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+    "CSeq: 314159 CANCEL\r\n"
+    "\r\n";
+  EXPECT_NE(id, Message::Parse(raw_cancel)->GetTransactionTraceId());
+
+  // Requests get their branch when sent.
+  const char *raw_unsent =
+    "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "\r\n";
+  EXPECT_EQ(0u, Message::Parse(raw_unsent)->GetTransactionTraceId());
+}
+
 TEST(ResponseTest, Basic) {
   const char *raw_message = "SIP/2.0 200 OK\n\n";
   scoped_refptr<Message> message = Message::Parse(raw_message);
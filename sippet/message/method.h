@@ -30,6 +30,7 @@ struct AtomTraits<details::Method> {
 };
 
 typedef Atom<details::Method> Method;
+typedef AtomLess<details::Method> MethodLess;
 
 } // End of sippet namespace
 
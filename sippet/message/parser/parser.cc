@@ -15,6 +15,7 @@
 #include "base/strings/string_piece.h"
 #include "net/http/http_util.h"
 #include "net/base/net_util.h"
+#include "sippet/base/tracing.h"
 
 using base::LowerCaseEqualsASCII;
 
@@ -1008,7 +1009,7 @@ bool AssembleRawHeaders(const std::string &input, std::string *output) {
     if (tok.EndOfInput())
       break;
     if (!net::HttpUtil::IsLWS(*tok.current()))
-      output->append(1, '\n');  // not line folding
+      output->append("\r\n");  // not line folding
   }
 
   return true;
@@ -1028,6 +1029,7 @@ scoped_ptr<Header> Header::Parse(const std::string &raw_header) {
 }
 
 scoped_refptr<Message> Message::Parse(const std::string &raw_message) {
+  SIPPET_TRACE_EVENT0("Message::Parse");
   std::string input;
   AssembleRawHeaders(raw_message, &input);
 
@@ -1068,9 +1070,18 @@ scoped_refptr<Message> Message::Parse(const std::string &raw_message) {
       scoped_ptr<Header> header =
         ParseHeader(it.name_begin(), it.name_end(),
                     it.values_begin(), it.values_end());
-      if (header)
-        message->push_back(header.Pass());
+      if (!header)
+        continue;
+      // Keep track of the header line, so it can be printed verbatim.
+      std::string::const_iterator line_end =
+        FindLineEnd(it.values_end(), end);
+      if (end - line_end >= 2 && *line_end == '\r' && *(line_end + 1) == '\n') {
+        header->raw_offset_ = it.name_begin() - input.begin();
+        header->raw_size_ = line_end + 2 - it.name_begin();
+      }
+      message->push_back(header.Pass());
     }
+    message->raw_headers_ = base::RefCountedString::TakeString(&input);
   }
 
   return message;
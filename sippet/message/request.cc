@@ -17,7 +17,7 @@ Request::Request(const Method &method,
                  const Version &version)
   : Message(true, Outgoing), method_(method), request_uri_(request_uri),
     version_(version), time_stamp_(base::Time::Now()),
-    id_(base::GenerateGUID()) {}
+    id_(base::GenerateGUID()), stateless_(false) {}
 
 Request::Request(const Method &method,
                  const GURL &request_uri,
@@ -25,7 +25,7 @@ Request::Request(const Method &method,
                  const Version &version)
   : Message(true, direction), method_(method), request_uri_(request_uri),
     version_(version), time_stamp_(base::Time::Now()),
-    id_(base::GenerateGUID()) {}
+    id_(base::GenerateGUID()), stateless_(false) {}
 
 Request::~Request() {}
 
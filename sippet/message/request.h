@@ -37,6 +37,14 @@ class Request :
   Version version() const;
   void set_version(const Version &version);
 
+  // Stateless requests are sent and received without transactions. Outgoing
+  // ones are not retransmitted, and their responses are matched by the
+  // branch only: intended for keepalives and OPTIONS pings, not for INVITEs.
+  // Incoming requests are marked stateless by the |NetworkLayer| when their
+  // method is listed in |NetworkSettings::stateless_methods|.
+  bool stateless() const { return stateless_; }
+  void set_stateless(bool stateless) { stateless_ = stateless; }
+
   void print(raw_ostream &os) const override;
 
   // Responses can be generated from incoming requests by using this method.
@@ -77,6 +85,7 @@ class Request :
   GURL request_uri_;
   Version version_;
   base::Time time_stamp_;
+  bool stateless_;
 
   // Used by the parser.
   Request(const Method &method,
@@ -0,0 +1,64 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/message/request_template.h"
+
+#include "base/logging.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/message/message.h"
+
+namespace sippet {
+
+RequestTemplate::RequestTemplate(const scoped_refptr<Request> &prototype)
+  : request_uri_(prototype->request_uri()),
+    version_(prototype->version()) {
+  // Parsing the printed prototype gives every header its original text.
+  compiled_ = dyn_cast<Request>(Message::Parse(prototype->ToString()));
+  DCHECK(compiled_);
+}
+
+RequestTemplate::~RequestTemplate() {
+}
+
+size_t RequestTemplate::EstimateMemoryUsage() const {
+  size_t bytes = sizeof(*this) + compiled_->EstimateMemoryUsage();
+  // The text of the headers belongs to the template, even while shared with
+  // the requests created from it.
+  const base::RefCountedString *raw_headers = compiled_->raw_headers_.get();
+  if (raw_headers && !raw_headers->HasOneRef())
+    bytes += EstimateStringMemoryUsage(raw_headers->data());
+  return bytes;
+}
+
+scoped_refptr<Request> RequestTemplate::CreateRequest(
+    const Method &method,
+    unsigned local_sequence,
+    const std::string &local_tag,
+    const std::string &call_id) const {
+  scoped_refptr<Request> request(
+      new Request(method, request_uri_, version_));
+  request->raw_headers_ = compiled_->raw_headers_;
+  for (Message::const_iterator i = compiled_->begin(), ie = compiled_->end();
+       i != ie; ++i) {
+    if (isa<ContentLength>(i))
+      continue;
+    scoped_ptr<Header> header(i->Clone());
+    if (isa<Cseq>(i)) {
+      Cseq *cseq = dyn_cast<Cseq>(header.get());
+      cseq->set_sequence(local_sequence);
+      cseq->set_method(method);
+    } else if (isa<From>(i) && !local_tag.empty()) {
+      dyn_cast<From>(header.get())->set_tag(local_tag);
+    } else if (isa<CallId>(i) && !call_id.empty()) {
+      dyn_cast<CallId>(header.get())->set_value(call_id);
+    } else {
+      header->raw_offset_ = i->raw_offset_;
+      header->raw_size_ = i->raw_size_;
+    }
+    request->push_back(header.Pass());
+  }
+  return request;
+}
+
+} // End of sippet namespace
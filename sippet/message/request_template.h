@@ -0,0 +1,65 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_MESSAGE_REQUEST_TEMPLATE_H_
+#define SIPPET_MESSAGE_REQUEST_TEMPLATE_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "sippet/message/method.h"
+#include "sippet/message/version.h"
+#include "url/gurl.h"
+
+namespace sippet {
+
+class Request;
+
+// Creates series of requests that differ only by their |Cseq|, and possibly
+// by their |From| tag and |CallId|, such as registration refreshes,
+// keepalives or requests within a dialog.
+//
+// The headers of the prototype request are printed once, when the template
+// is created. Requests created from the template share that text, and print
+// their unmodified headers from it instead of formatting them again.
+class RequestTemplate
+  : public base::RefCountedThreadSafe<RequestTemplate> {
+ public:
+  // Compiles |prototype|. Later changes to |prototype| don't affect the
+  // template.
+  explicit RequestTemplate(const scoped_refptr<Request> &prototype);
+
+  const GURL &request_uri() const {
+    return request_uri_;
+  }
+
+  // Creates a request with a |Cseq| made of |local_sequence| and |method|.
+  // When not empty, |local_tag| replaces the |From| tag and |call_id| the
+  // |CallId| of the prototype.
+  scoped_refptr<Request> CreateRequest(
+      const Method &method,
+      unsigned local_sequence,
+      const std::string &local_tag = std::string(),
+      const std::string &call_id = std::string()) const;
+
+  // Approximate bytes taken by the template and its compiled headers.
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<RequestTemplate>;
+  ~RequestTemplate();
+
+  GURL request_uri_;
+  Version version_;
+
+  // The prototype headers, as parsed from their printed form.
+  scoped_refptr<const Request> compiled_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestTemplate);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_MESSAGE_REQUEST_TEMPLATE_H_
@@ -0,0 +1,80 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/message/request_template.h"
+
+#include "sippet/message/message.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+scoped_refptr<Request> CreatePrototype() {
+  scoped_refptr<Request> request(
+      new Request(Method::REGISTER, GURL("sip:biloxi.com")));
+  request->push_back(scoped_ptr<Header>(
+      new To(GURL("sip:bob@biloxi.com"))));
+  scoped_ptr<From> from(new From(GURL("sip:bob@biloxi.com")));
+  from->set_tag("456248");
+  request->push_back(from.Pass());
+  request->push_back(scoped_ptr<Header>(
+      new CallId("843817637684230@998sdasdh09")));
+  request->push_back(scoped_ptr<Header>(new Cseq(1826, Method::REGISTER)));
+  request->push_back(scoped_ptr<Header>(new MaxForwards(70)));
+  scoped_ptr<Contact> contact(new Contact(GURL("sip:bob@192.0.2.4")));
+  contact->front().set_expires(7200);
+  request->push_back(contact.Pass());
+  return request;
+}
+
+}  // namespace
+
+TEST(RequestTemplateTest, StampsSequence) {
+  scoped_refptr<Request> prototype(CreatePrototype());
+  scoped_refptr<RequestTemplate> request_template(
+      new RequestTemplate(prototype));
+
+  scoped_refptr<Request> request(
+      request_template->CreateRequest(Method::REGISTER, 1827));
+  EXPECT_EQ(Method::REGISTER, request->method());
+  EXPECT_EQ(GURL("sip:biloxi.com"), request->request_uri());
+  EXPECT_EQ(1827u, request->get<Cseq>()->sequence());
+  EXPECT_EQ("456248", request->get<From>()->tag());
+  EXPECT_EQ("843817637684230@998sdasdh09", request->get<CallId>()->value());
+
+  prototype->get<Cseq>()->set_sequence(1827);
+  EXPECT_EQ(prototype->ToString(), request->ToString());
+}
+
+TEST(RequestTemplateTest, StampsTagAndCallId) {
+  scoped_refptr<RequestTemplate> request_template(
+      new RequestTemplate(CreatePrototype()));
+
+  scoped_refptr<Request> request(request_template->CreateRequest(
+      Method::OPTIONS, 1, "a6c85cf", "a84b4c76e66710"));
+  EXPECT_EQ(Method::OPTIONS, request->method());
+  EXPECT_EQ(Method::OPTIONS, request->get<Cseq>()->method());
+  EXPECT_EQ("a6c85cf", request->get<From>()->tag());
+  EXPECT_EQ("a84b4c76e66710", request->get<CallId>()->value());
+}
+
+TEST(RequestTemplateTest, RequestsAreIndependent) {
+  scoped_refptr<Request> prototype(CreatePrototype());
+  scoped_refptr<RequestTemplate> request_template(
+      new RequestTemplate(prototype));
+
+  scoped_refptr<Request> first(
+      request_template->CreateRequest(Method::REGISTER, 1826));
+  first->get<Contact>()->front().set_expires(0);
+  first->push_back(scoped_ptr<Header>(new Expires(0)));
+  EXPECT_NE(prototype->ToString(), first->ToString());
+
+  scoped_refptr<Request> second(
+      request_template->CreateRequest(Method::REGISTER, 1826));
+  EXPECT_EQ(prototype->ToString(), second->ToString());
+  EXPECT_EQ(7200u, second->get<Contact>()->front().expires());
+}
+
+} // namespace sippet
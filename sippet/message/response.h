@@ -11,6 +11,10 @@
 
 namespace sippet {
 
+namespace proxy {
+class Proxy;
+} // namespace proxy
+
 namespace ua {
 class UserAgent;
 } // namespace ua
@@ -55,8 +59,11 @@ private:
   friend class Request;
   friend class Message;
   friend class ClientTransactionImpl;
+  friend class NetworkLayer;
   friend class AuthControllerTest;
+  friend class CaptureReplayer;
   friend class ua::UserAgent;
+  friend class proxy::Proxy;
 
   Version version_;
   int response_code_;
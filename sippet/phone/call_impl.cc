@@ -13,6 +13,7 @@
 #include "base/callback.h"
 #include "net/base/net_errors.h"
 #include "re2/re2.h"
+#include "sippet/base/tracing.h"
 #include "sippet/message/status_code.h"
 #include "sippet/phone/completion_status.h"
 
@@ -248,6 +249,8 @@ void CallImpl::DeletePeerConnection() {
 
 void CallImpl::OnMakeCall(
     webrtc::PeerConnectionFactoryInterface *peer_connection_factory) {
+  SIPPET_TRACE_EVENT0("CallImpl::OnMakeCall");
+  SIPPET_TRACE_ASYNC_STEP_INTO0("Call::Setup", this, "CreateOffer");
   InitializePeerConnection(peer_connection_factory);
   // TODO(david): handle errors
 
@@ -267,6 +270,8 @@ void CallImpl::CreateOffer() {
 }
 
 void CallImpl::OnIceComplete() {
+  SIPPET_TRACE_EVENT0("CallImpl::OnIceComplete");
+  SIPPET_TRACE_ASYNC_STEP_INTO0("Call::Setup", this, "SendInvite");
   std::string offer;
   const webrtc::SessionDescriptionInterface* desc =
     peer_connection_->local_description();
@@ -326,15 +331,16 @@ void CallImpl::OnSetRemoteSessionFailure(const std::string& error) {
 }
 
 void CallImpl::OnCreateOfferCompleted(const std::string& offer) {
+  SIPPET_TRACE_EVENT0("CallImpl::OnCreateOfferCompleted");
   std::string request_uri(uri_.spec());
   std::string to(uri_.spec());
 
-  last_request_ =
+  set_last_request(
     phone_->user_agent()->CreateRequest(
         Method::INVITE,
         GURL(request_uri),
         phone_->settings().uri(),
-        GURL(to));
+        GURL(to)));
 
   scoped_ptr<ContentType> content_type(
     new ContentType("application", "sdp"));
@@ -344,14 +350,26 @@ void CallImpl::OnCreateOfferCompleted(const std::string& offer) {
   int rv = phone_->user_agent()->Send(last_request_,
       base::Bind(&RunIfNotOk, on_completed_));
   if (net::OK != rv && net::ERR_IO_PENDING != rv) {
+    EndSetupTrace(rv);
     state_ = CALL_STATE_TERMINATED;
     on_completed_.Run(rv);
     return;
   }
+  SIPPET_TRACE_ASYNC_STEP_INTO0("Call::Setup", this, "Calling");
 
   // Wait for SIP response now
 }
 
+void CallImpl::set_last_request(const scoped_refptr<Request> &request) {
+  phone_->OnCallRequestChanged(this, last_request_, request);
+  last_request_ = request;
+}
+
+void CallImpl::set_dialog(const scoped_refptr<Dialog> &dialog) {
+  phone_->OnCallDialogChanged(this, dialog_, dialog);
+  dialog_ = dialog;
+}
+
 void CallImpl::HandleSessionDescriptionAnswer(
       const scoped_refptr<Response> &incoming_response) {
   ContentType *content_type = incoming_response->get<ContentType>();
@@ -383,6 +401,7 @@ void CallImpl::SendAck(const scoped_refptr<Response> &incoming_response) {
   int rv = phone_->user_agent()->Send(ack,
       base::Bind(&RunIfNotOk, on_completed_));
   if (net::OK != rv && net::ERR_IO_PENDING != rv) {
+    EndSetupTrace(rv);
     state_ = CALL_STATE_TERMINATED;
     on_completed_.Run(rv);
     return;
@@ -411,7 +430,7 @@ void CallImpl::SendCancel() {
 }
 
 void CallImpl::SendBye() {
-  last_request_ = dialog_->CreateRequest(Method::BYE);
+  set_last_request(dialog_->CreateRequest(Method::BYE));
   int rv = phone_->user_agent()->Send(last_request_,
     base::Bind(&RunIfNotOk, on_hangup_completed_));
   if (net::OK != rv && net::ERR_IO_PENDING != rv) {
@@ -426,6 +445,8 @@ void CallImpl::HandleCallingOrRingingResponse(
       const scoped_refptr<Response> &incoming_response,
       const scoped_refptr<Dialog> &dialog) {
   DCHECK(CALL_STATE_RINGING == state_ || CALL_STATE_CALLING == state_);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("CallImpl::HandleCallingOrRingingResponse",
+                                incoming_response->GetTransactionTraceId());
 
   CallState next_state;  // Determine the next state
   int response_code = incoming_response->response_code();
@@ -444,6 +465,10 @@ void CallImpl::HandleCallingOrRingingResponse(
   // Send ACK for every 2xx
   if (next_state == CALL_STATE_ESTABLISHED) {
     SendAck(incoming_response);
+    if (CALL_STATE_TERMINATED == state_) {
+      phone_->RemoveCall(this);
+      return;
+    }
   }
 
   // Handle Session Description on ringing or established
@@ -454,6 +479,14 @@ void CallImpl::HandleCallingOrRingingResponse(
     }
   }
 
+  if (CALL_STATE_RINGING == next_state && state_ != next_state) {
+    SIPPET_TRACE_ASYNC_STEP_INTO0("Call::Setup", this, "Ringing");
+  } else if (CALL_STATE_ESTABLISHED == next_state
+             || CALL_STATE_TERMINATED == next_state) {
+    SIPPET_TRACE_ASYNC_END1("Call::Setup", this, "response_code",
+                            response_code);
+  }
+
   // Now change state and process post changed state conditions
   state_ = next_state;
   if (CALL_STATE_RINGING == state_) {
@@ -489,6 +522,13 @@ void CallImpl::HandleHungupResponse(
   }
 }
 
+void CallImpl::EndSetupTrace(int result) {
+  if (CALL_DIRECTION_OUTGOING == direction_
+      && (CALL_STATE_CALLING == state_ || CALL_STATE_RINGING == state_)) {
+    SIPPET_TRACE_ASYNC_END1("Call::Setup", this, "result", result);
+  }
+}
+
 void CallImpl::OnDestroy() {
   peer_connection_->Close();
   peer_connection_ = nullptr;
@@ -504,6 +544,7 @@ void CallImpl::OnReject() {
 }
 
 void CallImpl::OnHangup() {
+  EndSetupTrace(ERR_HANGUP_NORMAL_CLEARING);
   state_ = CALL_STATE_TERMINATED;
   if (!dialog_) {
     // Wait until the server answers a 18x before sending CANCEL
@@ -550,7 +591,7 @@ void CallImpl::OnIncomingRequest(
 void CallImpl::OnIncomingResponse(
     const scoped_refptr<Response> &incoming_response,
     const scoped_refptr<Dialog> &dialog) {
-  dialog_ = dialog;  // Save dialog
+  set_dialog(dialog);  // Save dialog
   if (CALL_STATE_CALLING == state_
       || CALL_STATE_RINGING == state_) {
     HandleCallingOrRingingResponse(incoming_response, dialog);
@@ -564,6 +605,7 @@ void CallImpl::OnTimedOut(
     const scoped_refptr<Dialog> &dialog) {
   if (CALL_STATE_CALLING == state_
       || CALL_STATE_RINGING == state_) {
+    EndSetupTrace(ERR_TIMED_OUT);
     state_ = CALL_STATE_TERMINATED;
     on_completed_.Run(ERR_TIMED_OUT);
     phone_->RemoveCall(this);
@@ -575,6 +617,7 @@ void CallImpl::OnTransportError(
     const scoped_refptr<Dialog> &dialog) {
   if (CALL_STATE_CALLING == state_
       || CALL_STATE_RINGING == state_) {
+    EndSetupTrace(error);
     state_ = CALL_STATE_TERMINATED;
     on_completed_.Run(error);
     phone_->RemoveCall(this);
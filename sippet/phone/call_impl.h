@@ -70,6 +70,8 @@ class CallImpl :
   void DeletePeerConnection();
   void CreateOffer();
   void OnCreateOfferCompleted(const std::string& offer);
+  void set_last_request(const scoped_refptr<Request> &request);
+  void set_dialog(const scoped_refptr<Dialog> &dialog);
   void HandleSessionDescriptionAnswer(const scoped_refptr<Response> &incoming_response);
   void SendAck(const scoped_refptr<Response> &incoming_response);
   void SendCancel();
@@ -80,6 +82,9 @@ class CallImpl :
   void HandleHungupResponse(
       const scoped_refptr<Response> &incoming_response,
       const scoped_refptr<Dialog> &dialog);
+  // Ends the "Call::Setup" trace of an outgoing call being terminated
+  // before it got established.
+  void EndSetupTrace(int result);
 
   //
   // PeerConnectionObserver implementation.
@@ -10,6 +10,7 @@
 
 #include "base/bind.h"
 #include "sippet/base/casting.h"
+#include "sippet/base/tracing.h"
 #include "base/strings/utf_string_conversions.h"
 #include "net/base/net_errors.h"
 #include "net/socket/client_socket_factory.h"
@@ -239,6 +240,7 @@ void PhoneImpl::UnregisterAll(const net::CompletionCallback& on_completed) {
 
 scoped_refptr<Call> PhoneImpl::MakeCall(const std::string& destination,
     const net::CompletionCallback& on_completed) {
+  SIPPET_TRACE_EVENT0("PhoneImpl::MakeCall");
   if (destination.empty()) {
     DVLOG(1) << "Empty destination";
     return nullptr;
@@ -257,6 +259,8 @@ scoped_refptr<Call> PhoneImpl::MakeCall(const std::string& destination,
   scoped_refptr<CallImpl> call(
       new CallImpl(destination_uri, this, on_completed));
   calls_.push_back(call);
+  // The setup stages of the call run on several threads.
+  SIPPET_TRACE_ASYNC_BEGIN0("Call::Setup", call.get());
   network_thread_.message_loop()->PostTask(FROM_HERE,
       base::Bind(&CallImpl::OnMakeCall, base::Unretained(call.get()),
           base::Unretained(peer_connection_factory_.get())));
@@ -264,6 +268,11 @@ scoped_refptr<Call> PhoneImpl::MakeCall(const std::string& destination,
 }
 
 void PhoneImpl::RemoveCall(const scoped_refptr<Call>& call) {
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+  CallImpl *call_impl = static_cast<CallImpl*>(call.get());
+  OnCallRequestChanged(call_impl, call_impl->last_request(), nullptr);
+  OnCallDialogChanged(call_impl, call_impl->dialog(), nullptr);
+
   base::AutoLock lock(lock_);
   CallsVector::iterator i;
   for (i = calls_.begin(); i != calls_.end(); ++i) {
@@ -274,6 +283,36 @@ void PhoneImpl::RemoveCall(const scoped_refptr<Call>& call) {
     calls_.erase(i);
 }
 
+void PhoneImpl::OnCallRequestChanged(
+    CallImpl *call,
+    const scoped_refptr<Request>& old_request,
+    const scoped_refptr<Request>& new_request) {
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+  if (old_request) {
+    CallsMap::iterator i = calls_by_request_id_.find(old_request->id());
+    if (calls_by_request_id_.end() != i && call == i->second)
+      calls_by_request_id_.erase(i);
+  }
+  if (new_request)
+    calls_by_request_id_[new_request->id()] = call;
+}
+
+void PhoneImpl::OnCallDialogChanged(
+    CallImpl *call,
+    const scoped_refptr<Dialog>& old_dialog,
+    const scoped_refptr<Dialog>& new_dialog) {
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+  if (old_dialog == new_dialog)
+    return;
+  if (old_dialog) {
+    CallsMap::iterator i = calls_by_dialog_id_.find(old_dialog->id());
+    if (calls_by_dialog_id_.end() != i && call == i->second)
+      calls_by_dialog_id_.erase(i);
+  }
+  if (new_dialog)
+    calls_by_dialog_id_[new_dialog->id()] = call;
+}
+
 bool PhoneImpl::InitializePeerConnectionFactory() {
   DCHECK(peer_connection_factory_.get() == nullptr);
 
@@ -303,6 +342,7 @@ void PhoneImpl::OnInit() {
 
   base::MessageLoop *message_loop = network_thread_.message_loop();
   refresh_timer_.reset(new base::OneShotTimer<PhoneImpl>);
+  settings_.timer_source()->Attach(refresh_timer_.get());
 
   request_context_getter_ =
       new URLRequestContextGetter(message_loop->task_runner());
@@ -318,7 +358,9 @@ void PhoneImpl::OnInit() {
       password_handler_factory_.get(),
       DialogController::GetDefaultDialogController(), net_log_));
 
-  network_layer_.reset(new NetworkLayer(user_agent_.get()));
+  NetworkSettings network_settings;
+  network_settings.set_timer_source(settings_.timer_source());
+  network_layer_.reset(new NetworkLayer(user_agent_.get(), network_settings));
 
   // Register the channel factory
   net::SSLConfig ssl_config;
@@ -336,6 +378,10 @@ void PhoneImpl::OnInit() {
 
   InitializePeerConnectionFactory();
 
+  memory_dump_provider_.reset(new MemoryUsageDumpProvider(
+      base::Bind(&PhoneImpl::DumpMemoryUsage, base::Unretained(this))));
+  memory_dump_provider_->Register();
+
   // Initialize the route-set, if available
   if (settings_.route_set().size() > 0) {
     user_agent_->set_route_set(settings_.route_set());
@@ -345,10 +391,14 @@ void PhoneImpl::OnInit() {
 void PhoneImpl::OnDestroy() {
   DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
 
+  memory_dump_provider_.reset();
+
   for (CallsVector::iterator i = calls_.begin(), ie = calls_.end();
        i != ie; i++) {
     (*i)->OnDestroy();
   }
+  calls_by_request_id_.clear();
+  calls_by_dialog_id_.clear();
   calls_.clear();
 
   channel_factory_.reset();
@@ -395,7 +445,8 @@ void PhoneImpl::OnStartRefreshRegister() {
   DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
 
   // Refresh the registration 25 seconds before expiration.
-  base::TimeDelta expiration = register_expires_ - base::Time::Now()
+  base::TimeDelta expiration = register_expires_
+      - settings_.timer_source()->NowTicks()
       - base::TimeDelta::FromSeconds(25);
   if (expiration < base::TimeDelta::FromSeconds(0))
     expiration = base::TimeDelta::FromSeconds(0);
@@ -465,6 +516,7 @@ void PhoneImpl::OnIncomingRequest(
       base::AutoLock lock(lock_);
       calls_.push_back(call);
     }
+    OnCallRequestChanged(call.get(), nullptr, incoming_request);
     delegate_->OnIncomingCall(call);
   } else {
     scoped_refptr<CallImpl> call = RouteToCall(dialog);
@@ -489,7 +541,7 @@ void PhoneImpl::OnIncomingResponse(
       } else if (response_code / 100 == 2) {
         // Save the time when the registration will expire
         unsigned int expiration = GetContactExpiration(incoming_response);
-        register_expires_ = base::Time::Now() +
+        register_expires_ = settings_.timer_source()->NowTicks() +
             base::TimeDelta::FromSeconds(expiration);
         base::AutoLock lock(lock_);
         state_ = PHONE_STATE_REGISTERED;
@@ -508,7 +560,7 @@ void PhoneImpl::OnIncomingResponse(
       } else if (response_code / 100 == 2) {
         // Start the timer to refresh login again
         unsigned int expiration = GetContactExpiration(incoming_response);
-        register_expires_ = base::Time::Now() +
+        register_expires_ = settings_.timer_source()->NowTicks() +
             base::TimeDelta::FromSeconds(expiration);
         OnStartRefreshRegister();
       } else {
@@ -590,25 +642,17 @@ void PhoneImpl::OnRefreshRegister() {
 }
 
 CallImpl *PhoneImpl::RouteToCall(const scoped_refptr<Request>& request) {
-  base::AutoLock lock(lock_);
-  CallsVector::iterator i;
-  // A simple linear search will do it for a small amount of
-  // simultaneous calls... But you can improve it if you want
-  for (i = calls_.begin(); i != calls_.end(); ++i) {
-    if (i->get()->last_request()->id() == request->id())
-      break;
-  }
-  return calls_.end() != i ? i->get() : nullptr;
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+  CallsMap::const_iterator i = calls_by_request_id_.find(request->id());
+  return calls_by_request_id_.end() != i ? i->second : nullptr;
 }
 
 CallImpl *PhoneImpl::RouteToCall(const scoped_refptr<Dialog>& dialog) {
-  base::AutoLock lock(lock_);
-  CallsVector::iterator i;
-  for (i = calls_.begin(); i != calls_.end(); ++i) {
-    if (i->get()->dialog()->id() == dialog->id())
-      break;
-  }
-  return calls_.end() != i ? i->get() : nullptr;
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+  if (!dialog)
+    return nullptr;
+  CallsMap::const_iterator i = calls_by_dialog_id_.find(dialog->id());
+  return calls_by_dialog_id_.end() != i ? i->second : nullptr;
 }
 
 unsigned int PhoneImpl::GetContactExpiration(
@@ -646,6 +690,30 @@ unsigned int PhoneImpl::GetContactExpiration(
   return 3600;
 }
 
+void PhoneImpl::DumpMemoryUsage(MemoryUsageDump *dump) {
+  DCHECK(GetNetworkTaskRunner()->BelongsToCurrentThread());
+
+  size_t call_count;
+  size_t bytes;
+  {
+    base::AutoLock lock(lock_);
+    call_count = calls_.size();
+    bytes = calls_.capacity() * sizeof(CallsVector::value_type)
+        + call_count * sizeof(CallImpl);
+  }
+  const CallsMap *indexes[] = { &calls_by_request_id_, &calls_by_dialog_id_ };
+  for (const CallsMap *index : indexes) {
+    for (const auto &entry : *index) {
+      bytes += kHashNodeOverhead + sizeof(entry)
+          + EstimateStringMemoryUsage(entry.first);
+    }
+  }
+  dump->Add("phone/calls", call_count, bytes);
+
+  user_agent_->DumpMemoryUsage(dump);
+  network_layer_->DumpMemoryUsage(dump);
+}
+
 std::string PhoneImpl::GetRegistrarUri() const {
   if (!settings_.registrar_server().is_empty()) {
     return settings_.registrar_server().spec();
@@ -7,6 +7,7 @@
 
 #include "sippet/phone/phone.h"
 
+#include "base/containers/hash_tables.h"
 #include "base/threading/thread.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/synchronization/lock.h"
@@ -14,6 +15,7 @@
 #include "net/dns/host_resolver.h"
 #include "net/url_request/url_request_context_getter.h"
 
+#include "sippet/base/memory_usage.h"
 #include "sippet/transport/network_layer.h"
 #include "sippet/transport/ssl_cert_error_handler.h"
 #include "sippet/transport/chrome/chrome_channel_factory.h"
@@ -49,6 +51,7 @@ class PhoneImpl :
   friend class CallImpl;
   friend class base::RefCountedThreadSafe<Phone>;
   typedef std::vector<scoped_refptr<CallImpl>> CallsVector;
+  typedef base::hash_map<std::string, CallImpl*> CallsMap;
 
   // Construct a |Phone|.
   PhoneImpl(Phone::Delegate *delegate);
@@ -61,6 +64,12 @@ class PhoneImpl :
   PhoneState last_state_;
   base::Lock lock_;
   CallsVector calls_;
+
+  // Indexes used to route network events to calls without scanning
+  // |calls_|. They are only accessed on the network thread, so they don't
+  // need to be guarded by |lock_|.
+  CallsMap calls_by_request_id_;
+  CallsMap calls_by_dialog_id_;
   Phone::Delegate *delegate_;
   Settings settings_;
 
@@ -103,8 +112,9 @@ class PhoneImpl :
   scoped_ptr<NetworkLayer> network_layer_;
   scoped_ptr<ChromeChannelFactory> channel_factory_;
   scoped_ptr<base::OneShotTimer<PhoneImpl>> refresh_timer_;
+  scoped_ptr<MemoryUsageDumpProvider> memory_dump_provider_;
   Settings::IceServers ice_servers_;
-  base::Time register_expires_;
+  base::TimeTicks register_expires_;
   net::CompletionCallback on_register_completed_;
   net::CompletionCallback on_unregister_completed_;
   net::CompletionCallback on_refresh_completed_;
@@ -122,6 +132,15 @@ class PhoneImpl :
   ua::UserAgent *user_agent() { return user_agent_.get(); }
   void RemoveCall(const scoped_refptr<Call>& call);
 
+  // Called by |CallImpl| on the network thread whenever its last request or
+  // dialog changes, so the routing indexes can follow.
+  void OnCallRequestChanged(CallImpl *call,
+                            const scoped_refptr<Request>& old_request,
+                            const scoped_refptr<Request>& new_request);
+  void OnCallDialogChanged(CallImpl *call,
+                           const scoped_refptr<Dialog>& old_dialog,
+                           const scoped_refptr<Dialog>& new_dialog);
+
   //
   // Signalling thread callbacks
   //
@@ -164,6 +183,10 @@ class PhoneImpl :
   CallImpl *RouteToCall(const scoped_refptr<Dialog>& dialog);
   unsigned int GetContactExpiration(const scoped_refptr<Response>& response);
 
+  // Adds the approximate memory held by the calls, the user agent and the
+  // network layer to |dump|. Run on the network thread.
+  void DumpMemoryUsage(MemoryUsageDump *dump);
+
   std::string GetRegistrarUri() const;
   std::string GetFromUri() const;
   SipURI GetToUri(const std::string& destination) const;
@@ -12,7 +12,8 @@ namespace phone {
 Settings::Settings() :
   disable_encryption_(false),
   disable_sctp_data_channels_(false),
-  register_expires_(600) {
+  register_expires_(600),
+  timer_source_(TimerSource::GetDefault()) {
 }
 
 Settings::~Settings() {
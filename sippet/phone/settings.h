@@ -11,6 +11,7 @@
 #include "url/gurl.h"
 
 #include "sippet/phone/ice_server.h"
+#include "sippet/transport/timer_source.h"
 
 namespace sippet {
 namespace phone {
@@ -116,6 +117,16 @@ class Settings {
   void set_registrar_server(const GURL& value) {
     registrar_server_ = value;
   }
+
+  // Source of the time and timers of the network thread: SIP transactions,
+  // idle channels and registration refreshes. It must run its timers on the
+  // network thread. Defaults to the system clock.
+  TimerSource *timer_source() const {
+    return timer_source_;
+  }
+  void set_timer_source(TimerSource *value) {
+    timer_source_ = value;
+  }
  
  private:
   IceServers ice_servers_;
@@ -129,6 +140,7 @@ class Settings {
   std::string password_;
   unsigned register_expires_;
   GURL registrar_server_;
+  TimerSource *timer_source_;
 };
 
 } // namespace sippet
@@ -0,0 +1,667 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/proxy/proxy.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/md5.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "net/base/net_errors.h"
+#include "sippet/base/tags.h"
+#include "sippet/uri/uri.h"
+
+namespace sippet {
+namespace proxy {
+
+namespace {
+
+const unsigned kDefaultMaxForwards = 70;
+
+// Timer C must be longer than 3 minutes (RFC 3261 section 16.6, item 11).
+const int kTimerCSeconds = 181;
+
+// Length of the hashes put in branches, in hex digits.
+const size_t kHashLength = 16;
+
+std::string Hash(const std::string &key) {
+  return base::MD5String(key).substr(0, kHashLength);
+}
+
+// Copies |request| to be sent to a new branch, keeping its CSeq.
+scoped_refptr<Request> CopyRequest(const scoped_refptr<Request> &request) {
+  const Request *source = request.get();
+  scoped_refptr<Request> copy(new Request(source->method(),
+      source->request_uri(), source->version()));
+  for (Message::const_iterator i = source->begin(), ie = source->end();
+       i != ie; ++i) {
+    copy->push_back(i->Clone().Pass());
+  }
+  if (source->has_content())
+    copy->set_content(source->content());
+  return copy;
+}
+
+}  // namespace
+
+Proxy::Target::Target()
+  : q(1.0) {
+}
+
+Proxy::Target::Target(const GURL &uri, double q)
+  : uri(uri),
+    q(q) {
+}
+
+Proxy::Target::~Target() {
+}
+
+Proxy::Branch::Branch()
+  : response_code(0),
+    cancel_sent(false) {
+}
+
+Proxy::Branch::~Branch() {
+}
+
+Proxy::ServerContext::ServerContext()
+  : next_target(0),
+    best_response_code(0),
+    final_response_sent(false),
+    cancelled(false) {
+}
+
+Proxy::ServerContext::~ServerContext() {
+}
+
+Proxy::Proxy(Mode mode,
+             const net::HostPortPair &local_address,
+             Delegate *delegate)
+  : mode_(mode),
+    local_address_(local_address),
+    record_route_uri_("sip:" + local_address.ToString() + ";lr"),
+    delegate_(delegate),
+    network_layer_(nullptr),
+    record_route_(false),
+    timer_source_(TimerSource::GetDefault()),
+    weak_factory_(this) {
+  DCHECK(delegate_);
+  timer_source_->Attach(&timer_c_);
+}
+
+Proxy::~Proxy() {
+  STLDeleteValues(&contexts_);
+}
+
+void Proxy::set_timer_source(TimerSource *timer_source) {
+  DCHECK(timer_source);
+  DCHECK(!timer_c_.IsRunning());
+  timer_source_ = timer_source;
+  timer_source_->Attach(&timer_c_);
+}
+
+void Proxy::AddDomain(const std::string &domain) {
+  domains_.insert(base::StringToLowerASCII(domain));
+}
+
+void Proxy::OnChannelConnected(const EndPoint &destination, int err) {
+}
+
+void Proxy::OnChannelClosed(const EndPoint &destination) {
+}
+
+void Proxy::OnIncomingRequest(const scoped_refptr<Request> &request) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(network_layer_);
+  std::string loop_hash(GetLoopHash(request));
+  if (DetectLoop(request, loop_hash)) {
+    Reply(request, SIP_LOOP_DETECTED);
+    return;
+  }
+  int response_code = PrepareRequest(request);
+  if (0 != response_code) {
+    Reply(request, response_code);
+    return;
+  }
+
+  if (MODE_STATELESS == mode_ || Method::ACK == request->method()) {
+    ForwardStateless(request, loop_hash);
+    return;
+  }
+  if (Method::CANCEL == request->method()) {
+    HandleCancel(request);
+    return;
+  }
+
+  std::string key(GetContextKey(request));
+  if (contexts_.end() != contexts_.find(key))
+    return;
+  scoped_ptr<ServerContext> context(new ServerContext);
+  GetRequestTargets(request, &context->targets);
+  if (context->targets.empty()) {
+    Reply(request, SIP_TEMPORARILY_UNAVAILABLE);
+    return;
+  }
+  context->key = key;
+  context->loop_hash = loop_hash;
+  context->request = request;
+  ServerContext *raw_context = context.release();
+  contexts_[key] = raw_context;
+  StartNextTargets(raw_context);
+  Proceed(raw_context);
+}
+
+void Proxy::OnIncomingResponse(const scoped_refptr<Response> &response) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ServerContext *context;
+  Branch *branch;
+  if (!response->refer_to()
+      || !FindBranch(response->refer_to()->id(), &context, &branch))
+    return;
+  HandleBranchResponse(context, branch, response, response->response_code());
+  Proceed(context);
+}
+
+void Proxy::OnTimedOut(const scoped_refptr<Request> &request) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ServerContext *context;
+  Branch *branch;
+  if (!FindBranch(request->id(), &context, &branch))
+    return;
+  HandleBranchResponse(context, branch, nullptr, SIP_REQUEST_TIMEOUT);
+  Proceed(context);
+}
+
+void Proxy::OnTransportError(const scoped_refptr<Request> &request,
+                             int error) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ServerContext *context;
+  Branch *branch;
+  if (!FindBranch(request->id(), &context, &branch))
+    return;
+  HandleBranchResponse(context, branch, nullptr, SIP_SERVICE_UNAVAILABLE);
+  Proceed(context);
+}
+
+bool Proxy::ShouldCreateServerTransaction(
+    const scoped_refptr<Request> &request) {
+  return MODE_STATEFUL == mode_ && Method::ACK != request->method();
+}
+
+bool Proxy::OnUnattachedResponse(const scoped_refptr<Response> &response) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  // Either a response to a stateless request, or a retransmission of a 2xx
+  // of an INVITE whose client transaction is already gone.
+  return ForwardResponse(response, nullptr);
+}
+
+// static
+std::string Proxy::GetLoopHash(const scoped_refptr<Request> &request) {
+  const Request *source = request.get();
+  std::string key;
+  // The ACK of a non-2xx response carries the To tag of the response, which
+  // the INVITE didn't have. Leaving it out gives both the same hash, and so
+  // the same stateless branch.
+  const To *to = source->get<To>();
+  if (to && to->HasTag() && Method::ACK != source->method())
+    key += to->tag();
+  key += '\n';
+  const From *from = source->get<From>();
+  if (from && from->HasTag())
+    key += from->tag();
+  key += '\n';
+  const CallId *call_id = source->get<CallId>();
+  if (call_id)
+    key += call_id->value();
+  key += '\n';
+  const Cseq *cseq = source->get<Cseq>();
+  if (cseq)
+    key += base::UintToString(cseq->sequence());
+  key += '\n';
+  key += source->request_uri().spec();
+  for (Message::const_iterator i = source->find_first<Route>(),
+       ie = source->end(); i != ie; i = source->find_next<Route>(i)) {
+    const Route *route = dyn_cast<Route>(i);
+    for (Route::const_iterator j = route->begin(), je = route->end();
+         j != je; ++j) {
+      key += '\n';
+      key += j->address().spec();
+    }
+  }
+  return Hash(key);
+}
+
+// static
+std::string Proxy::GetStatelessBranch(const scoped_refptr<Request> &request,
+                                      const std::string &loop_hash) {
+  const Request *source = request.get();
+  const Via *via = source->get<Via>();
+  std::string key;
+  if (via && !via->empty()) {
+    const ViaParam &topmost = via->front();
+    if (topmost.HasBranch()
+        && base::StartsWith(topmost.branch(), kMagicCookie,
+            base::CompareCase::SENSITIVE))
+      key = topmost.branch();
+    else
+      key = loop_hash;
+    key += '\n';
+    key += topmost.sent_by().ToString();
+  } else {
+    key = loop_hash;
+  }
+  return kMagicCookie + Hash(key) + "." + loop_hash;
+}
+
+// static
+std::string Proxy::GetContextKey(const scoped_refptr<Request> &request) {
+  const Request *source = request.get();
+  const Via *via = source->get<Via>();
+  if (!via || via->empty() || !via->front().HasBranch())
+    return GetLoopHash(request);
+  return via->front().branch() + "\n" + via->front().sent_by().ToString();
+}
+
+// static
+int Proxy::GetResponseRank(int response_code) {
+  int response_class = response_code / 100;
+  return 6 == response_class ? 0 : response_class;
+}
+
+bool Proxy::IsLocal(const GURL &uri) const {
+  if (!uri.SchemeIs("sip") && !uri.SchemeIs("sips"))
+    return false;
+  SipURI sip_uri(uri);
+  return sip_uri.is_valid()
+      && sip_uri.host() == local_address_.host()
+      && sip_uri.EffectiveIntPort() == local_address_.port();
+}
+
+bool Proxy::IsResponsibleFor(const GURL &uri) const {
+  if (!uri.SchemeIs("sip") && !uri.SchemeIs("sips"))
+    return false;
+  SipURI sip_uri(uri);
+  return sip_uri.is_valid()
+      && (domains_.end() != domains_.find(sip_uri.host()) || IsLocal(uri));
+}
+
+bool Proxy::DetectLoop(const scoped_refptr<Request> &request,
+                       const std::string &loop_hash) const {
+  const Request *source = request.get();
+  std::string suffix("." + loop_hash);
+  for (Message::const_iterator i = source->find_first<Via>(),
+       ie = source->end(); i != ie; i = source->find_next<Via>(i)) {
+    const Via *via = dyn_cast<Via>(i);
+    for (Via::const_iterator j = via->begin(), je = via->end(); j != je;
+         ++j) {
+      if (j->sent_by().Equals(local_address_) && j->HasBranch()
+          && base::EndsWith(j->branch(), suffix,
+              base::CompareCase::SENSITIVE))
+        return true;
+    }
+  }
+  return false;
+}
+
+int Proxy::PrepareRequest(const scoped_refptr<Request> &request) {
+  MaxForwards *max_forwards = request->get<MaxForwards>();
+  if (max_forwards && 0 == max_forwards->value())
+    return SIP_TOO_MANY_HOPS;
+
+  Message::iterator i = request->find_first<Route>();
+  if (request->end() != i) {
+    // A strict router placed our Record-Route in the Request-URI, and the
+    // target in the last Route (RFC 3261 section 16.4).
+    if (IsLocal(request->request_uri())) {
+      Message::iterator last = i;
+      for (Message::iterator j = request->find_next<Route>(i);
+           request->end() != j; j = request->find_next<Route>(j))
+        last = j;
+      Route *last_route = dyn_cast<Route>(last);
+      request->set_request_uri(last_route->back().address());
+      last_route->erase(last_route->end() - 1);
+      if (last_route->empty()) {
+        if (last == i)
+          i = request->end();
+        request->erase(last);
+      }
+    }
+    // Remove ourselves from the route set.
+    if (request->end() != i) {
+      Route *route = dyn_cast<Route>(i);
+      if (IsLocal(route->front().address())) {
+        route->erase(route->begin());
+        if (route->empty())
+          request->erase(i);
+      }
+    }
+  }
+
+  if (max_forwards) {
+    max_forwards->set_value(max_forwards->value() - 1);
+  } else {
+    request->push_back(scoped_ptr<Header>(
+        new MaxForwards(kDefaultMaxForwards - 1)));
+  }
+
+  if (record_route_ && Method::ACK != request->method()
+      && Method::CANCEL != request->method()) {
+    request->insert(request->find_first<RecordRoute>(),
+        scoped_ptr<Header>(new RecordRoute(RouteParam(record_route_uri_))));
+  }
+  return 0;
+}
+
+void Proxy::GetRequestTargets(const scoped_refptr<Request> &request,
+                              std::vector<Target> *targets) {
+  if (IsResponsibleFor(request->request_uri()))
+    delegate_->GetTargets(request, targets);
+  else
+    targets->push_back(Target(request->request_uri(), 1.0));
+}
+
+int Proxy::Forward(const scoped_refptr<Request> &request,
+                   const GURL &target,
+                   const std::string &branch,
+                   const net::CompletionCallback &callback) {
+  if (request->request_uri() != target)
+    request->set_request_uri(target);
+  EndPoint destination(NetworkLayer::GetMessageEndPoint(request));
+  if (destination.IsEmpty())
+    return net::ERR_INVALID_ARGUMENT;
+  scoped_ptr<Via> via(new Via);
+  via->push_back(ViaParam(destination.protocol(), local_address_));
+  via->back().set_branch(branch);
+  request->push_front(via.Pass());
+  request->set_direction(Message::Outgoing);
+  if (!ShouldCreateServerTransaction(request))
+    return network_layer_->SendStateless(request, callback);
+  return network_layer_->Send(request, callback);
+}
+
+void Proxy::ForwardStateless(const scoped_refptr<Request> &request,
+                             const std::string &loop_hash) {
+  std::vector<Target> targets;
+  GetRequestTargets(request, &targets);
+  if (targets.empty()) {
+    Reply(request, SIP_TEMPORARILY_UNAVAILABLE);
+    return;
+  }
+  int rv = Forward(request, targets.front().uri,
+      GetStatelessBranch(request, loop_hash), net::CompletionCallback());
+  if (net::OK != rv && net::ERR_IO_PENDING != rv)
+    DVLOG(1) << "Failed to forward request: " << net::ErrorToString(rv);
+}
+
+bool Proxy::ForwardResponse(const scoped_refptr<Response> &response,
+                            const scoped_refptr<Request> &refer_to) {
+  Message::iterator i = response->find_first<Via>();
+  if (response->end() == i)
+    return false;
+  Via *via = dyn_cast<Via>(i);
+  if (via->empty() || !via->front().sent_by().Equals(local_address_))
+    return false;
+  via->erase(via->begin());
+  if (via->empty())
+    response->erase(i);
+  // Responses to requests originated by the proxy itself end here.
+  if (response->end() == response->find_first<Via>())
+    return false;
+
+  response->set_direction(Message::Outgoing);
+  int rv;
+  if (refer_to) {
+    response->set_refer_to(refer_to);
+    rv = network_layer_->Send(response, net::CompletionCallback());
+  } else {
+    rv = network_layer_->SendStateless(response, net::CompletionCallback());
+  }
+  if (net::OK != rv && net::ERR_IO_PENDING != rv)
+    DVLOG(1) << "Failed to forward response: " << net::ErrorToString(rv);
+  return true;
+}
+
+void Proxy::Reply(const scoped_refptr<Request> &request, int response_code) {
+  if (Method::ACK == request->method())
+    return;
+  scoped_refptr<Response> response(
+      request->CreateResponse(static_cast<StatusCode>(response_code)));
+  if (ShouldCreateServerTransaction(request))
+    network_layer_->Send(response, net::CompletionCallback());
+  else
+    network_layer_->SendStateless(response, net::CompletionCallback());
+}
+
+void Proxy::HandleCancel(const scoped_refptr<Request> &cancel) {
+  ContextMap::iterator i = contexts_.find(GetContextKey(cancel));
+  if (contexts_.end() == i || Method::INVITE != i->second->request->method()) {
+    Reply(cancel, SIP_CALL_TRANSACTION_DOES_NOT_EXIST);
+    return;
+  }
+  Reply(cancel, SIP_OK);
+  ServerContext *context = i->second;
+  context->cancelled = true;
+  CancelPendingBranches(context);
+}
+
+void Proxy::StartNextTargets(ServerContext *context) {
+  const std::vector<Target> &targets = context->targets;
+  while (context->next_target < targets.size()) {
+    double q = targets[context->next_target].q;
+    bool started = false;
+    for (; context->next_target < targets.size()
+           && targets[context->next_target].q == q; ++context->next_target) {
+      Branch branch;
+      branch.request = CopyRequest(context->request);
+      std::string request_id(branch.request->id());
+      int rv = Forward(branch.request, targets[context->next_target].uri,
+          CreateBranch() + "." + context->loop_hash,
+          base::Bind(&Proxy::OnBranchSent, weak_factory_.GetWeakPtr(),
+                     request_id));
+      if (net::OK != rv && net::ERR_IO_PENDING != rv) {
+        HandleBranchResponse(context, &branch, nullptr,
+                             SIP_SERVICE_UNAVAILABLE);
+        continue;
+      }
+      branches_[request_id] = context->key;
+      context->branches.push_back(branch);
+      if (Method::INVITE == branch.request->method())
+        StartTimerC(&context->branches.back());
+      started = true;
+    }
+    if (started)
+      return;
+  }
+}
+
+void Proxy::OnBranchSent(const std::string &request_id, int rv) {
+  if (net::OK == rv)
+    return;
+  ServerContext *context;
+  Branch *branch;
+  if (!FindBranch(request_id, &context, &branch))
+    return;
+  HandleBranchResponse(context, branch, nullptr, SIP_SERVICE_UNAVAILABLE);
+  Proceed(context);
+}
+
+void Proxy::HandleBranchResponse(ServerContext *context,
+                                 Branch *branch,
+                                 const scoped_refptr<Response> &response,
+                                 int response_code) {
+  if (branch->response_code >= 200)
+    return;
+  branch->response_code = response_code;
+  if (response_code < 200) {
+    if (!branch->timer_c_deadline.is_null())
+      StartTimerC(branch);
+    if (context->cancelled)
+      CancelBranch(branch);
+    else if (response_code > 100 && response)
+      ForwardResponse(response, context->request);
+    return;
+  }
+  if (response_code / 100 == 2) {
+    // All 2xx responses are forwarded, even after another one.
+    if (response)
+      ForwardResponse(response, context->request);
+    context->final_response_sent = true;
+    context->cancelled = true;
+    CancelPendingBranches(context);
+    return;
+  }
+  if (context->final_response_sent)
+    return;
+  if (0 == context->best_response_code
+      || GetResponseRank(response_code)
+          < GetResponseRank(context->best_response_code)) {
+    context->best_response = response;
+    context->best_response_code = response_code;
+  }
+  if (response_code / 100 == 6) {
+    context->cancelled = true;
+    CancelPendingBranches(context);
+  }
+}
+
+void Proxy::CancelBranch(Branch *branch) {
+  if (branch->cancel_sent || Method::INVITE != branch->request->method())
+    return;
+  scoped_refptr<Request> cancel;
+  if (net::OK != branch->request->CreateCancel(cancel))
+    return;
+  branch->cancel_sent = true;
+  network_layer_->Send(cancel, net::CompletionCallback());
+}
+
+void Proxy::CancelPendingBranches(ServerContext *context) {
+  // Branches without a provisional response are cancelled once they get
+  // one.
+  for (std::vector<Branch>::iterator i = context->branches.begin(),
+       ie = context->branches.end(); i != ie; ++i) {
+    if (i->response_code > 0 && i->response_code < 200)
+      CancelBranch(&*i);
+  }
+}
+
+void Proxy::StartTimerC(Branch *branch) {
+  base::TimeDelta interval(base::TimeDelta::FromSeconds(kTimerCSeconds));
+  branch->timer_c_deadline = timer_source_->NowTicks() + interval;
+  // All branches share the same interval, so deadlines are kept in order.
+  timer_c_deadlines_.push_back(
+      std::make_pair(branch->timer_c_deadline, branch->request->id()));
+  if (!timer_c_.IsRunning())
+    timer_c_.Start(FROM_HERE, interval, this, &Proxy::OnTimerC);
+}
+
+void Proxy::OnTimerC() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  base::TimeTicks now(timer_source_->NowTicks());
+  std::vector<std::string> expired;
+  while (!timer_c_deadlines_.empty()
+         && timer_c_deadlines_.front().first <= now) {
+    ServerContext *context;
+    Branch *branch;
+    const std::string &request_id = timer_c_deadlines_.front().second;
+    if (FindBranch(request_id, &context, &branch)
+        && branch->response_code < 200
+        && branch->timer_c_deadline == timer_c_deadlines_.front().first)
+      expired.push_back(request_id);
+    timer_c_deadlines_.pop_front();
+  }
+  if (!timer_c_deadlines_.empty()) {
+    timer_c_.Start(FROM_HERE, timer_c_deadlines_.front().first - now, this,
+                   &Proxy::OnTimerC);
+  }
+  for (std::vector<std::string>::const_iterator i = expired.begin(),
+       ie = expired.end(); i != ie; ++i) {
+    // Contexts may have been destroyed by the previous branches.
+    ServerContext *context;
+    Branch *branch;
+    if (!FindBranch(*i, &context, &branch))
+      continue;
+    // Branches that got a provisional response must be cancelled, and all
+    // of them behave as if they got a 408 (RFC 3261 section 16.8).
+    if (branch->response_code > 0)
+      CancelBranch(branch);
+    HandleBranchResponse(context, branch, nullptr, SIP_REQUEST_TIMEOUT);
+    Proceed(context);
+  }
+}
+
+bool Proxy::IsCompleted(const ServerContext *context) const {
+  for (std::vector<Branch>::const_iterator i = context->branches.begin(),
+       ie = context->branches.end(); i != ie; ++i) {
+    if (i->response_code < 200)
+      return false;
+  }
+  return true;
+}
+
+void Proxy::Proceed(ServerContext *context) {
+  while (IsCompleted(context) && !context->final_response_sent) {
+    if (context->cancelled
+        || context->next_target >= context->targets.size()) {
+      SendBestResponse(context);
+      break;
+    }
+    StartNextTargets(context);
+  }
+  if (!context->final_response_sent || !IsCompleted(context))
+    return;
+  for (std::vector<Branch>::const_iterator i = context->branches.begin(),
+       ie = context->branches.end(); i != ie; ++i) {
+    branches_.erase(i->request->id());
+  }
+  contexts_.erase(context->key);
+  delete context;
+}
+
+void Proxy::SendBestResponse(ServerContext *context) {
+  context->final_response_sent = true;
+  int response_code = context->best_response_code;
+  if (0 == response_code)
+    response_code = SIP_REQUEST_TIMEOUT;
+  // A 503 would make the upstream elements avoid this proxy, instead of the
+  // failed target (RFC 3261 section 16.7, item 6).
+  if (SIP_SERVICE_UNAVAILABLE == response_code)
+    response_code = SIP_SERVER_INTERNAL_ERROR;
+  scoped_refptr<Response> response(context->best_response);
+  if (response) {
+    if (response->response_code() != response_code) {
+      response->set_response_code(response_code);
+      response->set_reason_phrase(
+          GetReasonPhrase(static_cast<StatusCode>(response_code)));
+    }
+    ForwardResponse(response, context->request);
+  } else {
+    Reply(context->request, response_code);
+  }
+}
+
+bool Proxy::FindBranch(const std::string &request_id,
+                       ServerContext **context,
+                       Branch **branch) {
+  BranchMap::const_iterator i = branches_.find(request_id);
+  if (branches_.end() == i)
+    return false;
+  ContextMap::iterator j = contexts_.find(i->second);
+  if (contexts_.end() == j)
+    return false;
+  std::vector<Branch> &branches = j->second->branches;
+  for (std::vector<Branch>::iterator k = branches.begin(),
+       ke = branches.end(); k != ke; ++k) {
+    if (k->request->id() == request_id) {
+      *context = j->second;
+      *branch = &*k;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace proxy
+} // namespace sippet
@@ -0,0 +1,266 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_PROXY_PROXY_H_
+#define SIPPET_PROXY_PROXY_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/gtest_prod_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "net/base/host_port_pair.h"
+#include "sippet/message/message.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/transport/timer_source.h"
+#include "url/gurl.h"
+
+namespace sippet {
+namespace proxy {
+
+// A SIP proxy core (RFC 3261 section 16), built directly on |NetworkLayer|.
+//
+// In |MODE_STATELESS| (section 16.11), no transactions are created. Each
+// request is forwarded to a single target, and responses are forwarded by
+// their |Via| headers alone. The branch of a forwarded request is computed
+// from the received one, so that retransmissions, CANCELs and ACKs of
+// non-2xx responses take the same branch as the request they refer to.
+// Received messages are forwarded as they are, changing only the headers
+// the proxy must change, so that unchanged headers are printed from their
+// original text.
+//
+// In |MODE_STATEFUL|, requests are received through server transactions and
+// forwarded through client transactions, forking to all targets given by the
+// |Delegate|. Targets with the same q-value are tried in parallel, and
+// groups of decreasing q-value one after the other. ACKs of 2xx responses
+// are always forwarded statelessly. INVITE branches without a final response
+// for more than 3 minutes after their last provisional one are cancelled and
+// taken as answered by a 408 (Request Timeout), as done by Timer C (section
+// 16.8).
+//
+// The proxy must be the |NetworkLayer::Delegate|, and all its methods must
+// be called on the network thread.
+class Proxy : public NetworkLayer::Delegate {
+ public:
+  enum Mode {
+    MODE_STATELESS,
+    MODE_STATEFUL,
+  };
+
+  struct Target {
+    Target();
+    Target(const GURL &uri, double q);
+    ~Target();
+
+    GURL uri;
+    double q;
+  };
+
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // Fills |targets| with the targets of a |request| whose Request-URI is
+    // in one of the proxy domains, in decreasing q-value order, such as the
+    // contacts of a |ua::LocationService|. Requests without targets are
+    // answered with 480 (Temporarily Unavailable). A stateless proxy only
+    // uses the first target, and must be given the same targets for a
+    // CANCEL or ACK as for the request they refer to.
+    virtual void GetTargets(const scoped_refptr<Request> &request,
+                            std::vector<Target> *targets) = 0;
+  };
+
+  // |local_address| is the address the proxy is reachable at, used in its
+  // |Via| and |RecordRoute| headers. |delegate| must outlive the proxy.
+  Proxy(Mode mode,
+        const net::HostPortPair &local_address,
+        Delegate *delegate);
+  ~Proxy() override;
+
+  // The |NetworkLayer| must have the proxy as its delegate, and outlive it.
+  void set_network_layer(NetworkLayer *network_layer) {
+    network_layer_ = network_layer;
+  }
+
+  // The time seen by Timer C, usually the one given to the |NetworkLayer|.
+  // Defaults to the system clock. To be set before any request is received.
+  void set_timer_source(TimerSource *timer_source);
+
+  // Requests whose Request-URI host is |domain| are routed to the targets
+  // given by the |Delegate|. Other requests are forwarded to their
+  // Request-URI.
+  void AddDomain(const std::string &domain);
+
+  // Whether to insert a |RecordRoute| header in forwarded requests, keeping
+  // the proxy in the path of the dialogs they establish. Defaults to false.
+  void set_record_route(bool record_route) {
+    record_route_ = record_route;
+  }
+
+  Mode mode() const {
+    return mode_;
+  }
+
+  // NetworkLayer::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override;
+  void OnChannelClosed(const EndPoint &destination) override;
+  void OnIncomingRequest(const scoped_refptr<Request> &request) override;
+  void OnIncomingResponse(const scoped_refptr<Response> &response) override;
+  void OnTimedOut(const scoped_refptr<Request> &request) override;
+  void OnTransportError(
+      const scoped_refptr<Request> &request, int error) override;
+  bool ShouldCreateServerTransaction(
+      const scoped_refptr<Request> &request) override;
+  bool OnUnattachedResponse(const scoped_refptr<Response> &response) override;
+
+ private:
+  FRIEND_TEST_ALL_PREFIXES(ProxyTest, StatelessBranch);
+  FRIEND_TEST_ALL_PREFIXES(ProxyTest, LoopDetection);
+  FRIEND_TEST_ALL_PREFIXES(ProxyTest, ResponseRanking);
+  FRIEND_TEST_ALL_PREFIXES(StatefulProxyTest, ForwardRequestAndResponses);
+  FRIEND_TEST_ALL_PREFIXES(StatefulProxyTest, CancelPendingBranch);
+  FRIEND_TEST_ALL_PREFIXES(StatefulProxyTest, TimerC);
+
+  // A request forwarded by a stateful proxy.
+  struct Branch {
+    Branch();
+    ~Branch();
+
+    scoped_refptr<Request> request;
+    // The last response code received, if any.
+    int response_code;
+    bool cancel_sent;
+    // When Timer C fires, for INVITE branches.
+    base::TimeTicks timer_c_deadline;
+  };
+
+  // The state of a request received by a stateful proxy.
+  struct ServerContext {
+    ServerContext();
+    ~ServerContext();
+
+    std::string key;
+    std::string loop_hash;
+    scoped_refptr<Request> request;
+    std::vector<Target> targets;
+    // The next target to be tried.
+    size_t next_target;
+    std::vector<Branch> branches;
+    // The best final response received so far, or NULL if it was generated
+    // locally, such as a 408 after a timeout.
+    scoped_refptr<Response> best_response;
+    int best_response_code;
+    bool final_response_sent;
+    // No more branches are to be started, and the pending ones are
+    // cancelled.
+    bool cancelled;
+  };
+
+  typedef std::map<std::string, ServerContext*> ContextMap;
+  // Context keys by the ID of the forwarded requests.
+  typedef base::hash_map<std::string, std::string> BranchMap;
+  // Timer C deadlines, with the ID of their branch requests.
+  typedef std::deque<std::pair<base::TimeTicks, std::string> > DeadlineList;
+
+  // Hash of the fields that identify a request along its path, used to
+  // detect loops (RFC 3261 section 16.6, item 8). The To tag of ACKs isn't
+  // hashed, so that the ACK of a non-2xx response hashes as its INVITE.
+  static std::string GetLoopHash(const scoped_refptr<Request> &request);
+
+  // The branch a stateless proxy uses to forward |request|: a hash of its
+  // topmost branch and sent-by, followed by |loop_hash|. Retransmissions,
+  // CANCELs and ACKs of non-2xx responses get the branch of their INVITE.
+  static std::string GetStatelessBranch(const scoped_refptr<Request> &request,
+                                        const std::string &loop_hash);
+
+  // Key matching a received request with its CANCEL.
+  static std::string GetContextKey(const scoped_refptr<Request> &request);
+
+  // Ranks final response codes: the lower, the better (section 16.7, item
+  // 6).
+  static int GetResponseRank(int response_code);
+
+  bool IsLocal(const GURL &uri) const;
+  bool IsResponsibleFor(const GURL &uri) const;
+  bool DetectLoop(const scoped_refptr<Request> &request,
+                  const std::string &loop_hash) const;
+
+  // Validates and updates the headers of a received |request| before
+  // forwarding. Returns a response code to reject it, or zero.
+  int PrepareRequest(const scoped_refptr<Request> &request);
+
+  void GetRequestTargets(const scoped_refptr<Request> &request,
+                         std::vector<Target> *targets);
+
+  // Sets the target and the topmost |Via| of |request|, and sends it.
+  int Forward(const scoped_refptr<Request> &request,
+              const GURL &target,
+              const std::string &branch,
+              const net::CompletionCallback &callback);
+
+  void ForwardStateless(const scoped_refptr<Request> &request,
+                        const std::string &loop_hash);
+  bool ForwardResponse(const scoped_refptr<Response> &response,
+                       const scoped_refptr<Request> &refer_to);
+  void Reply(const scoped_refptr<Request> &request, int response_code);
+
+  void HandleCancel(const scoped_refptr<Request> &cancel);
+  void StartNextTargets(ServerContext *context);
+  void OnBranchSent(const std::string &request_id, int rv);
+  void HandleBranchResponse(ServerContext *context,
+                            Branch *branch,
+                            const scoped_refptr<Response> &response,
+                            int response_code);
+  void CancelBranch(Branch *branch);
+  void CancelPendingBranches(ServerContext *context);
+
+  // (Re)starts Timer C of an INVITE |branch|.
+  void StartTimerC(Branch *branch);
+  void OnTimerC();
+  bool IsCompleted(const ServerContext *context) const;
+
+  // Starts the next targets, or sends the best response, once all branches
+  // are completed. The |context| is destroyed when no longer needed.
+  void Proceed(ServerContext *context);
+  void SendBestResponse(ServerContext *context);
+  bool FindBranch(const std::string &request_id,
+                  ServerContext **context,
+                  Branch **branch);
+
+  Mode mode_;
+  net::HostPortPair local_address_;
+  GURL record_route_uri_;
+  Delegate *delegate_;
+  NetworkLayer *network_layer_;
+  std::set<std::string> domains_;
+  bool record_route_;
+
+  ContextMap contexts_;
+  BranchMap branches_;
+
+  TimerSource *timer_source_;
+  // Superseded deadlines are left in the list, and skipped when due.
+  DeadlineList timer_c_deadlines_;
+  base::OneShotTimer<Proxy> timer_c_;
+
+  base::ThreadChecker thread_checker_;
+  base::WeakPtrFactory<Proxy> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Proxy);
+};
+
+} // namespace proxy
+} // namespace sippet
+
+#endif // SIPPET_PROXY_PROXY_H_
@@ -0,0 +1,365 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/proxy/proxy.h"
+
+#include <iterator>
+
+#include "net/base/net_errors.h"
+#include "sippet/base/tags.h"
+#include "sippet/message/message.h"
+#include "sippet/transport/simulated_network.h"
+#include "sippet/transport/virtual_timer_source.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+namespace proxy {
+
+namespace {
+
+const char kClientAddress[] = "10.0.0.1";
+const char kProxyAddress[] = "10.0.0.2";
+const char kServerAddress[] = "10.0.0.3";
+const uint16 kPort = 5060;
+
+const char kInvite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kCancel[] =
+  "CANCEL sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 CANCEL\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+// The ACK of a non-2xx response, part of the INVITE transaction.
+const char kNon2xxAck[] =
+  "ACK sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>;tag=8321234356\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 ACK\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kAck[] =
+  "ACK sip:bob@192.0.2.4 SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bKnashds8\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>;tag=a6c85cf\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 ACK\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+class NullDelegate : public Proxy::Delegate {
+ public:
+  void GetTargets(const scoped_refptr<Request> &request,
+                  std::vector<Proxy::Target> *targets) override {
+  }
+};
+
+class FixedTargetsDelegate : public Proxy::Delegate {
+ public:
+  void AddTarget(const GURL &uri, double q) {
+    targets_.push_back(Proxy::Target(uri, q));
+  }
+
+  void GetTargets(const scoped_refptr<Request> &request,
+                  std::vector<Proxy::Target> *targets) override {
+    *targets = targets_;
+  }
+
+ private:
+  std::vector<Proxy::Target> targets_;
+};
+
+scoped_refptr<Request> Parse(const char *message) {
+  return dyn_cast<Request>(Message::Parse(message));
+}
+
+NetworkSettings CreateSettings(TimerSource *timer_source) {
+  NetworkSettings settings;
+  settings.set_timer_source(timer_source);
+  return settings;
+}
+
+// A user agent attached to the simulated network, recording what it
+// receives. Requests are answered by the test.
+class Peer : public NetworkLayer::Delegate {
+ public:
+  Peer(SimulatedNetwork *network, const char *address,
+       TimerSource *timer_source)
+    : network_layer_(new NetworkLayer(this, CreateSettings(timer_source))),
+      channel_factory_(network, net::HostPortPair(address, kPort),
+                       network_layer_.get()) {
+    network_layer_->RegisterChannelFactory(Protocol::UDP, &channel_factory_);
+  }
+  ~Peer() override {}
+
+  const std::vector<scoped_refptr<Request> > &requests() const {
+    return requests_;
+  }
+  const std::vector<scoped_refptr<Response> > &responses() const {
+    return responses_;
+  }
+
+  int Send(const scoped_refptr<Message> &message) {
+    return network_layer_->Send(message, net::CompletionCallback());
+  }
+
+  void Answer(const scoped_refptr<Request> &request, StatusCode code) {
+    Send(request->CreateResponse(code));
+  }
+
+  // NetworkLayer::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override {}
+  void OnChannelClosed(const EndPoint &destination) override {}
+  void OnIncomingRequest(const scoped_refptr<Request> &request) override {
+    requests_.push_back(request);
+  }
+  void OnIncomingResponse(const scoped_refptr<Response> &response) override {
+    responses_.push_back(response);
+  }
+  void OnTimedOut(const scoped_refptr<Request> &request) override {}
+  void OnTransportError(const scoped_refptr<Request> &request,
+                        int error) override {}
+
+ private:
+  scoped_ptr<NetworkLayer> network_layer_;
+  SimulatedChannelFactory channel_factory_;
+  std::vector<scoped_refptr<Request> > requests_;
+  std::vector<scoped_refptr<Response> > responses_;
+};
+
+// The number of |Via| entries of |message|.
+size_t CountVias(const scoped_refptr<Message> &message) {
+  const Message *source = message.get();
+  size_t count = 0;
+  for (Message::const_iterator i = source->find_first<Via>(),
+       ie = source->end(); i != ie; i = source->find_next<Via>(i)) {
+    const Via *via = dyn_cast<Via>(i);
+    count += std::distance(via->begin(), via->end());
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(ProxyTest, StatelessBranch) {
+  scoped_refptr<Request> invite(Parse(kInvite));
+  scoped_refptr<Request> cancel(Parse(kCancel));
+  scoped_refptr<Request> non_2xx_ack(Parse(kNon2xxAck));
+  scoped_refptr<Request> ack(Parse(kAck));
+
+  std::string invite_branch(
+      Proxy::GetStatelessBranch(invite, Proxy::GetLoopHash(invite)));
+  EXPECT_EQ(0u, invite_branch.find(kMagicCookie));
+
+  // Retransmissions, CANCELs and ACKs of non-2xx responses must take the
+  // same branch.
+  EXPECT_EQ(invite_branch,
+      Proxy::GetStatelessBranch(Parse(kInvite),
+                                Proxy::GetLoopHash(Parse(kInvite))));
+  EXPECT_EQ(invite_branch,
+      Proxy::GetStatelessBranch(cancel, Proxy::GetLoopHash(cancel)));
+  EXPECT_EQ(invite_branch,
+      Proxy::GetStatelessBranch(non_2xx_ack,
+                                Proxy::GetLoopHash(non_2xx_ack)));
+
+  // The ACK of a 2xx is a new transaction.
+  EXPECT_NE(invite_branch,
+      Proxy::GetStatelessBranch(ack, Proxy::GetLoopHash(ack)));
+}
+
+TEST(ProxyTest, LoopDetection) {
+  NullDelegate delegate;
+  net::HostPortPair local_address("192.0.2.1", 5060);
+  Proxy proxy(Proxy::MODE_STATEFUL, local_address, &delegate);
+
+  scoped_refptr<Request> request(Parse(kInvite));
+  std::string loop_hash(Proxy::GetLoopHash(request));
+  EXPECT_FALSE(proxy.DetectLoop(request, loop_hash));
+
+  // The request comes back unchanged: a loop.
+  scoped_ptr<Via> via(new Via);
+  via->push_back(ViaParam(Protocol::UDP, local_address));
+  via->back().set_branch(CreateBranch() + "." + loop_hash);
+  request->push_front(via.Pass());
+  EXPECT_TRUE(proxy.DetectLoop(request, Proxy::GetLoopHash(request)));
+
+  // The request comes back to another target: a spiral.
+  request->set_request_uri(GURL("sip:bob@192.0.2.4"));
+  EXPECT_FALSE(proxy.DetectLoop(request, Proxy::GetLoopHash(request)));
+}
+
+TEST(ProxyTest, ResponseRanking) {
+  EXPECT_LT(Proxy::GetResponseRank(603), Proxy::GetResponseRank(404));
+  EXPECT_LT(Proxy::GetResponseRank(486), Proxy::GetResponseRank(503));
+  EXPECT_EQ(Proxy::GetResponseRank(401), Proxy::GetResponseRank(407));
+}
+
+// A stateful proxy at |kProxyAddress| responsible for its own address,
+// between a client and a server.
+class StatefulProxyTest : public testing::Test {
+ public:
+  StatefulProxyTest()
+    : network_(timer_source_.task_runner(), timer_source_.tick_clock(), 1),
+      client_(&network_, kClientAddress, &timer_source_),
+      server_(&network_, kServerAddress, &timer_source_) {
+  }
+
+  void SetUp() override {
+    net::HostPortPair local_address(kProxyAddress, kPort);
+    proxy_.reset(new Proxy(Proxy::MODE_STATEFUL, local_address, &delegate_));
+    network_layer_.reset(new NetworkLayer(proxy_.get(),
+        CreateSettings(&timer_source_)));
+    channel_factory_.reset(new SimulatedChannelFactory(&network_,
+        local_address, network_layer_.get()));
+    network_layer_->RegisterChannelFactory(Protocol::UDP,
+                                           channel_factory_.get());
+    proxy_->set_network_layer(network_layer_.get());
+    proxy_->set_timer_source(&timer_source_);
+    delegate_.AddTarget(
+        GURL("sip:bob@" + std::string(kServerAddress)), 1.0);
+  }
+
+  // An INVITE from the client to bob at the proxy.
+  scoped_refptr<Request> CreateInvite() {
+    scoped_refptr<Request> request(new Request(Method::INVITE,
+        GURL("sip:bob@" + std::string(kProxyAddress))));
+    scoped_ptr<From> from(new From(GURL("sip:alice@atlanta.com")));
+    from->set_tag("1928301774");
+    request->push_back(from.Pass());
+    request->push_back(scoped_ptr<Header>(
+        new To(GURL("sip:bob@biloxi.com"))));
+    request->push_back(scoped_ptr<Header>(
+        new CallId("a84b4c76e66710@pc33.atlanta.com")));
+    request->push_back(scoped_ptr<Header>(
+        new Cseq(314159, Method::INVITE)));
+    request->push_back(scoped_ptr<Header>(new MaxForwards(70)));
+    return request;
+  }
+
+  // Sends |message| from the client, and delivers what follows.
+  void SendFromClient(const scoped_refptr<Message> &message) {
+    int rv = client_.Send(message);
+    EXPECT_TRUE(net::OK == rv || net::ERR_IO_PENDING == rv);
+    timer_source_.RunUntilIdle();
+  }
+
+  void AnswerFromServer(size_t index, StatusCode code) {
+    server_.Answer(server_.requests()[index], code);
+    timer_source_.RunUntilIdle();
+  }
+
+  VirtualTimerSource timer_source_;
+  SimulatedNetwork network_;
+  Peer client_;
+  Peer server_;
+  FixedTargetsDelegate delegate_;
+  scoped_ptr<Proxy> proxy_;
+  scoped_ptr<NetworkLayer> network_layer_;
+  scoped_ptr<SimulatedChannelFactory> channel_factory_;
+};
+
+TEST_F(StatefulProxyTest, ForwardRequestAndResponses) {
+  SendFromClient(CreateInvite());
+
+  ASSERT_EQ(1u, server_.requests().size());
+  scoped_refptr<Request> invite(server_.requests()[0]);
+  EXPECT_EQ(Method::INVITE, invite->method());
+  EXPECT_EQ(GURL("sip:bob@" + std::string(kServerAddress)),
+            invite->request_uri());
+  EXPECT_EQ(69u, invite->get<MaxForwards>()->value());
+  ASSERT_EQ(2u, CountVias(invite));
+  EXPECT_TRUE(invite->get<Via>()->front().sent_by().Equals(
+      net::HostPortPair(kProxyAddress, kPort)));
+
+  // Responses are relayed without the Via of the proxy.
+  AnswerFromServer(0, SIP_RINGING);
+  ASSERT_FALSE(client_.responses().empty());
+  EXPECT_EQ(SIP_RINGING, client_.responses().back()->response_code());
+  EXPECT_EQ(1u, CountVias(client_.responses().back()));
+
+  AnswerFromServer(0, SIP_OK);
+  EXPECT_EQ(SIP_OK, client_.responses().back()->response_code());
+  EXPECT_EQ(1u, CountVias(client_.responses().back()));
+  EXPECT_TRUE(proxy_->contexts_.empty());
+}
+
+TEST_F(StatefulProxyTest, CancelPendingBranch) {
+  scoped_refptr<Request> invite(CreateInvite());
+  SendFromClient(invite);
+  ASSERT_EQ(1u, server_.requests().size());
+  AnswerFromServer(0, SIP_RINGING);
+
+  scoped_refptr<Request> cancel;
+  ASSERT_EQ(net::OK, invite->CreateCancel(cancel));
+  SendFromClient(cancel);
+
+  // The proxy answers the CANCEL, and cancels the branch in turn.
+  ASSERT_FALSE(client_.responses().empty());
+  EXPECT_EQ(SIP_OK, client_.responses().back()->response_code());
+  EXPECT_EQ(Method::CANCEL,
+            client_.responses().back()->get<Cseq>()->method());
+  ASSERT_EQ(2u, server_.requests().size());
+  EXPECT_EQ(Method::CANCEL, server_.requests()[1]->method());
+
+  AnswerFromServer(1, SIP_OK);
+  AnswerFromServer(0, SIP_REQUEST_TERMINATED);
+  EXPECT_EQ(SIP_REQUEST_TERMINATED,
+            client_.responses().back()->response_code());
+  EXPECT_EQ(Method::INVITE,
+            client_.responses().back()->get<Cseq>()->method());
+  EXPECT_TRUE(proxy_->contexts_.empty());
+}
+
+TEST_F(StatefulProxyTest, TimerC) {
+  SendFromClient(CreateInvite());
+  ASSERT_EQ(1u, server_.requests().size());
+  AnswerFromServer(0, SIP_RINGING);
+
+  // Each provisional response restarts the timer.
+  timer_source_.FastForwardBy(base::TimeDelta::FromSeconds(120));
+  AnswerFromServer(0, SIP_SESSION_PROGRESS);
+  timer_source_.FastForwardBy(base::TimeDelta::FromSeconds(120));
+  EXPECT_EQ(1u, server_.requests().size());
+  EXPECT_EQ(SIP_SESSION_PROGRESS,
+            client_.responses().back()->response_code());
+
+  // Once fired, the branch is cancelled, and the client gets a 408 as no
+  // other branch is pending.
+  timer_source_.FastForwardBy(base::TimeDelta::FromSeconds(61));
+  ASSERT_EQ(2u, server_.requests().size());
+  EXPECT_EQ(Method::CANCEL, server_.requests()[1]->method());
+  EXPECT_EQ(SIP_REQUEST_TIMEOUT, client_.responses().back()->response_code());
+  EXPECT_TRUE(proxy_->contexts_.empty());
+  EXPECT_TRUE(proxy_->branches_.empty());
+
+  // The late 487 isn't relayed.
+  size_t response_count = client_.responses().size();
+  AnswerFromServer(1, SIP_OK);
+  AnswerFromServer(0, SIP_REQUEST_TERMINATED);
+  EXPECT_EQ(response_count, client_.responses().size());
+}
+
+} // namespace proxy
+} // namespace sippet
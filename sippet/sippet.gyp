@@ -3,6 +3,10 @@
 # found in the LICENSE file.
 
 {
+  'variables': {
+    # Trace events of the stack. When disabled, they're compiled out.
+    'sippet_enable_tracing%': 1,
+  },
   'includes': [
     '../build/win_precompile.gypi',
   ],
@@ -14,6 +18,7 @@
         'sippet_version',
         '<(DEPTH)/base/base.gyp:base',
         '<(DEPTH)/net/net.gyp:net',
+        '<(DEPTH)/third_party/boringssl/boringssl.gyp:boringssl',
       ],
       'include_dirs': [
         '<(DEPTH)',
@@ -21,9 +26,14 @@
       ],
       'sources': [
         'base/casting.h',
+        'base/copy_on_write.h',
         'base/format.h',
         'base/ilist.h',
         'base/ilist_node.h',
+        'base/memory_usage.h',
+        'base/memory_usage.cc',
+        'base/metrics.h',
+        'base/metrics.cc',
         'base/raw_ostream.cc',
         'base/raw_ostream.h',
         'base/sequences.h',
@@ -31,6 +41,9 @@
         'base/string_extras.h',
         'base/tags.h',
         'base/tags.cc',
+        'base/timer_wheel.h',
+        'base/timer_wheel.cc',
+        'base/tracing.h',
         'base/type_traits.h',
         'base/user_agent_utils.h',
         'base/user_agent_utils.cc',
@@ -153,6 +166,8 @@
         'message/protocol.cc',
         'message/request.h',
         'message/request.cc',
+        'message/request_template.h',
+        'message/request_template.cc',
         'message/response.h',
         'message/response.cc',
         'message/version.h',
@@ -177,6 +192,12 @@
         'transport/network_layer.cc',
         'transport/network_settings.h',
         'transport/network_settings.cc',
+        'transport/overload_control.h',
+        'transport/overload_control.cc',
+        'transport/rtt_time_delta_factory.h',
+        'transport/rtt_time_delta_factory.cc',
+        'transport/sip_resolver.h',
+        'transport/sip_resolver.cc',
         'transport/branch_factory.h',
         'transport/branch_factory.cc',
         'transport/channel.h',
@@ -193,6 +214,12 @@
         'transport/time_delta_provider.h',
         'transport/time_delta_factory.h',
         'transport/time_delta_factory.cc',
+        'transport/timer_source.h',
+        'transport/timer_source.cc',
+        'transport/message_tracer.h',
+        'transport/message_tracer.cc',
+        'transport/transport_metrics.h',
+        'transport/transport_metrics.cc',
         'transport/ssl_cert_error_handler.h',
         'transport/ssl_cert_error_transaction.h',
         'transport/ssl_cert_error_transaction.cc',
@@ -212,14 +239,20 @@
         'transport/chrome/chrome_datagram_channel.cc',
         'transport/chrome/chrome_channel_factory.h',
         'transport/chrome/chrome_channel_factory.cc',
+        'transport/chrome/chrome_dns_lookup.h',
+        'transport/chrome/chrome_dns_lookup.cc',
         'ua/ua_user_agent.h',
         'ua/ua_user_agent.cc',
         'ua/dialog.h',
         'ua/dialog.cc',
         'ua/dialog_store.h',
         'ua/dialog_store.cc',
+        'ua/ua_metrics.h',
+        'ua/ua_metrics.cc',
         'ua/dialog_controller.h',
         'ua/dialog_controller.cc',
+        'ua/interned_url.h',
+        'ua/interned_url.cc',
         'ua/auth.h',
         'ua/auth.cc',
         'ua/auth_cache.h',
@@ -228,13 +261,25 @@
         'ua/auth_handler.cc',
         'ua/auth_handler_digest.h',
         'ua/auth_handler_digest.cc',
+        'ua/digest_hash.h',
+        'ua/digest_hash.cc',
+        'ua/digest_authenticator.h',
+        'ua/digest_authenticator.cc',
         'ua/auth_handler_factory.h',
         'ua/auth_handler_factory.cc',
         'ua/auth_controller.h',
         'ua/auth_controller.cc',
         'ua/auth_transaction.h',
         'ua/auth_transaction.cc',
+        'ua/location_service.h',
+        'ua/location_service.cc',
         'ua/password_handler.h',
+        'ua/registration_manager.h',
+        'ua/registration_manager.cc',
+        'ua/registrar.h',
+        'ua/registrar.cc',
+        'proxy/proxy.h',
+        'proxy/proxy.cc',
       ],
       'conditions': [
         ['OS == "ios"', {
@@ -247,6 +292,16 @@
             'base/user_agent_utils_ios.mm',
           ],
         }],
+        ['sippet_enable_tracing == 1', {
+          'defines': [
+            'SIPPET_ENABLE_TRACING',
+          ],
+          'direct_dependent_settings': {
+            'defines': [
+              'SIPPET_ENABLE_TRACING',
+            ],
+          },
+        }],
       ],
     },  # target sippet
     {
@@ -72,5 +72,20 @@
         'examples/call/call_main.cc',
       ],
     },  # target sippet_examples_call
+    {
+      'target_name': 'sippet_examples_loadgen',
+      'product_name': 'sippet_loadgen',
+      'type': 'executable',
+      'dependencies': [
+        'sippet_examples_program_main',
+      ],
+      'sources': [
+        'examples/loadgen/latency_histogram.h',
+        'examples/loadgen/latency_histogram.cc',
+        'examples/loadgen/load_generator.h',
+        'examples/loadgen/load_generator.cc',
+        'examples/loadgen/loadgen_main.cc',
+      ],
+    },  # target sippet_examples_loadgen
   ],
 }
@@ -28,22 +28,73 @@
       ],
       'sources': [
         '../net/test/run_all_unittests.cc',
+        'base/memory_usage_unittest.cc',
+        'base/metrics_unittest.cc',
+        'base/timer_wheel_unittest.cc',
         'message/message_unittest.cc',
         'message/headers_unittest.cc',
         'message/parser_unittest.cc',
+        'message/request_template_unittest.cc',
+        'proxy/proxy_unittest.cc',
         'uri/uri_unittest.cc',
         'transport/end_point_unittest.cc',
+        'transport/message_tracer_unittest.cc',
         'transport/network_layer_unittest.cc',
+        'transport/overload_control_unittest.cc',
+        'transport/rtt_time_delta_factory_unittest.cc',
+        'transport/simulated_network_unittest.cc',
+        'transport/sip_resolver_unittest.cc',
         'transport/chrome/chrome_datagram_writer_unittest.cc',
         'transport/chrome/chrome_stream_writer_unittest.cc',
+        'test/replay/capture_reader_unittest.cc',
+        'ua/auth_cache_unittest.cc',
         'ua/auth_controller_unittest.cc',
         'ua/auth_handler_digest_unittest.cc',
+        'ua/dialog_store_unittest.cc',
+        'ua/digest_hash_unittest.cc',
+        'ua/digest_authenticator_unittest.cc',
+        'ua/interned_url_unittest.cc',
+        'ua/location_service_unittest.cc',
+        'ua/registrar_unittest.cc',
+        'ua/registration_manager_unittest.cc',
+        'ua/ua_user_agent_unittest.cc',
       ],
     },  # target sippet_unittest
+    {
+      'target_name': 'sippet_perftests',
+      'type': 'executable',
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:test_support_perf',
+        'sippet_test_support',
+        'sippet.gyp:sippet',
+      ],
+      'sources': [
+        'message/message_perftest.cc',
+        'test/allocation_counter.h',
+        'test/allocation_counter.cc',
+        'test/microbenchmark.h',
+        'test/microbenchmark.cc',
+        'transport/network_layer_perftest.cc',
+        'ua/auth_handler_digest_perftest.cc',
+        'ua/dialog_perftest.cc',
+        'ua/location_service_perftest.cc',
+        'uri/uri_perftest.cc',
+      ],
+      'conditions': [
+        # Allocations are counted by replacing operator new, which the
+        # allocator shims already do otherwise.
+        ['use_allocator=="none"', {
+          'defines': [
+            'SIPPET_COUNT_ALLOCATIONS',
+          ],
+        }],
+      ],
+    },  # target sippet_perftests
     {
       'target_name': 'sippet_test_support',
       'type': 'static_library',
       'dependencies': [
+        '<(DEPTH)/base/base.gyp:test_support_base',
         '<(DEPTH)/testing/gtest.gyp:gtest',
         '<(DEPTH)/testing/gmock.gyp:gmock',
         '<(DEPTH)/net/net.gyp:net',
@@ -59,8 +110,16 @@
         '<(DEPTH)/testing/gmock.gyp:gmock',
       ],
       'sources': [
+        'test/replay/capture_reader.h',
+        'test/replay/capture_reader.cc',
         'transport/chrome/transport_test_util.h',
         'transport/chrome/transport_test_util.cc',
+        'transport/dns_lookup_mock.h',
+        'transport/dns_lookup_mock.cc',
+        'transport/simulated_network.h',
+        'transport/simulated_network.cc',
+        'transport/virtual_timer_source.h',
+        'transport/virtual_timer_source.cc',
         'ua/auth_handler_mock.h',
         'ua/auth_handler_mock.cc',
       ],
@@ -114,5 +173,32 @@
         'test/standalone_test_server/main.cc',
       ],
     },  # target sippet_standalone_test_server_main
+    {
+      'target_name': 'sippet_loopback_perftests',
+      'type': 'executable',
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:test_support_perf',
+        '<(DEPTH)/testing/gtest.gyp:gtest',
+        'sippet.gyp:sippet',
+        'sippet_examples.gyp:sippet_examples_common',
+        'sippet_standalone_test_server',
+      ],
+      'sources': [
+        'test/standalone_test_server/loopback_perftest.cc',
+      ],
+    },  # target sippet_loopback_perftests
+    {
+      'target_name': 'sippet_replay',
+      'type': 'executable',
+      'dependencies': [
+        'sippet.gyp:sippet',
+        'sippet_test_support',
+      ],
+      'sources': [
+        'test/replay/capture_replayer.h',
+        'test/replay/capture_replayer.cc',
+        'test/replay/replay_main.cc',
+      ],
+    },  # target sippet_replay
   ],
 }
@@ -0,0 +1,85 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/test/allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+#include "base/atomicops.h"
+#include "base/process/memory.h"
+
+#if defined(SIPPET_COUNT_ALLOCATIONS)
+
+namespace {
+
+base::subtle::AtomicWord g_allocation_count = 0;
+
+void* CountedAlloc(size_t size) {
+  base::subtle::NoBarrier_AtomicIncrement(&g_allocation_count, 1);
+  return malloc(size ? size : 1);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  void* ptr = CountedAlloc(size);
+  if (!ptr)
+    base::TerminateBecauseOutOfMemory(size);
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  void* ptr = CountedAlloc(size);
+  if (!ptr)
+    base::TerminateBecauseOutOfMemory(size);
+  return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+  return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw() {
+  return CountedAlloc(size);
+}
+
+void operator delete(void* ptr) throw() {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) throw() {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) throw() {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) throw() {
+  free(ptr);
+}
+
+#endif  // defined(SIPPET_COUNT_ALLOCATIONS)
+
+namespace sippet {
+
+bool CanCountAllocations() {
+#if defined(SIPPET_COUNT_ALLOCATIONS)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int64 GetAllocationCount() {
+#if defined(SIPPET_COUNT_ALLOCATIONS)
+  return base::subtle::NoBarrier_Load(&g_allocation_count);
+#else
+  return 0;
+#endif
+}
+
+} // End of sippet namespace
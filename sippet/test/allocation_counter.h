@@ -0,0 +1,23 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TEST_ALLOCATION_COUNTER_H_
+#define SIPPET_TEST_ALLOCATION_COUNTER_H_
+
+#include "base/basictypes.h"
+
+namespace sippet {
+
+// Heap allocations are counted by replacing the global operator new, which
+// is only possible when the executable is built without an allocator of
+// its own (use_allocator=none).
+bool CanCountAllocations();
+
+// Returns the number of calls to operator new since the process started,
+// or zero if allocations are not counted.
+int64 GetAllocationCount();
+
+} // End of sippet namespace
+
+#endif // SIPPET_TEST_ALLOCATION_COUNTER_H_
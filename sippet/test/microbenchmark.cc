@@ -0,0 +1,111 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/test/microbenchmark.h"
+
+#include <algorithm>
+
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/values.h"
+#include "sippet/test/allocation_counter.h"
+#include "testing/perf/perf_test.h"
+
+namespace sippet {
+
+namespace {
+
+const char kPerfJsonSwitch[] = "perf-json";
+
+const int64 kDefaultMinTimeMilliseconds = 500;
+const int64 kWarmUpIterations = 100;
+const int64 kMaxBatchSize = 1 << 20;
+
+}  // namespace
+
+Microbenchmark::Microbenchmark(const std::string &benchmark,
+                               const std::string &test_case)
+  : benchmark_(benchmark),
+    test_case_(test_case),
+    min_time_(base::TimeDelta::FromMilliseconds(kDefaultMinTimeMilliseconds)),
+    iterations_(0),
+    allocations_(0) {
+}
+
+Microbenchmark::~Microbenchmark() {
+}
+
+void Microbenchmark::Run(const base::Closure &operation) {
+  for (int64 i = 0; i < kWarmUpIterations; ++i)
+    operation.Run();
+
+  elapsed_ = base::TimeDelta();
+  iterations_ = 0;
+  allocations_ = 0;
+  // Batches grow so that reading the clock doesn't weigh on fast
+  // operations, while slow ones don't run for much longer than needed.
+  for (int64 batch_size = 1; elapsed_ < min_time_;
+       batch_size = std::min(batch_size * 2, kMaxBatchSize)) {
+    int64 allocations_before = GetAllocationCount();
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int64 i = 0; i < batch_size; ++i)
+      operation.Run();
+    elapsed_ += base::TimeTicks::Now() - start;
+    allocations_ += GetAllocationCount() - allocations_before;
+    iterations_ += batch_size;
+  }
+
+  Report();
+}
+
+double Microbenchmark::ns_per_op() const {
+  DCHECK_LT(0, iterations_);
+  return elapsed_.InMicrosecondsF() * 1000 / iterations_;
+}
+
+double Microbenchmark::allocs_per_op() const {
+  DCHECK_LT(0, iterations_);
+  if (!CanCountAllocations())
+    return -1;
+  return static_cast<double>(allocations_) / iterations_;
+}
+
+void Microbenchmark::Report() const {
+  perf_test::PrintResult(benchmark_, "", test_case_ + "_time",
+      ns_per_op(), "ns/op", true);
+  if (CanCountAllocations()) {
+    perf_test::PrintResult(benchmark_, "", test_case_ + "_allocs",
+        allocs_per_op(), "allocs/op", true);
+  }
+
+  base::CommandLine *command_line = base::CommandLine::ForCurrentProcess();
+  if (command_line->HasSwitch(kPerfJsonSwitch))
+    AppendJson(command_line->GetSwitchValueASCII(kPerfJsonSwitch));
+}
+
+void Microbenchmark::AppendJson(const std::string &path) const {
+  base::DictionaryValue result;
+  result.SetString("benchmark", benchmark_);
+  result.SetString("case", test_case_);
+  // |base::Value| has no 64-bit integers.
+  result.SetDouble("iterations", static_cast<double>(iterations_));
+  result.SetDouble("ns_per_op", ns_per_op());
+  if (CanCountAllocations())
+    result.SetDouble("allocs_per_op", allocs_per_op());
+
+  std::string json;
+  base::JSONWriter::Write(result, &json);
+  json += "\n";
+
+  base::FilePath file_path = base::FilePath::FromUTF8Unsafe(path);
+  bool written = base::PathExists(file_path)
+      ? base::AppendToFile(file_path, json.data(), json.size())
+      : base::WriteFile(file_path, json.data(), json.size()) >= 0;
+  LOG_IF(ERROR, !written) << "Couldn't write results to " << path;
+}
+
+} // End of sippet namespace
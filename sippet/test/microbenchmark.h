@@ -0,0 +1,63 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TEST_MICROBENCHMARK_H_
+#define SIPPET_TEST_MICROBENCHMARK_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/time/time.h"
+
+namespace sippet {
+
+// Runs an operation repeatedly, until it has been measured for a minimum
+// time, and reports the average time and heap allocations per operation.
+//
+// Results are printed with |perf_test::PrintResult|. When the perf tests
+// are run with --perf-json=<path>, they are also appended to that file,
+// one JSON object per line:
+//
+//   {"benchmark":"message_parse","case":"invite","iterations":524287.0,
+//    "ns_per_op":2514.3,"allocs_per_op":38.0}
+//
+// "allocs_per_op" is left out when allocations can't be counted (see
+// |CanCountAllocations|). The cost of running the |base::Closure| itself,
+// a few nanoseconds, is included in the time.
+class Microbenchmark {
+ public:
+  Microbenchmark(const std::string &benchmark, const std::string &test_case);
+  ~Microbenchmark();
+
+  // Defaults to 500 milliseconds.
+  void set_min_time(base::TimeDelta min_time) {
+    min_time_ = min_time;
+  }
+
+  // Warms up and measures |operation|, then reports the results.
+  void Run(const base::Closure &operation);
+
+  int64 iterations() const { return iterations_; }
+  double ns_per_op() const;
+  // Negative if allocations are not counted.
+  double allocs_per_op() const;
+
+ private:
+  void Report() const;
+  void AppendJson(const std::string &path) const;
+
+  std::string benchmark_;
+  std::string test_case_;
+  base::TimeDelta min_time_;
+  base::TimeDelta elapsed_;
+  int64 iterations_;
+  int64 allocations_;
+
+  DISALLOW_COPY_AND_ASSIGN(Microbenchmark);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TEST_MICROBENCHMARK_H_
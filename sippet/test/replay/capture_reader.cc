@@ -0,0 +1,644 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/test/replay/capture_reader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
+#include "base/sys_byteorder.h"
+
+namespace sippet {
+
+namespace {
+
+const uint32 kPcapMagic = 0xa1b2c3d4;
+const uint32 kPcapNanosecondMagic = 0xa1b23c4d;
+const char kHepMagic[] = "HEP3";
+
+// Link types, as registered at tcpdump.org.
+const uint32 kLinkTypeNull = 0;
+const uint32 kLinkTypeEthernet = 1;
+const uint32 kLinkTypeRawOpenBSD = 12;
+const uint32 kLinkTypeRaw = 101;
+const uint32 kLinkTypeLinuxSll = 113;
+const uint32 kLinkTypeIPv4 = 228;
+const uint32 kLinkTypeIPv6 = 229;
+
+const uint16 kEtherTypeIPv4 = 0x0800;
+const uint16 kEtherTypeIPv6 = 0x86dd;
+const uint16 kEtherTypeVlan = 0x8100;
+const uint16 kEtherTypeQinQ = 0x88a8;
+
+const uint8 kIPProtocolHopByHop = 0;
+const uint8 kIPProtocolTcp = 6;
+const uint8 kIPProtocolUdp = 17;
+const uint8 kIPProtocolRouting = 43;
+const uint8 kIPProtocolDestinationOptions = 60;
+
+const uint8 kTcpFin = 0x01;
+const uint8 kTcpSyn = 0x02;
+const uint8 kTcpRst = 0x04;
+
+// HEP chunk types of the generic vendor.
+const uint16 kHepIPProtocol = 2;
+const uint16 kHepIPv4Source = 3;
+const uint16 kHepIPv4Destination = 4;
+const uint16 kHepIPv6Source = 5;
+const uint16 kHepIPv6Destination = 6;
+const uint16 kHepSourcePort = 7;
+const uint16 kHepDestinationPort = 8;
+const uint16 kHepSeconds = 9;
+const uint16 kHepMicroseconds = 10;
+const uint16 kHepProtocolType = 11;
+const uint16 kHepPayload = 15;
+const uint8 kHepProtocolSip = 1;
+
+// Larger records are taken as a sign of a corrupt capture.
+const uint32 kMaxRecordSize = 256 * 1024;
+// Bytes held ahead of a gap in a TCP stream before the gap is skipped.
+const size_t kMaxOutOfOrderSize = 256 * 1024;
+// The same maximum the stream channels have.
+const size_t kMaxMessageSize = 64 * 1024;
+const size_t kReadBufferSize = 64 * 1024;
+
+uint16 ReadUint16(const char *data) {
+  uint16 value;
+  memcpy(&value, data, sizeof(value));
+  return base::NetToHost16(value);
+}
+
+uint32 ReadUint32(const char *data) {
+  uint32 value;
+  memcpy(&value, data, sizeof(value));
+  return base::NetToHost32(value);
+}
+
+// pcap headers are written in the byte order of the capturing machine.
+uint32 ReadPcapUint32(const char *data, bool swapped) {
+  uint32 value;
+  memcpy(&value, data, sizeof(value));
+  return swapped ? base::ByteSwap(value) : value;
+}
+
+net::IPAddressNumber ReadAddress(const char *data, size_t size) {
+  const uint8 *bytes = reinterpret_cast<const uint8*>(data);
+  return net::IPAddressNumber(bytes, bytes + size);
+}
+
+// Tells whether |line| is the start line of a request or a response.
+bool IsStartLine(const base::StringPiece &line) {
+  return line.starts_with("SIP/2.0 ") || line.ends_with(" SIP/2.0");
+}
+
+// Gets the Content-Length of a header section, or zero if missing, as
+// stream transports require it.
+size_t GetContentLength(const base::StringPiece &headers) {
+  size_t begin = 0;
+  while (begin < headers.size()) {
+    size_t end = headers.find("\r\n", begin);
+    if (base::StringPiece::npos == end)
+      end = headers.size();
+    base::StringPiece line(headers.substr(begin, end - begin));
+    begin = end + 2;
+    size_t colon = line.find(':');
+    if (base::StringPiece::npos == colon)
+      continue;
+    std::string name;
+    base::TrimWhitespaceASCII(line.substr(0, colon).as_string(),
+                              base::TRIM_ALL, &name);
+    if (!base::EqualsCaseInsensitiveASCII(name, "content-length")
+        && !base::EqualsCaseInsensitiveASCII(name, "l"))
+      continue;
+    std::string value;
+    base::TrimWhitespaceASCII(line.substr(colon + 1).as_string(),
+                              base::TRIM_ALL, &value);
+    size_t content_length;
+    if (base::StringToSizeT(value, &content_length))
+      return content_length;
+    return 0;
+  }
+  return 0;
+}
+
+}  // namespace
+
+CapturedMessage::CapturedMessage() {
+}
+
+CapturedMessage::~CapturedMessage() {
+}
+
+CaptureReader::TcpStream::TcpStream()
+  : next_sequence(0),
+    out_of_order_size(0) {
+}
+
+CaptureReader::TcpStream::~TcpStream() {
+}
+
+CaptureReader::CaptureReader()
+  : read_position_(0),
+    read_end_(0),
+    format_(FORMAT_UNKNOWN),
+    swapped_(false),
+    nanoseconds_(false),
+    link_type_(0),
+    first_time_(0),
+    has_first_time_(false),
+    packets_read_(0),
+    packets_skipped_(0),
+    stream_bytes_dropped_(0) {
+}
+
+CaptureReader::~CaptureReader() {
+}
+
+bool CaptureReader::Open(const base::FilePath &path) {
+  DCHECK(!file_.IsValid());
+  file_.Initialize(path, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Couldn't open " << path.AsUTF8Unsafe();
+    return false;
+  }
+  read_buffer_.resize(kReadBufferSize);
+
+  std::string magic;
+  if (!ReadBytes(4, &magic))
+    return false;
+  if (0 == magic.compare(kHepMagic)) {
+    // The magic is part of the first packet.
+    if (0 != file_.Seek(base::File::FROM_BEGIN, 0))
+      return false;
+    read_position_ = read_end_ = 0;
+    format_ = FORMAT_HEP;
+    return true;
+  }
+
+  uint32 value = ReadPcapUint32(magic.data(), false);
+  if (kPcapMagic != value && kPcapNanosecondMagic != value) {
+    value = base::ByteSwap(value);
+    swapped_ = true;
+  }
+  if (kPcapMagic != value && kPcapNanosecondMagic != value) {
+    LOG(ERROR) << "Unrecognized capture format";
+    return false;
+  }
+  nanoseconds_ = kPcapNanosecondMagic == value;
+  format_ = FORMAT_PCAP;
+  return ReadPcapHeader();
+}
+
+bool CaptureReader::ReadNext(CapturedMessage *message) {
+  DCHECK_NE(FORMAT_UNKNOWN, format_);
+  while (messages_.empty()) {
+    bool more = FORMAT_PCAP == format_ ? ReadPcapRecord() : ReadHepPacket();
+    if (!more) {
+      while (!tcp_streams_.empty())
+        DropStream(tcp_streams_.begin());
+      return false;
+    }
+  }
+  CapturedMessage &front = messages_.front();
+  message->timestamp = front.timestamp;
+  message->protocol = front.protocol;
+  message->source = front.source;
+  message->destination = front.destination;
+  message->data.swap(front.data);
+  messages_.pop_front();
+  return true;
+}
+
+bool CaptureReader::ReadBytes(size_t size, std::string *data) {
+  data->clear();
+  while (data->size() < size) {
+    if (read_position_ == read_end_) {
+      int result = file_.ReadAtCurrentPos(&read_buffer_[0],
+          static_cast<int>(read_buffer_.size()));
+      if (result <= 0) {
+        if (!data->empty())
+          LOG(WARNING) << "The capture is truncated";
+        return false;
+      }
+      read_position_ = 0;
+      read_end_ = static_cast<size_t>(result);
+    }
+    size_t count = std::min(size - data->size(), read_end_ - read_position_);
+    data->append(&read_buffer_[read_position_], count);
+    read_position_ += count;
+  }
+  return true;
+}
+
+bool CaptureReader::ReadPcapHeader() {
+  // The rest of the global header: version, time zone, accuracy, snapshot
+  // length and link type.
+  std::string header;
+  if (!ReadBytes(20, &header))
+    return false;
+  link_type_ = ReadPcapUint32(header.data() + 16, swapped_);
+  switch (link_type_) {
+    case kLinkTypeNull:
+    case kLinkTypeEthernet:
+    case kLinkTypeRawOpenBSD:
+    case kLinkTypeRaw:
+    case kLinkTypeLinuxSll:
+    case kLinkTypeIPv4:
+    case kLinkTypeIPv6:
+      return true;
+  }
+  LOG(ERROR) << "Unsupported pcap link type " << link_type_;
+  return false;
+}
+
+bool CaptureReader::ReadPcapRecord() {
+  std::string header;
+  if (!ReadBytes(16, &header))
+    return false;
+  int64 seconds = ReadPcapUint32(header.data(), swapped_);
+  int64 fraction = ReadPcapUint32(header.data() + 4, swapped_);
+  uint32 captured_size = ReadPcapUint32(header.data() + 8, swapped_);
+  if (captured_size > kMaxRecordSize) {
+    LOG(ERROR) << "Corrupt pcap record of " << captured_size << " bytes";
+    return false;
+  }
+  std::string packet;
+  if (!ReadBytes(captured_size, &packet))
+    return false;
+
+  ++packets_read_;
+  int64 time = seconds * base::Time::kMicrosecondsPerSecond
+      + (nanoseconds_ ? fraction / 1000 : fraction);
+  if (!has_first_time_) {
+    first_time_ = time;
+    has_first_time_ = true;
+  }
+  if (!HandleLinkLayer(time, packet))
+    ++packets_skipped_;
+  return true;
+}
+
+bool CaptureReader::ReadHepPacket() {
+  std::string header;
+  if (!ReadBytes(6, &header))
+    return false;
+  size_t size = ReadUint16(header.data() + 4);
+  if (0 != header.compare(0, 4, kHepMagic) || size < header.size()) {
+    LOG(ERROR) << "Corrupt HEP packet";
+    return false;
+  }
+  std::string packet;
+  if (!ReadBytes(size - header.size(), &packet))
+    return false;
+
+  ++packets_read_;
+  if (!HandleHepPacket(packet))
+    ++packets_skipped_;
+  return true;
+}
+
+bool CaptureReader::HandleHepPacket(const std::string &packet) {
+  uint8 ip_protocol = kIPProtocolUdp;
+  uint8 protocol_type = kHepProtocolSip;
+  net::IPAddressNumber source_address;
+  net::IPAddressNumber destination_address;
+  uint16 source_port = 0;
+  uint16 destination_port = 0;
+  int64 seconds = 0;
+  int64 microseconds = 0;
+  std::string payload;
+
+  // Chunks are made of a vendor, a type and a length that includes them.
+  size_t position = 0;
+  while (position + 6 <= packet.size()) {
+    const char *chunk = packet.data() + position;
+    uint16 vendor = ReadUint16(chunk);
+    uint16 type = ReadUint16(chunk + 2);
+    size_t size = ReadUint16(chunk + 4);
+    if (size < 6 || position + size > packet.size())
+      return false;
+    position += size;
+    const char *value = chunk + 6;
+    size -= 6;
+    if (0 != vendor)
+      continue;
+    switch (type) {
+      case kHepIPProtocol:
+        if (1 == size)
+          ip_protocol = static_cast<uint8>(value[0]);
+        break;
+      case kHepIPv4Source:
+      case kHepIPv6Source:
+        source_address = ReadAddress(value, size);
+        break;
+      case kHepIPv4Destination:
+      case kHepIPv6Destination:
+        destination_address = ReadAddress(value, size);
+        break;
+      case kHepSourcePort:
+        if (2 == size)
+          source_port = ReadUint16(value);
+        break;
+      case kHepDestinationPort:
+        if (2 == size)
+          destination_port = ReadUint16(value);
+        break;
+      case kHepSeconds:
+        if (4 == size)
+          seconds = ReadUint32(value);
+        break;
+      case kHepMicroseconds:
+        if (4 == size)
+          microseconds = ReadUint32(value);
+        break;
+      case kHepProtocolType:
+        if (1 == size)
+          protocol_type = static_cast<uint8>(value[0]);
+        break;
+      case kHepPayload:
+        payload.assign(value, size);
+        break;
+    }
+  }
+
+  if (kHepProtocolSip != protocol_type || payload.empty()
+      || (4 != source_address.size() && 16 != source_address.size())
+      || source_address.size() != destination_address.size())
+    return false;
+  int64 time = seconds * base::Time::kMicrosecondsPerSecond + microseconds;
+  if (!has_first_time_) {
+    first_time_ = time;
+    has_first_time_ = true;
+  }
+  // Captured messages are whole, whatever the transport.
+  FlowKey flow(net::IPEndPoint(source_address, source_port),
+               net::IPEndPoint(destination_address, destination_port));
+  AddMessage(time, kIPProtocolTcp == ip_protocol ? Protocol::TCP
+                                                 : Protocol::UDP,
+             flow, payload);
+  return true;
+}
+
+bool CaptureReader::HandleLinkLayer(int64 time, const std::string &packet) {
+  const char *data = packet.data();
+  size_t size = packet.size();
+  switch (link_type_) {
+    case kLinkTypeNull:
+      // The address family, which the IP version tells as well.
+      if (size < 4)
+        return false;
+      data += 4;
+      size -= 4;
+      break;
+    case kLinkTypeEthernet: {
+      if (size < 14)
+        return false;
+      uint16 ether_type = ReadUint16(data + 12);
+      data += 14;
+      size -= 14;
+      while ((kEtherTypeVlan == ether_type || kEtherTypeQinQ == ether_type)
+             && size >= 4) {
+        ether_type = ReadUint16(data + 2);
+        data += 4;
+        size -= 4;
+      }
+      if (kEtherTypeIPv4 != ether_type && kEtherTypeIPv6 != ether_type)
+        return false;
+      break;
+    }
+    case kLinkTypeLinuxSll: {
+      if (size < 16)
+        return false;
+      uint16 ether_type = ReadUint16(data + 14);
+      if (kEtherTypeIPv4 != ether_type && kEtherTypeIPv6 != ether_type)
+        return false;
+      data += 16;
+      size -= 16;
+      break;
+    }
+  }
+  return HandleIPPacket(time, data, size);
+}
+
+bool CaptureReader::HandleIPPacket(int64 time, const char *data,
+                                   size_t size) {
+  if (size < 1)
+    return false;
+  uint8 protocol;
+  net::IPAddressNumber source_address;
+  net::IPAddressNumber destination_address;
+  const char *payload;
+  size_t payload_size;
+  uint8 version = static_cast<uint8>(data[0]) >> 4;
+  if (4 == version) {
+    if (size < 20)
+      return false;
+    size_t header_size = (data[0] & 0x0f) * 4;
+    size_t total_size = ReadUint16(data + 2);
+    // Truncated by the snapshot length, or corrupt.
+    if (header_size < 20 || total_size < header_size || total_size > size)
+      return false;
+    // More fragments, or a fragment offset.
+    if (ReadUint16(data + 6) & 0x3fff)
+      return false;
+    protocol = static_cast<uint8>(data[9]);
+    source_address = ReadAddress(data + 12, 4);
+    destination_address = ReadAddress(data + 16, 4);
+    payload = data + header_size;
+    payload_size = total_size - header_size;
+  } else if (6 == version) {
+    if (size < 40)
+      return false;
+    size_t total_size = 40 + ReadUint16(data + 4);
+    if (total_size > size)
+      return false;
+    protocol = static_cast<uint8>(data[6]);
+    source_address = ReadAddress(data + 8, 16);
+    destination_address = ReadAddress(data + 24, 16);
+    payload = data + 40;
+    payload_size = total_size - 40;
+    // Fragment headers aren't skipped, as fragments are.
+    while (kIPProtocolHopByHop == protocol
+           || kIPProtocolRouting == protocol
+           || kIPProtocolDestinationOptions == protocol) {
+      if (payload_size < 8)
+        return false;
+      size_t extension_size = (static_cast<uint8>(payload[1]) + 1) * 8;
+      if (extension_size > payload_size)
+        return false;
+      protocol = static_cast<uint8>(payload[0]);
+      payload += extension_size;
+      payload_size -= extension_size;
+    }
+  } else {
+    return false;
+  }
+
+  if (kIPProtocolUdp == protocol) {
+    if (payload_size < 8)
+      return false;
+    FlowKey flow(net::IPEndPoint(source_address, ReadUint16(payload)),
+                 net::IPEndPoint(destination_address,
+                                 ReadUint16(payload + 2)));
+    base::StringPiece datagram(payload + 8, payload_size - 8);
+    // Keep-alives are made of blank lines.
+    if (base::StringPiece::npos == datagram.find_first_not_of("\r\n"))
+      return true;
+    // Other protocols, such as RTP, are often captured along.
+    if (!IsStartLine(datagram.substr(0, datagram.find("\r\n"))))
+      return false;
+    AddMessage(time, Protocol::UDP, flow, datagram.as_string());
+    return true;
+  }
+  if (kIPProtocolTcp == protocol) {
+    if (payload_size < 20)
+      return false;
+    size_t header_size = (static_cast<uint8>(payload[12]) >> 4) * 4;
+    if (header_size < 20 || header_size > payload_size)
+      return false;
+    FlowKey flow(net::IPEndPoint(source_address, ReadUint16(payload)),
+                 net::IPEndPoint(destination_address,
+                                 ReadUint16(payload + 2)));
+    HandleTcpSegment(time, flow, ReadUint32(payload + 4),
+                     static_cast<uint8>(payload[13]), payload + header_size,
+                     payload_size - header_size);
+    return true;
+  }
+  return false;
+}
+
+void CaptureReader::HandleTcpSegment(int64 time, const FlowKey &flow,
+                                     uint32 sequence, uint8 flags,
+                                     const char *data, size_t size) {
+  TcpStreamsMap::iterator it = tcp_streams_.find(flow);
+  if (flags & kTcpRst) {
+    if (tcp_streams_.end() != it)
+      DropStream(it);
+    return;
+  }
+  if (flags & kTcpSyn) {
+    if (tcp_streams_.end() != it)
+      DropStream(it);
+    it = tcp_streams_.insert(std::make_pair(flow, TcpStream())).first;
+    // The SYN takes a sequence number of its own.
+    ++sequence;
+    it->second.next_sequence = sequence;
+  } else if (tcp_streams_.end() == it) {
+    // The connection was opened before the capture started.
+    it = tcp_streams_.insert(std::make_pair(flow, TcpStream())).first;
+    it->second.next_sequence = sequence;
+  }
+
+  TcpStream *stream = &it->second;
+  if (size > 0) {
+    int32 offset = static_cast<int32>(sequence - stream->next_sequence);
+    if (offset > 0) {
+      std::string &segment = stream->out_of_order[sequence];
+      if (segment.size() < size) {
+        stream->out_of_order_size += size - segment.size();
+        segment.assign(data, size);
+      }
+    } else if (static_cast<size_t>(-offset) < size) {
+      // Retransmitted bytes are left out.
+      stream->buffer.append(data - offset, size + offset);
+      stream->next_sequence += static_cast<uint32>(size + offset);
+    }
+
+    // Segments that were ahead may have become contiguous.
+    while (!stream->out_of_order.empty()) {
+      std::map<uint32, std::string>::iterator next =
+          stream->out_of_order.begin();
+      int32 next_offset =
+          static_cast<int32>(next->first - stream->next_sequence);
+      if (next_offset > 0) {
+        if (stream->out_of_order_size <= kMaxOutOfOrderSize)
+          break;
+        // The missing bytes weren't captured, and the message they were
+        // part of is lost.
+        stream_bytes_dropped_ += stream->buffer.size();
+        stream->buffer.clear();
+        stream->next_sequence = next->first;
+        next_offset = 0;
+      }
+      const std::string &segment = next->second;
+      if (static_cast<size_t>(-next_offset) < segment.size()) {
+        stream->buffer.append(segment, static_cast<size_t>(-next_offset),
+                              std::string::npos);
+        stream->next_sequence +=
+            static_cast<uint32>(segment.size() + next_offset);
+      }
+      stream->out_of_order_size -= segment.size();
+      stream->out_of_order.erase(next);
+    }
+    FrameMessages(time, flow, stream);
+  }
+  if (flags & kTcpFin)
+    DropStream(it);
+}
+
+void CaptureReader::FrameMessages(int64 time, const FlowKey &flow,
+                                  TcpStream *stream) {
+  std::string &buffer = stream->buffer;
+  size_t start = 0;
+  for (;;) {
+    // Blank lines are keep-alives.
+    start = buffer.find_first_not_of("\r\n", start);
+    if (std::string::npos == start) {
+      start = buffer.size();
+      break;
+    }
+    size_t line_end = buffer.find("\r\n", start);
+    if (std::string::npos == line_end)
+      break;
+    if (!IsStartLine(base::StringPiece(buffer.data() + start,
+                                       line_end - start))) {
+      // Past a capture gap, the stream is resynchronized at the next start
+      // line.
+      stream_bytes_dropped_ += line_end + 2 - start;
+      start = line_end + 2;
+      continue;
+    }
+    size_t headers_end = buffer.find("\r\n\r\n", line_end);
+    if (std::string::npos == headers_end)
+      break;
+    headers_end += 4;
+    size_t content_length = GetContentLength(
+        base::StringPiece(buffer.data() + line_end,
+                          headers_end - line_end));
+    if (buffer.size() - headers_end < content_length)
+      break;
+    size_t end = headers_end + content_length;
+    AddMessage(time, Protocol::TCP, flow, buffer.substr(start, end - start));
+    start = end;
+  }
+  buffer.erase(0, start);
+  if (buffer.size() > kMaxMessageSize) {
+    stream_bytes_dropped_ += buffer.size();
+    buffer.clear();
+  }
+}
+
+void CaptureReader::DropStream(TcpStreamsMap::iterator it) {
+  stream_bytes_dropped_ += it->second.buffer.size()
+      + it->second.out_of_order_size;
+  tcp_streams_.erase(it);
+}
+
+void CaptureReader::AddMessage(int64 time, const Protocol &protocol,
+                               const FlowKey &flow, const std::string &data) {
+  messages_.push_back(CapturedMessage());
+  CapturedMessage &message = messages_.back();
+  message.timestamp = base::TimeDelta::FromMicroseconds(time - first_time_);
+  message.protocol = protocol;
+  message.source = flow.first;
+  message.destination = flow.second;
+  message.data = data;
+}
+
+} // namespace sippet
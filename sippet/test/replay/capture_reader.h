@@ -0,0 +1,150 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TEST_REPLAY_CAPTURE_READER_H_
+#define SIPPET_TEST_REPLAY_CAPTURE_READER_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/time/time.h"
+#include "net/base/ip_endpoint.h"
+#include "sippet/message/protocol.h"
+
+namespace sippet {
+
+// A SIP message found in a capture, as it was sent on the wire.
+struct CapturedMessage {
+  CapturedMessage();
+  ~CapturedMessage();
+
+  // Time elapsed since the first packet of the capture.
+  base::TimeDelta timestamp;
+  // Either |Protocol::UDP| or |Protocol::TCP|.
+  Protocol protocol;
+  net::IPEndPoint source;
+  net::IPEndPoint destination;
+  std::string data;
+};
+
+// CaptureReader extracts the SIP messages of a capture file, one at a time,
+// so that captures much larger than the memory can be read. Two formats are
+// recognized from their first bytes:
+//
+//  - pcap files, in microsecond or nanosecond resolution, of Ethernet, Linux
+//    cooked, BSD loopback or raw IP link types. UDP datagrams carry one
+//    message each, while TCP segments are reassembled per direction and the
+//    resulting streams are split into messages by their Content-Length.
+//    Fragmented IP packets are skipped, and so are pcapng files, which can
+//    be converted with "editcap -F pcap".
+//
+//  - HEP version 3 dumps, that is, the length-prefixed packets sent by
+//    capture agents to a HEP collector, one after the other. Each packet
+//    carries a whole message along with its addresses and capture time.
+//
+// Messages are returned in capture order. A TCP message is timestamped with
+// the segment that completed it.
+class CaptureReader {
+ public:
+  enum Format {
+    FORMAT_UNKNOWN,
+    FORMAT_PCAP,
+    FORMAT_HEP,
+  };
+
+  CaptureReader();
+  ~CaptureReader();
+
+  // Opens the capture at |path| and reads its header. Returns false if the
+  // file can't be read or its format isn't recognized.
+  bool Open(const base::FilePath &path);
+
+  Format format() const { return format_; }
+
+  // Reads the next message into |message|. Returns false at the end of the
+  // capture, or once it turns out to be truncated.
+  bool ReadNext(CapturedMessage *message);
+
+  // Packets read from the capture.
+  int64 packets_read() const { return packets_read_; }
+  // Packets read but not carrying SIP over UDP or TCP, or that couldn't be
+  // decoded.
+  int64 packets_skipped() const { return packets_skipped_; }
+  // Bytes of TCP streams left out of any message, because of capture gaps
+  // or of data that couldn't be framed.
+  int64 stream_bytes_dropped() const { return stream_bytes_dropped_; }
+
+ private:
+  typedef std::pair<net::IPEndPoint, net::IPEndPoint> FlowKey;
+
+  // The state of a TCP stream going in one direction.
+  struct TcpStream {
+    TcpStream();
+    ~TcpStream();
+
+    // The sequence number of the next byte expected.
+    uint32 next_sequence;
+    // Segments received ahead of |next_sequence|, by sequence number.
+    std::map<uint32, std::string> out_of_order;
+    size_t out_of_order_size;
+    // Bytes received in order and not yet framed into messages.
+    std::string buffer;
+  };
+
+  typedef std::map<FlowKey, TcpStream> TcpStreamsMap;
+
+  // Reads |size| bytes of the file into |data|.
+  bool ReadBytes(size_t size, std::string *data);
+
+  bool ReadPcapHeader();
+  bool ReadPcapRecord();
+  bool ReadHepPacket();
+  bool HandleHepPacket(const std::string &packet);
+
+  // Decodes a packet captured at |time|, in microseconds since the epoch,
+  // starting at the given link layer.
+  bool HandleLinkLayer(int64 time, const std::string &packet);
+  bool HandleIPPacket(int64 time, const char *data, size_t size);
+  void HandleTcpSegment(int64 time, const FlowKey &flow, uint32 sequence,
+                        uint8 flags, const char *data, size_t size);
+  // Moves the messages completed in |stream| to |messages_|.
+  void FrameMessages(int64 time, const FlowKey &flow, TcpStream *stream);
+  void DropStream(TcpStreamsMap::iterator it);
+
+  void AddMessage(int64 time, const Protocol &protocol,
+                  const FlowKey &flow, const std::string &data);
+
+  base::File file_;
+  std::vector<char> read_buffer_;
+  size_t read_position_;
+  size_t read_end_;
+
+  Format format_;
+  bool swapped_;
+  bool nanoseconds_;
+  uint32 link_type_;
+
+  // The capture time of the first packet, in microseconds since the epoch.
+  int64 first_time_;
+  bool has_first_time_;
+
+  TcpStreamsMap tcp_streams_;
+  std::deque<CapturedMessage> messages_;
+
+  int64 packets_read_;
+  int64 packets_skipped_;
+  int64 stream_bytes_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureReader);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TEST_REPLAY_CAPTURE_READER_H_
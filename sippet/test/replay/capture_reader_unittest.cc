@@ -0,0 +1,258 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/test/replay/capture_reader.h"
+
+#include <string.h>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/sys_byteorder.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kOptions[] =
+  "OPTIONS sip:10.0.0.2 SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bK776asdhds\r\n"
+  "Call-ID: a84b4c76e66710\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kMessage[] =
+  "MESSAGE sip:10.0.0.2 SIP/2.0\r\n"
+  "Via: SIP/2.0/TCP 10.0.0.1;branch=z9hG4bK776asdhds\r\n"
+  "l: 5\r\n"
+  "\r\n"
+  "Hello";
+
+const uint8 kClientAddress[] = { 10, 0, 0, 1 };
+const uint8 kServerAddress[] = { 10, 0, 0, 2 };
+
+void AppendUint16(uint16 value, std::string *data) {
+  value = base::HostToNet16(value);
+  data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendUint32(uint32 value, std::string *data) {
+  value = base::HostToNet32(value);
+  data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// pcap headers are written in the byte order of the capturing machine.
+void AppendHostUint32(uint32 value, std::string *data) {
+  data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string CreatePcapHeader() {
+  std::string header;
+  AppendHostUint32(0xa1b2c3d4, &header);
+  AppendHostUint32(0x00040002, &header);  // Version 2.4
+  AppendHostUint32(0, &header);
+  AppendHostUint32(0, &header);
+  AppendHostUint32(65535, &header);
+  AppendHostUint32(1, &header);           // Ethernet
+  return header;
+}
+
+// An Ethernet frame carrying an IPv4 packet from the client to the server.
+std::string CreateIPv4Frame(uint8 protocol, const std::string &payload) {
+  std::string frame(12, '\0');
+  AppendUint16(0x0800, &frame);
+  frame.push_back(0x45);
+  frame.push_back(0);
+  AppendUint16(static_cast<uint16>(20 + payload.size()), &frame);
+  AppendUint32(0, &frame);
+  frame.push_back(64);
+  frame.push_back(static_cast<char>(protocol));
+  AppendUint16(0, &frame);
+  frame.append(reinterpret_cast<const char*>(kClientAddress), 4);
+  frame.append(reinterpret_cast<const char*>(kServerAddress), 4);
+  frame.append(payload);
+  return frame;
+}
+
+std::string CreateUdpFrame(const std::string &data) {
+  std::string datagram;
+  AppendUint16(5060, &datagram);
+  AppendUint16(5060, &datagram);
+  AppendUint16(static_cast<uint16>(8 + data.size()), &datagram);
+  AppendUint16(0, &datagram);
+  datagram.append(data);
+  return CreateIPv4Frame(17, datagram);
+}
+
+std::string CreateTcpFrame(uint32 sequence, uint8 flags,
+                           const std::string &data) {
+  std::string segment;
+  AppendUint16(40000, &segment);
+  AppendUint16(5060, &segment);
+  AppendUint32(sequence, &segment);
+  AppendUint32(0, &segment);
+  segment.push_back(0x50);
+  segment.push_back(static_cast<char>(flags));
+  AppendUint16(65535, &segment);
+  AppendUint32(0, &segment);
+  segment.append(data);
+  return CreateIPv4Frame(6, segment);
+}
+
+void AppendPcapRecord(int64 microseconds, const std::string &frame,
+                      std::string *capture) {
+  AppendHostUint32(static_cast<uint32>(microseconds / 1000000), capture);
+  AppendHostUint32(static_cast<uint32>(microseconds % 1000000), capture);
+  AppendHostUint32(static_cast<uint32>(frame.size()), capture);
+  AppendHostUint32(static_cast<uint32>(frame.size()), capture);
+  capture->append(frame);
+}
+
+void AppendHepChunk(uint16 type, const std::string &value,
+                    std::string *packet) {
+  AppendUint16(0, packet);
+  AppendUint16(type, packet);
+  AppendUint16(static_cast<uint16>(6 + value.size()), packet);
+  packet->append(value);
+}
+
+class CaptureReaderTest : public testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  bool OpenCapture(const std::string &capture) {
+    base::FilePath path(temp_dir_.path().AppendASCII("capture"));
+    int size = static_cast<int>(capture.size());
+    if (size != base::WriteFile(path, capture.data(), size))
+      return false;
+    return reader_.Open(path);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  CaptureReader reader_;
+};
+
+}  // namespace
+
+TEST_F(CaptureReaderTest, PcapUdp) {
+  std::string capture(CreatePcapHeader());
+  AppendPcapRecord(1000000, CreateUdpFrame(kOptions), &capture);
+  // RTP, or anything else not looking like SIP.
+  AppendPcapRecord(1000500, CreateUdpFrame(std::string(160, '\x80')),
+                   &capture);
+  AppendPcapRecord(1250000, CreateUdpFrame("\r\n\r\n"), &capture);
+  AppendPcapRecord(1500000, CreateUdpFrame(kOptions), &capture);
+  ASSERT_TRUE(OpenCapture(capture));
+  EXPECT_EQ(CaptureReader::FORMAT_PCAP, reader_.format());
+
+  CapturedMessage message;
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(kOptions, message.data);
+  EXPECT_EQ(Protocol::UDP, message.protocol);
+  EXPECT_EQ("10.0.0.1:5060", message.source.ToString());
+  EXPECT_EQ("10.0.0.2:5060", message.destination.ToString());
+  EXPECT_EQ(base::TimeDelta(), message.timestamp);
+
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(500), message.timestamp);
+  EXPECT_FALSE(reader_.ReadNext(&message));
+  EXPECT_EQ(4, reader_.packets_read());
+  EXPECT_EQ(1, reader_.packets_skipped());
+}
+
+TEST_F(CaptureReaderTest, PcapTcpReassembly) {
+  std::string stream(std::string(kOptions) + "\r\n" + kMessage);
+  std::string first(stream.substr(0, 40));
+  std::string second(stream.substr(40, 60));
+  std::string third(stream.substr(100));
+
+  std::string capture(CreatePcapHeader());
+  AppendPcapRecord(0, CreateTcpFrame(999, 0x02, ""), &capture);
+  AppendPcapRecord(1000, CreateTcpFrame(1000, 0x10, first), &capture);
+  // Arrives ahead of the second segment, which is retransmitted along with
+  // bytes already received.
+  AppendPcapRecord(2000, CreateTcpFrame(1100, 0x10, third), &capture);
+  AppendPcapRecord(3000, CreateTcpFrame(1020, 0x10,
+                                        stream.substr(20, 80)), &capture);
+  AppendPcapRecord(4000, CreateTcpFrame(
+      static_cast<uint32>(1000 + stream.size()), 0x11, ""), &capture);
+  ASSERT_TRUE(OpenCapture(capture));
+
+  CapturedMessage message;
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(kOptions, message.data);
+  EXPECT_EQ(Protocol::TCP, message.protocol);
+  EXPECT_EQ("10.0.0.1:40000", message.source.ToString());
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(3), message.timestamp);
+
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(kMessage, message.data);
+  EXPECT_FALSE(reader_.ReadNext(&message));
+  EXPECT_EQ(0, reader_.packets_skipped());
+  EXPECT_EQ(0, reader_.stream_bytes_dropped());
+}
+
+TEST_F(CaptureReaderTest, PcapTcpResynchronizes) {
+  // The capture starts in the middle of a message.
+  std::string stream(std::string("Content-Length: 0\r\n\r\n") + kOptions);
+
+  std::string capture(CreatePcapHeader());
+  AppendPcapRecord(0, CreateTcpFrame(5000, 0x10, stream), &capture);
+  ASSERT_TRUE(OpenCapture(capture));
+
+  CapturedMessage message;
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(kOptions, message.data);
+  EXPECT_FALSE(reader_.ReadNext(&message));
+  EXPECT_EQ(19, reader_.stream_bytes_dropped());
+}
+
+TEST_F(CaptureReaderTest, Hep) {
+  std::string chunks;
+  AppendHepChunk(1, std::string(1, 2), &chunks);
+  AppendHepChunk(2, std::string(1, 6), &chunks);
+  AppendHepChunk(3, std::string(reinterpret_cast<const char*>(kServerAddress),
+                                4), &chunks);
+  AppendHepChunk(4, std::string(reinterpret_cast<const char*>(kClientAddress),
+                                4), &chunks);
+  std::string port;
+  AppendUint16(5060, &port);
+  AppendHepChunk(7, port, &chunks);
+  AppendHepChunk(8, port, &chunks);
+  std::string seconds;
+  AppendUint32(1440000000, &seconds);
+  AppendHepChunk(9, seconds, &chunks);
+  std::string microseconds;
+  AppendUint32(250000, &microseconds);
+  AppendHepChunk(10, microseconds, &chunks);
+  AppendHepChunk(11, std::string(1, 1), &chunks);
+  AppendHepChunk(15, kMessage, &chunks);
+
+  std::string capture;
+  for (int i = 0; i < 2; ++i) {
+    capture.append("HEP3");
+    AppendUint16(static_cast<uint16>(6 + chunks.size()), &capture);
+    capture.append(chunks);
+  }
+  ASSERT_TRUE(OpenCapture(capture));
+  EXPECT_EQ(CaptureReader::FORMAT_HEP, reader_.format());
+
+  CapturedMessage message;
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_EQ(kMessage, message.data);
+  EXPECT_EQ(Protocol::TCP, message.protocol);
+  EXPECT_EQ("10.0.0.2:5060", message.source.ToString());
+  EXPECT_EQ("10.0.0.1:5060", message.destination.ToString());
+  ASSERT_TRUE(reader_.ReadNext(&message));
+  EXPECT_FALSE(reader_.ReadNext(&message));
+  EXPECT_EQ(2, reader_.packets_read());
+}
+
+TEST_F(CaptureReaderTest, UnrecognizedFormat) {
+  EXPECT_FALSE(OpenCapture("\x0a\x0d\x0d\x0a"));
+}
+
+} // namespace sippet
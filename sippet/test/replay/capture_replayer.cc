@@ -0,0 +1,723 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/test/replay/capture_replayer.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include "base/bind.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/memory/weak_ptr.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/net_errors.h"
+#include "sippet/message/message.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/test/replay/capture_reader.h"
+#include "sippet/transport/channel_factory.h"
+#include "sippet/ua/dialog_controller.h"
+
+namespace sippet {
+
+namespace {
+
+// Transactions have terminated this long after their final response, or
+// after the first transmission of a request: 64*T1.
+const int64 kTransactionLifetimeSeconds = 32;
+
+const char *kStageNames[] = {
+  "capture",
+  "parse",
+  "transactions",
+  "dialogs",
+  "timers",
+};
+
+// Parses |data| as the channels do: the header section first, then the
+// content. Messages lacking the headers transactions are matched with are
+// taken as parse failures too.
+scoped_refptr<Message> ParseMessage(const std::string &data) {
+  size_t end_size = 4;
+  size_t end = data.find("\r\n\r\n");
+  if (std::string::npos == end) {
+    // CRLF is the standard, but just LF is accepted.
+    end = data.find("\n\n");
+    end_size = 2;
+  }
+  if (std::string::npos == end)
+    return nullptr;
+  size_t content_start = end + end_size;
+  scoped_refptr<Message> message(Message::Parse(data.substr(0, content_start)));
+  if (!message)
+    return nullptr;
+  Via *via = message->get<Via>();
+  if (!via || via->empty() || !message->get<Cseq>()
+      || !message->get<CallId>() || !message->get<From>()
+      || !message->get<To>())
+    return nullptr;
+  if (content_start < data.size()) {
+    // Datagrams may carry bytes past the Content-Length.
+    size_t content_size = data.size() - content_start;
+    ContentLength *content_length = message->get<ContentLength>();
+    if (content_length)
+      content_size = std::min<size_t>(content_size, content_length->value());
+    message->set_content(data.substr(content_start, content_size));
+  }
+  return message;
+}
+
+std::string TransactionKey(const Message *message, const Method &method) {
+  const Via *via = message->get<Via>();
+  return via->front().branch() + ":" + method.str();
+}
+
+}  // namespace
+
+// A channel between the replayed host and a peer. Messages sent through it
+// are dropped, and captured ones are delivered to the network layer as if
+// received through it.
+class ReplayChannel : public Channel {
+ public:
+  ReplayChannel(const base::WeakPtr<ReplayChannelFactory> &factory,
+                const EndPoint &origin,
+                const EndPoint &destination,
+                Channel::Delegate *delegate,
+                const scoped_refptr<base::SingleThreadTaskRunner> &task_runner);
+
+  int origin(EndPoint *origin) const override;
+  const EndPoint& destination() const override;
+
+  bool is_secure() const override;
+  bool is_connected() const override;
+  bool is_stream() const override;
+
+  void Connect() override;
+  int ReconnectIgnoringLastError() override;
+  int ReconnectWithCertificate(net::X509Certificate* client_cert) override;
+
+  int Send(const scoped_refptr<Message> &message,
+           const net::CompletionCallback& callback) override;
+
+  void Close() override;
+
+  void CloseWithError(int err) override;
+
+  void DetachDelegate() override;
+
+  // Messages arriving while connecting are delivered once connected.
+  void DeliverIncomingMessage(const scoped_refptr<Message> &message);
+
+ private:
+  friend class base::RefCountedThreadSafe<Channel>;
+  ~ReplayChannel() override;
+
+  void OnConnected();
+
+  base::WeakPtr<ReplayChannelFactory> factory_;
+  EndPoint origin_;
+  EndPoint destination_;
+  Channel::Delegate *delegate_;
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
+  bool is_connected_;
+  bool is_closed_;
+  std::deque<scoped_refptr<Message> > pending_messages_;
+
+  base::WeakPtrFactory<ReplayChannel> weak_ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplayChannel);
+};
+
+// Creates the |ReplayChannel|s of the replayed host, whatever their
+// destination is, and keeps track of them.
+class ReplayChannelFactory : public ChannelFactory {
+ public:
+  explicit ReplayChannelFactory(TimerSource *timer_source);
+  ~ReplayChannelFactory() override;
+
+  void set_local_address(const net::HostPortPair &local_address) {
+    local_address_ = local_address;
+  }
+
+  // Returns the open channel to |destination|, if any.
+  ReplayChannel *GetChannel(const EndPoint &destination) const;
+
+  // ChannelFactory methods:
+  int CreateChannel(const EndPoint &destination,
+                    Channel::Delegate *delegate,
+                    scoped_refptr<Channel> *channel) override;
+
+ private:
+  friend class ReplayChannel;
+
+  typedef std::map<EndPoint, ReplayChannel*, EndPointLess> ChannelsMap;
+
+  void RemoveChannel(ReplayChannel *channel);
+
+  TimerSource *timer_source_;
+  net::HostPortPair local_address_;
+  ChannelsMap channels_;
+
+  base::WeakPtrFactory<ReplayChannelFactory> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplayChannelFactory);
+};
+
+ReplayChannel::ReplayChannel(
+    const base::WeakPtr<ReplayChannelFactory> &factory,
+    const EndPoint &origin,
+    const EndPoint &destination,
+    Channel::Delegate *delegate,
+    const scoped_refptr<base::SingleThreadTaskRunner> &task_runner)
+  : factory_(factory),
+    origin_(origin),
+    destination_(destination),
+    delegate_(delegate),
+    task_runner_(task_runner),
+    is_connected_(false),
+    is_closed_(false),
+    weak_ptr_factory_(this) {
+}
+
+ReplayChannel::~ReplayChannel() {
+  if (factory_ && !is_closed_)
+    factory_->RemoveChannel(this);
+}
+
+int ReplayChannel::origin(EndPoint *origin) const {
+  *origin = origin_;
+  return net::OK;
+}
+
+const EndPoint& ReplayChannel::destination() const {
+  return destination_;
+}
+
+bool ReplayChannel::is_secure() const {
+  return false;
+}
+
+bool ReplayChannel::is_connected() const {
+  return is_connected_;
+}
+
+bool ReplayChannel::is_stream() const {
+  return destination_.protocol() != Protocol::UDP;
+}
+
+void ReplayChannel::Connect() {
+  DCHECK(!is_connected_);
+  task_runner_->PostTask(FROM_HERE,
+      base::Bind(&ReplayChannel::OnConnected,
+                 weak_ptr_factory_.GetWeakPtr()));
+}
+
+int ReplayChannel::ReconnectIgnoringLastError() {
+  return net::ERR_NOT_IMPLEMENTED;
+}
+
+int ReplayChannel::ReconnectWithCertificate(
+    net::X509Certificate* client_cert) {
+  return net::ERR_NOT_IMPLEMENTED;
+}
+
+int ReplayChannel::Send(const scoped_refptr<Message> &message,
+                        const net::CompletionCallback& callback) {
+  if (!is_connected_)
+    return net::ERR_SOCKET_NOT_CONNECTED;
+  return net::OK;
+}
+
+void ReplayChannel::Close() {
+  if (is_closed_)
+    return;
+  is_connected_ = false;
+  is_closed_ = true;
+  pending_messages_.clear();
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  if (factory_)
+    factory_->RemoveChannel(this);
+}
+
+void ReplayChannel::CloseWithError(int err) {
+  Close();
+}
+
+void ReplayChannel::DetachDelegate() {
+  delegate_ = nullptr;
+  Close();
+}
+
+void ReplayChannel::DeliverIncomingMessage(
+    const scoped_refptr<Message> &message) {
+  if (is_closed_)
+    return;
+  if (!is_connected_) {
+    pending_messages_.push_back(message);
+    return;
+  }
+  if (delegate_)
+    delegate_->OnIncomingMessage(this, message);
+}
+
+void ReplayChannel::OnConnected() {
+  is_connected_ = true;
+  if (delegate_)
+    delegate_->OnChannelConnected(this, net::OK);
+  base::WeakPtr<ReplayChannel> self(weak_ptr_factory_.GetWeakPtr());
+  while (self && is_connected_ && !pending_messages_.empty()) {
+    scoped_refptr<Message> message(pending_messages_.front());
+    pending_messages_.pop_front();
+    DeliverIncomingMessage(message);
+  }
+}
+
+ReplayChannelFactory::ReplayChannelFactory(TimerSource *timer_source)
+  : timer_source_(timer_source),
+    weak_factory_(this) {
+}
+
+ReplayChannelFactory::~ReplayChannelFactory() {
+}
+
+ReplayChannel *ReplayChannelFactory::GetChannel(
+    const EndPoint &destination) const {
+  ChannelsMap::const_iterator it = channels_.find(destination);
+  return channels_.end() == it ? nullptr : it->second;
+}
+
+int ReplayChannelFactory::CreateChannel(const EndPoint &destination,
+                                        Channel::Delegate *delegate,
+                                        scoped_refptr<Channel> *channel) {
+  DCHECK(channel);
+  if (GetChannel(destination))
+    return net::ERR_ADDRESS_IN_USE;
+  ReplayChannel *replay_channel = new ReplayChannel(
+      weak_factory_.GetWeakPtr(),
+      EndPoint(local_address_, destination.protocol()), destination,
+      delegate, timer_source_->GetTaskRunner());
+  channels_[destination] = replay_channel;
+  *channel = replay_channel;
+  return net::OK;
+}
+
+void ReplayChannelFactory::RemoveChannel(ReplayChannel *channel) {
+  ChannelsMap::iterator it = channels_.find(channel->destination());
+  if (channels_.end() != it && channel == it->second)
+    channels_.erase(it);
+}
+
+// Accounts the CPU time spent in its scope to a stage.
+class CaptureReplayer::ScopedStage {
+ public:
+  ScopedStage(CaptureReplayer *replayer, Stage stage)
+    : replayer_(replayer) {
+    replayer_->EnterStage(stage);
+  }
+  ~ScopedStage() {
+    replayer_->LeaveStage();
+  }
+
+ private:
+  CaptureReplayer *replayer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStage);
+};
+
+CaptureReplayer::Settings::Settings()
+  : speed(1),
+    sample_interval(base::TimeDelta::FromSeconds(10)),
+    drain_time(base::TimeDelta::FromSeconds(2 * kTransactionLifetimeSeconds)) {
+}
+
+CaptureReplayer::Settings::~Settings() {
+}
+
+CaptureReplayer::PendingRequests::PendingRequests() {
+}
+
+CaptureReplayer::PendingRequests::~PendingRequests() {
+}
+
+void CaptureReplayer::PendingRequests::Add(
+    const std::string &key, const scoped_refptr<Request> &request) {
+  requests[key] = std::make_pair(base::TimeTicks(), request);
+}
+
+scoped_refptr<Request> CaptureReplayer::PendingRequests::Find(
+    const std::string &key) const {
+  RequestsMap::const_iterator it = requests.find(key);
+  return requests.end() == it ? nullptr : it->second.second;
+}
+
+void CaptureReplayer::PendingRequests::SetDeadline(
+    const std::string &key, base::TimeTicks deadline) {
+  RequestsMap::iterator it = requests.find(key);
+  if (requests.end() == it)
+    return;
+  DCHECK(deadlines.empty() || deadlines.back().first <= deadline);
+  it->second.first = deadline;
+  deadlines.push_back(std::make_pair(deadline, key));
+}
+
+void CaptureReplayer::PendingRequests::Expire(base::TimeTicks now) {
+  while (!deadlines.empty() && deadlines.front().first <= now) {
+    RequestsMap::iterator it = requests.find(deadlines.front().second);
+    if (requests.end() != it && deadlines.front().first == it->second.first)
+      requests.erase(it);
+    deadlines.pop_front();
+  }
+}
+
+CaptureReplayer::CaptureReplayer(const Settings &settings)
+  : settings_(settings),
+    dialog_controller_(DialogController::GetDefaultDialogController()),
+    channel_factory_(new ReplayChannelFactory(&timer_source_)),
+    process_metrics_(base::ProcessMetrics::CreateProcessMetrics(
+        base::GetCurrentProcessHandle())),
+    peak_working_set_(0),
+    peak_client_transactions_(0),
+    peak_server_transactions_(0),
+    peak_dialogs_(0),
+    messages_injected_(0),
+    messages_sent_(0),
+    messages_ignored_(0),
+    retransmissions_(0),
+    parse_failures_(0),
+    send_failures_(0),
+    stray_responses_(0),
+    timeouts_(0),
+    transport_errors_(0),
+    packets_read_(0),
+    packets_skipped_(0),
+    stream_bytes_dropped_(0) {
+  DCHECK(settings_.sample_interval > base::TimeDelta());
+  NetworkSettings network_settings;
+  network_settings.set_timer_source(&timer_source_);
+  network_layer_.reset(new NetworkLayer(this, network_settings));
+  network_layer_->RegisterChannelFactory(Protocol::UDP,
+                                         channel_factory_.get());
+  network_layer_->RegisterChannelFactory(Protocol::TCP,
+                                         channel_factory_.get());
+  if (!settings_.local_address.address().empty()) {
+    channel_factory_->set_local_address(
+        net::HostPortPair::FromIPEndPoint(settings_.local_address));
+  }
+  for (int i = 0; i < STAGE_MAX; ++i)
+    stage_times_[i] = base::TimeDelta();
+}
+
+CaptureReplayer::~CaptureReplayer() {
+}
+
+void CaptureReplayer::Run(CaptureReader *reader) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  TakeSample();
+  next_sample_time_ = settings_.sample_interval;
+
+  CapturedMessage captured;
+  for (;;) {
+    bool more;
+    {
+      ScopedStage stage(this, STAGE_CAPTURE);
+      more = reader->ReadNext(&captured);
+    }
+    if (!more)
+      break;
+    base::TimeDelta time = replay_time_;
+    if (settings_.speed > 0) {
+      time = std::max(time, base::TimeDelta::FromMicroseconds(
+          static_cast<int64>(captured.timestamp.InMicroseconds()
+                             / settings_.speed)));
+    }
+    AdvanceTo(time);
+    ReplayMessage(captured);
+  }
+  AdvanceTo(replay_time_ + settings_.drain_time);
+  TakeSample();
+
+  wall_time_ = base::TimeTicks::Now() - start;
+  peak_working_set_ = std::max(peak_working_set_,
+                               process_metrics_->GetPeakWorkingSetSize());
+  packets_read_ = reader->packets_read();
+  packets_skipped_ = reader->packets_skipped();
+  stream_bytes_dropped_ = reader->stream_bytes_dropped();
+}
+
+void CaptureReplayer::PrintReport(std::ostream &os) const {
+  int64 messages = messages_injected_ + messages_sent_ + send_failures_
+      + retransmissions_ + parse_failures_;
+  os << base::StringPrintf("%-22s %s\n", "replayed host",
+                           settings_.local_address.ToString().c_str());
+  os << base::StringPrintf("%-22s %12.3f s\n", "replay time",
+                           replay_time_.InSecondsF());
+  os << base::StringPrintf("%-22s %12.3f s\n", "wall time",
+                           wall_time_.InSecondsF());
+  os << base::StringPrintf("%-22s %12lld\n", "packets read",
+                           static_cast<long long>(packets_read_));
+  os << base::StringPrintf("%-22s %12lld\n", "packets skipped",
+                           static_cast<long long>(packets_skipped_));
+  os << base::StringPrintf("%-22s %12lld\n", "stream bytes dropped",
+                           static_cast<long long>(stream_bytes_dropped_));
+  os << base::StringPrintf("%-22s %12lld\n", "messages ignored",
+                           static_cast<long long>(messages_ignored_));
+  os << base::StringPrintf("%-22s %12lld\n", "parse failures",
+                           static_cast<long long>(parse_failures_));
+  os << base::StringPrintf("%-22s %12lld\n", "messages received",
+                           static_cast<long long>(messages_injected_));
+  os << base::StringPrintf("%-22s %12lld\n", "messages sent",
+                           static_cast<long long>(messages_sent_));
+  os << base::StringPrintf("%-22s %12lld\n", "retransmissions",
+                           static_cast<long long>(retransmissions_));
+  os << base::StringPrintf("%-22s %12lld\n", "send failures",
+                           static_cast<long long>(send_failures_));
+  os << base::StringPrintf("%-22s %12lld\n", "stray responses",
+                           static_cast<long long>(stray_responses_));
+  os << base::StringPrintf("%-22s %12lld\n", "timeouts",
+                           static_cast<long long>(timeouts_));
+  os << base::StringPrintf("%-22s %12lld\n", "transport errors",
+                           static_cast<long long>(transport_errors_));
+  os << "\n";
+
+  os << base::StringPrintf("%-14s %12s %12s\n",
+      "stage", base::ThreadTicks::IsSupported() ? "cpu ms" : "wall ms",
+      "us/message");
+  for (int i = 0; i < STAGE_MAX; ++i) {
+    os << base::StringPrintf("%-14s %12.1f %12.2f\n", kStageNames[i],
+        stage_times_[i].InMillisecondsF(),
+        messages > 0 ? stage_times_[i].InMicrosecondsF() / messages : 0);
+  }
+  os << "\n";
+
+  os << base::StringPrintf("%-10s %12s %12s %12s %12s\n",
+      "time s", "client tx", "server tx", "dialogs", "rss KB");
+  for (size_t i = 0; i < samples_.size(); ++i) {
+    const Sample &sample = samples_[i];
+    os << base::StringPrintf(
+        "%-10.1f %12" PRIuS " %12" PRIuS " %12" PRIuS " %12" PRIuS "\n",
+        sample.time.InSecondsF(), sample.client_transactions,
+        sample.server_transactions, sample.dialogs,
+        sample.working_set / 1024);
+  }
+  os << base::StringPrintf(
+      "%-10s %12" PRIuS " %12" PRIuS " %12" PRIuS " %12" PRIuS "\n",
+      "peak", peak_client_transactions_, peak_server_transactions_,
+      peak_dialogs_, peak_working_set_ / 1024);
+}
+
+void CaptureReplayer::OnChannelConnected(const EndPoint &destination,
+                                         int err) {
+}
+
+void CaptureReplayer::OnChannelClosed(const EndPoint &destination) {
+}
+
+void CaptureReplayer::OnIncomingRequest(
+    const scoped_refptr<Request> &request) {
+  if (Method::ACK != request->method())
+    incoming_requests_.Add(TransactionKey(request.get(), request->method()),
+                           request);
+  ScopedStage stage(this, STAGE_DIALOGS);
+  dialog_controller_->HandleRequest(&dialog_store_, request);
+}
+
+void CaptureReplayer::OnIncomingResponse(
+    const scoped_refptr<Response> &response) {
+  ScopedStage stage(this, STAGE_DIALOGS);
+  dialog_controller_->HandleResponse(&dialog_store_, response);
+}
+
+void CaptureReplayer::OnTimedOut(const scoped_refptr<Request> &request) {
+  ++timeouts_;
+  ScopedStage stage(this, STAGE_DIALOGS);
+  dialog_controller_->HandleRequestError(&dialog_store_, request);
+}
+
+void CaptureReplayer::OnTransportError(const scoped_refptr<Request> &request,
+                                       int error) {
+  ++transport_errors_;
+  ScopedStage stage(this, STAGE_DIALOGS);
+  dialog_controller_->HandleRequestError(&dialog_store_, request);
+}
+
+bool CaptureReplayer::OnUnattachedResponse(
+    const scoped_refptr<Response> &response) {
+  // Responses to requests sent before the capture started, mostly.
+  ++stray_responses_;
+  return true;
+}
+
+void CaptureReplayer::ReplayMessage(const CapturedMessage &captured) {
+  if (settings_.local_address.address().empty()) {
+    if (base::StartsWith(captured.data, "SIP/2.0 ",
+                         base::CompareCase::SENSITIVE)) {
+      ++messages_ignored_;
+      return;
+    }
+    settings_.local_address = captured.destination;
+    channel_factory_->set_local_address(
+        net::HostPortPair::FromIPEndPoint(settings_.local_address));
+  }
+  bool incoming = IsLocal(captured.destination);
+  if (!incoming && !IsLocal(captured.source)) {
+    ++messages_ignored_;
+    return;
+  }
+
+  base::TimeTicks now = timer_source_.NowTicks();
+  incoming_requests_.Expire(now);
+  outgoing_requests_.Expire(now);
+
+  scoped_refptr<Message> message;
+  {
+    ScopedStage stage(this, STAGE_PARSE);
+    message = ParseMessage(captured.data);
+  }
+  if (!message) {
+    ++parse_failures_;
+    DVLOG(1) << "Couldn't parse a message from "
+             << captured.source.ToString();
+    return;
+  }
+  if (incoming)
+    InjectMessage(captured, message);
+  else
+    SendMessage(message->Copy(Message::Outgoing));
+}
+
+void CaptureReplayer::InjectMessage(const CapturedMessage &captured,
+                                    const scoped_refptr<Message> &message) {
+  ScopedStage stage(this, STAGE_TRANSACTIONS);
+  EndPoint origin(net::HostPortPair::FromIPEndPoint(captured.source),
+                  captured.protocol);
+  ReplayChannel *channel = channel_factory_->GetChannel(origin);
+  if (!channel) {
+    // As the network layer only opens channels by itself, it's told to
+    // connect to the peer, and the message is delivered once connected.
+    network_layer_->Connect(origin);
+    channel = channel_factory_->GetChannel(origin);
+    if (!channel) {
+      NOTREACHED() << "No channel to " << origin.ToString();
+      return;
+    }
+  }
+  ++messages_injected_;
+  channel->DeliverIncomingMessage(message);
+}
+
+void CaptureReplayer::SendMessage(const scoped_refptr<Message> &message) {
+  base::TimeTicks now = timer_source_.NowTicks();
+  base::TimeDelta lifetime =
+      base::TimeDelta::FromSeconds(kTransactionLifetimeSeconds);
+  int rv;
+  if (isa<Request>(message)) {
+    scoped_refptr<Request> request = dyn_cast<Request>(message);
+    if (Method::ACK != request->method()) {
+      std::string key(TransactionKey(request.get(), request->method()));
+      // The client transaction retransmits the request by itself.
+      if (outgoing_requests_.Find(key)) {
+        ++retransmissions_;
+        return;
+      }
+      outgoing_requests_.Add(key, request);
+      outgoing_requests_.SetDeadline(key, now + lifetime);
+    }
+    {
+      ScopedStage stage(this, STAGE_DIALOGS);
+      dialog_controller_->HandleRequest(&dialog_store_, request);
+    }
+    ScopedStage stage(this, STAGE_TRANSACTIONS);
+    rv = network_layer_->Send(request, net::CompletionCallback());
+  } else {
+    scoped_refptr<Response> response = dyn_cast<Response>(message);
+    std::string key(TransactionKey(response.get(),
+                                   response->get<Cseq>()->method()));
+    scoped_refptr<Request> request(incoming_requests_.Find(key));
+    if (request) {
+      // Server transactions only send responses to their own request.
+      response->set_refer_to(request);
+      if (response->response_code() >= 200)
+        incoming_requests_.SetDeadline(key, now + lifetime);
+    }
+    {
+      ScopedStage stage(this, STAGE_DIALOGS);
+      dialog_controller_->HandleResponse(&dialog_store_, response);
+    }
+    ScopedStage stage(this, STAGE_TRANSACTIONS);
+    rv = network_layer_->Send(response, net::CompletionCallback());
+  }
+  if (net::OK == rv || net::ERR_IO_PENDING == rv) {
+    ++messages_sent_;
+  } else {
+    ++send_failures_;
+    DVLOG(1) << "Couldn't send a message: " << net::ErrorToString(rv);
+  }
+}
+
+void CaptureReplayer::AdvanceTo(base::TimeDelta time) {
+  DCHECK(time >= replay_time_);
+  while (next_sample_time_ <= time) {
+    {
+      ScopedStage stage(this, STAGE_TIMERS);
+      timer_source_.FastForwardBy(next_sample_time_ - replay_time_);
+    }
+    replay_time_ = next_sample_time_;
+    TakeSample();
+    next_sample_time_ += settings_.sample_interval;
+  }
+  ScopedStage stage(this, STAGE_TIMERS);
+  timer_source_.FastForwardBy(time - replay_time_);
+  replay_time_ = time;
+}
+
+void CaptureReplayer::TakeSample() {
+  Sample sample;
+  sample.time = replay_time_;
+  sample.client_transactions = network_layer_->client_transaction_count();
+  sample.server_transactions = network_layer_->server_transaction_count();
+  sample.dialogs = dialog_store_.size();
+  sample.working_set = process_metrics_->GetWorkingSetSize();
+  samples_.push_back(sample);
+
+  peak_client_transactions_ = std::max(peak_client_transactions_,
+                                       sample.client_transactions);
+  peak_server_transactions_ = std::max(peak_server_transactions_,
+                                       sample.server_transactions);
+  peak_dialogs_ = std::max(peak_dialogs_, sample.dialogs);
+  peak_working_set_ = std::max(peak_working_set_, sample.working_set);
+}
+
+bool CaptureReplayer::IsLocal(const net::IPEndPoint &address) const {
+  return address.address() == settings_.local_address.address()
+      && (0 == settings_.local_address.port()
+          || address.port() == settings_.local_address.port());
+}
+
+void CaptureReplayer::EnterStage(Stage stage) {
+  base::TimeDelta now = CpuTime();
+  if (!stages_.empty())
+    stage_times_[stages_.back()] += now - stage_start_;
+  stages_.push_back(stage);
+  stage_start_ = now;
+}
+
+void CaptureReplayer::LeaveStage() {
+  DCHECK(!stages_.empty());
+  base::TimeDelta now = CpuTime();
+  stage_times_[stages_.back()] += now - stage_start_;
+  stages_.pop_back();
+  stage_start_ = now;
+}
+
+base::TimeDelta CaptureReplayer::CpuTime() const {
+  if (base::ThreadTicks::IsSupported())
+    return base::ThreadTicks::Now() - base::ThreadTicks();
+  return base::TimeTicks::Now() - base::TimeTicks();
+}
+
+} // namespace sippet
@@ -0,0 +1,195 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TEST_REPLAY_CAPTURE_REPLAYER_H_
+#define SIPPET_TEST_REPLAY_CAPTURE_REPLAYER_H_
+
+#include <deque>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/containers/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process/process_metrics.h"
+#include "base/time/time.h"
+#include "net/base/ip_endpoint.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/transport/virtual_timer_source.h"
+#include "sippet/ua/dialog_store.h"
+
+namespace sippet {
+
+class CaptureReader;
+class DialogController;
+class ReplayChannelFactory;
+struct CapturedMessage;
+
+// CaptureReplayer feeds the messages of a capture through the parser, a
+// |NetworkLayer| and a |DialogStore|, as if they were handled by one of the
+// captured hosts, the replayed host:
+//
+//  - Messages sent to it are parsed and injected into the network layer
+//    through fake channels, one per captured peer, creating and matching
+//    server transactions and dialogs.
+//
+//  - Messages sent by it are parsed and sent through the network layer,
+//    creating client transactions that the captured responses complete.
+//    Retransmissions are left to the transactions.
+//
+// Other messages are ignored. Timers run on a |VirtualTimerSource| following
+// the capture timeline, sped up by a given factor, so that hours of traffic
+// replay in the time it takes to process them. The replay time is the one
+// of this timeline.
+//
+// The report tells the CPU time spent in each stage of the processing, the
+// sizes of the transaction and dialog tables over time, and the peak memory
+// usage of the process.
+class CaptureReplayer : public NetworkLayer::Delegate {
+ public:
+  struct Settings {
+    Settings();
+    ~Settings();
+
+    // The address of the replayed host. A zero port matches any. Defaults
+    // to the destination of the first captured request.
+    net::IPEndPoint local_address;
+    // How many times faster than captured messages are replayed. Zero
+    // replays them all at once.
+    double speed;
+    // The interval at which table sizes are sampled, in replay time.
+    base::TimeDelta sample_interval;
+    // The time timers are run for after the last message, letting
+    // transactions complete.
+    base::TimeDelta drain_time;
+  };
+
+  explicit CaptureReplayer(const Settings &settings);
+  ~CaptureReplayer() override;
+
+  // Replays the messages read from |reader| until the end of the capture.
+  void Run(CaptureReader *reader);
+
+  void PrintReport(std::ostream &os) const;
+
+  // NetworkLayer::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override;
+  void OnChannelClosed(const EndPoint &destination) override;
+  void OnIncomingRequest(const scoped_refptr<Request> &request) override;
+  void OnIncomingResponse(const scoped_refptr<Response> &response) override;
+  void OnTimedOut(const scoped_refptr<Request> &request) override;
+  void OnTransportError(const scoped_refptr<Request> &request,
+                        int error) override;
+  bool OnUnattachedResponse(const scoped_refptr<Response> &response) override;
+
+ private:
+  class ScopedStage;
+
+  enum Stage {
+    // Reading the capture and reassembling TCP streams.
+    STAGE_CAPTURE,
+    STAGE_PARSE,
+    // The network layer and the transactions, on messages.
+    STAGE_TRANSACTIONS,
+    STAGE_DIALOGS,
+    // Timers and other tasks run on the virtual time.
+    STAGE_TIMERS,
+    STAGE_MAX,
+  };
+
+  struct Sample {
+    // Replay time of the sample.
+    base::TimeDelta time;
+    size_t client_transactions;
+    size_t server_transactions;
+    size_t dialogs;
+    size_t working_set;
+  };
+
+  // Requests by transaction, kept until a deadline is set and reached.
+  struct PendingRequests {
+    PendingRequests();
+    ~PendingRequests();
+
+    void Add(const std::string &key, const scoped_refptr<Request> &request);
+    scoped_refptr<Request> Find(const std::string &key) const;
+    void SetDeadline(const std::string &key, base::TimeTicks deadline);
+    void Expire(base::TimeTicks now);
+
+    typedef base::hash_map<std::string,
+        std::pair<base::TimeTicks, scoped_refptr<Request> > > RequestsMap;
+
+    RequestsMap requests;
+    // All requests share the same lifetime, so deadlines are kept in order.
+    // Those replaced by a later one are left behind, and skipped when
+    // reached.
+    std::deque<std::pair<base::TimeTicks, std::string> > deadlines;
+  };
+
+  void ReplayMessage(const CapturedMessage &captured);
+  void InjectMessage(const CapturedMessage &captured,
+                     const scoped_refptr<Message> &message);
+  void SendMessage(const scoped_refptr<Message> &message);
+
+  // Runs the timers until the replay time |time|, sampling on the way.
+  void AdvanceTo(base::TimeDelta time);
+  void TakeSample();
+
+  bool IsLocal(const net::IPEndPoint &address) const;
+
+  // Stages nest: the time spent in an inner stage isn't counted in the
+  // outer one.
+  void EnterStage(Stage stage);
+  void LeaveStage();
+  // The CPU time of the thread, where supported, or the wall time.
+  base::TimeDelta CpuTime() const;
+
+  Settings settings_;
+  VirtualTimerSource timer_source_;
+  DialogStore dialog_store_;
+  DialogController *dialog_controller_;
+  // Outlives the network layer, which closes its channels when destroyed.
+  scoped_ptr<ReplayChannelFactory> channel_factory_;
+  scoped_ptr<NetworkLayer> network_layer_;
+  scoped_ptr<base::ProcessMetrics> process_metrics_;
+
+  base::TimeDelta replay_time_;
+  base::TimeDelta next_sample_time_;
+
+  // Incoming requests to be answered by the replayed host, and requests it
+  // sent, by transaction.
+  PendingRequests incoming_requests_;
+  PendingRequests outgoing_requests_;
+
+  std::vector<Stage> stages_;
+  base::TimeDelta stage_start_;
+  base::TimeDelta stage_times_[STAGE_MAX];
+
+  std::vector<Sample> samples_;
+  size_t peak_working_set_;
+  size_t peak_client_transactions_;
+  size_t peak_server_transactions_;
+  size_t peak_dialogs_;
+
+  int64 messages_injected_;
+  int64 messages_sent_;
+  int64 messages_ignored_;
+  int64 retransmissions_;
+  int64 parse_failures_;
+  int64 send_failures_;
+  int64 stray_responses_;
+  int64 timeouts_;
+  int64 transport_errors_;
+  int64 packets_read_;
+  int64 packets_skipped_;
+  int64 stream_bytes_dropped_;
+  base::TimeDelta wall_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureReplayer);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TEST_REPLAY_CAPTURE_REPLAYER_H_
@@ -0,0 +1,102 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <iostream>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/ip_address_number.h"
+#include "sippet/test/replay/capture_reader.h"
+#include "sippet/test/replay/capture_replayer.h"
+
+using sippet::CaptureReader;
+using sippet::CaptureReplayer;
+
+static void PrintUsage() {
+  std::cout << "sippet_replay [--local=address[:port]]"
+            << " [--speed=factor]"
+            << " \\" << std::endl
+            << "    [--sample-interval=seconds]"
+            << " [--drain=seconds]"
+            << " capture.{pcap,hep}\n";
+}
+
+static bool GetSecondsSwitch(base::CommandLine* command_line,
+                             const char* name, base::TimeDelta* value) {
+  if (!command_line->HasSwitch(name))
+    return true;
+  double seconds;
+  if (!base::StringToDouble(command_line->GetSwitchValueASCII(name),
+                            &seconds) || seconds < 0)
+    return false;
+  *value = base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(seconds * base::Time::kMicrosecondsPerSecond));
+  return true;
+}
+
+static bool ParseLocalAddress(const std::string &value,
+                              net::IPEndPoint *address) {
+  std::string host(value);
+  int port = 0;
+  size_t colon = value.rfind(':');
+  // Bare IPv6 addresses have colons too, but no brackets.
+  if (std::string::npos != colon
+      && (value.find(':') == colon
+          || (value[0] == '[' && value[colon - 1] == ']'))) {
+    if (!base::StringToInt(value.substr(colon + 1), &port)
+        || port < 0 || port > 65535)
+      return false;
+    host = value.substr(0, colon);
+  }
+  if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']')
+    host = host.substr(1, host.size() - 2);
+  net::IPAddressNumber number;
+  if (!net::ParseIPLiteralToNumber(host, &number))
+    return false;
+  *address = net::IPEndPoint(number, static_cast<uint16>(port));
+  return true;
+}
+
+int main(int argc, char **argv) {
+  base::AtExitManager at_exit_manager;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
+
+  if (command_line->GetArgs().size() != 1 ||
+      command_line->HasSwitch("help")) {
+    PrintUsage();
+    return -1;
+  }
+
+  CaptureReplayer::Settings settings;
+  if ((command_line->HasSwitch("speed")
+       && (!base::StringToDouble(command_line->GetSwitchValueASCII("speed"),
+                                 &settings.speed)
+           || settings.speed < 0))
+      || !GetSecondsSwitch(command_line, "sample-interval",
+                           &settings.sample_interval)
+      || !GetSecondsSwitch(command_line, "drain", &settings.drain_time)
+      || settings.sample_interval <= base::TimeDelta()
+      || (command_line->HasSwitch("local")
+          && !ParseLocalAddress(command_line->GetSwitchValueASCII("local"),
+                                &settings.local_address))) {
+    PrintUsage();
+    return -1;
+  }
+
+  // Logging every message would make the logging the bottleneck.
+  logging::SetMinLogLevel(logging::LOG_WARNING);
+
+  CaptureReader reader;
+  if (!reader.Open(base::FilePath(command_line->GetArgs()[0])))
+    return -1;
+
+  CaptureReplayer replayer(settings);
+  replayer.Run(&reader);
+  replayer.PrintReport(std::cout);
+  return 0;
+}
@@ -0,0 +1,390 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/message_loop/message_loop.h"
+#include "base/path_service.h"
+#include "base/process/process_metrics.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "net/base/net_errors.h"
+#include "net/dns/host_resolver.h"
+#include "net/socket/client_socket_factory.h"
+#include "sippet/examples/common/dump_ssl_cert_error.h"
+#include "sippet/examples/common/static_password_handler.h"
+#include "sippet/examples/common/url_request_context_getter.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/test/standalone_test_server/standalone_test_server.h"
+#include "sippet/transport/chrome/chrome_channel_factory.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/transport/network_settings.h"
+#include "sippet/ua/auth_handler_factory.h"
+#include "sippet/ua/dialog_controller.h"
+#include "sippet/ua/ua_user_agent.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace sippet {
+
+namespace {
+
+enum Scenario {
+  // REGISTER transactions, authenticated preemptively after the first.
+  SCENARIO_REGISTER,
+  // OPTIONS transactions.
+  SCENARIO_NON_INVITE,
+  // INVITE-200-ACK followed by BYE-200.
+  SCENARIO_CALL,
+};
+
+// The matrix is fixed, so the numbers of different releases compare.
+const int kConcurrencyLevels[] = { 1, 10, 50 };
+const int kTransactionsPerRun = 2000;
+const int kCallsPerRun = 500;
+
+const char kUsername[] = "test";
+const char kPassword[] = "1234";
+const char kFromUri[] = "sip:test@no-biloxi.com";
+const char kToUri[] = "sip:echo@no-biloxi.com";
+
+const char *ScenarioName(Scenario scenario) {
+  switch (scenario) {
+    case SCENARIO_REGISTER:
+      return "register";
+    case SCENARIO_NON_INVITE:
+      return "non_invite";
+    case SCENARIO_CALL:
+      return "call";
+  }
+  NOTREACHED();
+  return "";
+}
+
+size_t GetWorkingSetSize() {
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+  return metrics->GetWorkingSetSize();
+}
+
+double InMillisecondsF(const std::vector<base::TimeDelta> &sorted,
+                       int percentile) {
+  if (sorted.empty())
+    return 0;
+  size_t index = std::min(sorted.size() - 1,
+                          sorted.size() * percentile / 100);
+  return sorted[index].InMillisecondsF();
+}
+
+}  // namespace
+
+// Drives a |ua::UserAgent| over a |NetworkLayer| and a
+// |ChromeChannelFactory| against the |StandaloneTestServer| on loopback,
+// keeping a number of operations outstanding until a fixed count has
+// completed. The pjsip server runs on threads of its own, so the reported
+// CPU time is the one of the sippet thread alone, where supported.
+class LoopbackPerfTest
+    : public testing::Test,
+      public ua::UserAgent::Delegate {
+ public:
+  LoopbackPerfTest()
+    : scenario_(SCENARIO_REGISTER),
+      count_(0),
+      started_(0),
+      failed_(0),
+      run_loop_(nullptr),
+      weak_factory_(this) {
+  }
+
+  void TearDown() override {
+    if (server_)
+      ASSERT_TRUE(server_->ShutdownAndWaitUntilComplete());
+  }
+
+  // ua::UserAgent::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override {
+  }
+
+  void OnChannelClosed(const EndPoint &destination) override {
+  }
+
+  void OnIncomingRequest(
+      const scoped_refptr<Request> &incoming_request,
+      const scoped_refptr<Dialog> &dialog) override {
+  }
+
+  void OnIncomingResponse(
+      const scoped_refptr<Response> &incoming_response,
+      const scoped_refptr<Dialog> &dialog) override {
+    if (incoming_response->response_code() < 200)
+      return;
+    std::string call_id(incoming_response->get<CallId>()->value());
+    OperationsMap::iterator i = operations_.find(call_id);
+    if (operations_.end() == i)
+      return;
+    bool success = incoming_response->response_code() < 300;
+    if (success && Method::INVITE ==
+        incoming_response->get<Cseq>()->method()) {
+      // Retransmissions of the 200 OK are ignored.
+      if (!i->second.invite)
+        return;
+      if (!dialog) {
+        CompleteOperation(call_id, false);
+        return;
+      }
+      // The call is up: acknowledge it and hang up right away.
+      scoped_refptr<Request> invite;
+      invite.swap(i->second.invite);
+      SendRequest(call_id, dialog->CreateAck(invite));
+      SendRequest(call_id, dialog->CreateRequest(Method::BYE));
+      return;
+    }
+    CompleteOperation(call_id, success);
+  }
+
+  void OnTimedOut(
+      const scoped_refptr<Request> &request,
+      const scoped_refptr<Dialog> &dialog) override {
+    CompleteOperation(request->get<CallId>()->value(), false);
+  }
+
+  void OnTransportError(
+      const scoped_refptr<Request> &request, int error,
+      const scoped_refptr<Dialog> &dialog) override {
+    CompleteOperation(request->get<CallId>()->value(), false);
+  }
+
+ protected:
+  void Init(const Protocol &protocol) {
+    if (Protocol::TLS == protocol) {
+      base::FilePath certs_dir;
+      PathService::Get(base::DIR_SOURCE_ROOT, &certs_dir);
+      certs_dir = certs_dir.Append(
+          FILE_PATH_LITERAL("net/data/ssl/certificates"));
+      StandaloneTestServer::SSLOptions ssl_options;
+      ssl_options.certificate_file = certs_dir.AppendASCII("ok_cert.pem");
+      ssl_options.privatekey_file = certs_dir.AppendASCII("ok_cert.pem");
+      server_.reset(new StandaloneTestServer(protocol, ssl_options));
+    } else {
+      server_.reset(new StandaloneTestServer(protocol));
+    }
+    ASSERT_TRUE(server_->InitializeAndWaitUntilReady());
+
+    request_context_getter_ =
+        new URLRequestContextGetter(message_loop_.task_runner());
+    host_resolver_ = net::HostResolver::CreateDefaultResolver(nullptr);
+    auth_handler_factory_.reset(
+        AuthHandlerFactory::CreateDefault(host_resolver_.get()));
+    password_handler_factory_.reset(new StaticPasswordHandler::Factory(
+        base::ASCIIToUTF16(kUsername), base::ASCIIToUTF16(kPassword)));
+    user_agent_.reset(new ua::UserAgent(auth_handler_factory_.get(),
+        password_handler_factory_.get(),
+        DialogController::GetDefaultDialogController(),
+        net::BoundNetLog()));
+    user_agent_->set_preemptive_auth_enabled(true);
+    user_agent_->AppendHandler(this);
+
+    // The server certificate is self-signed.
+    ssl_cert_error_handler_factory_.reset(new DumpSSLCertError::Factory(true));
+    NetworkSettings network_settings;
+    network_settings.set_ssl_cert_error_handler_factory(
+        ssl_cert_error_handler_factory_.get());
+    network_layer_.reset(new NetworkLayer(user_agent_.get(),
+        network_settings));
+
+    net::SSLConfig ssl_config;
+    ssl_config.version_min = net::SSL_PROTOCOL_VERSION_TLS1;
+    channel_factory_.reset(new ChromeChannelFactory(
+        net::ClientSocketFactory::GetDefaultFactory(),
+        request_context_getter_, ssl_config));
+    network_layer_->RegisterChannelFactory(protocol, channel_factory_.get());
+    user_agent_->SetNetworkLayer(network_layer_.get());
+  }
+
+  // Runs every scenario at every concurrency level, reporting the results
+  // under |trace|, usually the transport.
+  void RunMatrix(const std::string &trace) {
+    for (size_t i = 0; i < arraysize(kConcurrencyLevels); ++i) {
+      RunScenario(SCENARIO_REGISTER, kConcurrencyLevels[i],
+                  kTransactionsPerRun, trace);
+      RunScenario(SCENARIO_NON_INVITE, kConcurrencyLevels[i],
+                  kTransactionsPerRun, trace);
+      RunScenario(SCENARIO_CALL, kConcurrencyLevels[i],
+                  kCallsPerRun, trace);
+    }
+  }
+
+ private:
+  struct Operation {
+    Operation() {}
+    ~Operation() {}
+
+    // The INVITE to be acknowledged, in calls, until it is.
+    scoped_refptr<Request> invite;
+    base::TimeTicks start;
+  };
+
+  // Operations are identified by the Call-ID of their requests.
+  typedef std::map<std::string, Operation> OperationsMap;
+
+  void RunScenario(Scenario scenario, int concurrency, int count,
+                   const std::string &trace) {
+    scenario_ = scenario;
+    count_ = count;
+    started_ = 0;
+    failed_ = 0;
+    latencies_.clear();
+    latencies_.reserve(count);
+
+    size_t working_set_before = GetWorkingSetSize();
+    base::ThreadTicks cpu_start;
+    if (base::ThreadTicks::IsSupported())
+      cpu_start = base::ThreadTicks::Now();
+    base::TimeTicks start = base::TimeTicks::Now();
+
+    base::RunLoop run_loop;
+    run_loop_ = &run_loop;
+    for (int i = 0; i < concurrency && i < count; ++i)
+      StartOperation();
+    run_loop.Run();
+    run_loop_ = nullptr;
+
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::TimeDelta cpu;
+    if (base::ThreadTicks::IsSupported())
+      cpu = base::ThreadTicks::Now() - cpu_start;
+    size_t working_set_after = GetWorkingSetSize();
+
+    std::sort(latencies_.begin(), latencies_.end());
+    std::string measurement(ScenarioName(scenario));
+    std::string modifier("_c" + base::IntToString(concurrency));
+    perf_test::PrintResult(measurement, modifier, trace + "_throughput",
+        count / elapsed.InSecondsF(), "ops/s", true);
+    perf_test::PrintResult(measurement, modifier, trace + "_latency_p50",
+        InMillisecondsF(latencies_, 50), "ms", true);
+    perf_test::PrintResult(measurement, modifier, trace + "_latency_p90",
+        InMillisecondsF(latencies_, 90), "ms", false);
+    perf_test::PrintResult(measurement, modifier, trace + "_latency_p99",
+        InMillisecondsF(latencies_, 99), "ms", true);
+    if (base::ThreadTicks::IsSupported()) {
+      perf_test::PrintResult(measurement, modifier, trace + "_cpu",
+          cpu.InMicrosecondsF() / count, "us/op", true);
+    }
+    // May be negative if memory was returned to the system.
+    perf_test::PrintResult(measurement, modifier, trace + "_rss_growth",
+        (static_cast<double>(working_set_after) - working_set_before)
+            / 1024, "KB", false);
+    perf_test::PrintResult(measurement, modifier, trace + "_failures",
+        failed_, "ops", false);
+    EXPECT_EQ(0, failed_);
+  }
+
+  void StartOperation() {
+    ++started_;
+    scoped_refptr<Request> request;
+    switch (scenario_) {
+      case SCENARIO_REGISTER:
+        request = user_agent_->CreateRequest(Method::REGISTER,
+            server_->base_uri(), GURL(kFromUri), GURL(kFromUri));
+        break;
+      case SCENARIO_NON_INVITE:
+        request = user_agent_->CreateRequest(Method::OPTIONS,
+            server_->base_uri(), GURL(kFromUri), GURL(kToUri));
+        break;
+      case SCENARIO_CALL:
+        request = user_agent_->CreateRequest(Method::INVITE,
+            server_->base_uri(), GURL(kFromUri), GURL(kToUri));
+        break;
+    }
+    std::string call_id(request->get<CallId>()->value());
+    Operation &operation = operations_[call_id];
+    if (SCENARIO_CALL == scenario_)
+      operation.invite = request;
+    operation.start = base::TimeTicks::Now();
+    SendRequest(call_id, request);
+  }
+
+  void SendRequest(const std::string &call_id,
+                   const scoped_refptr<Request> &request) {
+    int rv = user_agent_->Send(request,
+        base::Bind(&LoopbackPerfTest::OnRequestSent,
+                   weak_factory_.GetWeakPtr(), call_id));
+    if (net::ERR_IO_PENDING != rv)
+      OnRequestSent(call_id, rv);
+  }
+
+  void OnRequestSent(const std::string &call_id, int rv) {
+    if (net::OK != rv)
+      CompleteOperation(call_id, false);
+  }
+
+  void CompleteOperation(const std::string &call_id, bool success) {
+    OperationsMap::iterator i = operations_.find(call_id);
+    if (operations_.end() == i)
+      return;
+    latencies_.push_back(base::TimeTicks::Now() - i->second.start);
+    if (!success)
+      ++failed_;
+    operations_.erase(i);
+
+    if (started_ < count_) {
+      // Posted, so that failures reported synchronously don't recurse.
+      base::ThreadTaskRunnerHandle::Get()->PostTask(FROM_HERE,
+          base::Bind(&LoopbackPerfTest::StartOperation,
+                     weak_factory_.GetWeakPtr()));
+    } else if (operations_.empty()) {
+      run_loop_->Quit();
+    }
+  }
+
+  base::MessageLoopForIO message_loop_;
+  scoped_ptr<StandaloneTestServer> server_;
+  scoped_refptr<net::URLRequestContextGetter> request_context_getter_;
+  scoped_ptr<net::HostResolver> host_resolver_;
+  scoped_ptr<AuthHandlerFactory> auth_handler_factory_;
+  scoped_ptr<StaticPasswordHandler::Factory> password_handler_factory_;
+  scoped_ptr<DumpSSLCertError::Factory> ssl_cert_error_handler_factory_;
+  scoped_ptr<ua::UserAgent> user_agent_;
+  scoped_ptr<NetworkLayer> network_layer_;
+  scoped_ptr<ChromeChannelFactory> channel_factory_;
+
+  Scenario scenario_;
+  int count_;
+  int started_;
+  int failed_;
+  OperationsMap operations_;
+  std::vector<base::TimeDelta> latencies_;
+  base::RunLoop *run_loop_;
+
+  base::WeakPtrFactory<LoopbackPerfTest> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopbackPerfTest);
+};
+
+TEST_F(LoopbackPerfTest, UDP) {
+  Init(Protocol::UDP);
+  RunMatrix("udp");
+}
+
+TEST_F(LoopbackPerfTest, TCP) {
+  Init(Protocol::TCP);
+  RunMatrix("tcp");
+}
+
+TEST_F(LoopbackPerfTest, TLS) {
+  Init(Protocol::TLS);
+  RunMatrix("tls");
+}
+
+}  // namespace sippet
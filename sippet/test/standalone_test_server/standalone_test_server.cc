@@ -329,34 +329,45 @@ bool StandaloneTestServer::Started() const {
 }
 
 void StandaloneTestServer::OnReceiveRequest(pjsip_rx_data *rdata) {
-  if (rdata->msg_info.msg->line.req.method.id == PJSIP_CANCEL_METHOD)
+  pjsip_method_e method = rdata->msg_info.msg->line.req.method.id;
+  // ACKs to our 2xx responses complete the calls, and CANCELs arrive too
+  // late to stop them.
+  if (method == PJSIP_CANCEL_METHOD || method == PJSIP_ACK_METHOD)
     return;
 
-  if (!VerifyRequest(rdata))
+  if (method == PJSIP_REGISTER_METHOD && !VerifyRequest(rdata))
     return;
 
-  if (rdata->msg_info.msg->line.req.method.id == PJSIP_REGISTER_METHOD) {
-    // Authentication was OK, so just return success
-    pj_status_t status;
-    pjsip_tx_data *tdata = nullptr;
-    do {
-      status = pjsip_endpt_create_response(control_struct_->endpoint_,
-          rdata, PJSIP_SC_OK, nullptr, &tdata);
-      if (status != PJ_SUCCESS)
-        break;
-      pjsip_transaction *uas_tsx;
-      status = pjsip_tsx_create_uas(nullptr, rdata, &uas_tsx);
-      if (status != PJ_SUCCESS)
-        break;
-      pjsip_tsx_recv_msg(uas_tsx, rdata);
-      pjsip_tsx_send_msg(uas_tsx, tdata);
-      return;
-    } while (0);
-    if (tdata)
-      pjsip_tx_data_dec_ref(tdata);
-    pjsip_endpt_respond_stateless(control_struct_->endpoint_, rdata,
-        PJSIP_SC_INTERNAL_SERVER_ERROR, nullptr, nullptr, nullptr);
-  }
+  // Everything else is accepted: INVITEs are answered as if the call was
+  // established, and BYEs as if it was terminated.
+  pj_status_t status;
+  pjsip_tx_data *tdata = nullptr;
+  do {
+    status = pjsip_endpt_create_response(control_struct_->endpoint_,
+        rdata, PJSIP_SC_OK, nullptr, &tdata);
+    if (status != PJ_SUCCESS)
+      break;
+    if (method == PJSIP_INVITE_METHOD) {
+      const pj_str_t STR_CONTACT = {"Contact", 7};
+      pj_str_t contact = pj_str(const_cast<char*>(contact_.c_str()));
+      pjsip_generic_string_hdr *contact_hdr =
+          pjsip_generic_string_hdr_create(tdata->pool, &STR_CONTACT,
+                                          &contact);
+      pjsip_msg_add_hdr(tdata->msg,
+          reinterpret_cast<pjsip_hdr*>(contact_hdr));
+    }
+    pjsip_transaction *uas_tsx;
+    status = pjsip_tsx_create_uas(nullptr, rdata, &uas_tsx);
+    if (status != PJ_SUCCESS)
+      break;
+    pjsip_tsx_recv_msg(uas_tsx, rdata);
+    pjsip_tsx_send_msg(uas_tsx, tdata);
+    return;
+  } while (0);
+  if (tdata)
+    pjsip_tx_data_dec_ref(tdata);
+  pjsip_endpt_respond_stateless(control_struct_->endpoint_, rdata,
+      PJSIP_SC_INTERNAL_SERVER_ERROR, nullptr, nullptr, nullptr);
 }
 
 bool StandaloneTestServer::VerifyRequest(pjsip_rx_data *rdata) {
@@ -452,6 +463,7 @@ void StandaloneTestServer::InitializeOnIOThread() {
       NOTREACHED() << "Unknown protocol";
     }
     base_uri_ = GURL(uri.str());
+    contact_ = "<" + base_uri_.spec() + ">";
   }
 }
 
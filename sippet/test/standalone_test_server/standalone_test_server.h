@@ -19,6 +19,11 @@ struct pjsip_rx_data;
 
 namespace sippet {
 
+// An in-process SIP peer, backed by pjsip. REGISTER requests are
+// authenticated against the "no-biloxi.com" realm, with user "test" and
+// password "1234", and then accepted. All other requests are accepted
+// right away: INVITEs are answered with a 200 OK carrying |base_uri| as
+// Contact, and the subsequent ACKs are absorbed.
 class StandaloneTestServer {
  public:
   // Container for various options to control how the SIPS or WSS server is
@@ -107,6 +112,7 @@ class StandaloneTestServer {
   Protocol protocol_;
   int port_;
   GURL base_uri_;
+  std::string contact_;
 
   base::ThreadChecker thread_checker_;
 
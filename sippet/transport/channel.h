@@ -64,6 +64,12 @@ class NET_EXPORT_PRIVATE Channel :
   // Whether this channel is a stream channel.
   virtual bool is_stream() const = 0;
 
+  // Number of messages waiting to be written to the socket.
+  virtual size_t pending_writes() const { return 0; }
+
+  // Bytes held by the read buffer and the messages waiting to be written.
+  virtual size_t buffered_bytes() const { return 0; }
+
   // Opens the connection on the IO thread.
   // Once the connection is established, calls delegate's OnChannelConnected.
   virtual void Connect() = 0;
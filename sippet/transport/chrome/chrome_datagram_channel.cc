@@ -13,7 +13,10 @@
 #include "net/udp/datagram_client_socket.h"
 #include "net/url_request/url_request_context.h"
 #include "net/url_request/url_request_context_getter.h"
+#include "sippet/base/tracing.h"
 #include "sippet/message/message.h"
+#include "sippet/transport/message_tracer.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -75,9 +78,23 @@ bool ChromeDatagramChannel::is_stream() const {
   return false;
 }
 
+size_t ChromeDatagramChannel::pending_writes() const {
+  return datagram_writer_.get() ? datagram_writer_->pending_messages() : 0;
+}
+
+size_t ChromeDatagramChannel::buffered_bytes() const {
+  size_t bytes = 0;
+  if (datagram_reader_.get())
+    bytes += datagram_reader_->max_size();
+  if (datagram_writer_.get())
+    bytes += datagram_writer_->pending_bytes();
+  return bytes;
+}
+
 void ChromeDatagramChannel::Connect() {
   DCHECK(!socket_.get());
   DCHECK_EQ(STATE_NONE, next_state_);
+  SIPPET_TRACE_ASYNC_BEGIN0("ChromeDatagramChannel::Connect", this);
 
   next_state_ = STATE_RESOLVE_HOST;
   base::MessageLoop* message_loop = base::MessageLoop::current();
@@ -103,6 +120,8 @@ int ChromeDatagramChannel::ReconnectWithCertificate(
 
 void ChromeDatagramChannel::RunUserConnectCallback(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
+  SIPPET_TRACE_ASYNC_END1("ChromeDatagramChannel::Connect", this,
+                          "result", result);
   if (net::OK == result)
     PostDoRead();
   if (delegate_)
@@ -196,9 +215,15 @@ int ChromeDatagramChannel::DoResolveHostComplete(int result) {
 
 int ChromeDatagramChannel::Send(const scoped_refptr<Message> &message,
                                 const net::CompletionCallback& callback) {
+  SIPPET_TRACE_EVENT0("ChromeDatagramChannel::Send");
   if (is_connected_ && datagram_writer_.get()) {
     scoped_refptr<net::StringIOBuffer> string_buffer =
         new net::StringIOBuffer(message->ToString());
+    TransportMetrics::Get()->CountMessage(message);
+    if (MessageTracer::GetInstance()->ShouldTrace(message)) {
+      TraceMessage(message, string_buffer->data(),
+                   static_cast<size_t>(string_buffer->size()));
+    }
     return datagram_writer_->Write(
         string_buffer.get(),
         string_buffer->size(),
@@ -253,13 +278,31 @@ void ChromeDatagramChannel::DoRead() {
 
 void ChromeDatagramChannel::OnReadComplete(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
+  SIPPET_TRACE_EVENT0("ChromeDatagramChannel::OnReadComplete");
   if (net::OK == result) {
     PostDoRead();
-    delegate_->OnIncomingMessage(this, datagram_reader_->GetIncomingMessage());
+    scoped_refptr<Message> message(datagram_reader_->GetIncomingMessage());
+    TransportMetrics::Get()->CountMessage(message);
+    if (MessageTracer::GetInstance()->ShouldTrace(message)) {
+      base::StringPiece data(datagram_reader_->raw_message());
+      TraceMessage(message, data.data(), data.size());
+    }
+    delegate_->OnIncomingMessage(this, message);
   } else if (result < 0) {
     RunUserChannelClosed(result);
     // |this| may be deleted after this call.
   }
 }
 
+void ChromeDatagramChannel::TraceMessage(const scoped_refptr<Message> &message,
+    const char *data, size_t size) {
+  net::IPEndPoint local;
+  net::IPEndPoint remote;
+  if (net::OK != socket_->GetLocalAddress(&local)
+      || net::OK != socket_->GetPeerAddress(&remote))
+    return;
+  MessageTracer::GetInstance()->Trace(message->direction(),
+      Protocol::UDP, local, remote, data, size);
+}
+
 }  // namespace sippet
@@ -8,6 +8,7 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/socket/socket.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -28,6 +29,8 @@ ChromeDatagramWriter::ChromeDatagramWriter(
 }
 
 ChromeDatagramWriter::~ChromeDatagramWriter() {
+  TransportMetrics::Get()->pending_writes->Add(
+      -static_cast<int64>(pending_messages_.size()));
   STLDeleteElements(&pending_messages_);
 }
 
@@ -44,10 +47,18 @@ int ChromeDatagramWriter::Write(net::IOBuffer* buf, int buf_len,
     }
   }
 
+  TransportMetrics::Get()->pending_writes->Increment();
   pending_messages_.push_back(new PendingFrame(buf, buf_len, callback));
   return net::ERR_IO_PENDING;
 }
 
+size_t ChromeDatagramWriter::pending_bytes() const {
+  size_t bytes = 0;
+  for (const PendingFrame *pending : pending_messages_)
+    bytes += pending->buf_len_;
+  return bytes;
+}
+
 void ChromeDatagramWriter::CloseWithError(int err) {
   error_ = err;
   while (!pending_messages_.empty())
@@ -82,6 +93,7 @@ void ChromeDatagramWriter::DidConsume() {
 }
 
 void ChromeDatagramWriter::Pop(int result) {
+  TransportMetrics::Get()->pending_writes->Decrement();
   PendingFrame *pending = pending_messages_.front();
   pending->callback_.Run(result);
   delete pending;
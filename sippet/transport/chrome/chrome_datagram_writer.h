@@ -37,6 +37,12 @@ class ChromeDatagramWriter {
 
   void CloseWithError(int err);
 
+  // Number of messages waiting to be written.
+  size_t pending_messages() const { return pending_messages_.size(); }
+
+  // Bytes held by the messages waiting to be written.
+  size_t pending_bytes() const;
+
  private:
   net::Socket* wrapped_socket_;
   int error_;
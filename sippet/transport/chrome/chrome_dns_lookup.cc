@@ -0,0 +1,182 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/chrome/chrome_dns_lookup.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/big_endian.h"
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/stl_util.h"
+#include "net/base/net_errors.h"
+#include "net/dns/dns_client.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_response.h"
+#include "net/dns/dns_transaction.h"
+#include "net/dns/record_rdata.h"
+
+namespace sippet {
+
+namespace {
+
+// Not among the types known by net/dns (RFC 3403).
+const uint16 kTypeNAPTR = 35;
+
+bool ReadCharacterString(base::BigEndianReader *reader, std::string *out) {
+  uint8 length;
+  base::StringPiece value;
+  if (!reader->ReadU8(&length) || !reader->ReadPiece(&value, length))
+    return false;
+  value.CopyToString(out);
+  return true;
+}
+
+int ParseNaptrRecords(const net::DnsResponse *response,
+                      std::vector<SipResolver::NaptrRecord> *records,
+                      base::TimeDelta *ttl) {
+  net::DnsRecordParser parser = response->Parser();
+  uint32 min_ttl = kuint32max;
+  for (unsigned i = 0; i < response->answer_count(); ++i) {
+    net::DnsResourceRecord record;
+    if (!parser.ReadRecord(&record))
+      return net::ERR_DNS_MALFORMED_RESPONSE;
+    // Skip the CNAMEs followed by the server.
+    if (kTypeNAPTR != record.type)
+      continue;
+    base::BigEndianReader reader(record.rdata.data(), record.rdata.size());
+    SipResolver::NaptrRecord naptr;
+    std::string regexp;
+    if (!reader.ReadU16(&naptr.order)
+        || !reader.ReadU16(&naptr.preference)
+        || !ReadCharacterString(&reader, &naptr.flags)
+        || !ReadCharacterString(&reader, &naptr.services)
+        || !ReadCharacterString(&reader, &regexp)
+        || !parser.ReadName(reader.ptr(), &naptr.replacement))
+      return net::ERR_DNS_MALFORMED_RESPONSE;
+    records->push_back(naptr);
+    min_ttl = std::min(min_ttl, record.ttl);
+  }
+  if (records->empty())
+    return net::ERR_NAME_NOT_RESOLVED;
+  *ttl = base::TimeDelta::FromSeconds(min_ttl);
+  return net::OK;
+}
+
+int ParseSrvRecords(const net::DnsResponse *response,
+                    std::vector<SipResolver::SrvRecord> *records,
+                    base::TimeDelta *ttl) {
+  net::DnsRecordParser parser = response->Parser();
+  uint32 min_ttl = kuint32max;
+  for (unsigned i = 0; i < response->answer_count(); ++i) {
+    net::DnsResourceRecord record;
+    if (!parser.ReadRecord(&record))
+      return net::ERR_DNS_MALFORMED_RESPONSE;
+    if (net::dns_protocol::kTypeSRV != record.type)
+      continue;
+    scoped_ptr<net::SrvRecordRdata> srv(
+        net::SrvRecordRdata::Create(record.rdata, parser));
+    if (!srv)
+      return net::ERR_DNS_MALFORMED_RESPONSE;
+    records->push_back(SipResolver::SrvRecord(srv->priority(),
+        srv->weight(), srv->port(), srv->target()));
+    min_ttl = std::min(min_ttl, record.ttl);
+  }
+  if (records->empty())
+    return net::ERR_NAME_NOT_RESOLVED;
+  *ttl = base::TimeDelta::FromSeconds(min_ttl);
+  return net::OK;
+}
+
+}  // namespace
+
+ChromeDnsLookup::Query::Query() {
+}
+
+ChromeDnsLookup::Query::~Query() {
+}
+
+ChromeDnsLookup::ChromeDnsLookup(net::DnsClient *dns_client,
+                                 const net::BoundNetLog &net_log)
+  : dns_client_(dns_client),
+    net_log_(net_log) {
+  DCHECK(dns_client);
+}
+
+ChromeDnsLookup::~ChromeDnsLookup() {
+  STLDeleteValues(&queries_);
+}
+
+void ChromeDnsLookup::LookupNaptr(const std::string &domain,
+                                  const NaptrCallback &callback) {
+  scoped_ptr<Query> query(new Query);
+  query->naptr_callback = callback;
+  if (StartQuery(domain, kTypeNAPTR, query.get())) {
+    ignore_result(query.release());
+    return;
+  }
+  base::MessageLoop::current()->PostTask(FROM_HERE,
+      base::Bind(callback, net::ERR_NAME_RESOLUTION_FAILED,
+          std::vector<SipResolver::NaptrRecord>(), base::TimeDelta()));
+}
+
+void ChromeDnsLookup::LookupSrv(const std::string &name,
+                                const SrvCallback &callback) {
+  scoped_ptr<Query> query(new Query);
+  query->srv_callback = callback;
+  if (StartQuery(name, net::dns_protocol::kTypeSRV, query.get())) {
+    ignore_result(query.release());
+    return;
+  }
+  base::MessageLoop::current()->PostTask(FROM_HERE,
+      base::Bind(callback, net::ERR_NAME_RESOLUTION_FAILED,
+          std::vector<SipResolver::SrvRecord>(), base::TimeDelta()));
+}
+
+bool ChromeDnsLookup::StartQuery(const std::string &name, uint16 qtype,
+                                 Query *query) {
+  net::DnsTransactionFactory *factory = dns_client_->GetTransactionFactory();
+  if (!factory) {
+    DVLOG(1) << "No DNS configuration to look up " << name;
+    return false;
+  }
+  query->transaction = factory->CreateTransaction(name, qtype,
+      base::Bind(&ChromeDnsLookup::OnTransactionComplete,
+          base::Unretained(this)),
+      net_log_);
+  queries_[query->transaction.get()] = query;
+  // Transactions always complete asynchronously.
+  query->transaction->Start();
+  return true;
+}
+
+void ChromeDnsLookup::OnTransactionComplete(
+    net::DnsTransaction *transaction,
+    int result,
+    const net::DnsResponse *response) {
+  QueriesMap::iterator i = queries_.find(transaction);
+  DCHECK(queries_.end() != i);
+  scoped_ptr<Query> query(i->second);
+  queries_.erase(i);
+
+  base::TimeDelta ttl;
+  if (!query->naptr_callback.is_null()) {
+    std::vector<SipResolver::NaptrRecord> records;
+    if (net::OK == result)
+      result = ParseNaptrRecords(response, &records, &ttl);
+    if (net::OK != result)
+      records.clear();
+    query->naptr_callback.Run(result, records, ttl);
+  } else {
+    std::vector<SipResolver::SrvRecord> records;
+    if (net::OK == result)
+      result = ParseSrvRecords(response, &records, &ttl);
+    if (net::OK != result)
+      records.clear();
+    query->srv_callback.Run(result, records, ttl);
+  }
+}
+
+} // End of sippet namespace
@@ -0,0 +1,67 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_CHROME_CHROME_DNS_LOOKUP_H_
+#define SIPPET_TRANSPORT_CHROME_CHROME_DNS_LOOKUP_H_
+
+#include <map>
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "net/log/net_log.h"
+#include "sippet/transport/sip_resolver.h"
+
+namespace net {
+class DnsClient;
+class DnsResponse;
+class DnsTransaction;
+}
+
+namespace sippet {
+
+// Queries the NAPTR and SRV records of a |SipResolver| through the
+// asynchronous DNS client of Chromium.
+class ChromeDnsLookup : public SipResolver::DnsLookup {
+ public:
+  // |dns_client| is not owned, and must outlive this object. Pending
+  // queries are cancelled on destruction.
+  ChromeDnsLookup(net::DnsClient *dns_client,
+                  const net::BoundNetLog &net_log);
+  ~ChromeDnsLookup() override;
+
+  // SipResolver::DnsLookup methods:
+  void LookupNaptr(const std::string &domain,
+                   const NaptrCallback &callback) override;
+  void LookupSrv(const std::string &name,
+                 const SrvCallback &callback) override;
+
+ private:
+  struct Query {
+    Query();
+    ~Query();
+
+    scoped_ptr<net::DnsTransaction> transaction;
+    NaptrCallback naptr_callback;
+    SrvCallback srv_callback;
+  };
+
+  typedef std::map<net::DnsTransaction*, Query*> QueriesMap;
+
+  // Returns false if there is no DNS configuration.
+  bool StartQuery(const std::string &name, uint16 qtype, Query *query);
+
+  void OnTransactionComplete(net::DnsTransaction *transaction,
+                             int result,
+                             const net::DnsResponse *response);
+
+  net::DnsClient *dns_client_;
+  net::BoundNetLog net_log_;
+  QueriesMap queries_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChromeDnsLookup);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TRANSPORT_CHROME_CHROME_DNS_LOOKUP_H_
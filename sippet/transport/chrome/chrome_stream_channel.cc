@@ -14,6 +14,7 @@
 #include "base/logging.h"
 #include "base/strings/string_number_conversions.h"
 #include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
 #include "net/base/net_errors.h"
 #include "net/http/http_network_session.h"
 #include "net/socket/client_socket_handle.h"
@@ -23,7 +24,10 @@
 #include "net/url_request/url_request_context.h"
 #include "net/url_request/url_request_context_getter.h"
 #include "net/ssl/ssl_cert_request_info.h"
+#include "sippet/base/tracing.h"
 #include "sippet/message/message.h"
+#include "sippet/transport/message_tracer.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -133,8 +137,22 @@ bool ChromeStreamChannel::is_stream() const {
   return true;
 }
 
+size_t ChromeStreamChannel::pending_writes() const {
+  return stream_writer_.get() ? stream_writer_->pending_messages() : 0;
+}
+
+size_t ChromeStreamChannel::buffered_bytes() const {
+  size_t bytes = 0;
+  if (stream_reader_.get())
+    bytes += stream_reader_->max_size();
+  if (stream_writer_.get())
+    bytes += stream_writer_->pending_bytes();
+  return bytes;
+}
+
 void ChromeStreamChannel::Connect() {
   DCHECK(!is_connecting_);
+  SIPPET_TRACE_ASYNC_BEGIN0("ChromeStreamChannel::Connect", this);
 
   tried_direct_connect_fallback_ = false;
 
@@ -162,6 +180,7 @@ void ChromeStreamChannel::Connect() {
 }
 
 int ChromeStreamChannel::ReconnectIgnoringLastError() {
+  SIPPET_TRACE_ASYNC_BEGIN0("ChromeStreamChannel::Connect", this);
   base::MessageLoop* message_loop = base::MessageLoop::current();
   CHECK(message_loop);
   message_loop->PostTask(
@@ -173,6 +192,7 @@ int ChromeStreamChannel::ReconnectIgnoringLastError() {
 
 int ChromeStreamChannel::ReconnectWithCertificate(
     net::X509Certificate* client_cert) {
+  SIPPET_TRACE_ASYNC_BEGIN0("ChromeStreamChannel::Connect", this);
   ssl_config_.send_client_cert = true;
   ssl_config_.client_cert = client_cert;
   network_session_->ssl_client_auth_cache()->Add(
@@ -188,9 +208,15 @@ int ChromeStreamChannel::ReconnectWithCertificate(
 
 int ChromeStreamChannel::Send(const scoped_refptr<Message> &message,
         const net::CompletionCallback& callback) {
+  SIPPET_TRACE_EVENT0("ChromeStreamChannel::Send");
   if (transport_.get() && transport_->socket()) {
     scoped_refptr<net::StringIOBuffer> string_buffer =
         new net::StringIOBuffer(message->ToString());
+    TransportMetrics::Get()->CountMessage(message);
+    if (MessageTracer::GetInstance()->ShouldTrace(message)) {
+      TraceMessage(message, string_buffer->data(),
+                   static_cast<size_t>(string_buffer->size()));
+    }
     return stream_writer_->Write(
         string_buffer.get(),
         string_buffer->size(),
@@ -216,6 +242,8 @@ void ChromeStreamChannel::DetachDelegate() {
 
 void ChromeStreamChannel::RunUserConnectCallback(int status) {
   DCHECK_LE(status, net::OK);
+  SIPPET_TRACE_ASYNC_END1("ChromeStreamChannel::Connect", this,
+                          "result", status);
   is_connecting_ = false;
   if (delegate_)
     delegate_->OnChannelConnected(this, status);
@@ -434,15 +462,33 @@ void ChromeStreamChannel::DoRead() {
 
 void ChromeStreamChannel::OnReadComplete(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
+  SIPPET_TRACE_EVENT0("ChromeStreamChannel::OnReadComplete");
   if (net::OK == result) {
     PostDoRead();
-    delegate_->OnIncomingMessage(this, stream_reader_->GetIncomingMessage());
+    scoped_refptr<Message> message(stream_reader_->GetIncomingMessage());
+    TransportMetrics::Get()->CountMessage(message);
+    if (MessageTracer::GetInstance()->ShouldTrace(message)) {
+      base::StringPiece data(stream_reader_->raw_message());
+      TraceMessage(message, data.data(), data.size());
+    }
+    delegate_->OnIncomingMessage(this, message);
   } else if (result < 0) {
     RunUserChannelClosed(result);
     // |this| may be deleted after this call.
   }
 }
 
+void ChromeStreamChannel::TraceMessage(const scoped_refptr<Message> &message,
+    const char *data, size_t size) {
+  net::IPEndPoint local;
+  net::IPEndPoint remote;
+  if (net::OK != transport_->socket()->GetLocalAddress(&local)
+      || net::OK != transport_->socket()->GetPeerAddress(&remote))
+    return;
+  MessageTracer::GetInstance()->Trace(message->direction(),
+      destination_.protocol(), local, remote, data, size);
+}
+
 void ChromeStreamChannel::StartTls() {
   DCHECK(is_connected());
   DCHECK(destination_.protocol().Equals(Protocol::TLS));
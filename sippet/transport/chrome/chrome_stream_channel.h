@@ -39,6 +39,8 @@ class ChromeStreamChannel : public Channel {
   bool is_secure() const override;
   bool is_connected() const override;
   bool is_stream() const override;
+  size_t pending_writes() const override;
+  size_t buffered_bytes() const override;
 
   void Connect() override;
   int ReconnectIgnoringLastError() override;
@@ -75,6 +77,10 @@ class ChromeStreamChannel : public Channel {
   void DoRead();
   void OnReadComplete(int result);
 
+  // Hands |message|, as |data| on the wire, to the |MessageTracer|.
+  void TraceMessage(const scoped_refptr<Message> &message,
+                    const char *data, size_t size);
+
   // TLS related functions
   void StartTls();
   void ProcessSSLConnectDone(int status);
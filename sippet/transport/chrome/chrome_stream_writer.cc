@@ -8,6 +8,7 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/socket/socket.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -28,6 +29,8 @@ ChromeStreamWriter::ChromeStreamWriter(
 }
 
 ChromeStreamWriter::~ChromeStreamWriter() {
+  TransportMetrics::Get()->pending_writes->Add(
+      -static_cast<int64>(pending_messages_.size()));
   STLDeleteElements(&pending_messages_);
 }
 
@@ -47,10 +50,18 @@ int ChromeStreamWriter::Write(
     }
   }
 
+  TransportMetrics::Get()->pending_writes->Increment();
   pending_messages_.push_back(new PendingBlock(io_buffer.get(), callback));
   return net::ERR_IO_PENDING;
 }
 
+size_t ChromeStreamWriter::pending_bytes() const {
+  size_t bytes = 0;
+  for (const PendingBlock *pending : pending_messages_)
+    bytes += pending->io_buffer_->size();
+  return bytes;
+}
+
 void ChromeStreamWriter::CloseWithError(int err) {
   error_ = err;
   while (!pending_messages_.empty())
@@ -91,6 +102,7 @@ void ChromeStreamWriter::DidConsume(int result) {
 }
 
 void ChromeStreamWriter::Pop(int result) {
+  TransportMetrics::Get()->pending_writes->Decrement();
   PendingBlock *pending = pending_messages_.front();
   pending->callback_.Run(result);
   delete pending;
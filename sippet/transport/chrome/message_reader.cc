@@ -11,11 +11,13 @@
 #include "net/base/io_buffer.h"
 #include "net/socket/stream_socket.h"
 #include "sippet/message/message.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
 MessageReader::MessageReader()
     : next_state_(STATE_NONE),
+      header_size_(0),
       io_callback_(base::Bind(&MessageReader::OnIOComplete,
           base::Unretained(this))) {
 }
@@ -26,6 +28,7 @@ MessageReader::~MessageReader() {
 int MessageReader::Read(const net::CompletionCallback& callback) {
   DCHECK_EQ(STATE_NONE, next_state_);
   callback_ = callback;
+  raw_message_.clear();
   next_state_ = STATE_RECEIVE_DATA;
   int rv = DoLoop(net::OK);
   if (rv == net::ERR_IO_PENDING)
@@ -137,10 +140,11 @@ int MessageReader::DoReadHeaders() {
     // Read more...
     return ReadMore();
   }
-  std::string header(data(), end + end_size);
-  DidConsume(static_cast<int>(end + end_size));
+  header_size_ = end + end_size;
+  std::string header(data(), header_size_);
   current_message_ = Message::Parse(header);
   if (!current_message_) {
+    TransportMetrics::Get()->parse_failures->Increment();
     // Close connection: bad protocol
     return net::ERR_INVALID_RESPONSE;  // XXX: what if it's a request?
   }
@@ -154,12 +158,12 @@ int MessageReader::DoReadHeadersComplete() {
   // If there's no Content-Length, then we accept as if the content is empty
   ContentLength *content_length = current_message_->get<ContentLength>();
   if (content_length && content_length->value() > 0) {
-    if (content_length->value() > max_size()) {
+    if (header_size_ + content_length->value() > max_size()) {
       // Close the connection immediately: the server is trying to send a
-      // too large content. Maximum size allowed is 64kb.
+      // too large message. Maximum size allowed is 64kb.
       VLOG(1) << "Trying to receive a too large message content: "
               << content_length->value()
-              << ", max = " << max_size();
+              << ", max = " << max_size() - header_size_;
       return net::ERR_MSG_TOO_BIG;
     }
     next_state_ = STATE_READ_BODY;
@@ -174,18 +178,22 @@ int MessageReader::DoReadHeadersComplete() {
 int MessageReader::DoReadBody() {
   ContentLength *content_length = current_message_->get<ContentLength>();
   DCHECK(content_length);
-  if (content_length->value() > static_cast<unsigned>(BytesRemaining())) {
+  if (header_size_ + content_length->value()
+      > static_cast<unsigned>(BytesRemaining())) {
     // Read more...
     return ReadMore();
   }
-  std::string content(data(), content_length->value());
-  DidConsume(content_length->value());
+  std::string content(data() + header_size_, content_length->value());
   current_message_->set_content(content);
   next_state_ = STATE_READ_BODY_COMPLETE;
   return net::OK;
 }
 
 int MessageReader::DoReadBodyComplete() {
+  size_t size = header_size_ + current_message_->content().size();
+  raw_message_.set(data(), size);
+  DidConsume(static_cast<int>(size));
+  header_size_ = 0;
   // This will make the callback to be called
   next_state_ = STATE_NONE;
   return net::OK;
@@ -6,6 +6,7 @@
 #define SIPPET_TRANSPORT_CHROME_MESSAGE_READER_H_
 
 #include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
 #include "net/base/completion_callback.h"
 
 namespace sippet {
@@ -20,6 +21,13 @@ class MessageReader {
   int Read(const net::CompletionCallback& callback);
   scoped_refptr<Message> GetIncomingMessage();
 
+  // The bytes of the last message read, as received, such as for tracing.
+  // They point into the read buffer, and so are only valid until the next
+  // |Read|.
+  base::StringPiece raw_message() const {
+    return raw_message_;
+  }
+
   bool is_idle() const {
     return next_state_ == STATE_NONE;
   }
@@ -74,6 +82,10 @@ class MessageReader {
 
   State next_state_;
   scoped_refptr<Message> current_message_;
+  // The headers of |current_message_| are consumed along with its body, so
+  // that the whole message stays in the buffer until read.
+  size_t header_size_;
+  base::StringPiece raw_message_;
   net::CompletionCallback callback_;
   net::CompletionCallback io_callback_;
 
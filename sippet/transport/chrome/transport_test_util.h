@@ -474,12 +474,14 @@ class MockTransactionFactory : public TransactionFactory {
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) override;
   ServerTransaction *CreateServerTransaction(
       const Method &method,
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) override;
  private:
   DataProvider *data_provider_;
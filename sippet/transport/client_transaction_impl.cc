@@ -7,6 +7,9 @@
 #include <string>
 
 #include "net/base/net_errors.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/base/tracing.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -14,17 +17,27 @@ ClientTransactionImpl::ClientTransactionImpl(
                           const std::string &id,
                           const scoped_refptr<Channel> &channel,
                           TransactionDelegate *delegate,
-                          TimeDeltaFactory *time_delta_factory)
+                          TimeDeltaFactory *time_delta_factory,
+                          TimerSource *timer_source)
   : weak_factory_(this),
     id_(id), channel_(channel), delegate_(delegate),
-    time_delta_factory_(time_delta_factory) {
+    retransmitted_(false),
+    time_delta_factory_(time_delta_factory),
+    timer_source_(timer_source) {
   DCHECK(id.length());
   DCHECK(channel);
   DCHECK(delegate);
   DCHECK(time_delta_factory);
+  DCHECK(timer_source);
+  timer_source_->Attach(&retryTimer_);
+  timer_source_->Attach(&timedOutTimer_);
+  timer_source_->Attach(&terminateTimer_);
+  TransportMetrics::Get()->client_transactions->Increment();
 }
 
-ClientTransactionImpl::~ClientTransactionImpl() {}
+ClientTransactionImpl::~ClientTransactionImpl() {
+  TransportMetrics::Get()->client_transactions->Decrement();
+}
 
 const std::string& ClientTransactionImpl::id() const {
   return id_;
@@ -39,14 +52,17 @@ void ClientTransactionImpl::Start(
   DCHECK(outgoing_request);
 
   initial_request_ = outgoing_request;
+  start_time_ = timer_source_->NowTicks();
   if (Method::INVITE == outgoing_request->method()) {
     mode_ = MODE_INVITE;
     next_state_ = STATE_CALLING;
-    time_delta_provider_.reset(time_delta_factory_->CreateClientInvite());
+    time_delta_provider_.reset(
+        time_delta_factory_->CreateClientInviteTo(channel_->destination()));
   } else {
     mode_ = MODE_NORMAL;
     next_state_ = STATE_TRYING;
-    time_delta_provider_.reset(time_delta_factory_->CreateClientNonInvite());
+    time_delta_provider_.reset(
+        time_delta_factory_->CreateClientNonInviteTo(channel_->destination()));
   }
 
   if (!channel_->is_stream())
@@ -58,10 +74,26 @@ void ClientTransactionImpl::HandleIncomingResponse(
       const scoped_refptr<Response> &response) {
   DCHECK(response);
   DCHECK(next_state_ != STATE_TERMINATED);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ClientTransaction::HandleIncomingResponse",
+                                initial_request_->GetTransactionTraceId());
 
   State state = next_state_;
   int response_code = response->response_code();
 
+  if ((STATE_TRYING == state || STATE_CALLING == state) && !retransmitted_) {
+    time_delta_factory_->OnRoundTripTime(channel_->destination(),
+        timer_source_->NowTicks() - start_time_);
+  }
+
+  TransportMetrics *metrics = TransportMetrics::Get();
+  if (STATE_COMPLETED == state) {
+    metrics->response_retransmissions_received->Increment();
+  } else if (response_code >= 200) {
+    (MODE_INVITE == mode_ ? metrics->client_invite_latency
+                          : metrics->client_non_invite_latency)
+        ->AddTime(timer_source_->NowTicks() - start_time_);
+  }
+
   switch (state) {
     case STATE_TRYING:
       switch (response_code/100) {
@@ -146,6 +178,15 @@ void ClientTransactionImpl::Close() {
   StopTimers();
 }
 
+size_t ClientTransactionImpl::EstimateMemoryUsage() const {
+  size_t bytes = sizeof(*this) + EstimateStringMemoryUsage(id_);
+  if (initial_request_.get())
+    bytes += initial_request_->EstimateMemoryUsage();
+  if (generated_ack_.get())
+    bytes += generated_ack_->EstimateMemoryUsage();
+  return bytes;
+}
+
 void ClientTransactionImpl::OnRetransmit() {
   DCHECK(!channel_->is_stream());
 
@@ -155,6 +196,10 @@ void ClientTransactionImpl::OnRetransmit() {
     DCHECK(STATE_TRYING == next_state_ || STATE_PROCEEDING == next_state_);
   }
 
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ClientTransaction::OnRetransmit",
+                                initial_request_->GetTransactionTraceId());
+  retransmitted_ = true;
+  TransportMetrics::Get()->request_retransmissions_sent->Increment();
   int result = channel_->Send(initial_request_,
     base::Bind(&ClientTransactionImpl::OnWrite, weak_factory_.GetWeakPtr()));
   if (net::ERR_IO_PENDING != result)
@@ -162,6 +207,8 @@ void ClientTransactionImpl::OnRetransmit() {
 }
 
 void ClientTransactionImpl::OnTimedOut() {
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ClientTransaction::OnTimedOut",
+                                initial_request_->GetTransactionTraceId());
   if (MODE_INVITE == mode_) {
     DCHECK(STATE_CALLING == next_state_);
   }
@@ -169,6 +216,9 @@ void ClientTransactionImpl::OnTimedOut() {
   State state = next_state_;
   next_state_ = STATE_TERMINATED;
   if (STATE_COMPLETED != state) {
+    TransportMetrics *metrics = TransportMetrics::Get();
+    (MODE_INVITE == mode_ ? metrics->timer_b_timeouts
+                          : metrics->timer_f_timeouts)->Increment();
     delegate_->OnTimedOut(initial_request_);
   }
   Terminate();
@@ -224,6 +274,8 @@ void ClientTransactionImpl::ScheduleTerminate() {
 }
 
 void ClientTransactionImpl::Terminate() {
+  SIPPET_TRACE_EVENT0("ClientTransaction::Terminate");
+  SIPPET_TRACE_FLOW_END(initial_request_->GetTransactionTraceId());
   delegate_->OnTransactionTerminated(id_);
 }
 
@@ -11,6 +11,7 @@
 #include "sippet/transport/transaction_delegate.h"
 #include "sippet/transport/time_delta_factory.h"
 #include "sippet/transport/time_delta_provider.h"
+#include "sippet/transport/timer_source.h"
 
 namespace sippet {
 
@@ -22,7 +23,8 @@ class ClientTransactionImpl : public ClientTransaction {
         const std::string &id,
         const scoped_refptr<Channel> &channel,
         TransactionDelegate *delegate,
-        TimeDeltaFactory *time_delta_factory);
+        TimeDeltaFactory *time_delta_factory,
+        TimerSource *timer_source);
 
   // ClientTransaction methods:
   const std::string& id() const override;
@@ -31,6 +33,7 @@ class ClientTransactionImpl : public ClientTransaction {
   void HandleIncomingResponse(
       const scoped_refptr<Response> &response) override;
   void Close() override;
+  size_t EstimateMemoryUsage() const override;
  private:
   friend class base::RefCountedThreadSafe<ClientTransactionImpl>;
   ~ClientTransactionImpl() override;
@@ -61,6 +64,9 @@ class ClientTransactionImpl : public ClientTransaction {
   base::OneShotTimer<ClientTransactionImpl> retryTimer_;
   base::OneShotTimer<ClientTransactionImpl> timedOutTimer_;
   base::OneShotTimer<ClientTransactionImpl> terminateTimer_;
+  // Used to measure the round-trip time to the first response.
+  base::TimeTicks start_time_;
+  bool retransmitted_;
 
   void OnRetransmit();
   void OnTimedOut();
@@ -76,6 +82,7 @@ class ClientTransactionImpl : public ClientTransaction {
 
   TimeDeltaFactory *time_delta_factory_;
   scoped_ptr<TimeDeltaProvider> time_delta_provider_;
+  TimerSource *timer_source_;
 
   base::WeakPtrFactory<ClientTransactionImpl> weak_factory_;
 };
@@ -0,0 +1,87 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/dns_lookup_mock.h"
+
+#include "base/bind.h"
+#include "net/base/net_errors.h"
+
+namespace sippet {
+
+DnsLookupMock::DnsLookupMock()
+  : ttl_(base::TimeDelta::FromSeconds(60)),
+    queries_(0) {
+}
+
+DnsLookupMock::~DnsLookupMock() {
+}
+
+void DnsLookupMock::AddNaptr(const std::string &domain,
+                             uint16 order,
+                             uint16 preference,
+                             const std::string &services,
+                             const std::string &replacement) {
+  SipResolver::NaptrRecord record;
+  record.order = order;
+  record.preference = preference;
+  record.flags = "s";
+  record.services = services;
+  record.replacement = replacement;
+  naptr_records_[domain].push_back(record);
+}
+
+void DnsLookupMock::AddSrv(const std::string &name,
+                           uint16 priority,
+                           uint16 weight,
+                           uint16 port,
+                           const std::string &target) {
+  srv_records_[name].push_back(
+      SipResolver::SrvRecord(priority, weight, port, target));
+}
+
+void DnsLookupMock::CompletePending() {
+  while (!pending_.empty()) {
+    base::Closure answer(pending_.front());
+    pending_.pop_front();
+    answer.Run();
+  }
+}
+
+void DnsLookupMock::LookupNaptr(const std::string &domain,
+                                const NaptrCallback &callback) {
+  ++queries_;
+  pending_.push_back(base::Bind(&DnsLookupMock::AnswerNaptr,
+      base::Unretained(this), domain, callback));
+}
+
+void DnsLookupMock::LookupSrv(const std::string &name,
+                              const SrvCallback &callback) {
+  ++queries_;
+  pending_.push_back(base::Bind(&DnsLookupMock::AnswerSrv,
+      base::Unretained(this), name, callback));
+}
+
+void DnsLookupMock::AnswerNaptr(const std::string &domain,
+                                const NaptrCallback &callback) {
+  NaptrMap::const_iterator i = naptr_records_.find(domain);
+  if (naptr_records_.end() == i) {
+    callback.Run(net::ERR_NAME_NOT_RESOLVED,
+                 std::vector<SipResolver::NaptrRecord>(), base::TimeDelta());
+    return;
+  }
+  callback.Run(net::OK, i->second, ttl_);
+}
+
+void DnsLookupMock::AnswerSrv(const std::string &name,
+                              const SrvCallback &callback) {
+  SrvMap::const_iterator i = srv_records_.find(name);
+  if (srv_records_.end() == i) {
+    callback.Run(net::ERR_NAME_NOT_RESOLVED,
+                 std::vector<SipResolver::SrvRecord>(), base::TimeDelta());
+    return;
+  }
+  callback.Run(net::OK, i->second, ttl_);
+}
+
+} // namespace sippet
@@ -0,0 +1,78 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_DNS_LOOKUP_MOCK_H_
+#define SIPPET_TRANSPORT_DNS_LOOKUP_MOCK_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "sippet/transport/sip_resolver.h"
+
+namespace sippet {
+
+// DnsLookupMock answers the queries of a |SipResolver| with the records
+// added in advance, instead of querying a DNS server. The answers wait for
+// |CompletePending|.
+class DnsLookupMock : public SipResolver::DnsLookup {
+ public:
+  DnsLookupMock();
+  ~DnsLookupMock() override;
+
+  void AddNaptr(const std::string &domain,
+                uint16 order,
+                uint16 preference,
+                const std::string &services,
+                const std::string &replacement);
+  void AddSrv(const std::string &name,
+              uint16 priority,
+              uint16 weight,
+              uint16 port,
+              const std::string &target);
+
+  // TTL of all answers. Defaults to 60 seconds.
+  void set_ttl(base::TimeDelta ttl) {
+    ttl_ = ttl;
+  }
+
+  // Answers the pending queries, and the ones they lead to.
+  void CompletePending();
+
+  // Number of queries received.
+  int queries() const {
+    return queries_;
+  }
+
+  // SipResolver::DnsLookup methods:
+  void LookupNaptr(const std::string &domain,
+                   const NaptrCallback &callback) override;
+  void LookupSrv(const std::string &name,
+                 const SrvCallback &callback) override;
+
+ private:
+  typedef std::map<std::string, std::vector<SipResolver::NaptrRecord> >
+      NaptrMap;
+  typedef std::map<std::string, std::vector<SipResolver::SrvRecord> >
+      SrvMap;
+
+  void AnswerNaptr(const std::string &domain,
+                   const NaptrCallback &callback);
+  void AnswerSrv(const std::string &name,
+                 const SrvCallback &callback);
+
+  NaptrMap naptr_records_;
+  SrvMap srv_records_;
+  base::TimeDelta ttl_;
+  int queries_;
+  std::deque<base::Closure> pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsLookupMock);
+};
+
+} // namespace sippet
+
+#endif  // SIPPET_TRANSPORT_DNS_LOOKUP_MOCK_H_
@@ -0,0 +1,505 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/message_tracer.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/hash.h"
+#include "base/lazy_instance.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/single_thread_task_runner.h"
+#include "base/sys_byteorder.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "net/base/ip_endpoint.h"
+
+namespace sippet {
+
+namespace {
+
+// Room for a burst of about a hundred large messages per thread.
+const int32 kRingBufferSize = 1024 * 1024;
+const int32 kEntryAlignment = 8;
+// Marks the end of the buffer as unused, when the next entry didn't fit.
+const uint32 kWrapMarker = 0xffffffff;
+
+// Messages larger than this wouldn't fit in an IP packet once headers are
+// added. The channels don't send or receive them either.
+const size_t kMaxTracedSize = 65000;
+
+const int kSamplingScale = 10000;
+const int kFlushIntervalMilliseconds = 100;
+
+const uint32 kPcapMagic = 0xa1b2c3d4;
+const uint32 kLinkTypeRaw = 101;
+const uint32 kSnapshotLength = 65535;
+
+const uint8 kIPProtocolTcp = 6;
+const uint8 kIPProtocolUdp = 17;
+const uint8 kTcpPshAck = 0x18;
+
+// HEP chunk types of the generic vendor.
+const uint16 kHepIPFamily = 1;
+const uint16 kHepIPProtocol = 2;
+const uint16 kHepIPv4Source = 3;
+const uint16 kHepIPv4Destination = 4;
+const uint16 kHepIPv6Source = 5;
+const uint16 kHepIPv6Destination = 6;
+const uint16 kHepSourcePort = 7;
+const uint16 kHepDestinationPort = 8;
+const uint16 kHepSeconds = 9;
+const uint16 kHepMicroseconds = 10;
+const uint16 kHepProtocolType = 11;
+const uint16 kHepPayload = 15;
+const uint8 kHepFamilyIPv4 = 2;
+const uint8 kHepFamilyIPv6 = 10;
+const uint8 kHepProtocolSip = 1;
+
+static base::LazyInstance<MessageTracer>::Leaky
+  g_message_tracer = LAZY_INSTANCE_INITIALIZER;
+
+void AppendUint8(uint8 value, std::string *output) {
+  output->push_back(static_cast<char>(value));
+}
+
+void AppendUint16(uint16 value, std::string *output) {
+  value = base::HostToNet16(value);
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendUint32(uint32 value, std::string *output) {
+  value = base::HostToNet32(value);
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// pcap headers are written in the byte order of the capturing machine.
+void AppendHostUint32(uint32 value, std::string *output) {
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendBytes(const uint8 *bytes, size_t size, std::string *output) {
+  output->append(reinterpret_cast<const char*>(bytes), size);
+}
+
+void AppendHepChunk(uint16 type, const char *value, size_t size,
+                    std::string *output) {
+  AppendUint16(0, output);
+  AppendUint16(type, output);
+  AppendUint16(static_cast<uint16>(6 + size), output);
+  output->append(value, size);
+}
+
+void AppendHepChunk(uint16 type, const std::string &value,
+                    std::string *output) {
+  AppendHepChunk(type, value.data(), value.size(), output);
+}
+
+uint16 IPv4Checksum(const std::string &header) {
+  uint32 sum = 0;
+  for (size_t i = 0; i + 1 < header.size(); i += 2) {
+    sum += (static_cast<uint8>(header[i]) << 8)
+        | static_cast<uint8>(header[i + 1]);
+  }
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return static_cast<uint16>(~sum);
+}
+
+}  // namespace
+
+struct MessageTracer::Record {
+  // Microseconds since the Unix epoch.
+  int64 time;
+  uint32 size;
+  uint8 ip_protocol;
+  // 4 for IPv4, 16 for IPv6.
+  uint8 address_size;
+  uint16 source_port;
+  uint16 destination_port;
+  uint8 source_address[16];
+  uint8 destination_address[16];
+  // Points to the message in the ring buffer, once read.
+  const char *data;
+};
+
+// A single-producer, single-consumer queue of records, written by a
+// network thread and read by the writer thread. Each entry is its size,
+// the record and the message, kept contiguous.
+class MessageTracer::RingBuffer {
+ public:
+  RingBuffer()
+    : buffer_(new char[kRingBufferSize]),
+      head_(0),
+      tail_(0),
+      read_end_(0) {}
+
+  // Returns false if there's no room for the record.
+  bool Write(const Record &record, const char *data) {
+    int32 entry_size = static_cast<int32>(
+        sizeof(uint32) + sizeof(Record) + record.size);
+    entry_size += (kEntryAlignment - entry_size % kEntryAlignment)
+        % kEntryAlignment;
+    int32 head = base::subtle::NoBarrier_Load(&head_);
+    int32 tail = base::subtle::Acquire_Load(&tail_);
+    int32 used = (head - tail + kRingBufferSize) % kRingBufferSize;
+    // An empty entry is left so that a full buffer isn't taken as empty.
+    int32 room = kRingBufferSize - used - kEntryAlignment;
+    int32 skipped = entry_size > kRingBufferSize - head
+        ? kRingBufferSize - head : 0;
+    if (entry_size + skipped > room)
+      return false;
+    if (skipped) {
+      memcpy(buffer_.get() + head, &kWrapMarker, sizeof(kWrapMarker));
+      head = 0;
+    }
+    char *entry = buffer_.get() + head;
+    uint32 size = static_cast<uint32>(entry_size);
+    memcpy(entry, &size, sizeof(size));
+    memcpy(entry + sizeof(size), &record, sizeof(record));
+    memcpy(entry + sizeof(size) + sizeof(record), data, record.size);
+    base::subtle::Release_Store(&head_,
+        (head + entry_size) % kRingBufferSize);
+    return true;
+  }
+
+  // Appends the records written so far to |records|. Their messages are
+  // left in the buffer until |Release| is called.
+  void Read(std::vector<Record> *records) {
+    int32 tail = base::subtle::NoBarrier_Load(&tail_);
+    int32 head = base::subtle::Acquire_Load(&head_);
+    while (tail != head) {
+      uint32 size;
+      memcpy(&size, buffer_.get() + tail, sizeof(size));
+      if (kWrapMarker == size) {
+        tail = 0;
+        continue;
+      }
+      Record record;
+      memcpy(&record, buffer_.get() + tail + sizeof(size), sizeof(record));
+      record.data = buffer_.get() + tail + sizeof(size) + sizeof(record);
+      records->push_back(record);
+      tail = (tail + static_cast<int32>(size)) % kRingBufferSize;
+    }
+    read_end_ = tail;
+  }
+
+  // Frees the room of the records last read.
+  void Release() {
+    base::subtle::Release_Store(&tail_, read_end_);
+  }
+
+ private:
+  scoped_ptr<char[]> buffer_;
+  // Written by the producer only.
+  base::subtle::Atomic32 head_;
+  // Written by the consumer only.
+  base::subtle::Atomic32 tail_;
+  int32 read_end_;
+
+  DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
+
+MessageTracer::MessageTracer()
+  : sampling_threshold_(0),
+    dropped_messages_(0),
+    format_(FORMAT_PCAP) {
+}
+
+MessageTracer::~MessageTracer() {
+  Stop();
+}
+
+MessageTracer *MessageTracer::GetInstance() {
+  return g_message_tracer.Pointer();
+}
+
+bool MessageTracer::Start(const base::FilePath &path, Format format,
+                          double sampling_rate) {
+  DCHECK(sampling_rate > 0 && sampling_rate <= 1);
+  if (writer_thread_)
+    return false;
+
+  base::File file(path, base::File::FLAG_CREATE_ALWAYS
+                        | base::File::FLAG_WRITE);
+  if (!file.IsValid()) {
+    LOG(ERROR) << "Unable to create " << path.value() << ": "
+               << base::File::ErrorToString(file.error_details());
+    return false;
+  }
+  if (FORMAT_PCAP == format) {
+    std::string header;
+    AppendHostUint32(kPcapMagic, &header);
+    AppendHostUint32(0x00040002, &header);  // Version 2.4
+    AppendHostUint32(0, &header);
+    AppendHostUint32(0, &header);
+    AppendHostUint32(kSnapshotLength, &header);
+    AppendHostUint32(kLinkTypeRaw, &header);
+    if (file.WriteAtCurrentPos(header.data(), static_cast<int>(header.size()))
+        != static_cast<int>(header.size()))
+      return false;
+  }
+
+  // Forget what was traced after the last stop.
+  {
+    base::AutoLock lock(lock_);
+    for (RingBuffer *ring_buffer : ring_buffers_) {
+      std::vector<Record> records;
+      ring_buffer->Read(&records);
+      ring_buffer->Release();
+    }
+  }
+
+  file_ = file.Pass();
+  format_ = format;
+  tcp_sequences_.clear();
+  writer_thread_.reset(new base::Thread("MessageTracer"));
+  if (!writer_thread_->Start()) {
+    writer_thread_.reset();
+    file_.Close();
+    return false;
+  }
+  writer_thread_->task_runner()->PostDelayedTask(FROM_HERE,
+      base::Bind(&MessageTracer::FlushPeriodically, base::Unretained(this)),
+      base::TimeDelta::FromMilliseconds(kFlushIntervalMilliseconds));
+
+  int threshold = std::max(1,
+      static_cast<int>(sampling_rate * kSamplingScale));
+  base::subtle::Release_Store(&sampling_threshold_, threshold);
+  return true;
+}
+
+void MessageTracer::Stop() {
+  if (!writer_thread_)
+    return;
+  base::subtle::NoBarrier_Store(&sampling_threshold_, 0);
+  writer_thread_->task_runner()->PostTask(FROM_HERE,
+      base::Bind(&MessageTracer::Close, base::Unretained(this)));
+  // Runs the task above before joining the thread.
+  writer_thread_.reset();
+}
+
+bool MessageTracer::ShouldTrace(const scoped_refptr<Message> &message) const {
+  int threshold = base::subtle::NoBarrier_Load(&sampling_threshold_);
+  if (0 == threshold)
+    return false;
+  if (threshold >= kSamplingScale)
+    return true;
+  const Message *source = message.get();
+  const CallId *call_id = source->get<CallId>();
+  if (!call_id)
+    return false;
+  return static_cast<int>(base::Hash(call_id->value()) % kSamplingScale)
+      < threshold;
+}
+
+void MessageTracer::Trace(Message::Direction direction,
+                          const Protocol &protocol,
+                          const net::IPEndPoint &local,
+                          const net::IPEndPoint &remote,
+                          const char *data, size_t size) {
+  if (!IsEnabled())
+    return;
+  const net::IPEndPoint &source =
+      Message::Outgoing == direction ? local : remote;
+  const net::IPEndPoint &destination =
+      Message::Outgoing == direction ? remote : local;
+  size_t address_size = source.address().size();
+  if (size > kMaxTracedSize
+      || (4 != address_size && 16 != address_size)
+      || address_size != destination.address().size()) {
+    base::subtle::NoBarrier_AtomicIncrement(&dropped_messages_, 1);
+    return;
+  }
+
+  Record record;
+  memset(&record, 0, sizeof(record));
+  record.time = (base::Time::Now() - base::Time::UnixEpoch())
+      .InMicroseconds();
+  record.size = static_cast<uint32>(size);
+  record.ip_protocol = protocol.Equals(Protocol::UDP)
+      ? kIPProtocolUdp : kIPProtocolTcp;
+  record.address_size = static_cast<uint8>(address_size);
+  record.source_port = source.port();
+  record.destination_port = destination.port();
+  memcpy(record.source_address, &source.address()[0], address_size);
+  memcpy(record.destination_address, &destination.address()[0],
+         address_size);
+  if (!GetRingBuffer()->Write(record, data))
+    base::subtle::NoBarrier_AtomicIncrement(&dropped_messages_, 1);
+}
+
+MessageTracer::RingBuffer *MessageTracer::GetRingBuffer() {
+  RingBuffer *ring_buffer = ring_buffer_.Get();
+  if (!ring_buffer) {
+    ring_buffer = new RingBuffer;
+    ring_buffer_.Set(ring_buffer);
+    base::AutoLock lock(lock_);
+    ring_buffers_.push_back(ring_buffer);
+  }
+  return ring_buffer;
+}
+
+bool MessageTracer::IsRecordEarlier(const Record &a, const Record &b) {
+  return a.time < b.time;
+}
+
+void MessageTracer::Flush() {
+  if (!file_.IsValid())
+    return;
+
+  std::vector<RingBuffer*> ring_buffers;
+  {
+    base::AutoLock lock(lock_);
+    ring_buffers.assign(ring_buffers_.begin(), ring_buffers_.end());
+  }
+  std::vector<Record> records;
+  for (RingBuffer *ring_buffer : ring_buffers)
+    ring_buffer->Read(&records);
+  // Each buffer is in order, but threads are interleaved.
+  std::stable_sort(records.begin(), records.end(), IsRecordEarlier);
+
+  std::string output;
+  for (const Record &record : records) {
+    if (FORMAT_PCAP == format_)
+      AppendPcapRecord(record, &output);
+    else
+      AppendHepRecord(record, &output);
+  }
+  for (RingBuffer *ring_buffer : ring_buffers)
+    ring_buffer->Release();
+
+  int size = static_cast<int>(output.size());
+  if (size > 0 && file_.WriteAtCurrentPos(output.data(), size) != size) {
+    LOG(ERROR) << "Unable to write the message trace, stopped";
+    file_.Close();
+  }
+}
+
+void MessageTracer::FlushPeriodically() {
+  Flush();
+  if (!file_.IsValid())
+    return;
+  base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(FROM_HERE,
+      base::Bind(&MessageTracer::FlushPeriodically, base::Unretained(this)),
+      base::TimeDelta::FromMilliseconds(kFlushIntervalMilliseconds));
+}
+
+void MessageTracer::Close() {
+  Flush();
+  file_.Close();
+}
+
+void MessageTracer::AppendPcapRecord(const Record &record,
+                                     std::string *output) {
+  std::string transport_header;
+  AppendUint16(record.source_port, &transport_header);
+  AppendUint16(record.destination_port, &transport_header);
+  if (kIPProtocolUdp == record.ip_protocol) {
+    AppendUint16(static_cast<uint16>(8 + record.size), &transport_header);
+    AppendUint16(0, &transport_header);  // No checksum
+  } else {
+    std::string stream;
+    AppendBytes(record.source_address, record.address_size, &stream);
+    AppendBytes(record.destination_address, record.address_size, &stream);
+    stream.append(reinterpret_cast<const char*>(&record.source_port),
+                  sizeof(record.source_port));
+    stream.append(reinterpret_cast<const char*>(&record.destination_port),
+                  sizeof(record.destination_port));
+    std::map<std::string, uint32>::iterator i =
+        tcp_sequences_.insert(std::make_pair(stream, 1)).first;
+    AppendUint32(i->second, &transport_header);
+    i->second += record.size;
+    AppendUint32(0, &transport_header);
+    AppendUint8(0x50, &transport_header);  // 20 bytes, no options
+    AppendUint8(kTcpPshAck, &transport_header);
+    AppendUint16(65535, &transport_header);
+    AppendUint16(0, &transport_header);  // Checksum, left unset
+    AppendUint16(0, &transport_header);
+  }
+
+  std::string ip_header;
+  size_t ip_payload_size = transport_header.size() + record.size;
+  if (4 == record.address_size) {
+    AppendUint8(0x45, &ip_header);
+    AppendUint8(0, &ip_header);
+    AppendUint16(static_cast<uint16>(20 + ip_payload_size), &ip_header);
+    AppendUint16(0, &ip_header);
+    AppendUint16(0x4000, &ip_header);  // Don't fragment
+    AppendUint8(64, &ip_header);
+    AppendUint8(record.ip_protocol, &ip_header);
+    AppendUint16(0, &ip_header);
+    AppendBytes(record.source_address, 4, &ip_header);
+    AppendBytes(record.destination_address, 4, &ip_header);
+    uint16 checksum = base::HostToNet16(IPv4Checksum(ip_header));
+    memcpy(&ip_header[10], &checksum, sizeof(checksum));
+  } else {
+    AppendUint32(0x60000000, &ip_header);
+    AppendUint16(static_cast<uint16>(ip_payload_size), &ip_header);
+    AppendUint8(record.ip_protocol, &ip_header);
+    AppendUint8(64, &ip_header);
+    AppendBytes(record.source_address, 16, &ip_header);
+    AppendBytes(record.destination_address, 16, &ip_header);
+  }
+
+  uint32 packet_size = static_cast<uint32>(ip_header.size() + ip_payload_size);
+  AppendHostUint32(static_cast<uint32>(
+      record.time / base::Time::kMicrosecondsPerSecond), output);
+  AppendHostUint32(static_cast<uint32>(
+      record.time % base::Time::kMicrosecondsPerSecond), output);
+  AppendHostUint32(packet_size, output);
+  AppendHostUint32(packet_size, output);
+  output->append(ip_header);
+  output->append(transport_header);
+  output->append(record.data, record.size);
+}
+
+void MessageTracer::AppendHepRecord(const Record &record,
+                                    std::string *output) {
+  std::string chunks;
+  std::string value;
+  AppendUint8(4 == record.address_size ? kHepFamilyIPv4 : kHepFamilyIPv6,
+              &value);
+  AppendHepChunk(kHepIPFamily, value, &chunks);
+  value.clear();
+  AppendUint8(record.ip_protocol, &value);
+  AppendHepChunk(kHepIPProtocol, value, &chunks);
+  AppendHepChunk(4 == record.address_size ? kHepIPv4Source : kHepIPv6Source,
+                 reinterpret_cast<const char*>(record.source_address),
+                 record.address_size, &chunks);
+  AppendHepChunk(4 == record.address_size ? kHepIPv4Destination
+                                          : kHepIPv6Destination,
+                 reinterpret_cast<const char*>(record.destination_address),
+                 record.address_size, &chunks);
+  value.clear();
+  AppendUint16(record.source_port, &value);
+  AppendHepChunk(kHepSourcePort, value, &chunks);
+  value.clear();
+  AppendUint16(record.destination_port, &value);
+  AppendHepChunk(kHepDestinationPort, value, &chunks);
+  value.clear();
+  AppendUint32(static_cast<uint32>(
+      record.time / base::Time::kMicrosecondsPerSecond), &value);
+  AppendHepChunk(kHepSeconds, value, &chunks);
+  value.clear();
+  AppendUint32(static_cast<uint32>(
+      record.time % base::Time::kMicrosecondsPerSecond), &value);
+  AppendHepChunk(kHepMicroseconds, value, &chunks);
+  value.clear();
+  AppendUint8(kHepProtocolSip, &value);
+  AppendHepChunk(kHepProtocolType, value, &chunks);
+  AppendHepChunk(kHepPayload, record.data, record.size, &chunks);
+
+  output->append("HEP3");
+  AppendUint16(static_cast<uint16>(6 + chunks.size()), output);
+  output->append(chunks);
+}
+
+} // namespace sippet
@@ -0,0 +1,131 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_MESSAGE_TRACER_H_
+#define SIPPET_TRANSPORT_MESSAGE_TRACER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/files/file.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local.h"
+#include "sippet/message/message.h"
+#include "sippet/message/protocol.h"
+
+namespace base {
+class FilePath;
+class Thread;
+}
+
+namespace net {
+class IPEndPoint;
+}
+
+namespace sippet {
+
+// MessageTracer records the messages sent and received by the channels, as
+// they are on the wire, and writes them to a pcap or HEP (Homer) file.
+//
+// Tracing costs little to the network threads: each of them copies the
+// traced messages into a ring buffer of its own, without locking, and a
+// background thread empties the buffers into the file. Messages that don't
+// fit in a full buffer are dropped, rather than waited for. When tracing is
+// disabled, the only cost is an atomic load per message.
+//
+// Buffers take 1 MiB each, and are never freed: the writer thread may be
+// reading one when its thread exits. Only the network threads trace, which
+// are few and last as long as the stack, so this is bounded by 1 MiB per
+// network thread that ever traced.
+//
+// A sampling rate allows tracing a fraction of the calls on busy servers.
+// Calls are picked by their Call-ID, so that all the messages of a traced
+// call are traced.
+class MessageTracer {
+ public:
+  enum Format {
+    // pcap, with synthesized IP, UDP and TCP headers.
+    FORMAT_PCAP,
+    // Concatenated HEPv3 packets.
+    FORMAT_HEP,
+  };
+
+  MessageTracer();
+  ~MessageTracer();
+
+  // The tracer the channels use.
+  static MessageTracer *GetInstance();
+
+  // Starts tracing to the file at |path|, replacing it, with messages of
+  // a |sampling_rate| fraction of the calls, from 0 to 1. Returns false if
+  // the file can't be created, or if tracing is started already.
+  bool Start(const base::FilePath &path, Format format,
+             double sampling_rate);
+
+  // Stops tracing, after writing the messages traced so far.
+  void Stop();
+
+  bool IsEnabled() const {
+    return 0 != base::subtle::NoBarrier_Load(&sampling_threshold_);
+  }
+
+  // Whether |message| belongs to a traced call.
+  bool ShouldTrace(const scoped_refptr<Message> &message) const;
+
+  // Traces a message sent or received by a channel connected from |local|
+  // to |remote|. Can be called from any thread.
+  void Trace(Message::Direction direction, const Protocol &protocol,
+             const net::IPEndPoint &local, const net::IPEndPoint &remote,
+             const char *data, size_t size);
+
+  // Number of messages dropped for lack of room in the buffers.
+  int dropped_messages() const {
+    return base::subtle::NoBarrier_Load(&dropped_messages_);
+  }
+
+ private:
+  class RingBuffer;
+  struct Record;
+
+  RingBuffer *GetRingBuffer();
+
+  static bool IsRecordEarlier(const Record &a, const Record &b);
+
+  // Runs on the writer thread.
+  void Flush();
+  void FlushPeriodically();
+  void Close();
+  void AppendPcapRecord(const Record &record, std::string *output);
+  void AppendHepRecord(const Record &record, std::string *output);
+
+  // The fraction of calls traced, in units of 1/kSamplingScale. Zero when
+  // tracing is disabled.
+  base::subtle::Atomic32 sampling_threshold_;
+  base::subtle::Atomic32 dropped_messages_;
+
+  base::ThreadLocalPointer<RingBuffer> ring_buffer_;
+
+  // Guards |ring_buffers_|, which grows by one buffer per thread tracing,
+  // and never shrinks.
+  base::Lock lock_;
+  ScopedVector<RingBuffer> ring_buffers_;
+
+  // Used by the writer thread only, while tracing.
+  scoped_ptr<base::Thread> writer_thread_;
+  base::File file_;
+  Format format_;
+  // The next TCP sequence number of each stream, by source and destination.
+  std::map<std::string, uint32> tcp_sequences_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageTracer);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TRANSPORT_MESSAGE_TRACER_H_
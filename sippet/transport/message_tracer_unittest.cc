@@ -0,0 +1,149 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/message_tracer.h"
+
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/stringprintf.h"
+#include "net/base/ip_address_number.h"
+#include "net/base/ip_endpoint.h"
+#include "sippet/test/replay/capture_reader.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kRequest[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK776asdhds\r\n"
+  "Call-ID: a84b4c76e66710\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+const char kResponse[] =
+  "SIP/2.0 180 Ringing\r\n"
+  "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK776asdhds\r\n"
+  "Call-ID: a84b4c76e66710\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+net::IPEndPoint CreateEndPoint(const char *address, uint16 port) {
+  net::IPAddressNumber number;
+  EXPECT_TRUE(net::ParseIPLiteralToNumber(address, &number));
+  return net::IPEndPoint(number, port);
+}
+
+class MessageTracerTest : public testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("trace");
+  }
+
+  void TraceCall(const Protocol &protocol, const net::IPEndPoint &local,
+                 const net::IPEndPoint &remote) {
+    tracer_.Trace(Message::Outgoing, protocol, local, remote,
+                  kRequest, sizeof(kRequest) - 1);
+    tracer_.Trace(Message::Incoming, protocol, local, remote,
+                  kResponse, sizeof(kResponse) - 1);
+  }
+
+  void ExpectCall(const std::string &local, const std::string &remote) {
+    CapturedMessage message;
+    ASSERT_TRUE(reader_.ReadNext(&message));
+    EXPECT_EQ(kRequest, message.data);
+    EXPECT_EQ(local, message.source.ToString());
+    EXPECT_EQ(remote, message.destination.ToString());
+    ASSERT_TRUE(reader_.ReadNext(&message));
+    EXPECT_EQ(kResponse, message.data);
+    EXPECT_EQ(remote, message.source.ToString());
+    EXPECT_EQ(local, message.destination.ToString());
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  MessageTracer tracer_;
+  CaptureReader reader_;
+};
+
+}  // namespace
+
+TEST_F(MessageTracerTest, Disabled) {
+  scoped_refptr<Message> request(Message::Parse(kRequest));
+  ASSERT_TRUE(request);
+  EXPECT_FALSE(tracer_.IsEnabled());
+  EXPECT_FALSE(tracer_.ShouldTrace(request));
+}
+
+TEST_F(MessageTracerTest, Pcap) {
+  ASSERT_TRUE(tracer_.Start(path_, MessageTracer::FORMAT_PCAP, 1));
+  EXPECT_FALSE(tracer_.Start(path_, MessageTracer::FORMAT_PCAP, 1));
+  TraceCall(Protocol::UDP, CreateEndPoint("192.0.2.1", 5060),
+            CreateEndPoint("192.0.2.2", 5060));
+  TraceCall(Protocol::TCP, CreateEndPoint("2001:db8::1", 40000),
+            CreateEndPoint("2001:db8::2", 5060));
+  tracer_.Stop();
+  EXPECT_FALSE(tracer_.IsEnabled());
+
+  ASSERT_TRUE(reader_.Open(path_));
+  EXPECT_EQ(CaptureReader::FORMAT_PCAP, reader_.format());
+  ExpectCall("192.0.2.1:5060", "192.0.2.2:5060");
+  ExpectCall("[2001:db8::1]:40000", "[2001:db8::2]:5060");
+  CapturedMessage message;
+  EXPECT_FALSE(reader_.ReadNext(&message));
+  EXPECT_EQ(0, reader_.packets_skipped());
+  EXPECT_EQ(0, tracer_.dropped_messages());
+}
+
+TEST_F(MessageTracerTest, Hep) {
+  ASSERT_TRUE(tracer_.Start(path_, MessageTracer::FORMAT_HEP, 1));
+  TraceCall(Protocol::TLS, CreateEndPoint("192.0.2.1", 40000),
+            CreateEndPoint("192.0.2.2", 5061));
+  tracer_.Stop();
+
+  ASSERT_TRUE(reader_.Open(path_));
+  EXPECT_EQ(CaptureReader::FORMAT_HEP, reader_.format());
+  ExpectCall("192.0.2.1:40000", "192.0.2.2:5061");
+  CapturedMessage message;
+  EXPECT_FALSE(reader_.ReadNext(&message));
+}
+
+TEST_F(MessageTracerTest, NothingTracedWhenStopped) {
+  ASSERT_TRUE(tracer_.Start(path_, MessageTracer::FORMAT_PCAP, 1));
+  tracer_.Stop();
+  TraceCall(Protocol::UDP, CreateEndPoint("192.0.2.1", 5060),
+            CreateEndPoint("192.0.2.2", 5060));
+  ASSERT_TRUE(tracer_.Start(path_, MessageTracer::FORMAT_PCAP, 1));
+  tracer_.Stop();
+
+  ASSERT_TRUE(reader_.Open(path_));
+  CapturedMessage message;
+  EXPECT_FALSE(reader_.ReadNext(&message));
+}
+
+TEST_F(MessageTracerTest, SamplesCalls) {
+  ASSERT_TRUE(tracer_.Start(path_, MessageTracer::FORMAT_PCAP, 0.5));
+  int traced = 0;
+  for (int i = 0; i < 100; ++i) {
+    std::string call_id(base::StringPrintf("Call-ID: %d@192.0.2.1\r\n", i));
+    scoped_refptr<Message> request(Message::Parse(
+        "OPTIONS sip:192.0.2.2 SIP/2.0\r\n" + call_id + "\r\n"));
+    scoped_refptr<Message> response(Message::Parse(
+        "SIP/2.0 200 OK\r\n" + call_id + "\r\n"));
+    ASSERT_TRUE(request);
+    ASSERT_TRUE(response);
+    // All the messages of a call are traced, or none.
+    EXPECT_EQ(tracer_.ShouldTrace(request), tracer_.ShouldTrace(response));
+    if (tracer_.ShouldTrace(request))
+      ++traced;
+  }
+  EXPECT_LT(20, traced);
+  EXPECT_GT(80, traced);
+  tracer_.Stop();
+}
+
+} // namespace sippet
@@ -5,13 +5,17 @@
 #include "sippet/transport/network_layer.h"
 
 #include <string>
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include "base/stl_util.h"
 #include "base/strings/string_util.h"
 #include "net/base/net_errors.h"
 #include "net/cert/x509_certificate.h"
+#include "sippet/base/memory_usage.h"
 #include "sippet/base/tags.h"
+#include "sippet/base/tracing.h"
 #include "sippet/uri/uri.h"
 #include "sippet/message/headers/via.h"
 #include "sippet/message/headers/cseq.h"
@@ -19,12 +23,29 @@
 #include "sippet/transport/channel_factory.h"
 #include "sippet/transport/transaction_factory.h"
 #include "sippet/transport/time_delta_factory.h"
+#include "sippet/transport/time_delta_provider.h"
+#include "sippet/transport/transport_metrics.h"
 #include "sippet/transport/ssl_cert_error_transaction.h"
 
 namespace sippet {
 
+namespace {
+
+// New requests are the ones subject to overload control: requests within
+// dialogs, ACKs and CANCELs complete work already accepted.
+bool IsOutOfDialogRequest(const scoped_refptr<Request> &request) {
+  if (Method::ACK == request->method() || Method::CANCEL == request->method())
+    return false;
+  const Request *source = request.get();
+  const To *to = source->get<To>();
+  return !to || !to->HasTag();
+}
+
+}  // namespace
+
 NetworkLayer::ChannelContext::ChannelContext()
-  : refs_(0) {
+  : refs_(0),
+    initial_stateless_(false) {
 }
 
 NetworkLayer::ChannelContext::ChannelContext(
@@ -32,12 +53,21 @@ NetworkLayer::ChannelContext::ChannelContext(
     const scoped_refptr<Request> &initial_request,
     const net::CompletionCallback& initial_callback)
   : channel_(channel), refs_(0), initial_request_(initial_request),
-    initial_callback_(initial_callback) {
+    initial_callback_(initial_callback), initial_stateless_(false) {
 }
 
 NetworkLayer::ChannelContext::~ChannelContext() {
 }
 
+NetworkLayer::Resolution::Resolution()
+  : next_target(0),
+    stamped_via(false),
+    failing_over(false) {
+}
+
+NetworkLayer::Resolution::~Resolution() {
+}
+
 NetworkLayer::NetworkLayer(Delegate *delegate,
                            const NetworkSettings &network_settings)
   : delegate_(delegate),
@@ -46,6 +76,18 @@ NetworkLayer::NetworkLayer(Delegate *delegate,
     ssl_cert_error_handler_factory_(
         network_settings.ssl_cert_error_handler_factory()) {
   DCHECK(delegate);
+  // Stateless requests time out as non-INVITE client transactions would.
+  scoped_ptr<TimeDeltaProvider> time_delta_provider(
+      network_settings_.time_delta_factory()->CreateClientNonInvite());
+  stateless_timeout_ = time_delta_provider->GetTimeoutDelay();
+  network_settings_.timer_source()->Attach(&stateless_timer_);
+  network_settings_.timer_source()->Attach(&overload_timer_);
+  if (network_settings_.enable_overload_control()) {
+    overload_control_.reset(new OverloadControl(network_settings_));
+    last_overload_sample_ = network_settings_.timer_source()->NowTicks();
+    overload_timer_.Start(FROM_HERE, OverloadControl::GetSampleInterval(),
+        this, &NetworkLayer::OnOverloadSample);
+  }
 }
 
 NetworkLayer::~NetworkLayer() {
@@ -54,6 +96,7 @@ NetworkLayer::~NetworkLayer() {
   while (!channels_.empty()) {
     DestroyChannelContext(channels_.begin()->second);
   }
+  STLDeleteValues(&resolutions_);
 }
 
 void NetworkLayer::RegisterChannelFactory(const Protocol &protocol,
@@ -130,7 +173,6 @@ int NetworkLayer::GetOriginOf(const EndPoint& destination, EndPoint *origin) {
 int NetworkLayer::Send(const scoped_refptr<Message> &message,
                        const net::CompletionCallback& callback) {
   DCHECK(thread_checker_.CalledOnValidThread());
-  LOG(INFO) << message->ToString();
   if (Message::Outgoing != message->direction()) {
     DVLOG(1) << "Trying to send an incoming message";
     return net::ERR_UNEXPECTED;
@@ -144,6 +186,36 @@ int NetworkLayer::Send(const scoped_refptr<Message> &message,
   }
 }
 
+int NetworkLayer::SendStateless(const scoped_refptr<Message> &message,
+                                const net::CompletionCallback& callback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (Message::Outgoing != message->direction()) {
+    DVLOG(1) << "Trying to send an incoming message";
+    return net::ERR_UNEXPECTED;
+  }
+  EndPoint destination(GetMessageEndPoint(message));
+  if (destination.IsEmpty()) {
+    DVLOG(1) << "Impossible to route the message";
+    return net::ERR_INVALID_ARGUMENT;
+  }
+  ChannelContext *channel_context = GetChannelContext(destination);
+  if (channel_context) {
+    return SendStatelessUsingChannelContext(message, channel_context,
+                                            callback);
+  }
+  if (isa<Response>(message)) {
+    DVLOG(1) << "No channel can send the message";
+    return net::ERR_SOCKET_NOT_CONNECTED;
+  }
+  int result = CreateChannelContext(
+    destination, dyn_cast<Request>(message), callback, &channel_context);
+  if (result != net::OK)
+    return result;
+  channel_context->initial_stateless_ = true;
+  channel_context->channel_->Connect();
+  return net::ERR_IO_PENDING;
+}
+
 bool NetworkLayer::AddAlias(const EndPoint &destination,
     const EndPoint &alias) {
   DCHECK(thread_checker_.CalledOnValidThread());
@@ -155,12 +227,42 @@ bool NetworkLayer::AddAlias(const EndPoint &destination,
 
 int NetworkLayer::SendRequest(scoped_refptr<Request> &request,
     const net::CompletionCallback& callback) {
-  EndPoint destination(GetMessageEndPoint(request));
+  if (Method::CANCEL == request->method()) {
+    // A CANCEL goes where its INVITE went (RFC 3261 section 9.1), which may
+    // be a target the resolution failed over to.
+    scoped_refptr<ClientTransaction> invite_transaction(
+        GetInviteClientTransaction(request));
+    if (invite_transaction) {
+      return SendRequestTo(request,
+          invite_transaction->channel()->destination(), callback);
+    }
+  }
+  if (network_settings_.sip_resolver() && !request->stateless()
+      && Method::ACK != request->method()
+      && Method::CANCEL != request->method())
+    return ResolveRequest(request, callback);
+  return SendRequestTo(request, GetMessageEndPoint(request), callback);
+}
+
+int NetworkLayer::SendRequestTo(scoped_refptr<Request> &request,
+    const EndPoint &destination,
+    const net::CompletionCallback& callback) {
   if (destination.IsEmpty()) {
     DVLOG(1) << "invalid Request-URI";
     return net::ERR_INVALID_ARGUMENT;
   }
-  LOG(INFO) << "Sent to " << destination.ToString();
+  if (request->stateless() && Method::INVITE == request->method()) {
+    // Without a transaction, there would be nobody to ACK the responses.
+    DVLOG(1) << "INVITE requests can't be sent statelessly";
+    return net::ERR_INVALID_ARGUMENT;
+  }
+  if (overload_control_ && IsOutOfDialogRequest(request)
+      && overload_control_->ShouldThrottle(destination)) {
+    DVLOG(1) << "Request throttled, " << destination.ToString()
+             << " is overloaded";
+    return net::ERR_INSUFFICIENT_RESOURCES;
+  }
+  DVLOG(1) << "Sending to " << destination.ToString();
 
   // Add a User-Agent header if there's none
   if (!request->get<UserAgent>()) {
@@ -193,6 +295,7 @@ int NetworkLayer::SendRequestUsingChannelContext(
     scoped_refptr<Request> &request,
     ChannelContext *channel_context,
     const net::CompletionCallback& callback) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::SendRequest");
   if (!channel_context->channel_->is_connected()) {
     DVLOG(1) << "Cannot send a request yet";
     return net::ERR_SOCKET_NOT_CONNECTED;
@@ -202,8 +305,13 @@ int NetworkLayer::SendRequestUsingChannelContext(
     StampClientTopmostVia(request, channel_context->channel_);
   // Substitute the existing Contact by the real one
   StampContact(request, channel_context->channel_);
-  // Send ACKs out of transactions
-  if (Method::ACK != request->method()) {
+  if (request->stateless()) {
+    if (Method::ACK != request->method())
+      AddStatelessRequest(request);
+    if (0 == channel_context->refs_)
+      StartIdleTimer(channel_context);
+  } else if (Method::ACK != request->method()) {
+    // Send ACKs out of transactions.
     // The created transaction will handle the response processing.
     // Requests don't need to be passed to client transactions.
     ignore_result(CreateClientTransaction(request, channel_context));
@@ -211,8 +319,24 @@ int NetworkLayer::SendRequestUsingChannelContext(
   return channel_context->channel_->Send(request, callback);
 }
 
+int NetworkLayer::SendStatelessUsingChannelContext(
+    const scoped_refptr<Message> &message,
+    ChannelContext *channel_context,
+    const net::CompletionCallback& callback) {
+  if (!channel_context->channel_->is_connected()) {
+    DVLOG(1) << "Cannot send a message yet";
+    return net::ERR_SOCKET_NOT_CONNECTED;
+  }
+  // Without transactions holding the channel, keep it for a while after its
+  // last use.
+  if (0 == channel_context->refs_)
+    StartIdleTimer(channel_context);
+  return channel_context->channel_->Send(message, callback);
+}
+
 int NetworkLayer::SendResponse(const scoped_refptr<Response> &response,
                                const net::CompletionCallback& callback) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::SendResponse");
   // Add a Server header if there's none
   if (!response->get<Server>()) {
     scoped_ptr<Server> server(
@@ -220,13 +344,20 @@ int NetworkLayer::SendResponse(const scoped_refptr<Response> &response,
     response->push_back(server.Pass());
   }
 
+  if (overload_control_) {
+    Via *via = response->get<Via>();
+    if (via && !via->empty())
+      overload_control_->StampResponseVia(&via->front());
+  }
+
   scoped_refptr<ServerTransaction> server_transaction =
     GetServerTransaction(response);
   if (server_transaction) {
     server_transaction->Send(response);
   } else {
-    // When there's no server transaction available, tries to send the
-    // response directly through an available channel.
+    // When there's no server transaction available, such as for requests
+    // received statelessly, tries to send the response directly through an
+    // available channel.
     EndPoint destination(GetMessageEndPoint(response));
     if (destination.IsEmpty()) {
       DVLOG(1) << "Impossible to route without Via";
@@ -237,7 +368,8 @@ int NetworkLayer::SendResponse(const scoped_refptr<Response> &response,
       DVLOG(1) << "No channel can send the message";
       return net::ERR_SOCKET_NOT_CONNECTED;
     }
-    channel_context->channel_->Send(response, callback);
+    return SendStatelessUsingChannelContext(response, channel_context,
+                                            callback);
   }
 
   return net::OK;
@@ -257,24 +389,30 @@ void NetworkLayer::ReleaseChannelInternal(ChannelContext *channel_context) {
 
   channel_context->refs_--;
   // When all references reach zero, start the timer.
-  if (channel_context->refs_ == 0) {
-    channel_context->timer_.Start(FROM_HERE,
-        base::TimeDelta::FromSeconds(network_settings_.reuse_lifetime()),
-        base::Bind(&NetworkLayer::OnIdleChannelTimedOut,
-            weak_factory_.GetWeakPtr(),
-            channel_context->channel_->destination()));
-  }
+  if (channel_context->refs_ == 0)
+    StartIdleTimer(channel_context);
+}
+
+void NetworkLayer::StartIdleTimer(ChannelContext *channel_context) {
+  channel_context->timer_.Start(FROM_HERE,
+      base::TimeDelta::FromSeconds(network_settings_.reuse_lifetime()),
+      base::Bind(&NetworkLayer::OnIdleChannelTimedOut,
+          weak_factory_.GetWeakPtr(),
+          channel_context->channel_->destination()));
 }
 
 ClientTransaction *NetworkLayer::CreateClientTransaction(
           const scoped_refptr<Request> &request,
           ChannelContext *channel_context) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::CreateClientTransaction");
+  SIPPET_TRACE_FLOW_BEGIN(request->GetTransactionTraceId());
   scoped_refptr<ClientTransaction> client_transaction =
     network_settings_.transaction_factory()->CreateClientTransaction(
       request->method(),
       ClientTransactionId(request),
       channel_context->channel_,
-      TimeDeltaFactory::GetDefaultFactory(),
+      network_settings_.time_delta_factory(),
+      network_settings_.timer_source(),
       this);
   client_transactions_[client_transaction->id()] = client_transaction;
   channel_context->transactions_.insert(client_transaction->id());
@@ -286,12 +424,15 @@ ClientTransaction *NetworkLayer::CreateClientTransaction(
 ServerTransaction *NetworkLayer::CreateServerTransaction(
           const scoped_refptr<Request> &request,
           ChannelContext *channel_context) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::CreateServerTransaction");
+  SIPPET_TRACE_FLOW_BEGIN(request->GetTransactionTraceId());
   scoped_refptr<ServerTransaction> server_transaction =
     network_settings_.transaction_factory()->CreateServerTransaction(
       request->method(),
       ServerTransactionId(request),
       channel_context->channel_,
-      TimeDeltaFactory::GetDefaultFactory(),
+      network_settings_.time_delta_factory(),
+      network_settings_.timer_source(),
       this);
   server_transactions_[server_transaction->id()] = server_transaction;
   channel_context->transactions_.insert(server_transaction->id());
@@ -302,6 +443,7 @@ ServerTransaction *NetworkLayer::CreateServerTransaction(
 
 void NetworkLayer::DestroyClientTransaction(
                 const scoped_refptr<ClientTransaction> &client_transaction) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::DestroyClientTransaction");
   client_transactions_.erase(client_transaction->id());
   ChannelContext *channel_context =
     GetChannelContext(client_transaction->channel()->destination());
@@ -313,6 +455,7 @@ void NetworkLayer::DestroyClientTransaction(
 }
 void NetworkLayer::DestroyServerTransaction(
                 const scoped_refptr<ServerTransaction> &server_transaction) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::DestroyServerTransaction");
   server_transactions_.erase(server_transaction->id());
   ChannelContext *channel_context =
     GetChannelContext(server_transaction->channel()->destination());
@@ -323,6 +466,123 @@ void NetworkLayer::DestroyServerTransaction(
   server_transaction->Close();
 }
 
+void NetworkLayer::AddStatelessRequest(const scoped_refptr<Request> &request) {
+  std::string id(ClientTransactionId(request));
+  stateless_requests_[id] = request;
+  // All requests share the same timeout, so deadlines are kept in order.
+  stateless_deadlines_.push_back(
+      std::make_pair(network_settings_.timer_source()->NowTicks()
+          + stateless_timeout_, id));
+  if (!stateless_timer_.IsRunning()) {
+    stateless_timer_.Start(FROM_HERE, stateless_timeout_, this,
+        &NetworkLayer::OnStatelessRequestsTimedOut);
+  }
+}
+
+int NetworkLayer::ResolveRequest(scoped_refptr<Request> &request,
+    const net::CompletionCallback& callback) {
+  RemoveResolution(request->id());
+  scoped_ptr<Resolution> resolution(new Resolution);
+  resolution->request = request;
+  resolution->callback = callback;
+  const Request *source = request.get();
+  resolution->stamped_via = !source->get<Via>();
+  int rv = network_settings_.sip_resolver()->Resolve(
+      GetRequestTarget(request), &resolution->targets,
+      base::Bind(&NetworkLayer::OnRequestResolved,
+          weak_factory_.GetWeakPtr(), request->id()));
+  if (net::ERR_IO_PENDING == rv) {
+    resolutions_[request->id()] = resolution.release();
+    return rv;
+  }
+  if (net::OK != rv) {
+    DVLOG(1) << "Impossible to resolve " << GetRequestTarget(request);
+    return rv;
+  }
+  // Without other targets, there's nothing to fail over to.
+  if (1 == resolution->targets.size())
+    return SendRequestTo(request, resolution->targets.front(), callback);
+  Resolution *pending_resolution = resolution.get();
+  resolutions_[request->id()] = resolution.release();
+  rv = SendToNextTarget(pending_resolution);
+  if (net::OK == rv)
+    pending_resolution->callback.Reset();
+  else if (net::ERR_IO_PENDING != rv)
+    RemoveResolution(request->id());
+  return rv;
+}
+
+int NetworkLayer::SendToNextTarget(Resolution *resolution) {
+  int rv = net::ERR_ADDRESS_UNREACHABLE;
+  while (resolution->next_target < resolution->targets.size()) {
+    if (resolution->next_target > 0)
+      AbandonTarget(resolution);
+    EndPoint destination(resolution->targets[resolution->next_target++]);
+    rv = SendRequestTo(resolution->request, destination,
+        base::Bind(&NetworkLayer::OnResolvedRequestSent,
+            weak_factory_.GetWeakPtr(), resolution->request->id()));
+    if (net::OK == rv || net::ERR_IO_PENDING == rv)
+      break;
+    DVLOG(1) << "Failed to send to " << destination.ToString() << ": "
+             << net::ErrorToString(rv);
+  }
+  return rv;
+}
+
+bool NetworkLayer::FailOver(const scoped_refptr<Request> &request) {
+  ResolutionsMap::iterator i = resolutions_.find(request->id());
+  if (resolutions_.end() == i)
+    return false;
+  Resolution *resolution = i->second;
+  if (resolution->failing_over)
+    return true;
+  if (resolution->next_target == resolution->targets.size()) {
+    RemoveResolution(request->id());
+    return false;
+  }
+  // Let the failed transaction terminate before replacing it.
+  resolution->failing_over = true;
+  network_settings_.timer_source()->GetTaskRunner()->PostTask(FROM_HERE,
+      base::Bind(&NetworkLayer::OnFailOver, weak_factory_.GetWeakPtr(),
+          request->id()));
+  return true;
+}
+
+void NetworkLayer::AbandonTarget(Resolution *resolution) {
+  scoped_refptr<Request> request(resolution->request);
+  const Via *via = request->get<Via>();
+  if (!via || via->empty())
+    return;
+  scoped_refptr<ClientTransaction> client_transaction =
+      GetClientTransaction(ClientTransactionId(request));
+  if (client_transaction)
+    DestroyClientTransaction(client_transaction);
+  // A new transaction is created for the next target (RFC 3263, 4.3).
+  if (resolution->stamped_via)
+    request->erase(request->find_first<Via>());
+  else
+    request->get<Via>()->front().set_branch(CreateBranch());
+}
+
+void NetworkLayer::FailResolution(const std::string &request_id, int error) {
+  ResolutionsMap::iterator i = resolutions_.find(request_id);
+  DCHECK(resolutions_.end() != i);
+  scoped_ptr<Resolution> resolution(i->second);
+  resolutions_.erase(i);
+  if (!resolution->callback.is_null())
+    resolution->callback.Run(error);
+  else
+    delegate_->OnTransportError(resolution->request, error);
+}
+
+void NetworkLayer::RemoveResolution(const std::string &request_id) {
+  ResolutionsMap::iterator i = resolutions_.find(request_id);
+  if (resolutions_.end() == i)
+    return;
+  delete i->second;
+  resolutions_.erase(i);
+}
+
 int NetworkLayer::CreateChannelContext(
           const EndPoint &destination,
           const scoped_refptr<Request> &request,
@@ -343,7 +603,10 @@ int NetworkLayer::CreateChannelContext(
 
   *created_channel_context =
       new ChannelContext(channel.get(), request, callback);
+  network_settings_.timer_source()->Attach(
+      &(*created_channel_context)->timer_);
   channels_[destination] = *created_channel_context;
+  TransportMetrics::Get()->channels->Increment();
   return net::OK;
 }
 
@@ -351,6 +614,7 @@ void NetworkLayer::DestroyChannelContext(ChannelContext *channel_context) {
   DCHECK(channel_context);
 
   channels_.erase(channel_context->channel_->destination());
+  TransportMetrics::Get()->channels->Decrement();
 
   // The following code works as a 'cascade on delete'
   // for existing transactions still using the channel.
@@ -378,6 +642,8 @@ void NetworkLayer::StampClientTopmostVia(
   net::HostPortPair hostport(origin.host(), origin.port());
   via->push_back(ViaParam(origin.protocol(), hostport));
   via->back().set_branch(CreateBranch());
+  if (overload_control_)
+    overload_control_->StampRequestVia(&via->back());
   request->push_front(via.Pass());
 }
 
@@ -585,12 +851,7 @@ EndPoint NetworkLayer::GetMessageEndPoint(
     const scoped_refptr<Message> &message) {
   if (isa<Request>(message)) {
     scoped_refptr<Request> request = dyn_cast<Request>(message);
-    GURL destination;
-    Route *route = request->get<Route>();
-    if (route && !route->empty())
-      return EndPoint::FromGURL(route->front().address());
-    else
-      return EndPoint::FromGURL(request->request_uri());
+    return EndPoint::FromGURL(GetRequestTarget(request));
   } else {
     scoped_refptr<Response> response = dyn_cast<Response>(message);
     Message::iterator topmost_via = response->find_first<Via>();
@@ -606,6 +867,73 @@ EndPoint NetworkLayer::GetMessageEndPoint(
   }
 }
 
+GURL NetworkLayer::GetRequestTarget(const scoped_refptr<Request> &request) {
+  const Request *source = request.get();
+  const Route *route = source->get<Route>();
+  if (route && !route->empty())
+    return route->front().address();
+  return request->request_uri();
+}
+
+void NetworkLayer::DumpMemoryUsage(MemoryUsageDump *dump) const {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  size_t bytes = 0;
+  for (const auto &entry : client_transactions_) {
+    bytes += kTreeNodeOverhead + sizeof(entry)
+        + EstimateStringMemoryUsage(entry.first)
+        + entry.second->EstimateMemoryUsage();
+  }
+  dump->Add("transport/client_transactions", client_transactions_.size(),
+            bytes);
+
+  bytes = 0;
+  for (const auto &entry : server_transactions_) {
+    bytes += kTreeNodeOverhead + sizeof(entry)
+        + EstimateStringMemoryUsage(entry.first)
+        + entry.second->EstimateMemoryUsage();
+  }
+  dump->Add("transport/server_transactions", server_transactions_.size(),
+            bytes);
+
+  // Channel contexts refer to their transactions by ID.
+  bytes = 0;
+  size_t buffered_bytes = 0;
+  for (const auto &entry : channels_) {
+    const ChannelContext *channel_context = entry.second;
+    bytes += kTreeNodeOverhead + sizeof(entry) + sizeof(ChannelContext);
+    for (const std::string &transaction_id : channel_context->transactions_) {
+      bytes += kTreeNodeOverhead + sizeof(transaction_id)
+          + EstimateStringMemoryUsage(transaction_id);
+    }
+    if (channel_context->initial_request_.get())
+      bytes += channel_context->initial_request_->EstimateMemoryUsage();
+    buffered_bytes += channel_context->channel_->buffered_bytes();
+  }
+  dump->Add("transport/channels", channels_.size(), bytes);
+  dump->Add("transport/channel_buffers", channels_.size(), buffered_bytes);
+
+  bytes = stateless_deadlines_.size() * sizeof(StatelessDeadlines::value_type);
+  for (const auto &entry : stateless_requests_) {
+    bytes += kHashNodeOverhead + sizeof(entry)
+        + EstimateStringMemoryUsage(entry.first)
+        + entry.second->EstimateMemoryUsage();
+  }
+  dump->Add("transport/stateless_requests", stateless_requests_.size(),
+            bytes);
+
+  // Requests failing over to other targets are also counted by their
+  // client transactions.
+  bytes = 0;
+  for (const auto &entry : resolutions_) {
+    const Resolution *resolution = entry.second;
+    bytes += kTreeNodeOverhead + sizeof(entry) + sizeof(Resolution)
+        + EstimateStringMemoryUsage(entry.first)
+        + resolution->targets.capacity() * sizeof(EndPoint)
+        + resolution->request->EstimateMemoryUsage();
+  }
+  dump->Add("transport/resolutions", resolutions_.size(), bytes);
+}
+
 NetworkLayer::ChannelContext *NetworkLayer::GetChannelContext(
     const EndPoint &destination) {
   ChannelsMap::iterator channel_it;
@@ -654,6 +982,20 @@ scoped_refptr<ServerTransaction> NetworkLayer::GetServerTransaction(
   return server_transactions_it->second;
 }
 
+scoped_refptr<ClientTransaction> NetworkLayer::GetInviteClientTransaction(
+                      const scoped_refptr<Request> &cancel) {
+  const Request *source = cancel.get();
+  const Via *via = source->get<Via>();
+  if (!via || via->empty())
+    return 0;
+  // The CANCEL has the topmost Via of its INVITE, and so its branch.
+  std::string transaction_id("c:");
+  transaction_id += via->front().branch();
+  transaction_id += ":";
+  transaction_id += Method(Method::INVITE).str();
+  return GetClientTransaction(transaction_id);
+}
+
 void NetworkLayer::OnChannelConnected(const scoped_refptr<Channel> &channel,
                                       int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
@@ -666,8 +1008,15 @@ void NetworkLayer::OnChannelConnected(const scoped_refptr<Channel> &channel,
   delegate_->OnChannelConnected(destination, initial_result);
   if (result == net::OK) {
     if (channel_context->initial_request_) {
-      result = SendRequestUsingChannelContext(channel_context->initial_request_,
-        channel_context, channel_context->initial_callback_);
+      if (channel_context->initial_stateless_) {
+        result = SendStatelessUsingChannelContext(
+            channel_context->initial_request_, channel_context,
+            channel_context->initial_callback_);
+      } else {
+        result = SendRequestUsingChannelContext(
+            channel_context->initial_request_, channel_context,
+            channel_context->initial_callback_);
+      }
       if (result == net::OK) {
         if (!channel_context->initial_callback_.is_null()) {
           // Complete the pending send callback now
@@ -697,23 +1046,35 @@ void NetworkLayer::OnChannelConnected(const scoped_refptr<Channel> &channel,
 
 void NetworkLayer::OnIncomingMessage(const scoped_refptr<Channel> &channel,
                                      const scoped_refptr<Message> &message) {
+  SIPPET_TRACE_EVENT0("NetworkLayer::OnIncomingMessage");
   if (isa<Request>(message)) {
     scoped_refptr<Request> request = dyn_cast<Request>(message);
     StampServerTopmostVia(request, channel);
     scoped_refptr<ServerTransaction> server_transaction =
       GetServerTransaction(request);
-    if (server_transaction)
+    if (server_transaction) {
+      SIPPET_TRACE_FLOW_STEP(request->GetTransactionTraceId());
       server_transaction->HandleIncomingRequest(request);
-    else
+    } else {
       HandleIncomingRequest(channel, request);
+    }
   } else {  // response
     scoped_refptr<Response> response = dyn_cast<Response>(message);
+    if (overload_control_) {
+      const Response *source = response.get();
+      const Via *via = source->get<Via>();
+      if (via && !via->empty())
+        overload_control_->OnResponseVia(channel->destination(),
+                                         via->front());
+    }
     scoped_refptr<ClientTransaction> client_transaction =
       GetClientTransaction(response);
-    if (client_transaction)
+    if (client_transaction) {
+      SIPPET_TRACE_FLOW_STEP(response->GetTransactionTraceId());
       client_transaction->HandleIncomingResponse(response);
-    else
+    } else {
       HandleIncomingResponse(channel, response);
+    }
   }
 }
 
@@ -725,11 +1086,30 @@ void NetworkLayer::HandleIncomingRequest(
 
   DCHECK(channel_context);
 
+  if (overload_control_ && IsOutOfDialogRequest(request)
+      && overload_control_->ShouldReject()) {
+    RejectOverloaded(request);
+    return;
+  }
+
   // Server transactions are created in advance
-  CreateServerTransaction(request, channel_context);
+  if (network_settings_.is_stateless_method(request->method()))
+    request->set_stateless(true);
+  else if (delegate_->ShouldCreateServerTransaction(request))
+    CreateServerTransaction(request, channel_context);
   delegate_->OnIncomingRequest(request);
 }
 
+void NetworkLayer::RejectOverloaded(const scoped_refptr<Request> &request) {
+  scoped_refptr<Response> response(
+      request->CreateResponse(SIP_SERVICE_UNAVAILABLE));
+  scoped_ptr<RetryAfter> retry_after(
+      new RetryAfter(network_settings_.overload_retry_after()));
+  response->push_back(retry_after.Pass());
+  TransportMetrics::Get()->overload_rejections->Increment();
+  ignore_result(SendResponse(response, net::CompletionCallback()));
+}
+
 void NetworkLayer::HandleIncomingResponse(
                                  const scoped_refptr<Channel> &channel,
                                  const scoped_refptr<Response> &response) {
@@ -738,9 +1118,24 @@ void NetworkLayer::HandleIncomingResponse(
 
   DCHECK(channel_context);
 
+  StatelessRequestsMap::iterator stateless_request_it =
+    stateless_requests_.find(ClientTransactionId(response));
+  if (stateless_request_it != stateless_requests_.end()) {
+    response->set_refer_to(stateless_request_it->second);
+    // Its deadline is left behind, and skipped when reached.
+    if (response->response_code() >= 200)
+      stateless_requests_.erase(stateless_request_it);
+    delegate_->OnIncomingResponse(response);
+    return;
+  }
+
+  if (delegate_->OnUnattachedResponse(response))
+    return;
+
   // It's not a good idea to pass these responses up, as they aren't related
   // to an initiated request, so we're going to discard them at this point.
 
+  TransportMetrics::Get()->stray_responses->Increment();
   LOG(WARNING) << "Discarded inbound response ("
                << response->response_code()
                << " " << response->reason_phrase()
@@ -810,15 +1205,27 @@ void NetworkLayer::OnSSLCertErrorTransactionComplete(
 }
 
 void NetworkLayer::OnIncomingResponse(const scoped_refptr<Response> &response) {
+  if (!resolutions_.empty() && response->refer_to()) {
+    // A 503 (Service Unavailable) is a failure of the target, and any other
+    // response shows it is the one to use (RFC 3263, section 4.3).
+    if (SIP_SERVICE_UNAVAILABLE != response->response_code())
+      RemoveResolution(response->refer_to()->id());
+    else if (FailOver(response->refer_to()))
+      return;
+  }
   delegate_->OnIncomingResponse(response);
 }
 
 void NetworkLayer::OnTimedOut(const scoped_refptr<Request> &request) {
+  if (FailOver(request))
+    return;
   delegate_->OnTimedOut(request);
 }
 
 void NetworkLayer::OnTransportError(
     const scoped_refptr<Request> &request, int error) {
+  if (FailOver(request))
+    return;
   delegate_->OnTransportError(request, error);
 }
 
@@ -835,15 +1242,108 @@ void NetworkLayer::OnTransactionTerminated(const std::string &transaction_id) {
   }
 }
 
+void NetworkLayer::OnStatelessRequestsTimedOut() {
+  base::TimeTicks now(network_settings_.timer_source()->NowTicks());
+  std::vector<scoped_refptr<Request> > timed_out;
+  while (!stateless_deadlines_.empty()
+         && stateless_deadlines_.front().first <= now) {
+    StatelessRequestsMap::iterator i =
+      stateless_requests_.find(stateless_deadlines_.front().second);
+    if (i != stateless_requests_.end()) {
+      timed_out.push_back(i->second);
+      stateless_requests_.erase(i);
+    }
+    stateless_deadlines_.pop_front();
+  }
+  if (!stateless_deadlines_.empty()) {
+    stateless_timer_.Start(FROM_HERE,
+        stateless_deadlines_.front().first - now, this,
+        &NetworkLayer::OnStatelessRequestsTimedOut);
+  }
+  for (std::vector<scoped_refptr<Request> >::iterator i = timed_out.begin(),
+       ie = timed_out.end(); i != ie; ++i) {
+    delegate_->OnTimedOut(*i);
+  }
+}
+
+void NetworkLayer::OnOverloadSample() {
+  base::TimeTicks now(network_settings_.timer_source()->NowTicks());
+  // The time this task was delayed past its schedule.
+  base::TimeDelta loop_lag =
+      now - last_overload_sample_ - OverloadControl::GetSampleInterval();
+  last_overload_sample_ = now;
+  size_t pending_writes = 0;
+  for (ChannelsMap::const_iterator i = channels_.begin(),
+       ie = channels_.end(); i != ie; ++i) {
+    pending_writes += i->second->channel_->pending_writes();
+  }
+  overload_control_->Sample(std::max(loop_lag, base::TimeDelta()),
+      client_transactions_.size() + server_transactions_.size(),
+      pending_writes);
+}
+
+void NetworkLayer::OnRequestResolved(const std::string &request_id,
+                                     int result,
+                                     const std::vector<EndPoint> &targets) {
+  ResolutionsMap::iterator i = resolutions_.find(request_id);
+  if (resolutions_.end() == i)
+    return;
+  Resolution *resolution = i->second;
+  if (net::OK == result) {
+    resolution->targets = targets;
+    result = SendToNextTarget(resolution);
+  }
+  if (net::ERR_IO_PENDING == result)
+    return;
+  if (net::OK != result) {
+    FailResolution(request_id, result);
+    return;
+  }
+  net::CompletionCallback callback(resolution->callback);
+  resolution->callback.Reset();
+  if (!callback.is_null())
+    callback.Run(net::OK);
+}
+
+void NetworkLayer::OnResolvedRequestSent(const std::string &request_id,
+                                         int result) {
+  ResolutionsMap::iterator i = resolutions_.find(request_id);
+  if (resolutions_.end() == i)
+    return;
+  Resolution *resolution = i->second;
+  // The target couldn't be reached, try the next one.
+  if (net::OK != result)
+    result = SendToNextTarget(resolution);
+  if (net::ERR_IO_PENDING == result)
+    return;
+  if (net::OK != result) {
+    FailResolution(request_id, result);
+    return;
+  }
+  net::CompletionCallback callback(resolution->callback);
+  resolution->callback.Reset();
+  if (!callback.is_null())
+    callback.Run(net::OK);
+}
+
+void NetworkLayer::OnFailOver(const std::string &request_id) {
+  ResolutionsMap::iterator i = resolutions_.find(request_id);
+  if (resolutions_.end() == i)
+    return;
+  Resolution *resolution = i->second;
+  resolution->failing_over = false;
+  int result = SendToNextTarget(resolution);
+  if (net::OK != result && net::ERR_IO_PENDING != result)
+    FailResolution(request_id, result);
+}
+
 void NetworkLayer::OnIdleChannelTimedOut(const EndPoint &endpoint) {
   ChannelContext *channel_context = GetChannelContext(endpoint);
   OnChannelClosed(channel_context->channel_, net::ERR_TIMED_OUT);
 }
 
 void NetworkLayer::PostOnChannelClosed(const EndPoint &destination) {
-  base::MessageLoop* message_loop = base::MessageLoop::current();
-  CHECK(message_loop);
-  message_loop->PostTask(
+  network_settings_.timer_source()->GetTaskRunner()->PostTask(
       FROM_HERE,
       base::Bind(&NetworkLayer::Delegate::OnChannelClosed,
           base::Unretained(delegate_), destination));
@@ -5,8 +5,12 @@
 #ifndef SIPPET_TRANSPORT_NETWORK_LAYER_H_
 #define SIPPET_TRANSPORT_NETWORK_LAYER_H_
 
+#include <deque>
 #include <set>
+#include <utility>
+#include <vector>
 
+#include "base/containers/hash_tables.h"
 #include "base/timer/timer.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_vector.h"
@@ -23,6 +27,8 @@
 #include "sippet/transport/transaction_delegate.h"
 #include "sippet/transport/aliases_map.h"
 #include "sippet/transport/network_settings.h"
+#include "sippet/transport/overload_control.h"
+#include "sippet/transport/sip_resolver.h"
 #include "sippet/transport/ssl_cert_error_handler.h"
 
 namespace net {
@@ -32,6 +38,7 @@ class X509Certificate;
 namespace sippet {
 
 class ChannelFactory;
+class MemoryUsageDump;
 class TransactionFactory;
 class SSLCertErrorTransaction;
 
@@ -143,6 +150,23 @@ class NetworkLayer :
     // |error| the network error arised while handling the messages.
     virtual void OnTransportError(
         const scoped_refptr<Request> &request, int error) = 0;
+
+    // Called before creating a server transaction for an incoming |request|.
+    // Returning false handles the request statelessly, as a stateless proxy
+    // would: it's passed to |OnIncomingRequest| without a transaction, and
+    // its responses must be sent with |NetworkLayer::SendStateless|.
+    virtual bool ShouldCreateServerTransaction(
+        const scoped_refptr<Request> &request) {
+      return true;
+    }
+
+    // Called for responses that don't match any client transaction, such as
+    // the responses of requests sent by |NetworkLayer::SendStateless|.
+    // Returns false if the response was not handled, and is to be discarded.
+    virtual bool OnUnattachedResponse(
+        const scoped_refptr<Response> &response) {
+      return false;
+    }
   };
 
   // Construct a |NetworkLayer|.
@@ -194,11 +218,31 @@ class NetworkLayer :
   // |ViaParam::rport| available on the topmost |Via| header will be used as
   // the destination.
   //
+  // Requests marked with |Request::set_stateless| don't create a client
+  // transaction. They are sent once, their responses are matched by their
+  // topmost |Via| branch, and |Delegate::OnTimedOut| is called if no final
+  // response arrives within the transaction timeout (64*T1). Responses to
+  // requests received without a server transaction are sent directly.
+  //
+  // When a |SipResolver| is set in the settings, the destination of
+  // requests other than ACKs, CANCELs and stateless requests is resolved as
+  // in RFC 3263, and CANCELs are sent where their INVITE was. Requests that
+  // can't be sent, time out, fail in the transport or are answered with 503
+  // (Service Unavailable) are sent again to the next target, with a new
+  // branch, before |Delegate| is told about the failure.
+  //
   // |message| the message to be sent; it could be a request or a response.
   // |callback| the callback on completion of the socket Write.
   int Send(const scoped_refptr<Message> &message,
            const net::CompletionCallback& callback);
 
+  // Send a message without creating a transaction, and without changing its
+  // headers: a request must already have its topmost |Via|. Requests open a
+  // channel if needed, as in |Send|, and responses are sent through the
+  // channel of their topmost |Via|. Intended for stateless proxies.
+  int SendStateless(const scoped_refptr<Message> &message,
+                    const net::CompletionCallback& callback);
+
   // Add an alias to an existing channel endpoint. It is considered an error
   // to add aliases using different protocols. Return true if the alias has
   // been successfully created.
@@ -208,11 +252,38 @@ class NetworkLayer :
   // uses the request-URI; for responses, use the topmost Via header.
   static EndPoint GetMessageEndPoint(const scoped_refptr<Message> &message);
 
+  // The URI requests are sent to: the first |Route| entry, if any, or the
+  // request-URI.
+  static GURL GetRequestTarget(const scoped_refptr<Request> &request);
+
+  // The overload control state, or NULL if disabled in the settings. While
+  // overloaded, part of the new incoming requests are rejected with 503
+  // (Service Unavailable) before creating a server transaction, and new
+  // requests to destinations asking to be throttled fail with
+  // |net::ERR_INSUFFICIENT_RESOURCES|.
+  const OverloadControl *overload_control() const {
+    return overload_control_.get();
+  }
+
+  // The numbers of live client and server transactions.
+  size_t client_transaction_count() const {
+    return client_transactions_.size();
+  }
+  size_t server_transaction_count() const {
+    return server_transactions_.size();
+  }
+
+  // Adds the approximate memory held by the transactions, the channels and
+  // their buffers, the stateless requests and the pending resolutions to
+  // |dump|, under "transport/".
+  void DumpMemoryUsage(MemoryUsageDump *dump) const;
+
  private:
   friend struct base::DefaultDeleter<NetworkLayer>;
   ~NetworkLayer() override;
 
   FRIEND_TEST_ALL_PREFIXES(NetworkLayerTest, StaticFunctions);
+  FRIEND_TEST_ALL_PREFIXES(NetworkLayerPerfTest, TransactionIds);
 
   // Just for testing purposes
   friend class NetworkLayerTest;
@@ -228,6 +299,8 @@ class NetworkLayer :
     scoped_refptr<Request> initial_request_;
     // Keep the first callback to be called after connected and sent.
     net::CompletionCallback initial_callback_;
+    // Whether the |initial_request_| is to be sent by |SendStateless|.
+    bool initial_stateless_;
     // Keep references to transactions using this channel.
     std::set<std::string> transactions_;
 
@@ -238,6 +311,23 @@ class NetworkLayer :
     ~ChannelContext();
   };
 
+  // A request sent to the targets resolved by the |SipResolver|, one after
+  // the other, until one of them answers.
+  struct Resolution {
+    scoped_refptr<Request> request;
+    // Run once the request is written to a target, or on failure.
+    net::CompletionCallback callback;
+    std::vector<EndPoint> targets;
+    size_t next_target;
+    // Whether the topmost |Via| is stamped by the |NetworkLayer|.
+    bool stamped_via;
+    // Whether sending to the next target is already scheduled.
+    bool failing_over;
+
+    Resolution();
+    ~Resolution();
+  };
+
   typedef std::map<Protocol, ChannelFactory*, ProtocolLess> FactoriesMap;
   typedef std::map<EndPoint, ChannelContext*, EndPointLess> ChannelsMap;
 
@@ -245,6 +335,14 @@ class NetworkLayer :
       ClientTransactionsMap;
   typedef std::map<std::string, scoped_refptr<ServerTransaction> >
       ServerTransactionsMap;
+  // Stateless requests waiting for their final responses, by client
+  // transaction ID, and their expiration times in sending order.
+  typedef base::hash_map<std::string, scoped_refptr<Request> >
+      StatelessRequestsMap;
+  typedef std::deque<std::pair<base::TimeTicks, std::string> >
+      StatelessDeadlines;
+  // Requests being resolved or sent to their resolved targets, by ID.
+  typedef std::map<std::string, Resolution*> ResolutionsMap;
 
   NetworkSettings network_settings_;
   AliasesMap aliases_map_;
@@ -253,20 +351,36 @@ class NetworkLayer :
   ChannelsMap channels_;
   ClientTransactionsMap client_transactions_;
   ServerTransactionsMap server_transactions_;
+  StatelessRequestsMap stateless_requests_;
+  StatelessDeadlines stateless_deadlines_;
+  base::TimeDelta stateless_timeout_;
+  base::OneShotTimer<NetworkLayer> stateless_timer_;
+  scoped_ptr<OverloadControl> overload_control_;
+  base::RepeatingTimer<NetworkLayer> overload_timer_;
+  base::TimeTicks last_overload_sample_;
+  ResolutionsMap resolutions_;
   SSLCertErrorHandler::Factory *ssl_cert_error_handler_factory_;
   ScopedVector<SSLCertErrorTransaction> ssl_cert_error_transactions_;
 
   int SendRequest(scoped_refptr<Request> &request,
       const net::CompletionCallback& callback);
+  int SendRequestTo(scoped_refptr<Request> &request,
+      const EndPoint &destination,
+      const net::CompletionCallback& callback);
   int SendRequestUsingChannelContext(scoped_refptr<Request> &request,
       ChannelContext *channel_context,
       const net::CompletionCallback& callback);
   int SendResponse(const scoped_refptr<Response> &message,
       const net::CompletionCallback& callback);
+  int SendStatelessUsingChannelContext(
+      const scoped_refptr<Message> &message,
+      ChannelContext *channel_context,
+      const net::CompletionCallback& callback);
 
   // Manage the number of channel references to start/stop the idle timeout
   void RequestChannelInternal(ChannelContext *channel_context);
   void ReleaseChannelInternal(ChannelContext *channel_context);
+  void StartIdleTimer(ChannelContext *channel_context);
 
   // Create transactions, associating to referencing tables
   ClientTransaction *CreateClientTransaction(
@@ -280,6 +394,27 @@ class NetworkLayer :
   void DestroyServerTransaction(
       const scoped_refptr<ServerTransaction> &server_transaction);
 
+  // Keep a stateless request until its final response, or its timeout.
+  void AddStatelessRequest(const scoped_refptr<Request> &request);
+
+  // Resolve the destination of a request with the |SipResolver|, and send
+  // it to the first target that can be reached.
+  int ResolveRequest(scoped_refptr<Request> &request,
+                     const net::CompletionCallback& callback);
+  int SendToNextTarget(Resolution *resolution);
+
+  // Schedule sending a request to its next target after a failure. Returns
+  // false if there is none left, and the failure is to be passed up.
+  bool FailOver(const scoped_refptr<Request> &request);
+
+  // Close the transaction of the last attempt, and prepare the topmost
+  // |Via| to be sent again.
+  void AbandonTarget(Resolution *resolution);
+
+  // Report a request that couldn't be sent to any of its targets.
+  void FailResolution(const std::string &request_id, int error);
+  void RemoveResolution(const std::string &request_id);
+
   // Create channel contexts, associating to referencing tables
   int CreateChannelContext(
       const EndPoint &destination,
@@ -318,15 +453,21 @@ class NetworkLayer :
                         const std::string &transaction_id);
   scoped_refptr<ServerTransaction> GetServerTransaction(
                         const std::string &transaction_id);
+  // The transaction of the INVITE being cancelled by |cancel|, if any.
+  scoped_refptr<ClientTransaction> GetInviteClientTransaction(
+                        const scoped_refptr<Request> &cancel);
 
   // Handle new incoming requests (not retransmissions). Server transactions
   // are created in advance while receiving new requests
   void HandleIncomingRequest(const scoped_refptr<Channel> &channel,
                              const scoped_refptr<Request> &request);
+
+  // Answers a new request with 503 (Service Unavailable) while overloaded.
+  void RejectOverloaded(const scoped_refptr<Request> &request);
   
   // Handle responses not matching any of the existing client transactions.
-  // These responses are actually discarded, as they aren't related to any
-  // pending request.
+  // Responses to stateless requests are passed up, and the others offered
+  // to |Delegate::OnUnattachedResponse|, or discarded.
   void HandleIncomingResponse(const scoped_refptr<Channel> &channel,
                               const scoped_refptr<Response> &response);
 
@@ -364,6 +505,15 @@ class NetworkLayer :
 
   // Timer callbacks
   void OnIdleChannelTimedOut(const EndPoint &endpoint);
+  void OnStatelessRequestsTimedOut();
+  void OnOverloadSample();
+
+  // Resolution callbacks
+  void OnRequestResolved(const std::string &request_id,
+                         int result,
+                         const std::vector<EndPoint> &targets);
+  void OnResolvedRequestSent(const std::string &request_id, int result);
+  void OnFailOver(const std::string &request_id);
 
   void PostOnChannelClosed(const EndPoint &destination);
 
@@ -0,0 +1,84 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/network_layer.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/test/microbenchmark.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kRfc3261Invite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+// Without the magic cookie, the id is built from the RFC 2543 headers.
+const char kRfc2543Invite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=776asdhds\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+}  // namespace
+
+TEST(NetworkLayerPerfTest, TransactionIds) {
+  typedef std::string (*RequestIdFunction)(const scoped_refptr<Request>&);
+  typedef std::string (*ResponseIdFunction)(const scoped_refptr<Response>&);
+
+  struct {
+    const char *name;
+    const char *message;
+  } cases[] = {
+    { "rfc3261", kRfc3261Invite },
+    { "rfc2543", kRfc2543Invite },
+  };
+
+  for (size_t i = 0; i < arraysize(cases); ++i) {
+    scoped_refptr<Request> request(
+        dyn_cast<Request>(Message::Parse(cases[i].message)));
+    ASSERT_TRUE(request);
+    scoped_refptr<Response> response(request->CreateResponse(SIP_OK));
+
+    Microbenchmark server_request(
+        "server_transaction_id", std::string(cases[i].name) + "_request");
+    server_request.Run(base::Bind(base::IgnoreResult(
+        static_cast<RequestIdFunction>(&NetworkLayer::ServerTransactionId)),
+        request));
+
+    Microbenchmark server_response(
+        "server_transaction_id", std::string(cases[i].name) + "_response");
+    server_response.Run(base::Bind(base::IgnoreResult(
+        static_cast<ResponseIdFunction>(&NetworkLayer::ServerTransactionId)),
+        response));
+
+    Microbenchmark client_response(
+        "client_transaction_id", std::string(cases[i].name) + "_response");
+    client_response.Run(base::Bind(base::IgnoreResult(
+        static_cast<ResponseIdFunction>(&NetworkLayer::ClientTransactionId)),
+        response));
+  }
+}
+
+}  // namespace sippet
@@ -4,7 +4,10 @@
 
 #include "sippet/transport/chrome/transport_test_util.h"
 
+#include "sippet/base/memory_usage.h"
 #include "sippet/base/tags.h"
+#include "sippet/transport/dns_lookup_mock.h"
+#include "sippet/transport/sip_resolver.h"
 
 namespace sippet {
 
@@ -37,6 +40,20 @@ const char kRegisterResponse[] =
   "l: 0\r\n"
   "\r\n";
 
+const char kResolvedRegisterRequest[] =
+  "REGISTER sip:example.com SIP/2.0\r\n"
+  "v: SIP/2.0/TCP 192.0.2.33:123;rport;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "t: \"Bob\" <sip:bob@biloxi.com>\r\n"
+  "f: \"Bob\" <sip:bob@biloxi.com>;tag=456248\r\n"
+  "i: 843817637684230@998sdasdh09\r\n"
+  "CSeq: 1826 REGISTER\r\n"
+  "m: <sip:bob@192.0.2.4>\r\n"
+  "Expires: 7200\r\n"
+  "User-Agent: Sippet/1.0 (Cray-1)\r\n"
+  "l: 0\r\n"
+  "\r\n";
+
 const char kOptionsRequest[] =
   "OPTIONS sip:192.0.2.33;transport=TCP SIP/2.0\r\n"
   "v: SIP/2.0/TCP 192.0.4.42:123;branch=z9hG4bK776asdhds\r\n"
@@ -62,6 +79,28 @@ const char kOptionsResponse[] =
   "l: 0\r\n"
   "\r\n";
 
+const char kKeepaliveRequest[] =
+  "OPTIONS sip:192.0.4.42;transport=TCP SIP/2.0\r\n"
+  "v: SIP/2.0/TCP 192.0.2.33:123;rport;branch=z9hG4bKnashds8\r\n"
+  "Max-Forwards: 70\r\n"
+  "t: <sip:192.0.4.42>\r\n"
+  "f: \"Bob\" <sip:bob@biloxi.com>;tag=456249\r\n"
+  "i: 843817637684231@998sdasdh09\r\n"
+  "CSeq: 1 OPTIONS\r\n"
+  "User-Agent: Sippet/1.0 (Cray-1)\r\n"
+  "l: 0\r\n"
+  "\r\n";
+
+const char kKeepaliveResponse[] =
+  "SIP/2.0 200 OK\r\n"
+  "v: SIP/2.0/TCP 192.0.2.33:123;rport=123;branch=z9hG4bKnashds8\r\n"
+  "t: <sip:192.0.4.42>;tag=8321234356\r\n"
+  "f: \"Bob\" <sip:bob@biloxi.com>;tag=456249\r\n"
+  "i: 843817637684231@998sdasdh09\r\n"
+  "CSeq: 1 OPTIONS\r\n"
+  "l: 0\r\n"
+  "\r\n";
+
 }  // namespace
 
 class NetworkLayerTest : public testing::Test {
@@ -77,7 +116,7 @@ class NetworkLayerTest : public testing::Test {
                   net::MockWrite* writes = nullptr, size_t writes_count = 0,
                   MockEvent* events = nullptr, size_t events_count = 0,
                   const char *branches[] = nullptr, size_t branches_count = 0) {
-    NetworkSettings settings;
+    NetworkSettings settings(settings_);
     if (branches != nullptr) {
       branch_factory_.reset(new MockBranchFactory(branches, branches_count));
       settings.set_branch_factory(branch_factory_.get());
@@ -98,6 +137,7 @@ class NetworkLayerTest : public testing::Test {
         Protocol::TCP, channel_factory_.get());
   }
 
+  NetworkSettings settings_;
   scoped_ptr<DataProvider> data_provider_;
   scoped_ptr<net::DeterministicSocketData> data_;
   scoped_ptr<net::DeterministicMockClientSocketFactory> socket_factory_;
@@ -244,6 +284,18 @@ TEST_F(NetworkLayerTest, OutgoingRequest) {
   rv = callback_.WaitForResult();
   EXPECT_EQ(net::OK, rv);
 
+  // The pending transaction and its channel.
+  MemoryUsageDump dump;
+  network_layer_->DumpMemoryUsage(&dump);
+  const MemoryUsageDump::UsageMap &usages = dump.usages();
+  EXPECT_EQ(1u,
+      usages.find("transport/client_transactions")->second.object_count);
+  EXPECT_LT(0u, usages.find("transport/client_transactions")->second.bytes);
+  EXPECT_EQ(0u,
+      usages.find("transport/server_transactions")->second.object_count);
+  EXPECT_EQ(1u, usages.find("transport/channels")->second.object_count);
+  EXPECT_LT(0u, usages.find("transport/channels")->second.bytes);
+
   data_->RunFor(1);
 
   // The mock transaction doesn't terminate automatically
@@ -263,6 +315,131 @@ TEST_F(NetworkLayerTest, OutgoingRequest) {
   data_->RunFor(2);
 
   Finish();
+
+  // Nothing is left once the channel is closed.
+  MemoryUsageDump final_dump;
+  network_layer_->DumpMemoryUsage(&final_dump);
+  const MemoryUsageDump::UsageMap &final_usages = final_dump.usages();
+  EXPECT_EQ(0u, final_usages.find("transport/client_transactions")
+      ->second.object_count);
+  EXPECT_EQ(0u, final_usages.find("transport/server_transactions")
+      ->second.object_count);
+  EXPECT_EQ(0u,
+      final_usages.find("transport/channels")->second.object_count);
+}
+
+TEST_F(NetworkLayerTest, StatelessRequests) {
+  const char *branches[] = {
+    "z9hG4bKnashds8"
+  };
+
+  net::MockRead expected_reads[] = {
+    net::MockRead(net::ASYNC, 1, kKeepaliveResponse),
+    net::MockRead(net::ASYNC, 2, kOptionsRequest),
+    net::MockRead(net::ASYNC, net::ERR_CONNECTION_RESET, 4),
+  };
+
+  net::MockWrite expected_writes[] = {
+    net::MockWrite(net::SYNCHRONOUS, 0, kKeepaliveRequest),
+    net::MockWrite(net::ASYNC, 3, kOptionsResponse),
+  };
+
+  // No transactions are started in either direction.
+  MockEvent expected_events[] = {
+    ExpectConnectChannel("192.0.4.42:5060/TCP", net::OK),
+    ExpectIncomingMessage("^SIP/2.0 200 OK.*"),
+    ExpectIncomingMessage("^OPTIONS sip:192.0.2.33.*"),
+    ExpectCloseChannel("192.0.4.42:5060/TCP"),
+  };
+
+  settings_.add_stateless_method(Method::OPTIONS);
+  Initialize(expected_reads, arraysize(expected_reads),
+             expected_writes, arraysize(expected_writes),
+             expected_events, arraysize(expected_events),
+             branches, arraysize(branches));
+
+  scoped_refptr<Request> request(
+      dyn_cast<Request>(Message::Parse(kKeepaliveRequest)));
+  request->set_direction(Message::Outgoing);
+  request->erase(request->find_first<Via>());
+  request->set_stateless(true);
+  int rv = network_layer_->Send(request, callback_.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  data_->RunFor(1);
+
+  rv = callback_.WaitForResult();
+  EXPECT_EQ(net::OK, rv);
+
+  data_->RunFor(2);
+
+  scoped_refptr<Message> response(Message::Parse(kOptionsResponse));
+  response->set_direction(Message::Outgoing);
+  rv = network_layer_->Send(response, callback_.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  data_->RunFor(2);
+
+  Finish();
+}
+
+TEST_F(NetworkLayerTest, ResolvedTargets) {
+  const char *branches[] = {
+    "z9hG4bKnashds7"
+  };
+
+  net::MockRead expected_reads[] = {
+    net::MockRead(net::ASYNC, 1, kRegisterResponse),
+    net::MockRead(net::ASYNC, net::ERR_CONNECTION_RESET, 2),
+  };
+
+  net::MockWrite expected_writes[] = {
+    net::MockWrite(net::SYNCHRONOUS, 0, kResolvedRegisterRequest),
+  };
+
+  // The UDP target is skipped, as there's no UDP channel factory.
+  std::string client_tid;
+  MockEvent expected_events[] = {
+    ExpectConnectChannel("192.0.4.42:5060/TCP", net::OK),
+    ExpectStartTransaction("^REGISTER sip:example.com.*", &client_tid),
+    ExpectIncomingResponse("^SIP/2.0 200 OK.*", &client_tid),
+    ExpectIncomingMessage("^SIP/2.0 200 OK.*"),
+    ExpectTransactionClose(&client_tid),
+    ExpectCloseChannel("192.0.4.42:5060/TCP"),
+  };
+
+  DnsLookupMock dns_lookup;
+  dns_lookup.AddSrv("_sip._udp.example.com", 10, 0, 5060, "192.0.4.41");
+  dns_lookup.AddSrv("_sip._tcp.example.com", 20, 0, 5060, "192.0.4.42");
+  SipResolver sip_resolver(&dns_lookup);
+  settings_.set_sip_resolver(&sip_resolver);
+  Initialize(expected_reads, arraysize(expected_reads),
+             expected_writes, arraysize(expected_writes),
+             expected_events, arraysize(expected_events),
+             branches, arraysize(branches));
+
+  scoped_refptr<Request> request(
+      dyn_cast<Request>(Message::Parse(kResolvedRegisterRequest)));
+  request->set_direction(Message::Outgoing);
+  request->erase(request->find_first<Via>());
+  int rv = network_layer_->Send(request, callback_.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  dns_lookup.CompletePending();
+  data_->RunFor(1);
+
+  rv = callback_.WaitForResult();
+  EXPECT_EQ(net::OK, rv);
+
+  data_->RunFor(1);
+
+  MockClientTransaction *client_transaction =
+    transaction_factory_->client_transaction(0);
+  client_transaction->Terminate();
+
+  data_->RunFor(1);
+
+  Finish();
 }
 
 }  // namespace sippet
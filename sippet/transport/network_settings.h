@@ -7,14 +7,20 @@
 
 #include "net/base/net_export.h"
 #include "base/memory/ref_counted.h"
+#include "sippet/message/method.h"
 #include "sippet/transport/branch_factory.h"
+#include "sippet/transport/time_delta_factory.h"
+#include "sippet/transport/timer_source.h"
 #include "sippet/transport/transaction_factory.h"
 #include "sippet/transport/ssl_cert_error_handler.h"
 
+#include <set>
 #include <string>
 
 namespace sippet {
 
+class SipResolver;
+
 class NetworkSettings {
  public:
   static std::string GetDefaultSoftwareName();
@@ -26,7 +32,16 @@ class NetworkSettings {
     std::string software_name_;
     BranchFactory *branch_factory_;
     TransactionFactory *transaction_factory_;
+    TimeDeltaFactory *time_delta_factory_;
+    TimerSource *timer_source_;
     SSLCertErrorHandler::Factory *ssl_cert_error_handler_factory_;
+    SipResolver *sip_resolver_;
+    std::set<Method, MethodLess> stateless_methods_;
+    bool enable_overload_control_;
+    int overload_max_loop_lag_;
+    size_t overload_max_transactions_;
+    size_t overload_max_pending_writes_;
+    int overload_retry_after_;
     // Default values
     Data() :
       reuse_lifetime_(60),
@@ -34,7 +49,15 @@ class NetworkSettings {
       software_name_(GetDefaultSoftwareName()),
       branch_factory_(BranchFactory::GetDefaultBranchFactory()),
       transaction_factory_(TransactionFactory::GetDefaultTransactionFactory()),
-      ssl_cert_error_handler_factory_(nullptr) {}
+      time_delta_factory_(TimeDeltaFactory::GetDefaultFactory()),
+      timer_source_(TimerSource::GetDefault()),
+      ssl_cert_error_handler_factory_(nullptr),
+      sip_resolver_(nullptr),
+      enable_overload_control_(false),
+      overload_max_loop_lag_(50),
+      overload_max_transactions_(20000),
+      overload_max_pending_writes_(1000),
+      overload_retry_after_(5) {}
   };
 
   Data data_;
@@ -90,6 +113,24 @@ class NetworkSettings {
     data_.transaction_factory_ = transaction_factory;
   }
 
+  // The transaction timers to use, such as a |RttTimeDeltaFactory|
+  TimeDeltaFactory *time_delta_factory() const {
+    return data_.time_delta_factory_;
+  }
+  void set_time_delta_factory(TimeDeltaFactory *time_delta_factory) {
+    DCHECK(time_delta_factory);
+    data_.time_delta_factory_ = time_delta_factory;
+  }
+
+  // The clock and task runner of the transaction and channel timers
+  TimerSource *timer_source() const {
+    return data_.timer_source_;
+  }
+  void set_timer_source(TimerSource *timer_source) {
+    DCHECK(timer_source);
+    data_.timer_source_ = timer_source;
+  }
+
   // The SSL certificate error handler factory to use
   SSLCertErrorHandler::Factory *ssl_cert_error_handler_factory() const {
     return data_.ssl_cert_error_handler_factory_;
@@ -99,6 +140,75 @@ class NetworkSettings {
     DCHECK(ssl_cert_error_handler_factory);
     data_.ssl_cert_error_handler_factory_ = ssl_cert_error_handler_factory;
   }
+
+  // The RFC 3263 resolver of request destinations. When unset, requests
+  // are sent to the host and port of their URIs, without failover.
+  SipResolver *sip_resolver() const {
+    return data_.sip_resolver_;
+  }
+  void set_sip_resolver(SipResolver *sip_resolver) {
+    data_.sip_resolver_ = sip_resolver;
+  }
+
+  // Methods of incoming requests to be handled without server transactions,
+  // such as OPTIONS used as keepalives. Retransmissions of these requests
+  // are passed up again, and must be answered again. Empty by default.
+  const std::set<Method, MethodLess> &stateless_methods() const {
+    return data_.stateless_methods_;
+  }
+  void add_stateless_method(const Method &method) {
+    DCHECK(Method::INVITE != method && Method::ACK != method);
+    data_.stateless_methods_.insert(method);
+  }
+  bool is_stateless_method(const Method &method) const {
+    return data_.stateless_methods_.end()
+        != data_.stateless_methods_.find(method);
+  }
+
+  // Whether to reject new requests when the network thread is overloaded,
+  // and to take part in the overload control of RFC 7339. Disabled by
+  // default.
+  bool enable_overload_control() const {
+    return data_.enable_overload_control_;
+  }
+  void set_enable_overload_control(bool value) {
+    data_.enable_overload_control_ = value;
+  }
+
+  // Delay of the message loop, in milliseconds, above which the network
+  // thread is considered overloaded.
+  int overload_max_loop_lag() const {
+    return data_.overload_max_loop_lag_;
+  }
+  void set_overload_max_loop_lag(int value) {
+    data_.overload_max_loop_lag_ = value;
+  }
+
+  // Number of pending transactions above which the network thread is
+  // considered overloaded.
+  size_t overload_max_transactions() const {
+    return data_.overload_max_transactions_;
+  }
+  void set_overload_max_transactions(size_t value) {
+    data_.overload_max_transactions_ = value;
+  }
+
+  // Number of messages waiting to be written to the sockets above which the
+  // network thread is considered overloaded.
+  size_t overload_max_pending_writes() const {
+    return data_.overload_max_pending_writes_;
+  }
+  void set_overload_max_pending_writes(size_t value) {
+    data_.overload_max_pending_writes_ = value;
+  }
+
+  // Value of the |RetryAfter| header of rejected requests, in seconds.
+  int overload_retry_after() const {
+    return data_.overload_retry_after_;
+  }
+  void set_overload_retry_after(int value) {
+    data_.overload_retry_after_ = value;
+  }
 };
 
 } // End of sippet namespace
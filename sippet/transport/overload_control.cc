@@ -0,0 +1,152 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/overload_control.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+
+namespace sippet {
+
+namespace {
+
+const int kSampleIntervalMilliseconds = 100;
+
+// The reduction is raised faster than it's lowered, so that the load is
+// quickly brought down and then slowly let in again.
+const int kRaiseStep = 20;
+const int kLowerStep = 10;
+
+// How long an advertised reduction is valid, in milliseconds. It's renewed
+// by every response sent while overloaded.
+const int kValidityMilliseconds = 2000;
+
+// Assumed when a downstream element doesn't send an "oc-validity".
+const int kDefaultValidityMilliseconds = 500;
+
+const char kLossAlgorithm[] = "loss";
+
+std::string GetParam(const ViaParam &via, const std::string &name) {
+  ViaParam::const_param_iterator i = via.param_find(name);
+  if (via.param_end() == i)
+    return std::string();
+  std::string value;
+  base::TrimString(i->second, "\"", &value);
+  return value;
+}
+
+}  // namespace
+
+OverloadControl::Throttle::Throttle()
+  : reduction(0),
+    sequence(0) {
+}
+
+OverloadControl::Throttle::~Throttle() {
+}
+
+OverloadControl::OverloadControl(const NetworkSettings &network_settings)
+  : max_loop_lag_(base::TimeDelta::FromMilliseconds(
+        network_settings.overload_max_loop_lag())),
+    max_transactions_(network_settings.overload_max_transactions()),
+    max_pending_writes_(network_settings.overload_max_pending_writes()),
+    timer_source_(network_settings.timer_source()),
+    overloaded_(false),
+    reduction_(0) {
+}
+
+OverloadControl::~OverloadControl() {
+}
+
+// static
+base::TimeDelta OverloadControl::GetSampleInterval() {
+  return base::TimeDelta::FromMilliseconds(kSampleIntervalMilliseconds);
+}
+
+void OverloadControl::Sample(base::TimeDelta loop_lag,
+                             size_t pending_transactions,
+                             size_t pending_writes) {
+  overloaded_ = loop_lag > max_loop_lag_
+      || pending_transactions > max_transactions_
+      || pending_writes > max_pending_writes_;
+  if (overloaded_)
+    reduction_ = std::min(100, reduction_ + kRaiseStep);
+  else
+    reduction_ = std::max(0, reduction_ - kLowerStep);
+}
+
+bool OverloadControl::ShouldReject() const {
+  return reduction_ > 0 && base::RandInt(0, 99) < reduction_;
+}
+
+void OverloadControl::StampResponseVia(ViaParam *via) const {
+  if (GetParam(*via, "oc-algo").find(kLossAlgorithm) == std::string::npos)
+    return;
+  via->param_set("oc", base::IntToString(reduction_));
+  via->param_set("oc-algo", std::string("\"") + kLossAlgorithm + "\"");
+  via->param_set("oc-validity",
+      base::IntToString(reduction_ > 0 ? kValidityMilliseconds : 0));
+  via->param_set("oc-seq",
+      base::StringPrintf("%.3f", base::Time::Now().ToDoubleT()));
+}
+
+void OverloadControl::StampRequestVia(ViaParam *via) const {
+  via->param_set("oc-algo", std::string("\"") + kLossAlgorithm + "\"");
+}
+
+void OverloadControl::OnResponseVia(const EndPoint &destination,
+                                    const ViaParam &via) {
+  std::string oc(GetParam(via, "oc"));
+  if (oc.empty())
+    return;
+  std::string algorithm(GetParam(via, "oc-algo"));
+  if (!algorithm.empty() && algorithm != kLossAlgorithm)
+    return;
+  int reduction;
+  if (!base::StringToInt(oc, &reduction))
+    return;
+  int validity = kDefaultValidityMilliseconds;
+  std::string oc_validity(GetParam(via, "oc-validity"));
+  if (!oc_validity.empty() && !base::StringToInt(oc_validity, &validity))
+    return;
+  double sequence = 0;
+  base::StringToDouble(GetParam(via, "oc-seq"), &sequence);
+
+  ThrottlesMap::iterator i = throttles_.find(destination);
+  if (throttles_.end() != i && sequence < i->second.sequence)
+    return;  // Reordered response
+  if (reduction <= 0 || validity <= 0) {
+    if (throttles_.end() != i)
+      throttles_.erase(i);
+    return;
+  }
+  Throttle &throttle = throttles_[destination];
+  throttle.reduction = std::min(100, reduction);
+  throttle.sequence = sequence;
+  throttle.expiration = timer_source_->NowTicks()
+      + base::TimeDelta::FromMilliseconds(validity);
+}
+
+bool OverloadControl::ShouldThrottle(const EndPoint &destination) {
+  int reduction = GetThrottleReduction(destination);
+  return reduction > 0 && base::RandInt(0, 99) < reduction;
+}
+
+int OverloadControl::GetThrottleReduction(const EndPoint &destination) {
+  ThrottlesMap::iterator i = throttles_.find(destination);
+  if (throttles_.end() == i)
+    return 0;
+  if (i->second.expiration <= timer_source_->NowTicks()) {
+    throttles_.erase(i);
+    return 0;
+  }
+  return i->second.reduction;
+}
+
+} // End of sippet namespace
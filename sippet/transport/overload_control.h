@@ -0,0 +1,97 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_OVERLOAD_CONTROL_H_
+#define SIPPET_TRANSPORT_OVERLOAD_CONTROL_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "sippet/message/headers/via.h"
+#include "sippet/transport/end_point.h"
+#include "sippet/transport/network_settings.h"
+
+namespace sippet {
+
+// Loss-based overload control (RFC 7339), used by the |NetworkLayer|.
+//
+// The local load is sampled periodically. While any of the measurements
+// exceeds its threshold, the percentage of new requests to be rejected is
+// raised, and lowered again once they are back to normal. The same
+// percentage is advertised to the upstream elements supporting the "loss"
+// algorithm, in the "oc" parameter of the topmost |Via| of responses.
+//
+// In the other direction, the percentages received from downstream
+// elements are kept by destination, and used to throttle the new requests
+// sent to them.
+class OverloadControl {
+ public:
+  explicit OverloadControl(const NetworkSettings &network_settings);
+  ~OverloadControl();
+
+  // Interval between calls to |Sample|.
+  static base::TimeDelta GetSampleInterval();
+
+  // Updates the local reduction from the current measurements.
+  void Sample(base::TimeDelta loop_lag,
+              size_t pending_transactions,
+              size_t pending_writes);
+
+  bool is_overloaded() const {
+    return overloaded_;
+  }
+
+  // Percentage of new requests currently being rejected.
+  int reduction() const {
+    return reduction_;
+  }
+
+  // Whether to reject a new incoming request.
+  bool ShouldReject() const;
+
+  // Adds the overload control parameters to the topmost |Via| of an
+  // outgoing response, if the upstream element announced support.
+  void StampResponseVia(ViaParam *via) const;
+
+  // Announces support in the topmost |Via| of an outgoing request.
+  void StampRequestVia(ViaParam *via) const;
+
+  // Takes the overload control parameters of the topmost |Via| of a
+  // response received from |destination|.
+  void OnResponseVia(const EndPoint &destination, const ViaParam &via);
+
+  // Whether to throttle a new request to |destination|.
+  bool ShouldThrottle(const EndPoint &destination);
+
+  // Percentage of requests to |destination| being throttled.
+  int GetThrottleReduction(const EndPoint &destination);
+
+ private:
+  struct Throttle {
+    Throttle();
+    ~Throttle();
+
+    int reduction;
+    double sequence;
+    base::TimeTicks expiration;
+  };
+
+  typedef std::map<EndPoint, Throttle, EndPointLess> ThrottlesMap;
+
+  base::TimeDelta max_loop_lag_;
+  size_t max_transactions_;
+  size_t max_pending_writes_;
+  TimerSource *timer_source_;
+
+  bool overloaded_;
+  int reduction_;
+  ThrottlesMap throttles_;
+
+  DISALLOW_COPY_AND_ASSIGN(OverloadControl);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TRANSPORT_OVERLOAD_CONTROL_H_
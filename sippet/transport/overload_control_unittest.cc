@@ -0,0 +1,89 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/overload_control.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+std::string GetParam(const ViaParam &via, const std::string &name) {
+  ViaParam::const_param_iterator i = via.param_find(name);
+  return via.param_end() == i ? std::string() : i->second;
+}
+
+}  // namespace
+
+TEST(OverloadControlTest, Reduction) {
+  NetworkSettings settings;
+  settings.set_overload_max_transactions(100);
+  OverloadControl overload_control(settings);
+  EXPECT_FALSE(overload_control.ShouldReject());
+
+  overload_control.Sample(base::TimeDelta(), 101, 0);
+  EXPECT_TRUE(overload_control.is_overloaded());
+  EXPECT_EQ(20, overload_control.reduction());
+  for (int i = 0; i < 10; ++i)
+    overload_control.Sample(base::TimeDelta::FromSeconds(1), 0, 0);
+  EXPECT_EQ(100, overload_control.reduction());
+  EXPECT_TRUE(overload_control.ShouldReject());
+
+  overload_control.Sample(base::TimeDelta(), 100, 0);
+  EXPECT_FALSE(overload_control.is_overloaded());
+  EXPECT_EQ(90, overload_control.reduction());
+  for (int i = 0; i < 10; ++i)
+    overload_control.Sample(base::TimeDelta(), 0, 0);
+  EXPECT_EQ(0, overload_control.reduction());
+  EXPECT_FALSE(overload_control.ShouldReject());
+}
+
+TEST(OverloadControlTest, StampResponseVia) {
+  NetworkSettings settings;
+  settings.set_overload_max_pending_writes(10);
+  OverloadControl overload_control(settings);
+  overload_control.Sample(base::TimeDelta(), 0, 11);
+
+  ViaParam unsupported(Protocol::UDP, net::HostPortPair("192.0.2.1", 5060));
+  overload_control.StampResponseVia(&unsupported);
+  EXPECT_TRUE(GetParam(unsupported, "oc").empty());
+
+  ViaParam supported(Protocol::UDP, net::HostPortPair("192.0.2.1", 5060));
+  overload_control.StampRequestVia(&supported);
+  overload_control.StampResponseVia(&supported);
+  EXPECT_EQ("20", GetParam(supported, "oc"));
+  EXPECT_EQ("2000", GetParam(supported, "oc-validity"));
+  EXPECT_FALSE(GetParam(supported, "oc-seq").empty());
+}
+
+TEST(OverloadControlTest, Throttle) {
+  NetworkSettings settings;
+  OverloadControl overload_control(settings);
+  EndPoint destination("192.0.2.1", 5060, Protocol::UDP);
+  EXPECT_FALSE(overload_control.ShouldThrottle(destination));
+
+  ViaParam via(Protocol::UDP, net::HostPortPair("192.0.2.2", 5060));
+  via.param_set("oc", "100");
+  via.param_set("oc-algo", "\"loss\"");
+  via.param_set("oc-validity", "60000");
+  via.param_set("oc-seq", "1282321615.782");
+  overload_control.OnResponseVia(destination, via);
+  EXPECT_EQ(100, overload_control.GetThrottleReduction(destination));
+  EXPECT_TRUE(overload_control.ShouldThrottle(destination));
+  EXPECT_FALSE(overload_control.ShouldThrottle(
+      EndPoint("192.0.2.3", 5060, Protocol::UDP)));
+
+  // Reordered responses are ignored.
+  via.param_set("oc", "0");
+  via.param_set("oc-seq", "1282321615.781");
+  overload_control.OnResponseVia(destination, via);
+  EXPECT_EQ(100, overload_control.GetThrottleReduction(destination));
+
+  via.param_set("oc-seq", "1282321615.783");
+  overload_control.OnResponseVia(destination, via);
+  EXPECT_EQ(0, overload_control.GetThrottleReduction(destination));
+}
+
+} // End of sippet namespace
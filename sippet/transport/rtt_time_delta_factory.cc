@@ -0,0 +1,134 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/rtt_time_delta_factory.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "sippet/transport/time_delta_provider.h"
+
+namespace sippet {
+
+namespace {
+
+const int64 kDefaultT1Milliseconds = 500;
+const int64 kDefaultMinT1Milliseconds = 50;
+const int64 kDefaultMaxT1Milliseconds = 3000;
+const size_t kDefaultMaxDestinations = 1024;
+
+}  // namespace
+
+RttTimeDeltaFactory::Stats::Stats()
+  : samples(0) {
+}
+
+RttTimeDeltaFactory::Stats::~Stats() {
+}
+
+RttTimeDeltaFactory::Estimate::Estimate()
+  : samples(0) {
+}
+
+RttTimeDeltaFactory::Estimate::~Estimate() {
+}
+
+RttTimeDeltaFactory::RttTimeDeltaFactory()
+  : min_t1_(base::TimeDelta::FromMilliseconds(kDefaultMinT1Milliseconds)),
+    max_t1_(base::TimeDelta::FromMilliseconds(kDefaultMaxT1Milliseconds)),
+    max_destinations_(kDefaultMaxDestinations) {
+  // Created on the main thread, used on the network thread.
+  thread_checker_.DetachFromThread();
+}
+
+RttTimeDeltaFactory::~RttTimeDeltaFactory() {
+}
+
+void RttTimeDeltaFactory::set_max_destinations(size_t max_destinations) {
+  DCHECK_LT(0u, max_destinations);
+  max_destinations_ = max_destinations;
+  EvictEstimates();
+}
+
+base::TimeDelta RttTimeDeltaFactory::GetT1(const EndPoint &destination) const {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  EstimatesMap::const_iterator i = estimates_.find(destination);
+  if (estimates_.end() == i)
+    return base::TimeDelta::FromMilliseconds(kDefaultT1Milliseconds);
+  return GetT1(i->second);
+}
+
+bool RttTimeDeltaFactory::GetStats(const EndPoint &destination,
+                                   Stats *stats) const {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  EstimatesMap::const_iterator i = estimates_.find(destination);
+  if (estimates_.end() == i)
+    return false;
+  stats->srtt = i->second.srtt;
+  stats->rttvar = i->second.rttvar;
+  stats->t1 = GetT1(i->second);
+  stats->samples = i->second.samples;
+  return true;
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateClientNonInvite() {
+  return GetDefaultFactory()->CreateClientNonInvite();
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateClientInvite() {
+  return GetDefaultFactory()->CreateClientInvite();
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateServerNonInvite() {
+  return GetDefaultFactory()->CreateServerNonInvite();
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateServerInvite() {
+  return GetDefaultFactory()->CreateServerInvite();
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateClientNonInviteTo(
+    const EndPoint &destination) {
+  return CreateClientNonInviteWithT1(GetT1(destination));
+}
+
+TimeDeltaProvider* RttTimeDeltaFactory::CreateClientInviteTo(
+    const EndPoint &destination) {
+  return CreateClientInviteWithT1(GetT1(destination));
+}
+
+void RttTimeDeltaFactory::OnRoundTripTime(const EndPoint &destination,
+                                          base::TimeDelta rtt) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  Estimate &estimate = estimates_[destination];
+  if (0 == estimate.samples) {
+    lru_.push_front(destination);
+    estimate.lru_position = lru_.begin();
+    estimate.srtt = rtt;
+    estimate.rttvar = rtt / 2;
+  } else {
+    base::TimeDelta error = estimate.srtt - rtt;
+    if (error < base::TimeDelta())
+      error = -error;
+    estimate.rttvar = (estimate.rttvar * 3 + error) / 4;
+    estimate.srtt = (estimate.srtt * 7 + rtt) / 8;
+    lru_.splice(lru_.begin(), lru_, estimate.lru_position);
+  }
+  ++estimate.samples;
+  EvictEstimates();
+}
+
+void RttTimeDeltaFactory::EvictEstimates() {
+  while (estimates_.size() > max_destinations_) {
+    estimates_.erase(lru_.back());
+    lru_.pop_back();
+  }
+}
+
+base::TimeDelta RttTimeDeltaFactory::GetT1(const Estimate &estimate) const {
+  base::TimeDelta t1 = estimate.srtt + estimate.rttvar * 4;
+  return std::min(std::max(t1, min_t1_), max_t1_);
+}
+
+} // End of sippet namespace
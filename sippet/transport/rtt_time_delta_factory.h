@@ -0,0 +1,107 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_RTT_TIME_DELTA_FACTORY_H_
+#define SIPPET_TRANSPORT_RTT_TIME_DELTA_FACTORY_H_
+
+#include <list>
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "sippet/transport/end_point.h"
+#include "sippet/transport/time_delta_factory.h"
+
+namespace sippet {
+
+// A |TimeDeltaFactory| adapting the T1 of client transactions to the
+// round-trip time measured to each destination, as TCP does for its
+// retransmission timeout (RFC 6298): T1 is SRTT + 4*RTTVAR, within
+// configurable bounds. Destinations not measured yet use the 500 ms of
+// RFC 3261. Server transactions keep the default timers.
+//
+// Estimates are kept for a limited number of destinations. Past it, the
+// destination measured least recently is forgotten.
+//
+// Set it with |NetworkSettings::set_time_delta_factory|. It must outlive
+// the |NetworkLayer|, and be used on the network thread only.
+class RttTimeDeltaFactory : public TimeDeltaFactory {
+ public:
+  struct Stats {
+    Stats();
+    ~Stats();
+
+    base::TimeDelta srtt;
+    base::TimeDelta rttvar;
+    // The T1 used for new client transactions.
+    base::TimeDelta t1;
+    int samples;
+  };
+
+  RttTimeDeltaFactory();
+  ~RttTimeDeltaFactory() override;
+
+  // Bounds of the estimated T1. Default to 50 ms and 3 seconds.
+  void set_min_t1(base::TimeDelta min_t1) {
+    min_t1_ = min_t1;
+  }
+  void set_max_t1(base::TimeDelta max_t1) {
+    max_t1_ = max_t1;
+  }
+
+  // Destinations to keep estimates for. Defaults to 1024.
+  void set_max_destinations(size_t max_destinations);
+
+  // The T1 used for new client transactions to |destination|.
+  base::TimeDelta GetT1(const EndPoint &destination) const;
+
+  // Fills |stats| for |destination|. Returns false if it was not measured.
+  bool GetStats(const EndPoint &destination, Stats *stats) const;
+
+  // TimeDeltaFactory methods:
+  TimeDeltaProvider* CreateClientNonInvite() override;
+  TimeDeltaProvider* CreateClientInvite() override;
+  TimeDeltaProvider* CreateServerNonInvite() override;
+  TimeDeltaProvider* CreateServerInvite() override;
+  TimeDeltaProvider* CreateClientNonInviteTo(
+      const EndPoint &destination) override;
+  TimeDeltaProvider* CreateClientInviteTo(
+      const EndPoint &destination) override;
+  void OnRoundTripTime(const EndPoint &destination,
+                       base::TimeDelta rtt) override;
+
+ private:
+  struct Estimate {
+    Estimate();
+    ~Estimate();
+
+    base::TimeDelta srtt;
+    base::TimeDelta rttvar;
+    int samples;
+    // Position in the recency list.
+    std::list<EndPoint>::iterator lru_position;
+  };
+
+  typedef std::map<EndPoint, Estimate, EndPointLess> EstimatesMap;
+
+  void EvictEstimates();
+
+  base::TimeDelta GetT1(const Estimate &estimate) const;
+
+  base::TimeDelta min_t1_;
+  base::TimeDelta max_t1_;
+  size_t max_destinations_;
+  EstimatesMap estimates_;
+  // Measured destinations, the most recent first.
+  std::list<EndPoint> lru_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(RttTimeDeltaFactory);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TRANSPORT_RTT_TIME_DELTA_FACTORY_H_
@@ -0,0 +1,113 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/rtt_time_delta_factory.h"
+
+#include "base/memory/scoped_ptr.h"
+#include "sippet/transport/time_delta_provider.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+base::TimeDelta Milliseconds(int64 ms) {
+  return base::TimeDelta::FromMilliseconds(ms);
+}
+
+}  // namespace
+
+TEST(RttTimeDeltaFactoryTest, DefaultTimers) {
+  scoped_ptr<TimeDeltaProvider> provider(
+      TimeDeltaFactory::GetDefaultFactory()->CreateClientNonInvite());
+  EXPECT_EQ(Milliseconds(500), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(1000), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(2000), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(4000), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(4000), provider->GetNextRetryDelay());
+  EXPECT_EQ(base::TimeDelta::FromSeconds(32), provider->GetTimeoutDelay());
+
+  provider.reset(TimeDeltaFactory::GetDefaultFactory()->CreateClientInvite());
+  EXPECT_EQ(Milliseconds(500), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(1000), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(2000), provider->GetNextRetryDelay());
+  EXPECT_EQ(base::TimeDelta::FromSeconds(32), provider->GetTimeoutDelay());
+}
+
+TEST(RttTimeDeltaFactoryTest, Estimate) {
+  RttTimeDeltaFactory factory;
+  EndPoint destination("192.0.2.1", 5060, Protocol::UDP);
+  RttTimeDeltaFactory::Stats stats;
+  EXPECT_FALSE(factory.GetStats(destination, &stats));
+  EXPECT_EQ(Milliseconds(500), factory.GetT1(destination));
+
+  factory.OnRoundTripTime(destination, Milliseconds(100));
+  ASSERT_TRUE(factory.GetStats(destination, &stats));
+  EXPECT_EQ(Milliseconds(100), stats.srtt);
+  EXPECT_EQ(Milliseconds(50), stats.rttvar);
+  EXPECT_EQ(Milliseconds(300), stats.t1);
+  EXPECT_EQ(1, stats.samples);
+
+  factory.OnRoundTripTime(destination, Milliseconds(180));
+  ASSERT_TRUE(factory.GetStats(destination, &stats));
+  EXPECT_EQ(Milliseconds(110), stats.srtt);
+  EXPECT_EQ(base::TimeDelta::FromMicroseconds(57500), stats.rttvar);
+  EXPECT_EQ(Milliseconds(340), stats.t1);
+  EXPECT_EQ(2, stats.samples);
+
+  // Other destinations are not affected.
+  EXPECT_EQ(Milliseconds(500),
+      factory.GetT1(EndPoint("192.0.2.2", 5060, Protocol::UDP)));
+}
+
+TEST(RttTimeDeltaFactoryTest, ForgetsLeastRecentDestinations) {
+  RttTimeDeltaFactory factory;
+  factory.set_max_destinations(2);
+  EndPoint first("192.0.2.1", 5060, Protocol::UDP);
+  EndPoint second("192.0.2.2", 5060, Protocol::UDP);
+  EndPoint third("192.0.2.3", 5060, Protocol::UDP);
+  RttTimeDeltaFactory::Stats stats;
+  factory.OnRoundTripTime(first, Milliseconds(100));
+  factory.OnRoundTripTime(second, Milliseconds(100));
+  // Measuring the first destination again makes it the most recent.
+  factory.OnRoundTripTime(first, Milliseconds(100));
+  factory.OnRoundTripTime(third, Milliseconds(100));
+  EXPECT_TRUE(factory.GetStats(first, &stats));
+  EXPECT_FALSE(factory.GetStats(second, &stats));
+  EXPECT_TRUE(factory.GetStats(third, &stats));
+  EXPECT_EQ(Milliseconds(500), factory.GetT1(second));
+
+  factory.set_max_destinations(1);
+  EXPECT_FALSE(factory.GetStats(first, &stats));
+  EXPECT_TRUE(factory.GetStats(third, &stats));
+}
+
+TEST(RttTimeDeltaFactoryTest, Bounds) {
+  RttTimeDeltaFactory factory;
+  EndPoint lan("192.0.2.1", 5060, Protocol::UDP);
+  EndPoint satellite("192.0.2.2", 5060, Protocol::UDP);
+  for (int i = 0; i < 20; ++i) {
+    factory.OnRoundTripTime(lan, Milliseconds(1));
+    factory.OnRoundTripTime(satellite, Milliseconds(5000));
+  }
+  EXPECT_EQ(Milliseconds(50), factory.GetT1(lan));
+  EXPECT_EQ(Milliseconds(3000), factory.GetT1(satellite));
+
+  factory.set_min_t1(Milliseconds(10));
+  EXPECT_EQ(Milliseconds(10), factory.GetT1(lan));
+
+  // Retransmissions follow T1, but timeouts are not shortened.
+  scoped_ptr<TimeDeltaProvider> provider(
+      factory.CreateClientNonInviteTo(lan));
+  EXPECT_EQ(Milliseconds(10), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(20), provider->GetNextRetryDelay());
+  EXPECT_EQ(base::TimeDelta::FromSeconds(32), provider->GetTimeoutDelay());
+
+  provider.reset(factory.CreateClientInviteTo(satellite));
+  EXPECT_EQ(Milliseconds(3000), provider->GetNextRetryDelay());
+  EXPECT_EQ(Milliseconds(6000), provider->GetNextRetryDelay());
+  EXPECT_EQ(base::TimeDelta::FromSeconds(192), provider->GetTimeoutDelay());
+}
+
+} // End of sippet namespace
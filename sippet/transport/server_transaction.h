@@ -32,6 +32,10 @@ class ServerTransaction :
 
   virtual void Close() = 0;
 
+  // Approximate bytes taken by the transaction and the messages it keeps
+  // for retransmissions.
+  virtual size_t EstimateMemoryUsage() const { return 0; }
+
  protected:
   friend class base::RefCountedThreadSafe<ServerTransaction>;
   virtual ~ServerTransaction() {}
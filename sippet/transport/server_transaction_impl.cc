@@ -7,6 +7,9 @@
 #include <string>
 
 #include "net/base/net_errors.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/base/tracing.h"
+#include "sippet/transport/transport_metrics.h"
 
 namespace sippet {
 
@@ -14,17 +17,27 @@ ServerTransactionImpl::ServerTransactionImpl(
                           const std::string &id,
                           const scoped_refptr<Channel> &channel,
                           TransactionDelegate *delegate,
-                          TimeDeltaFactory *time_delta_factory)
+                          TimeDeltaFactory *time_delta_factory,
+                          TimerSource *timer_source)
   : weak_factory_(this),
     id_(id), channel_(channel), delegate_(delegate),
-    time_delta_factory_(time_delta_factory) {
+    time_delta_factory_(time_delta_factory),
+    timer_source_(timer_source) {
   DCHECK(id.length());
   DCHECK(channel);
   DCHECK(delegate);
   DCHECK(time_delta_factory);
+  DCHECK(timer_source);
+  timer_source_->Attach(&retryTimer_);
+  timer_source_->Attach(&timedOutTimer_);
+  timer_source_->Attach(&terminateTimer_);
+  timer_source_->Attach(&provisionalTimer_);
+  TransportMetrics::Get()->server_transactions->Increment();
 }
 
-ServerTransactionImpl::~ServerTransactionImpl() {}
+ServerTransactionImpl::~ServerTransactionImpl() {
+  TransportMetrics::Get()->server_transactions->Decrement();
+}
 
 const std::string& ServerTransactionImpl::id() const {
   return id_;
@@ -38,6 +51,7 @@ void ServerTransactionImpl::Start(
       const scoped_refptr<Request> &incoming_request) {
   DCHECK(incoming_request);
   initial_request_ = incoming_request;
+  start_time_ = timer_source_->NowTicks();
   if (Method::INVITE == incoming_request->method()) {
     mode_ = MODE_INVITE;
     next_state_ = STATE_PROCEED_CALLING;
@@ -53,6 +67,8 @@ void ServerTransactionImpl::Start(
 void ServerTransactionImpl::Send(const scoped_refptr<Response> &response) {
   DCHECK(response);
   DCHECK(response->refer_to() == initial_request_);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ServerTransaction::Send",
+                                initial_request_->GetTransactionTraceId());
 
   if (STATE_PROCEED_CALLING < next_state_) {
     DVLOG(1) << "Ignored second final response attempt";
@@ -62,8 +78,6 @@ void ServerTransactionImpl::Send(const scoped_refptr<Response> &response) {
   if (STATE_PROCEED_CALLING == next_state_)
     StopProvisionalResponse();
 
-  LOG(INFO) << "Sent to " << channel_->destination().ToString();
-
   latest_response_ = response;
   int result = channel_->Send(response,
       base::Bind(&ServerTransactionImpl::OnSendWriteComplete,
@@ -81,6 +95,12 @@ void ServerTransactionImpl::OnSendWriteComplete(
 
   State state = next_state_;
   int response_code = response->response_code();
+  if (response_code >= 200) {
+    TransportMetrics *metrics = TransportMetrics::Get();
+    (MODE_INVITE == mode_ ? metrics->server_invite_latency
+                          : metrics->server_non_invite_latency)
+        ->AddTime(timer_source_->NowTicks() - start_time_);
+  }
   switch (state) {
     case STATE_TRYING:
       switch (response_code/100) {
@@ -129,12 +149,19 @@ void ServerTransactionImpl::HandleIncomingRequest(
       const scoped_refptr<Request> &request) {
   DCHECK(request);
   DCHECK(next_state_ != STATE_TERMINATED);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ServerTransaction::HandleIncomingRequest",
+                                initial_request_->GetTransactionTraceId());
+
+  TransportMetrics *metrics = TransportMetrics::Get();
+  if (Method::ACK != request->method() || STATE_CONFIRMED == next_state_)
+    metrics->request_retransmissions_received->Increment();
 
   int result = net::OK;
   if (STATE_PROCEEDING == next_state_
       || STATE_PROCEED_CALLING == next_state_
       || (STATE_COMPLETED == next_state_
           && Method::ACK != request->method())) {
+    metrics->response_retransmissions_sent->Increment();
     result = channel_->Send(latest_response_,
       base::Bind(&ServerTransactionImpl::OnRepeatResponseWriteComplete,
         this, request));
@@ -183,11 +210,23 @@ void ServerTransactionImpl::Close() {
   StopTimers();
 }
 
+size_t ServerTransactionImpl::EstimateMemoryUsage() const {
+  size_t bytes = sizeof(*this) + EstimateStringMemoryUsage(id_);
+  if (initial_request_.get())
+    bytes += initial_request_->EstimateMemoryUsage();
+  if (latest_response_.get())
+    bytes += latest_response_->EstimateMemoryUsage();
+  return bytes;
+}
+
 void ServerTransactionImpl::OnRetransmit() {
   DCHECK(!channel_->is_stream());
   DCHECK(MODE_INVITE == mode_);
   DCHECK(STATE_COMPLETED == next_state_);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ServerTransaction::OnRetransmit",
+                                initial_request_->GetTransactionTraceId());
 
+  TransportMetrics::Get()->response_retransmissions_sent->Increment();
   int result = channel_->Send(latest_response_,
       base::Bind(&ServerTransactionImpl::OnRetransmitWriteComplete,
           weak_factory_.GetWeakPtr()));
@@ -199,8 +238,11 @@ void ServerTransactionImpl::OnRetransmit() {
 void ServerTransactionImpl::OnTimedOut() {
   DCHECK(MODE_INVITE == mode_);
   DCHECK(STATE_COMPLETED == next_state_);
+  SIPPET_TRACE_EVENT_WITH_FLOW0("ServerTransaction::OnTimedOut",
+                                initial_request_->GetTransactionTraceId());
 
   next_state_ = STATE_TERMINATED;
+  TransportMetrics::Get()->timer_h_timeouts->Increment();
   delegate_->OnTimedOut(initial_request_);
   Terminate();
 }
@@ -285,6 +327,8 @@ void ServerTransactionImpl::ScheduleProvisionalResponse() {
 }
 
 void ServerTransactionImpl::Terminate() {
+  SIPPET_TRACE_EVENT0("ServerTransaction::Terminate");
+  SIPPET_TRACE_FLOW_END(initial_request_->GetTransactionTraceId());
   delegate_->OnTransactionTerminated(id_);
 }
 
@@ -10,6 +10,7 @@
 #include "sippet/transport/transaction_delegate.h"
 #include "sippet/transport/time_delta_factory.h"
 #include "sippet/transport/time_delta_provider.h"
+#include "sippet/transport/timer_source.h"
 
 namespace sippet {
 
@@ -21,7 +22,8 @@ class ServerTransactionImpl : public ServerTransaction {
         const std::string &id,
         const scoped_refptr<Channel> &channel,
         TransactionDelegate *delegate,
-        TimeDeltaFactory *time_delta_factory);
+        TimeDeltaFactory *time_delta_factory,
+        TimerSource *timer_source);
 
   // ServerTransaction methods:
   const std::string& id() const override;
@@ -32,6 +34,7 @@ class ServerTransactionImpl : public ServerTransaction {
           const scoped_refptr<Request> &request) override;
 
   void Close() override;
+  size_t EstimateMemoryUsage() const override;
  private:
   friend class base::RefCountedThreadSafe<ServerTransactionImpl>;
   ~ServerTransactionImpl() override;
@@ -63,6 +66,8 @@ class ServerTransactionImpl : public ServerTransaction {
   base::OneShotTimer<ServerTransactionImpl> timedOutTimer_;
   base::OneShotTimer<ServerTransactionImpl> terminateTimer_;
   base::OneShotTimer<ServerTransactionImpl> provisionalTimer_;
+  // Used to measure the time to the final response.
+  base::TimeTicks start_time_;
 
   void OnRetransmit();
   void OnTimedOut();
@@ -84,6 +89,7 @@ class ServerTransactionImpl : public ServerTransaction {
 
   TimeDeltaFactory *time_delta_factory_;
   scoped_ptr<TimeDeltaProvider> time_delta_provider_;
+  TimerSource *timer_source_;
   base::WeakPtrFactory<ServerTransactionImpl> weak_factory_;
 };
 
@@ -0,0 +1,447 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/simulated_network.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "net/base/net_errors.h"
+#include "sippet/base/raw_ostream.h"
+#include "sippet/message/message.h"
+#include "sippet/transport/network_layer.h"
+
+namespace sippet {
+
+namespace {
+
+// Any non-zero state will do for xorshift64*.
+const uint64 kDefaultRandomState = UINT64_C(0x9e3779b97f4a7c15);
+
+bool IsStreamProtocol(const Protocol &protocol) {
+  return Protocol::UDP != protocol;
+}
+
+}  // namespace
+
+// The end of a simulated channel. Messages sent through it are transmitted
+// by the network to the channel going the other way, which is opened by the
+// receiving network layer when needed.
+class SimulatedChannel : public Channel {
+ public:
+  SimulatedChannel(const base::WeakPtr<SimulatedNetwork> &network,
+                   const EndPoint &origin,
+                   const EndPoint &destination,
+                   Channel::Delegate *delegate);
+
+  int origin(EndPoint *origin) const override;
+  const EndPoint& destination() const override;
+
+  bool is_secure() const override;
+  bool is_connected() const override;
+  bool is_stream() const override;
+
+  void Connect() override;
+  int ReconnectIgnoringLastError() override;
+  int ReconnectWithCertificate(net::X509Certificate* client_cert) override;
+
+  int Send(const scoped_refptr<Message> &message,
+           const net::CompletionCallback& callback) override;
+
+  void Close() override;
+
+  void CloseWithError(int err) override;
+
+  void DetachDelegate() override;
+
+  // Called by the network when a message arrives. Messages arriving while
+  // connecting are delivered once connected.
+  void DeliverIncomingMessage(const scoped_refptr<Message> &message);
+
+  // Called by the network when the stream channel going the other way is
+  // closed.
+  void OnPeerClosed();
+
+ private:
+  friend class base::RefCountedThreadSafe<Channel>;
+  ~SimulatedChannel() override;
+
+  void OnConnected();
+
+  base::WeakPtr<SimulatedNetwork> network_;
+  EndPoint origin_;
+  EndPoint destination_;
+  Channel::Delegate *delegate_;
+  bool is_connected_;
+  bool is_closed_;
+  std::deque<scoped_refptr<Message> > pending_messages_;
+
+  base::WeakPtrFactory<SimulatedChannel> weak_ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedChannel);
+};
+
+SimulatedChannel::SimulatedChannel(
+    const base::WeakPtr<SimulatedNetwork> &network,
+    const EndPoint &origin,
+    const EndPoint &destination,
+    Channel::Delegate *delegate)
+  : network_(network),
+    origin_(origin),
+    destination_(destination),
+    delegate_(delegate),
+    is_connected_(false),
+    is_closed_(false),
+    weak_ptr_factory_(this) {
+  network_->AddChannel(this);
+}
+
+SimulatedChannel::~SimulatedChannel() {
+  if (network_ && !is_closed_)
+    network_->RemoveChannel(this);
+}
+
+int SimulatedChannel::origin(EndPoint *origin) const {
+  *origin = origin_;
+  return net::OK;
+}
+
+const EndPoint& SimulatedChannel::destination() const {
+  return destination_;
+}
+
+bool SimulatedChannel::is_secure() const {
+  return Protocol::TLS == destination_.protocol()
+      || Protocol::WSS == destination_.protocol();
+}
+
+bool SimulatedChannel::is_connected() const {
+  return is_connected_;
+}
+
+bool SimulatedChannel::is_stream() const {
+  return IsStreamProtocol(destination_.protocol());
+}
+
+void SimulatedChannel::Connect() {
+  DCHECK(network_);
+  DCHECK(!is_connected_);
+  network_->PostTask(base::Bind(&SimulatedChannel::OnConnected,
+                                weak_ptr_factory_.GetWeakPtr()),
+                     base::TimeDelta());
+}
+
+int SimulatedChannel::ReconnectIgnoringLastError() {
+  return net::ERR_NOT_IMPLEMENTED;
+}
+
+int SimulatedChannel::ReconnectWithCertificate(
+    net::X509Certificate* client_cert) {
+  return net::ERR_NOT_IMPLEMENTED;
+}
+
+int SimulatedChannel::Send(const scoped_refptr<Message> &message,
+                           const net::CompletionCallback& callback) {
+  if (!is_connected_ || !network_)
+    return net::ERR_SOCKET_NOT_CONNECTED;
+  network_->Transmit(origin_, destination_, message);
+  return net::OK;
+}
+
+void SimulatedChannel::Close() {
+  if (is_closed_)
+    return;
+  bool was_connected = is_connected_;
+  is_connected_ = false;
+  is_closed_ = true;
+  pending_messages_.clear();
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  if (!network_)
+    return;
+  network_->RemoveChannel(this);
+  if (was_connected && is_stream()) {
+    // The closing of a connection reaches the peer as any other message
+    // would, but regardless of the link conditions.
+    network_->PostTask(base::Bind(&SimulatedNetwork::ClosePeer, network_,
+                                  origin_, destination_),
+                       base::TimeDelta());
+  }
+}
+
+void SimulatedChannel::CloseWithError(int err) {
+  Close();
+}
+
+void SimulatedChannel::DetachDelegate() {
+  delegate_ = nullptr;
+  Close();
+}
+
+void SimulatedChannel::DeliverIncomingMessage(
+    const scoped_refptr<Message> &message) {
+  if (is_closed_)
+    return;
+  if (!is_connected_) {
+    pending_messages_.push_back(message);
+    return;
+  }
+  if (delegate_)
+    delegate_->OnIncomingMessage(this, message);
+}
+
+void SimulatedChannel::OnPeerClosed() {
+  if (!is_connected_)
+    return;
+  if (delegate_)
+    delegate_->OnChannelClosed(this, net::ERR_CONNECTION_CLOSED);
+  else
+    Close();
+}
+
+void SimulatedChannel::OnConnected() {
+  scoped_refptr<Channel> protect(this);
+  if (!network_ || !network_->GetNode(destination_.hostport())) {
+    if (delegate_)
+      delegate_->OnChannelConnected(this, net::ERR_CONNECTION_REFUSED);
+    return;
+  }
+  is_connected_ = true;
+  if (delegate_)
+    delegate_->OnChannelConnected(this, net::OK);
+  while (is_connected_ && !pending_messages_.empty()) {
+    scoped_refptr<Message> message(pending_messages_.front());
+    pending_messages_.pop_front();
+    if (delegate_)
+      delegate_->OnIncomingMessage(this, message);
+  }
+}
+
+SimulatedNetwork::LinkConditions::LinkConditions()
+  : loss_rate(0),
+    reorder_rate(0),
+    bandwidth(0) {
+}
+
+SimulatedNetwork::LinkConditions::~LinkConditions() {
+}
+
+SimulatedNetwork::Link::Link()
+  : has_conditions(false) {
+}
+
+SimulatedNetwork::Link::~Link() {
+}
+
+bool SimulatedNetwork::ChannelKeyLess::operator()(
+    const std::pair<EndPoint, EndPoint> &a,
+    const std::pair<EndPoint, EndPoint> &b) const {
+  EndPointLess less;
+  if (less(a.first, b.first))
+    return true;
+  if (less(b.first, a.first))
+    return false;
+  return less(a.second, b.second);
+}
+
+SimulatedNetwork::SimulatedNetwork(
+    const scoped_refptr<base::SingleThreadTaskRunner> &task_runner,
+    base::TickClock *clock,
+    uint64 seed)
+  : task_runner_(task_runner),
+    clock_(clock),
+    random_state_(seed ? seed : kDefaultRandomState),
+    messages_sent_(0),
+    messages_delivered_(0),
+    messages_dropped_(0),
+    weak_factory_(this) {
+  DCHECK(clock_);
+}
+
+SimulatedNetwork::~SimulatedNetwork() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(nodes_.empty());
+}
+
+void SimulatedNetwork::SetLinkConditions(const net::HostPortPair &from,
+                                         const net::HostPortPair &to,
+                                         const LinkConditions &conditions) {
+  Link &link = links_[LinkKey(from, to)];
+  link.conditions = conditions;
+  link.has_conditions = true;
+}
+
+void SimulatedNetwork::AddNode(SimulatedChannelFactory *factory) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (!nodes_.insert(std::make_pair(factory->address(), factory)).second)
+    NOTREACHED() << factory->address().ToString() << " already in use";
+}
+
+void SimulatedNetwork::RemoveNode(SimulatedChannelFactory *factory) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  nodes_.erase(factory->address());
+}
+
+SimulatedChannelFactory *SimulatedNetwork::GetNode(
+    const net::HostPortPair &address) const {
+  NodesMap::const_iterator i = nodes_.find(address);
+  return nodes_.end() == i ? nullptr : i->second;
+}
+
+void SimulatedNetwork::AddChannel(SimulatedChannel *channel) {
+  EndPoint origin;
+  ignore_result(channel->origin(&origin));
+  if (!channels_.insert(std::make_pair(
+          std::make_pair(origin, channel->destination()), channel)).second)
+    NOTREACHED() << "Duplicated channel to "
+                 << channel->destination().ToString();
+}
+
+void SimulatedNetwork::RemoveChannel(SimulatedChannel *channel) {
+  EndPoint origin;
+  ignore_result(channel->origin(&origin));
+  ChannelsMap::iterator i =
+      channels_.find(std::make_pair(origin, channel->destination()));
+  if (channels_.end() != i && channel == i->second)
+    channels_.erase(i);
+}
+
+SimulatedChannel *SimulatedNetwork::GetChannel(
+    const EndPoint &origin,
+    const EndPoint &destination) const {
+  ChannelsMap::const_iterator i =
+      channels_.find(std::make_pair(origin, destination));
+  return channels_.end() == i ? nullptr : i->second;
+}
+
+void SimulatedNetwork::Transmit(const EndPoint &origin,
+                                const EndPoint &destination,
+                                const scoped_refptr<Message> &message) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ++messages_sent_;
+
+  Link &link = links_[LinkKey(origin.hostport(), destination.hostport())];
+  const LinkConditions &conditions =
+      link.has_conditions ? link.conditions : default_conditions_;
+  bool is_datagram = !IsStreamProtocol(destination.protocol());
+  if (is_datagram && conditions.loss_rate > 0
+      && RandDouble() < conditions.loss_rate) {
+    ++messages_dropped_;
+    return;
+  }
+
+  base::TimeTicks now = Now();
+  base::TimeTicks departure = std::max(now, link.busy_until);
+  if (conditions.bandwidth > 0) {
+    raw_null_ostream os;
+    message->print(os);
+    int64 size = static_cast<int64>(os.tell());
+    departure += base::TimeDelta::FromMicroseconds(
+        size * base::Time::kMicrosecondsPerSecond / conditions.bandwidth);
+  }
+  link.busy_until = departure;
+
+  base::TimeDelta delay(conditions.latency);
+  if (conditions.jitter > base::TimeDelta()) {
+    delay += base::TimeDelta::FromMicroseconds(static_cast<int64>(
+        conditions.jitter.InMicroseconds() * (2 * RandDouble() - 1)));
+    delay = std::max(delay, base::TimeDelta());
+  }
+  base::TimeTicks arrival = departure + delay;
+  if (is_datagram && conditions.reorder_rate > 0
+      && RandDouble() < conditions.reorder_rate) {
+    arrival += conditions.latency + conditions.jitter;
+  } else {
+    arrival = std::max(arrival, link.last_arrival);
+    link.last_arrival = arrival;
+  }
+
+  // The sender may change the message once sent, such as a network layer
+  // replacing the branch when failing over, so the copy is taken now.
+  PostTask(base::Bind(&SimulatedNetwork::Deliver, weak_factory_.GetWeakPtr(),
+                      origin, destination, message->Copy(Message::Incoming)),
+           arrival - now);
+}
+
+void SimulatedNetwork::Deliver(const EndPoint &origin,
+                               const EndPoint &destination,
+                               const scoped_refptr<Message> &message) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  SimulatedChannel *channel = GetChannel(destination, origin);
+  if (!channel) {
+    SimulatedChannelFactory *node = GetNode(destination.hostport());
+    if (node) {
+      // Let the receiver open the channel the message arrives from.
+      int rv = node->network_layer()->Connect(origin);
+      if (net::OK != rv && net::ERR_IO_PENDING != rv) {
+        DVLOG(1) << destination.ToString() << " couldn't accept "
+                 << origin.ToString() << ": " << net::ErrorToString(rv);
+      }
+      channel = GetChannel(destination, origin);
+    }
+  }
+  if (!channel) {
+    ++messages_dropped_;
+    return;
+  }
+  ++messages_delivered_;
+  channel->DeliverIncomingMessage(message);
+}
+
+void SimulatedNetwork::ClosePeer(const EndPoint &origin,
+                                 const EndPoint &destination) {
+  SimulatedChannel *channel = GetChannel(destination, origin);
+  if (channel)
+    channel->OnPeerClosed();
+}
+
+void SimulatedNetwork::PostTask(const base::Closure &task,
+                                base::TimeDelta delay) {
+  task_runner_->PostDelayedTask(FROM_HERE, task, delay);
+}
+
+base::TimeTicks SimulatedNetwork::Now() const {
+  return clock_->NowTicks();
+}
+
+double SimulatedNetwork::RandDouble() {
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  uint64 value = random_state_ * UINT64_C(2685821657736338717);
+  // The 53 most significant bits fill the mantissa.
+  return (value >> 11) * (1.0 / (UINT64_C(1) << 53));
+}
+
+SimulatedChannelFactory::SimulatedChannelFactory(
+    SimulatedNetwork *network,
+    const net::HostPortPair &address,
+    NetworkLayer *network_layer)
+  : network_(network),
+    address_(address),
+    network_layer_(network_layer) {
+  DCHECK(network_);
+  DCHECK(network_layer_);
+  network_->AddNode(this);
+}
+
+SimulatedChannelFactory::~SimulatedChannelFactory() {
+  network_->RemoveNode(this);
+}
+
+int SimulatedChannelFactory::CreateChannel(
+    const EndPoint &destination,
+    Channel::Delegate *delegate,
+    scoped_refptr<Channel> *channel) {
+  DCHECK(channel);
+  EndPoint origin(address_, destination.protocol());
+  if (network_->GetChannel(origin, destination))
+    return net::ERR_ADDRESS_IN_USE;
+  *channel = new SimulatedChannel(network_->weak_factory_.GetWeakPtr(),
+                                  origin, destination, delegate);
+  return net::OK;
+}
+
+} // namespace sippet
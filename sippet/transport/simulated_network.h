@@ -0,0 +1,201 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_SIMULATED_NETWORK_H_
+#define SIPPET_TRANSPORT_SIMULATED_NETWORK_H_
+
+#include <map>
+#include <utility>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/tick_clock.h"
+#include "base/time/time.h"
+#include "net/base/host_port_pair.h"
+#include "sippet/transport/channel_factory.h"
+
+namespace sippet {
+
+class Message;
+class NetworkLayer;
+class SimulatedChannel;
+class SimulatedChannelFactory;
+
+// SimulatedNetwork connects |NetworkLayer|s in the same process, so that
+// thousands of them can exchange messages without sockets. Each network
+// layer is attached at an address by a |SimulatedChannelFactory|, and
+// messages sent between two addresses go through a link whose latency,
+// jitter, loss, reordering and bandwidth can be configured.
+//
+// Messages aren't printed nor parsed on the way: the receiver gets a copy
+// sharing the headers of the sent one (see |Message::Copy|). Deliveries are
+// posted as delayed tasks on the given task runner, and the randomness comes
+// from a seeded generator, so runs on a mock time task runner are both fast
+// and reproducible.
+//
+//   SimulatedNetwork network(task_runner, clock, seed);
+//   NetworkLayer server(&server_delegate);
+//   SimulatedChannelFactory server_factory(
+//       &network, net::HostPortPair("10.0.0.1", 5060), &server);
+//   server.RegisterChannelFactory(Protocol::UDP, &server_factory);
+//
+// As |NetworkLayer| only opens channels by itself, the first message coming
+// from an unknown peer makes the receiving network layer connect back to
+// the sender, and is delivered once that channel is connected.
+class SimulatedNetwork {
+ public:
+  struct LinkConditions {
+    LinkConditions();
+    ~LinkConditions();
+
+    // Messages take |latency|, give or take a uniformly distributed
+    // |jitter|. Jitter alone doesn't reorder the messages of a link.
+    base::TimeDelta latency;
+    base::TimeDelta jitter;
+    // Probability of a datagram being dropped.
+    double loss_rate;
+    // Probability of a datagram being held back for an extra |latency| plus
+    // |jitter|, letting the ones sent after it overtake.
+    double reorder_rate;
+    // Bytes per second the link can carry, or zero if unlimited. Only if
+    // limited, messages are measured by printing them to a stream that
+    // counts bytes: nothing is copied, but headers modified since parsed
+    // are formatted again.
+    int64 bandwidth;
+  };
+
+  SimulatedNetwork(
+      const scoped_refptr<base::SingleThreadTaskRunner> &task_runner,
+      base::TickClock *clock,
+      uint64 seed);
+  ~SimulatedNetwork();
+
+  // The conditions of links not given any by |SetLinkConditions|. Defaults
+  // to a perfect link.
+  void set_default_conditions(const LinkConditions &conditions) {
+    default_conditions_ = conditions;
+  }
+
+  // Sets the conditions of messages sent from |from| to |to|. The opposite
+  // direction is kept as is.
+  void SetLinkConditions(const net::HostPortPair &from,
+                         const net::HostPortPair &to,
+                         const LinkConditions &conditions);
+
+  // Messages passed to the sending channels.
+  int64 messages_sent() const { return messages_sent_; }
+  // Messages passed to the receiving network layers.
+  int64 messages_delivered() const { return messages_delivered_; }
+  // Messages lost, or sent to addresses nobody is attached at.
+  int64 messages_dropped() const { return messages_dropped_; }
+
+ private:
+  friend class SimulatedChannel;
+  friend class SimulatedChannelFactory;
+
+  typedef std::pair<net::HostPortPair, net::HostPortPair> LinkKey;
+
+  // A directional link, and the state of its queue.
+  struct Link {
+    Link();
+    ~Link();
+
+    LinkConditions conditions;
+    bool has_conditions;
+    // When the last message will have been put on the link.
+    base::TimeTicks busy_until;
+    // When the last message not reordered arrives.
+    base::TimeTicks last_arrival;
+  };
+
+  struct ChannelKeyLess {
+    bool operator()(const std::pair<EndPoint, EndPoint> &a,
+                    const std::pair<EndPoint, EndPoint> &b) const;
+  };
+
+  typedef std::map<LinkKey, Link> LinksMap;
+  typedef std::map<net::HostPortPair, SimulatedChannelFactory*> NodesMap;
+  typedef std::map<std::pair<EndPoint, EndPoint>, SimulatedChannel*,
+                   ChannelKeyLess> ChannelsMap;
+
+  void AddNode(SimulatedChannelFactory *factory);
+  void RemoveNode(SimulatedChannelFactory *factory);
+  SimulatedChannelFactory *GetNode(const net::HostPortPair &address) const;
+
+  void AddChannel(SimulatedChannel *channel);
+  void RemoveChannel(SimulatedChannel *channel);
+  SimulatedChannel *GetChannel(const EndPoint &origin,
+                               const EndPoint &destination) const;
+
+  // Schedules the delivery of a copy of |message| from |origin| to
+  // |destination|.
+  void Transmit(const EndPoint &origin,
+                const EndPoint &destination,
+                const scoped_refptr<Message> &message);
+  // Passes the copy taken by |Transmit| to the receiving channel.
+  void Deliver(const EndPoint &origin,
+               const EndPoint &destination,
+               const scoped_refptr<Message> &message);
+  // Tells the channel going from |destination| to |origin| that the
+  // connection was closed.
+  void ClosePeer(const EndPoint &origin, const EndPoint &destination);
+
+  // Posts |task| to run after |delay|.
+  void PostTask(const base::Closure &task, base::TimeDelta delay);
+  base::TimeTicks Now() const;
+
+  // A uniformly distributed number in [0, 1), from xorshift64*.
+  double RandDouble();
+
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
+  base::TickClock *clock_;
+  uint64 random_state_;
+
+  LinkConditions default_conditions_;
+  LinksMap links_;
+  NodesMap nodes_;
+  ChannelsMap channels_;
+
+  int64 messages_sent_;
+  int64 messages_delivered_;
+  int64 messages_dropped_;
+
+  base::ThreadChecker thread_checker_;
+  base::WeakPtrFactory<SimulatedNetwork> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedNetwork);
+};
+
+// SimulatedChannelFactory attaches a |NetworkLayer| to a |SimulatedNetwork|
+// at a given address. It's to be registered with the network layer for the
+// protocols to be simulated: stream protocols are reliable and ordered,
+// whatever the link conditions are.
+class SimulatedChannelFactory : public ChannelFactory {
+ public:
+  SimulatedChannelFactory(SimulatedNetwork *network,
+                          const net::HostPortPair &address,
+                          NetworkLayer *network_layer);
+  virtual ~SimulatedChannelFactory();
+
+  const net::HostPortPair &address() const { return address_; }
+  NetworkLayer *network_layer() const { return network_layer_; }
+
+  // ChannelFactory methods:
+  int CreateChannel(const EndPoint &destination,
+                    Channel::Delegate *delegate,
+                    scoped_refptr<Channel> *channel) override;
+
+ private:
+  SimulatedNetwork *network_;
+  net::HostPortPair address_;
+  NetworkLayer *network_layer_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedChannelFactory);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TRANSPORT_SIMULATED_NETWORK_H_
@@ -0,0 +1,301 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/simulated_network.h"
+
+#include <vector>
+
+#include "net/base/net_errors.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/transport/dns_lookup_mock.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/transport/sip_resolver.h"
+#include "sippet/transport/virtual_timer_source.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kClientAddress[] = "10.0.0.1";
+const char kServerAddress[] = "10.0.0.2";
+const uint16 kPort = 5060;
+
+NetworkSettings CreateSettings(TimerSource *timer_source) {
+  NetworkSettings settings;
+  settings.set_timer_source(timer_source);
+  return settings;
+}
+
+// Answers the incoming requests with a 200 OK, and records the incoming
+// responses and timeouts.
+class Peer : public NetworkLayer::Delegate {
+ public:
+  Peer(SimulatedNetwork *network, const char *address,
+       TimerSource *timer_source)
+    : Peer(network, address, CreateSettings(timer_source)) {
+  }
+  Peer(SimulatedNetwork *network, const char *address,
+       const NetworkSettings &settings)
+    : network_layer_(new NetworkLayer(this, settings)),
+      channel_factory_(network, net::HostPortPair(address, kPort),
+                       network_layer_.get()),
+      invite_response_code_(SIP_OK),
+      timeouts_(0) {
+    network_layer_->RegisterChannelFactory(Protocol::UDP, &channel_factory_);
+    network_layer_->RegisterChannelFactory(Protocol::TCP, &channel_factory_);
+  }
+  ~Peer() override {}
+
+  NetworkLayer *network_layer() { return network_layer_.get(); }
+  const std::vector<scoped_refptr<Request> > &requests() const {
+    return requests_;
+  }
+  const std::vector<scoped_refptr<Response> > &responses() const {
+    return responses_;
+  }
+  int timeouts() const { return timeouts_; }
+
+  // INVITEs are answered with |code| instead, such as a provisional one to
+  // keep their transactions pending.
+  void set_invite_response_code(StatusCode code) {
+    invite_response_code_ = code;
+  }
+
+  // NetworkLayer::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override {}
+  void OnChannelClosed(const EndPoint &destination) override {}
+  void OnIncomingRequest(const scoped_refptr<Request> &request) override {
+    requests_.push_back(request);
+    scoped_refptr<Response> response(request->CreateResponse(
+        Method::INVITE == request->method() ? invite_response_code_ : SIP_OK));
+    network_layer_->Send(response, net::CompletionCallback());
+  }
+  void OnIncomingResponse(const scoped_refptr<Response> &response) override {
+    responses_.push_back(response);
+  }
+  void OnTimedOut(const scoped_refptr<Request> &request) override {
+    ++timeouts_;
+  }
+  void OnTransportError(const scoped_refptr<Request> &request,
+                        int error) override {}
+
+ private:
+  scoped_ptr<NetworkLayer> network_layer_;
+  SimulatedChannelFactory channel_factory_;
+  std::vector<scoped_refptr<Request> > requests_;
+  std::vector<scoped_refptr<Response> > responses_;
+  StatusCode invite_response_code_;
+  int timeouts_;
+};
+
+class SimulatedNetworkTest : public testing::Test {
+ public:
+  SimulatedNetworkTest()
+    : network_(timer_source_.task_runner(), timer_source_.tick_clock(), 1) {
+  }
+
+  scoped_refptr<Request> CreateOptions(const std::string &transport) {
+    return CreateRequest(Method::OPTIONS,
+        GURL("sip:" + std::string(kServerAddress) + transport));
+  }
+
+  scoped_refptr<Request> CreateRequest(const Method &method,
+                                       const GURL &request_uri) {
+    scoped_refptr<Request> request(new Request(method, request_uri));
+    scoped_ptr<From> from(new From(GURL("sip:client@example.com")));
+    from->set_tag("1234");
+    request->push_back(from.Pass());
+    scoped_ptr<To> to(new To(GURL("sip:server@example.com")));
+    request->push_back(to.Pass());
+    scoped_ptr<CallId> call_id(new CallId("a84b4c76e66710"));
+    request->push_back(call_id.Pass());
+    scoped_ptr<Cseq> cseq(new Cseq(1, method));
+    request->push_back(cseq.Pass());
+    scoped_ptr<MaxForwards> max_forwards(new MaxForwards(70));
+    request->push_back(max_forwards.Pass());
+    return request;
+  }
+
+  int Send(Peer *peer, const scoped_refptr<Request> &request) {
+    return peer->network_layer()->Send(request, net::CompletionCallback());
+  }
+
+  VirtualTimerSource timer_source_;
+  SimulatedNetwork network_;
+};
+
+}  // namespace
+
+TEST_F(SimulatedNetworkTest, RequestAndResponse) {
+  SimulatedNetwork::LinkConditions conditions;
+  conditions.latency = base::TimeDelta::FromMilliseconds(20);
+  network_.set_default_conditions(conditions);
+  Peer client(&network_, kClientAddress, &timer_source_);
+  Peer server(&network_, kServerAddress, &timer_source_);
+
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, CreateOptions("")));
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(39));
+  EXPECT_EQ(1u, server.requests().size());
+  EXPECT_TRUE(client.responses().empty());
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(1));
+
+  ASSERT_EQ(1u, server.requests().size());
+  EXPECT_EQ(Message::Incoming, server.requests()[0]->direction());
+  ASSERT_EQ(1u, client.responses().size());
+  EXPECT_EQ(SIP_OK, client.responses()[0]->response_code());
+  EXPECT_EQ(2, network_.messages_delivered());
+}
+
+TEST_F(SimulatedNetworkTest, StreamsIgnoreLoss) {
+  SimulatedNetwork::LinkConditions conditions;
+  conditions.loss_rate = 1;
+  network_.set_default_conditions(conditions);
+  Peer client(&network_, kClientAddress, &timer_source_);
+  Peer server(&network_, kServerAddress, &timer_source_);
+
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            Send(&client, CreateOptions(";transport=tcp")));
+  timer_source_.RunUntilIdle();
+
+  EXPECT_EQ(1u, server.requests().size());
+  EXPECT_EQ(1u, client.responses().size());
+  EXPECT_EQ(0, network_.messages_dropped());
+}
+
+TEST_F(SimulatedNetworkTest, DatagramLoss) {
+  SimulatedNetwork::LinkConditions conditions;
+  conditions.loss_rate = 1;
+  Peer client(&network_, kClientAddress, &timer_source_);
+  Peer server(&network_, kServerAddress, &timer_source_);
+  network_.SetLinkConditions(net::HostPortPair(kClientAddress, kPort),
+                             net::HostPortPair(kServerAddress, kPort),
+                             conditions);
+
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, CreateOptions("")));
+  timer_source_.RunUntilIdle();
+  EXPECT_EQ(1, network_.messages_sent());
+  EXPECT_EQ(1, network_.messages_dropped());
+
+  // Retransmissions are lost as well, until Timer F fires after 64*T1.
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(31999));
+  EXPECT_EQ(0, client.timeouts());
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(1, client.timeouts());
+  EXPECT_TRUE(server.requests().empty());
+  EXPECT_LT(1, network_.messages_sent());
+  EXPECT_EQ(network_.messages_sent(), network_.messages_dropped());
+}
+
+TEST_F(SimulatedNetworkTest, LimitedBandwidth) {
+  SimulatedNetwork::LinkConditions conditions;
+  conditions.bandwidth = 1000;
+  network_.set_default_conditions(conditions);
+  Peer client(&network_, kClientAddress, &timer_source_);
+  Peer server(&network_, kServerAddress, &timer_source_);
+
+  scoped_refptr<Request> request(CreateOptions(""));
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, request));
+  timer_source_.RunUntilIdle();
+  EXPECT_EQ(1, network_.messages_sent());
+
+  // Each byte takes a millisecond.
+  int64 size = static_cast<int64>(request->ToString().size());
+  // Changes made once sent don't reach the receiver.
+  request->push_back(scoped_ptr<Header>(new Subject("Changed")));
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(size - 1));
+  EXPECT_TRUE(server.requests().empty());
+  timer_source_.FastForwardBy(base::TimeDelta::FromMilliseconds(1));
+  ASSERT_EQ(1u, server.requests().size());
+  EXPECT_FALSE(server.requests()[0]->get<Subject>());
+}
+
+TEST_F(SimulatedNetworkTest, UnknownDestination) {
+  Peer client(&network_, kClientAddress, &timer_source_);
+
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, CreateOptions("")));
+  timer_source_.RunUntilIdle();
+
+  EXPECT_EQ(0, network_.messages_sent());
+  EXPECT_TRUE(client.responses().empty());
+}
+
+TEST_F(SimulatedNetworkTest, CancelFollowsFailedOverInvite) {
+  // The primary target of example.com is down, so the INVITE fails over to
+  // the backup one, where its CANCEL must go as well.
+  DnsLookupMock dns_lookup;
+  dns_lookup.AddSrv("_sip._udp.example.com", 10, 0, kPort,
+                    "primary.example.com");
+  dns_lookup.AddSrv("_sip._udp.example.com", 20, 0, kPort,
+                    "backup.example.com");
+  SipResolver sip_resolver(&dns_lookup);
+  NetworkSettings settings(CreateSettings(&timer_source_));
+  settings.set_sip_resolver(&sip_resolver);
+  Peer client(&network_, kClientAddress, settings);
+  Peer backup(&network_, "backup.example.com", &timer_source_);
+  backup.set_invite_response_code(SIP_RINGING);
+
+  scoped_refptr<Request> invite(
+      CreateRequest(Method::INVITE, GURL("sip:bob@example.com")));
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, invite));
+  dns_lookup.CompletePending();
+  timer_source_.RunUntilIdle();
+  ASSERT_EQ(1u, backup.requests().size());
+  ASSERT_EQ(1u, client.responses().size());
+  EXPECT_EQ(SIP_RINGING, client.responses()[0]->response_code());
+
+  scoped_refptr<Request> cancel;
+  ASSERT_EQ(net::OK, invite->CreateCancel(cancel));
+  Send(&client, cancel);
+  timer_source_.RunUntilIdle();
+
+  // Were it resolved again, the CANCEL would fail over to the backup with a
+  // new branch, matching no transaction.
+  ASSERT_EQ(2u, backup.requests().size());
+  scoped_refptr<Request> received_cancel(backup.requests()[1]);
+  EXPECT_EQ(Method::CANCEL, received_cancel->method());
+  EXPECT_EQ(backup.requests()[0]->get<Via>()->front().branch(),
+            received_cancel->get<Via>()->front().branch());
+  ASSERT_EQ(2u, client.responses().size());
+  EXPECT_EQ(SIP_OK, client.responses()[1]->response_code());
+}
+
+TEST_F(SimulatedNetworkTest, OverloadedServerRejectsRequests) {
+  // A single pending transaction overloads the server.
+  NetworkSettings settings(CreateSettings(&timer_source_));
+  settings.set_enable_overload_control(true);
+  settings.set_overload_max_transactions(0);
+  settings.set_overload_retry_after(10);
+  Peer client(&network_, kClientAddress, &timer_source_);
+  Peer server(&network_, kServerAddress, settings);
+  server.set_invite_response_code(SIP_RINGING);
+
+  GURL server_uri("sip:" + std::string(kServerAddress));
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            Send(&client, CreateRequest(Method::INVITE, server_uri)));
+  timer_source_.RunUntilIdle();
+  ASSERT_EQ(1u, server.requests().size());
+  EXPECT_EQ(1u, server.network_layer()->server_transaction_count());
+
+  // Five overloaded samples take the reduction to 100%.
+  timer_source_.FastForwardBy(OverloadControl::GetSampleInterval() * 5);
+  ASSERT_TRUE(server.network_layer()->overload_control());
+  EXPECT_EQ(100, server.network_layer()->overload_control()->reduction());
+
+  EXPECT_EQ(net::ERR_IO_PENDING, Send(&client, CreateOptions("")));
+  timer_source_.RunUntilIdle();
+
+  // The OPTIONS is answered statelessly, without reaching the delegate.
+  EXPECT_EQ(1u, server.requests().size());
+  EXPECT_EQ(1u, server.network_layer()->server_transaction_count());
+  ASSERT_EQ(2u, client.responses().size());
+  scoped_refptr<Response> response(client.responses()[1]);
+  EXPECT_EQ(SIP_SERVICE_UNAVAILABLE, response->response_code());
+  RetryAfter *retry_after = response->get<RetryAfter>();
+  ASSERT_TRUE(retry_after);
+  EXPECT_EQ(10u, retry_after->value());
+}
+
+} // namespace sippet
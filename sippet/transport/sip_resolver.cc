@@ -0,0 +1,544 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/sip_resolver.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/weak_ptr.h"
+#include "base/rand_util.h"
+#include "base/stl_util.h"
+#include "base/strings/string_util.h"
+#include "net/base/net_errors.h"
+#include "sippet/uri/uri.h"
+
+namespace sippet {
+
+namespace {
+
+const int kDefaultNegativeTtlSeconds = 300;
+
+const char kNaptrKeyPrefix[] = "NAPTR ";
+const char kSrvKeyPrefix[] = "SRV ";
+
+// Transports of the NAPTR services (RFC 3263 and RFC 7118).
+const struct {
+  const char *service;
+  Protocol::Type protocol;
+} kNaptrServices[] = {
+  { "SIP+D2U", Protocol::UDP },
+  { "SIP+D2T", Protocol::TCP },
+  { "SIPS+D2T", Protocol::TLS },
+  { "SIP+D2S", Protocol::SCTP },
+  { "SIP+D2W", Protocol::WS },
+  { "SIPS+D2W", Protocol::WSS },
+};
+
+// Transports tried, in this order, when there are no NAPTR records.
+const Protocol::Type kSipProtocols[] = {
+  Protocol::UDP, Protocol::TCP, Protocol::TLS,
+};
+const Protocol::Type kSipsProtocols[] = {
+  Protocol::TLS,
+};
+
+bool IsSecure(const Protocol &protocol) {
+  return Protocol::TLS == protocol || Protocol::WSS == protocol;
+}
+
+uint16 GetDefaultPort(const Protocol &protocol) {
+  return IsSecure(protocol) ? 5061 : 5060;
+}
+
+// Returns an empty string for transports without SRV records.
+std::string GetSrvPrefix(const Protocol &protocol) {
+  switch (protocol.type()) {
+    case Protocol::UDP:
+      return "_sip._udp.";
+    case Protocol::TCP:
+      return "_sip._tcp.";
+    case Protocol::TLS:
+      return "_sips._tcp.";
+    case Protocol::SCTP:
+      return "_sip._sctp.";
+    default:
+      return std::string();
+  }
+}
+
+bool NaptrRecordLess(const SipResolver::NaptrRecord &a,
+                     const SipResolver::NaptrRecord &b) {
+  if (a.order != b.order)
+    return a.order < b.order;
+  return a.preference < b.preference;
+}
+
+// Zero weight records go first within their priority, as in RFC 2782.
+bool SrvRecordLess(const SipResolver::SrvRecord &a,
+                   const SipResolver::SrvRecord &b) {
+  if (a.priority != b.priority)
+    return a.priority < b.priority;
+  return 0 == a.weight && 0 != b.weight;
+}
+
+}  // namespace
+
+class SipResolver::Job {
+ public:
+  Job(SipResolver *resolver,
+      const SipURI &uri,
+      const ResolveCallback &callback);
+  ~Job();
+
+  int Start();
+
+  const std::vector<EndPoint> &targets() const {
+    return targets_;
+  }
+
+ private:
+  enum State {
+    STATE_LOOKUP_NAPTR,
+    STATE_LOOKUP_NAPTR_COMPLETE,
+    STATE_LOOKUP_SRV,
+    STATE_LOOKUP_SRV_COMPLETE,
+    STATE_NONE,
+  };
+
+  struct SrvQuery {
+    std::string name;
+    Protocol protocol;
+  };
+
+  void OnIOComplete(int result);
+  void OnLookupNaptrComplete(int result,
+                             const std::vector<NaptrRecord> &records,
+                             base::TimeDelta ttl);
+  void OnLookupSrvComplete(int result,
+                           const std::vector<SrvRecord> &records,
+                           base::TimeDelta ttl);
+
+  int DoLoop(int last_io_result);
+  int DoLookupNaptr();
+  int DoLookupNaptrComplete(int result);
+  int DoLookupSrv();
+  int DoLookupSrvComplete(int result);
+
+  // Queries the SRV records of the usable NAPTR records, or of the
+  // supported transports if there are none.
+  void AddSrvQueries();
+  void AddSrvQuery(const std::string &name, const Protocol &protocol);
+
+  // Appends the targets of |srv_records_| in the order to be tried.
+  void AddTargets(const Protocol &protocol);
+
+  SipResolver *resolver_;
+  SipURI uri_;
+  std::string domain_;
+  Protocol protocol_;
+  std::vector<EndPoint> targets_;
+  ResolveCallback callback_;
+  State next_state_;
+
+  std::vector<NaptrRecord> naptr_records_;
+  std::vector<SrvRecord> srv_records_;
+  base::TimeDelta ttl_;
+  std::vector<SrvQuery> srv_queries_;
+  size_t next_srv_query_;
+
+  base::WeakPtrFactory<Job> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Job);
+};
+
+SipResolver::Job::Job(SipResolver *resolver,
+                      const SipURI &uri,
+                      const ResolveCallback &callback)
+  : resolver_(resolver),
+    uri_(uri),
+    domain_(uri.HostNoBrackets()),
+    callback_(callback),
+    next_state_(STATE_NONE),
+    next_srv_query_(0),
+    weak_factory_(this) {
+}
+
+SipResolver::Job::~Job() {
+}
+
+int SipResolver::Job::Start() {
+  if (domain_.empty())
+    return net::ERR_INVALID_ARGUMENT;
+
+  std::pair<bool, std::string> transport = uri_.parameter("transport");
+  if (transport.first) {
+    protocol_.set_str(transport.second);
+    // SIPS URIs are only reached through secure transports.
+    if (uri_.SchemeIsSecure()) {
+      if (Protocol::TCP == protocol_)
+        protocol_ = Protocol::TLS;
+      else if (Protocol::WS == protocol_)
+        protocol_ = Protocol::WSS;
+    }
+  }
+
+  // Numeric hosts and explicit ports need no lookups, only a transport.
+  if (uri_.HostIsIPAddress() || uri_.has_port()) {
+    Protocol protocol(protocol_);
+    if (Protocol::Unknown == protocol)
+      protocol = uri_.SchemeIsSecure() ? Protocol::TLS : Protocol::UDP;
+    uint16 port = uri_.has_port()
+        ? static_cast<uint16>(uri_.IntPort()) : GetDefaultPort(protocol);
+    targets_.push_back(EndPoint(uri_.host(), port, protocol));
+    return net::OK;
+  }
+
+  if (Protocol::Unknown == protocol_) {
+    next_state_ = STATE_LOOKUP_NAPTR;
+  } else {
+    AddSrvQuery(GetSrvPrefix(protocol_) + domain_, protocol_);
+    next_state_ = STATE_LOOKUP_SRV;
+  }
+  return DoLoop(net::OK);
+}
+
+void SipResolver::Job::OnIOComplete(int result) {
+  DCHECK_NE(STATE_NONE, next_state_);
+  int rv = DoLoop(result);
+  if (rv != net::ERR_IO_PENDING) {
+    ResolveCallback callback(callback_);
+    std::vector<EndPoint> targets;
+    targets.swap(targets_);
+    resolver_->OnJobComplete(this);
+    callback.Run(rv, targets);
+  }
+}
+
+void SipResolver::Job::OnLookupNaptrComplete(
+    int result,
+    const std::vector<NaptrRecord> &records,
+    base::TimeDelta ttl) {
+  naptr_records_ = records;
+  ttl_ = ttl;
+  OnIOComplete(result);
+}
+
+void SipResolver::Job::OnLookupSrvComplete(
+    int result,
+    const std::vector<SrvRecord> &records,
+    base::TimeDelta ttl) {
+  srv_records_ = records;
+  ttl_ = ttl;
+  OnIOComplete(result);
+}
+
+int SipResolver::Job::DoLoop(int last_io_result) {
+  DCHECK_NE(next_state_, STATE_NONE);
+  int rv = last_io_result;
+  do {
+    State state = next_state_;
+    next_state_ = STATE_NONE;
+    switch (state) {
+      case STATE_LOOKUP_NAPTR:
+        DCHECK_EQ(net::OK, rv);
+        rv = DoLookupNaptr();
+        break;
+      case STATE_LOOKUP_NAPTR_COMPLETE:
+        rv = DoLookupNaptrComplete(rv);
+        break;
+      case STATE_LOOKUP_SRV:
+        DCHECK_EQ(net::OK, rv);
+        rv = DoLookupSrv();
+        break;
+      case STATE_LOOKUP_SRV_COMPLETE:
+        rv = DoLookupSrvComplete(rv);
+        break;
+      default:
+        NOTREACHED() << "bad state";
+        rv = net::ERR_UNEXPECTED;
+        break;
+    }
+  } while (rv != net::ERR_IO_PENDING && next_state_ != STATE_NONE);
+  return rv;
+}
+
+int SipResolver::Job::DoLookupNaptr() {
+  if (resolver_->GetCachedNaptr(domain_, &naptr_records_)) {
+    AddSrvQueries();
+    next_state_ = STATE_LOOKUP_SRV;
+    return net::OK;
+  }
+  next_state_ = STATE_LOOKUP_NAPTR_COMPLETE;
+  resolver_->dns_lookup_->LookupNaptr(domain_,
+      base::Bind(&Job::OnLookupNaptrComplete, weak_factory_.GetWeakPtr()));
+  return net::ERR_IO_PENDING;
+}
+
+int SipResolver::Job::DoLookupNaptrComplete(int result) {
+  resolver_->CacheNaptr(domain_, result, naptr_records_, ttl_);
+  if (net::OK != result) {
+    DVLOG(1) << "No NAPTR records for " << domain_ << ": "
+             << net::ErrorToString(result);
+    naptr_records_.clear();
+  }
+  AddSrvQueries();
+  next_state_ = STATE_LOOKUP_SRV;
+  return net::OK;
+}
+
+int SipResolver::Job::DoLookupSrv() {
+  if (next_srv_query_ == srv_queries_.size()) {
+    // Without SRV records, the host itself is the target.
+    if (targets_.empty()) {
+      Protocol protocol(protocol_);
+      if (Protocol::Unknown == protocol)
+        protocol = uri_.SchemeIsSecure() ? Protocol::TLS : Protocol::UDP;
+      targets_.push_back(
+          EndPoint(domain_, GetDefaultPort(protocol), protocol));
+    }
+    return net::OK;
+  }
+  const SrvQuery &query = srv_queries_[next_srv_query_];
+  srv_records_.clear();
+  if (resolver_->GetCachedSrv(query.name, &srv_records_)) {
+    AddTargets(query.protocol);
+    ++next_srv_query_;
+    next_state_ = STATE_LOOKUP_SRV;
+    return net::OK;
+  }
+  next_state_ = STATE_LOOKUP_SRV_COMPLETE;
+  resolver_->dns_lookup_->LookupSrv(query.name,
+      base::Bind(&Job::OnLookupSrvComplete, weak_factory_.GetWeakPtr()));
+  return net::ERR_IO_PENDING;
+}
+
+int SipResolver::Job::DoLookupSrvComplete(int result) {
+  const SrvQuery &query = srv_queries_[next_srv_query_];
+  resolver_->CacheSrv(query.name, result, srv_records_, ttl_);
+  if (net::OK == result) {
+    AddTargets(query.protocol);
+  } else {
+    DVLOG(1) << "No SRV records for " << query.name << ": "
+             << net::ErrorToString(result);
+  }
+  ++next_srv_query_;
+  next_state_ = STATE_LOOKUP_SRV;
+  return net::OK;
+}
+
+void SipResolver::Job::AddSrvQueries() {
+  std::stable_sort(naptr_records_.begin(), naptr_records_.end(),
+                   NaptrRecordLess);
+  for (std::vector<NaptrRecord>::const_iterator i = naptr_records_.begin(),
+       ie = naptr_records_.end(); i != ie; ++i) {
+    if (!base::EqualsCaseInsensitiveASCII(i->flags, "s"))
+      continue;
+    for (size_t j = 0; j < arraysize(kNaptrServices); ++j) {
+      if (!base::EqualsCaseInsensitiveASCII(i->services,
+                                            kNaptrServices[j].service))
+        continue;
+      Protocol protocol(kNaptrServices[j].protocol);
+      if (!uri_.SchemeIsSecure() || IsSecure(protocol))
+        AddSrvQuery(i->replacement, protocol);
+      break;
+    }
+  }
+  if (!srv_queries_.empty())
+    return;
+  if (uri_.SchemeIsSecure()) {
+    for (size_t i = 0; i < arraysize(kSipsProtocols); ++i) {
+      Protocol protocol(kSipsProtocols[i]);
+      AddSrvQuery(GetSrvPrefix(protocol) + domain_, protocol);
+    }
+  } else {
+    for (size_t i = 0; i < arraysize(kSipProtocols); ++i) {
+      Protocol protocol(kSipProtocols[i]);
+      AddSrvQuery(GetSrvPrefix(protocol) + domain_, protocol);
+    }
+  }
+}
+
+void SipResolver::Job::AddSrvQuery(const std::string &name,
+                                   const Protocol &protocol) {
+  // Transports without SRV records are reached at their default ports.
+  if (GetSrvPrefix(protocol).empty())
+    return;
+  SrvQuery query;
+  query.name = name;
+  query.protocol = protocol;
+  srv_queries_.push_back(query);
+}
+
+void SipResolver::Job::AddTargets(const Protocol &protocol) {
+  OrderSrvRecords(&srv_records_);
+  for (std::vector<SrvRecord>::const_iterator i = srv_records_.begin(),
+       ie = srv_records_.end(); i != ie; ++i) {
+    std::string target(i->target);
+    if (!target.empty() && '.' == target[target.size() - 1])
+      target.resize(target.size() - 1);
+    // A target of "." means the service is not available.
+    if (target.empty())
+      continue;
+    targets_.push_back(EndPoint(target, i->port, protocol));
+  }
+}
+
+SipResolver::NaptrRecord::NaptrRecord()
+  : order(0), preference(0) {
+}
+
+SipResolver::NaptrRecord::~NaptrRecord() {
+}
+
+SipResolver::SrvRecord::SrvRecord()
+  : priority(0), weight(0), port(0) {
+}
+
+SipResolver::SrvRecord::SrvRecord(uint16 priority, uint16 weight,
+                                  uint16 port, const std::string &target)
+  : priority(priority), weight(weight), port(port), target(target) {
+}
+
+SipResolver::SrvRecord::~SrvRecord() {
+}
+
+SipResolver::CacheEntry::CacheEntry() {
+}
+
+SipResolver::CacheEntry::~CacheEntry() {
+}
+
+SipResolver::SipResolver(DnsLookup *dns_lookup)
+  : dns_lookup_(dns_lookup),
+    negative_ttl_(
+        base::TimeDelta::FromSeconds(kDefaultNegativeTtlSeconds)),
+    timer_source_(TimerSource::GetDefault()) {
+  DCHECK(dns_lookup);
+  // Created on the main thread, used on the network thread.
+  thread_checker_.DetachFromThread();
+}
+
+SipResolver::~SipResolver() {
+  STLDeleteElements(&jobs_);
+}
+
+int SipResolver::Resolve(const GURL &uri,
+                         std::vector<EndPoint> *targets,
+                         const ResolveCallback &callback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(targets);
+  if (!uri.SchemeIs("sip") && !uri.SchemeIs("sips"))
+    return net::ERR_INVALID_ARGUMENT;
+  scoped_ptr<Job> job(new Job(this, SipURI(uri), callback));
+  int rv = job->Start();
+  if (net::ERR_IO_PENDING == rv)
+    jobs_.insert(job.release());
+  else
+    *targets = job->targets();
+  return rv;
+}
+
+void SipResolver::ClearCache() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  cache_.clear();
+}
+
+void SipResolver::OrderSrvRecords(std::vector<SrvRecord> *records) {
+  std::stable_sort(records->begin(), records->end(), SrvRecordLess);
+  std::vector<SrvRecord>::iterator begin = records->begin();
+  while (begin != records->end()) {
+    std::vector<SrvRecord>::iterator end = begin;
+    while (end != records->end() && end->priority == begin->priority)
+      ++end;
+    // Pick the records of this priority one by one, each with a chance
+    // proportional to its weight among the ones not picked yet.
+    for (; begin != end; ++begin) {
+      int sum = 0;
+      for (std::vector<SrvRecord>::iterator i = begin; i != end; ++i)
+        sum += i->weight;
+      int choice = base::RandInt(0, sum);
+      std::vector<SrvRecord>::iterator selected = begin;
+      int running_sum = selected->weight;
+      while (running_sum < choice) {
+        ++selected;
+        running_sum += selected->weight;
+      }
+      std::rotate(begin, selected, selected + 1);
+    }
+  }
+}
+
+bool SipResolver::GetCachedNaptr(const std::string &domain,
+                                 std::vector<NaptrRecord> *records) {
+  CacheEntry *entry = GetCacheEntry(kNaptrKeyPrefix + domain);
+  if (!entry)
+    return false;
+  *records = entry->naptr_records;
+  return true;
+}
+
+bool SipResolver::GetCachedSrv(const std::string &name,
+                               std::vector<SrvRecord> *records) {
+  CacheEntry *entry = GetCacheEntry(kSrvKeyPrefix + name);
+  if (!entry)
+    return false;
+  *records = entry->srv_records;
+  return true;
+}
+
+void SipResolver::CacheNaptr(const std::string &domain, int result,
+                             const std::vector<NaptrRecord> &records,
+                             base::TimeDelta ttl) {
+  if (net::OK == result && records.empty())
+    result = net::ERR_NAME_NOT_RESOLVED;
+  CacheEntry *entry = AddCacheEntry(kNaptrKeyPrefix + domain, result, ttl);
+  if (entry && net::OK == result)
+    entry->naptr_records = records;
+}
+
+void SipResolver::CacheSrv(const std::string &name, int result,
+                           const std::vector<SrvRecord> &records,
+                           base::TimeDelta ttl) {
+  if (net::OK == result && records.empty())
+    result = net::ERR_NAME_NOT_RESOLVED;
+  CacheEntry *entry = AddCacheEntry(kSrvKeyPrefix + name, result, ttl);
+  if (entry && net::OK == result)
+    entry->srv_records = records;
+}
+
+SipResolver::CacheEntry *SipResolver::GetCacheEntry(const std::string &key) {
+  CacheMap::iterator i = cache_.find(key);
+  if (cache_.end() == i)
+    return NULL;
+  if (i->second.expiration <= timer_source_->NowTicks()) {
+    cache_.erase(i);
+    return NULL;
+  }
+  return &i->second;
+}
+
+SipResolver::CacheEntry *SipResolver::AddCacheEntry(const std::string &key,
+                                                    int result,
+                                                    base::TimeDelta ttl) {
+  // Lookups that failed for other reasons are retried next time.
+  if (net::ERR_NAME_NOT_RESOLVED == result)
+    ttl = negative_ttl_;
+  else if (net::OK != result)
+    return NULL;
+  if (ttl <= base::TimeDelta())
+    return NULL;
+  CacheEntry &entry = cache_[key];
+  entry = CacheEntry();
+  entry.expiration = timer_source_->NowTicks() + ttl;
+  return &entry;
+}
+
+void SipResolver::OnJobComplete(Job *job) {
+  jobs_.erase(job);
+  delete job;
+}
+
+} // End of sippet namespace
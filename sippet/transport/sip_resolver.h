@@ -0,0 +1,168 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_SIP_RESOLVER_H_
+#define SIPPET_TRANSPORT_SIP_RESOLVER_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/logging.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "sippet/transport/end_point.h"
+#include "sippet/transport/timer_source.h"
+#include "url/gurl.h"
+
+namespace sippet {
+
+// Locates the SIP servers of a SIP or SIPS URI, as described in RFC 3263.
+//
+// Numeric hosts and explicit ports are used as they are. Otherwise, the
+// transports are selected by the NAPTR records of the host, and the
+// servers by the SRV records of each transport, ordered by priority and
+// weight (RFC 2782). When none are found, the host is used with the
+// default port of the transport. The records are cached until their TTL
+// expires, and domains without records for a while.
+//
+// The targets are returned in the order they should be tried, their hosts
+// being resolved to addresses when the channels connect. Set it with
+// |NetworkSettings::set_sip_resolver| to have the |NetworkLayer| fail over
+// to the next target when a request can't be delivered to the current one.
+class SipResolver {
+ public:
+  struct NaptrRecord {
+    NaptrRecord();
+    ~NaptrRecord();
+
+    uint16 order;
+    uint16 preference;
+    std::string flags;
+    std::string services;
+    std::string replacement;
+  };
+
+  struct SrvRecord {
+    SrvRecord();
+    SrvRecord(uint16 priority, uint16 weight, uint16 port,
+              const std::string &target);
+    ~SrvRecord();
+
+    uint16 priority;
+    uint16 weight;
+    uint16 port;
+    std::string target;
+  };
+
+  // The DNS queries made by the resolver. The callbacks are always run
+  // asynchronously, with the lowest TTL of the records, and may be run
+  // after the resolver is gone. Names without records of the queried type
+  // complete with |net::ERR_NAME_NOT_RESOLVED|.
+  class DnsLookup {
+   public:
+    typedef base::Callback<void(int result,
+                                const std::vector<NaptrRecord> &records,
+                                base::TimeDelta ttl)> NaptrCallback;
+    typedef base::Callback<void(int result,
+                                const std::vector<SrvRecord> &records,
+                                base::TimeDelta ttl)> SrvCallback;
+
+    virtual ~DnsLookup() {}
+
+    virtual void LookupNaptr(const std::string &domain,
+                             const NaptrCallback &callback) = 0;
+    virtual void LookupSrv(const std::string &name,
+                           const SrvCallback &callback) = 0;
+  };
+
+  typedef base::Callback<void(int result,
+                              const std::vector<EndPoint> &targets)>
+      ResolveCallback;
+
+  // |dns_lookup| is not owned, and must outlive the |SipResolver|.
+  explicit SipResolver(DnsLookup *dns_lookup);
+  ~SipResolver();
+
+  // Time to remember the names without records. Defaults to 5 minutes.
+  void set_negative_ttl(base::TimeDelta negative_ttl) {
+    negative_ttl_ = negative_ttl;
+  }
+
+  // The time cached records expire by, usually the one given to the
+  // |NetworkLayer|. Defaults to the system clock.
+  void set_timer_source(TimerSource *timer_source) {
+    DCHECK(timer_source);
+    timer_source_ = timer_source;
+  }
+
+  // Resolves the targets of |uri|, which is expected to have the "sip" or
+  // "sips" scheme. Returns |net::OK| when |targets| were filled from the
+  // URI or the cache, |net::ERR_IO_PENDING| if they are to be passed to
+  // |callback| later, or |net::ERR_INVALID_ARGUMENT|. There is always at
+  // least one target on success. Pending resolutions are abandoned if the
+  // resolver is deleted.
+  int Resolve(const GURL &uri,
+              std::vector<EndPoint> *targets,
+              const ResolveCallback &callback);
+
+  // Drops the cached records.
+  void ClearCache();
+
+  // Sorts |records| by priority, and randomly by weight within each
+  // priority, in the order in which their targets are to be tried.
+  static void OrderSrvRecords(std::vector<SrvRecord> *records);
+
+ private:
+  class Job;
+
+  struct CacheEntry {
+    CacheEntry();
+    ~CacheEntry();
+
+    std::vector<NaptrRecord> naptr_records;
+    std::vector<SrvRecord> srv_records;
+    base::TimeTicks expiration;
+  };
+
+  typedef std::map<std::string, CacheEntry> CacheMap;
+
+  // Returns false if the records of |domain| or |name| are not cached.
+  bool GetCachedNaptr(const std::string &domain,
+                      std::vector<NaptrRecord> *records);
+  bool GetCachedSrv(const std::string &name,
+                    std::vector<SrvRecord> *records);
+
+  // Caches the result of a lookup, if it completed with |net::OK| or
+  // |net::ERR_NAME_NOT_RESOLVED|.
+  void CacheNaptr(const std::string &domain, int result,
+                  const std::vector<NaptrRecord> &records,
+                  base::TimeDelta ttl);
+  void CacheSrv(const std::string &name, int result,
+                const std::vector<SrvRecord> &records,
+                base::TimeDelta ttl);
+
+  CacheEntry *GetCacheEntry(const std::string &key);
+  CacheEntry *AddCacheEntry(const std::string &key, int result,
+                            base::TimeDelta ttl);
+
+  void OnJobComplete(Job *job);
+
+  DnsLookup *dns_lookup_;
+  base::TimeDelta negative_ttl_;
+  TimerSource *timer_source_;
+  CacheMap cache_;
+  std::set<Job*> jobs_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(SipResolver);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TRANSPORT_SIP_RESOLVER_H_
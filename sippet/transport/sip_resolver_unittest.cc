@@ -0,0 +1,215 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/sip_resolver.h"
+
+#include "base/bind.h"
+#include "net/base/net_errors.h"
+#include "sippet/transport/dns_lookup_mock.h"
+#include "sippet/transport/virtual_timer_source.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+class SipResolverTest : public testing::Test {
+ public:
+  SipResolverTest()
+    : sip_resolver_(&dns_lookup_),
+      result_(net::ERR_IO_PENDING) {
+    sip_resolver_.set_timer_source(&timer_source_);
+  }
+
+  // Resolves |uri|, answering the DNS queries if needed.
+  int Resolve(const std::string &uri) {
+    targets_.clear();
+    result_ = net::ERR_IO_PENDING;
+    int rv = sip_resolver_.Resolve(GURL(uri), &targets_,
+        base::Bind(&SipResolverTest::OnResolved, base::Unretained(this)));
+    if (net::ERR_IO_PENDING != rv)
+      return rv;
+    dns_lookup_.CompletePending();
+    return result_;
+  }
+
+  void OnResolved(int result, const std::vector<EndPoint> &targets) {
+    result_ = result;
+    targets_ = targets;
+  }
+
+  VirtualTimerSource timer_source_;
+  DnsLookupMock dns_lookup_;
+  SipResolver sip_resolver_;
+  std::vector<EndPoint> targets_;
+  int result_;
+};
+
+TEST_F(SipResolverTest, WithoutLookups) {
+  EXPECT_EQ(net::OK, Resolve("sip:192.0.2.1;transport=tcp"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("192.0.2.1", 5060, Protocol::TCP), targets_[0]);
+
+  EXPECT_EQ(net::OK, Resolve("sips:alice@192.0.2.1"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("192.0.2.1", 5061, Protocol::TLS), targets_[0]);
+
+  EXPECT_EQ(net::OK, Resolve("sip:example.com:5070"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("example.com", 5070, Protocol::UDP), targets_[0]);
+
+  EXPECT_EQ(0, dns_lookup_.queries());
+  EXPECT_EQ(net::ERR_INVALID_ARGUMENT, Resolve("tel:+15551234567"));
+}
+
+TEST_F(SipResolverTest, Naptr) {
+  // The example of RFC 3263, section 4.1.
+  dns_lookup_.AddNaptr("example.com", 50, 50, "SIPS+D2T",
+                       "_sips._tcp.example.com");
+  dns_lookup_.AddNaptr("example.com", 90, 50, "SIP+D2T",
+                       "_sip._tcp.example.com");
+  dns_lookup_.AddNaptr("example.com", 100, 50, "SIP+D2U",
+                       "_sip._udp.example.com");
+  dns_lookup_.AddSrv("_sips._tcp.example.com", 0, 0, 5061,
+                     "server1.example.com");
+  dns_lookup_.AddSrv("_sip._tcp.example.com", 0, 0, 5060,
+                     "server1.example.com");
+  dns_lookup_.AddSrv("_sip._udp.example.com", 0, 0, 5060,
+                     "server2.example.com.");
+
+  EXPECT_EQ(net::OK, Resolve("sip:bob@example.com"));
+  ASSERT_EQ(3u, targets_.size());
+  EXPECT_EQ(EndPoint("server1.example.com", 5061, Protocol::TLS),
+            targets_[0]);
+  EXPECT_EQ(EndPoint("server1.example.com", 5060, Protocol::TCP),
+            targets_[1]);
+  EXPECT_EQ(EndPoint("server2.example.com", 5060, Protocol::UDP),
+            targets_[2]);
+  EXPECT_EQ(4, dns_lookup_.queries());
+
+  // SIPS URIs only use secure transports, and the records are cached.
+  std::vector<EndPoint> targets;
+  EXPECT_EQ(net::OK, sip_resolver_.Resolve(GURL("sips:bob@example.com"),
+      &targets, SipResolver::ResolveCallback()));
+  ASSERT_EQ(1u, targets.size());
+  EXPECT_EQ(EndPoint("server1.example.com", 5061, Protocol::TLS),
+            targets[0]);
+  EXPECT_EQ(4, dns_lookup_.queries());
+}
+
+TEST_F(SipResolverTest, Srv) {
+  dns_lookup_.AddSrv("_sip._tcp.example.com", 20, 0, 5060,
+                     "backup.example.com");
+  dns_lookup_.AddSrv("_sip._tcp.example.com", 10, 0, 5070,
+                     "primary.example.com");
+
+  // Without NAPTR records, the SRV records of each transport are queried.
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  ASSERT_EQ(2u, targets_.size());
+  EXPECT_EQ(EndPoint("primary.example.com", 5070, Protocol::TCP),
+            targets_[0]);
+  EXPECT_EQ(EndPoint("backup.example.com", 5060, Protocol::TCP),
+            targets_[1]);
+  EXPECT_EQ(4, dns_lookup_.queries());
+
+  // A transport parameter selects the SRV records to query.
+  sip_resolver_.ClearCache();
+  EXPECT_EQ(net::OK, Resolve("sip:example.com;transport=tcp"));
+  EXPECT_EQ(2u, targets_.size());
+  EXPECT_EQ(5, dns_lookup_.queries());
+}
+
+TEST_F(SipResolverTest, NoRecords) {
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("example.com", 5060, Protocol::UDP), targets_[0]);
+
+  EXPECT_EQ(net::OK, Resolve("sips:example.org"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("example.org", 5061, Protocol::TLS), targets_[0]);
+
+  EXPECT_EQ(net::OK, Resolve("sip:example.net;transport=tcp"));
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("example.net", 5060, Protocol::TCP), targets_[0]);
+}
+
+TEST_F(SipResolverTest, Cache) {
+  dns_lookup_.AddSrv("_sip._udp.example.com", 0, 0, 5060,
+                     "server.example.com");
+
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  EXPECT_EQ(4, dns_lookup_.queries());
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  EXPECT_EQ(4, dns_lookup_.queries());
+
+  // Records are not kept past their TTL...
+  sip_resolver_.ClearCache();
+  dns_lookup_.set_ttl(base::TimeDelta());
+  EXPECT_EQ(net::OK, Resolve("sip:example.com;transport=udp"));
+  EXPECT_EQ(net::OK, Resolve("sip:example.com;transport=udp"));
+  EXPECT_EQ(6, dns_lookup_.queries());
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("server.example.com", 5060, Protocol::UDP),
+            targets_[0]);
+
+  // ... and missing records for the negative TTL.
+  EXPECT_EQ(net::OK, Resolve("sip:example.org;transport=tcp"));
+  EXPECT_EQ(net::OK, Resolve("sip:example.org;transport=tcp"));
+  EXPECT_EQ(7, dns_lookup_.queries());
+  sip_resolver_.set_negative_ttl(base::TimeDelta());
+  EXPECT_EQ(net::OK, Resolve("sip:example.net;transport=tcp"));
+  EXPECT_EQ(net::OK, Resolve("sip:example.net;transport=tcp"));
+  EXPECT_EQ(9, dns_lookup_.queries());
+}
+
+TEST_F(SipResolverTest, CacheExpiresOnTimerSource) {
+  dns_lookup_.AddSrv("_sip._udp.example.com", 0, 0, 5060,
+                     "server.example.com");
+
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  EXPECT_EQ(4, dns_lookup_.queries());
+  timer_source_.FastForwardBy(base::TimeDelta::FromSeconds(59));
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  EXPECT_EQ(4, dns_lookup_.queries());
+
+  // The SRV records are looked up again past their TTL, while the names
+  // without records are still remembered.
+  timer_source_.FastForwardBy(base::TimeDelta::FromSeconds(2));
+  EXPECT_EQ(net::OK, Resolve("sip:example.com"));
+  EXPECT_EQ(5, dns_lookup_.queries());
+  ASSERT_EQ(1u, targets_.size());
+  EXPECT_EQ(EndPoint("server.example.com", 5060, Protocol::UDP),
+            targets_[0]);
+}
+
+TEST_F(SipResolverTest, Abandoned) {
+  scoped_ptr<SipResolver> sip_resolver(new SipResolver(&dns_lookup_));
+  std::vector<EndPoint> targets;
+  EXPECT_EQ(net::ERR_IO_PENDING, sip_resolver->Resolve(GURL("sip:example.com"),
+      &targets,
+      base::Bind(&SipResolverTest::OnResolved, base::Unretained(this))));
+  sip_resolver.reset();
+  dns_lookup_.CompletePending();
+  EXPECT_EQ(net::ERR_IO_PENDING, result_);
+}
+
+TEST(SipResolverOrderTest, OrderSrvRecords) {
+  int heavier_first = 0;
+  for (int i = 0; i < 1000; ++i) {
+    std::vector<SipResolver::SrvRecord> records;
+    records.push_back(SipResolver::SrvRecord(10, 10, 5060, "light"));
+    records.push_back(SipResolver::SrvRecord(10, 90, 5060, "heavy"));
+    records.push_back(SipResolver::SrvRecord(5, 0, 5060, "first"));
+    records.push_back(SipResolver::SrvRecord(20, 0, 5060, "last"));
+    SipResolver::OrderSrvRecords(&records);
+    ASSERT_EQ(4u, records.size());
+    EXPECT_EQ("first", records[0].target);
+    EXPECT_EQ("last", records[3].target);
+    if ("heavy" == records[1].target)
+      ++heavier_first;
+  }
+  // Picked first about 90% of the times.
+  EXPECT_GT(heavier_first, 800);
+  EXPECT_LT(heavier_first, 1000);
+}
+
+} // End of sippet namespace
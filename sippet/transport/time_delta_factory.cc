@@ -5,6 +5,8 @@
 #include "sippet/transport/time_delta_factory.h"
 #include "sippet/transport/time_delta_provider.h"
 
+#include <algorithm>
+
 #include "base/lazy_instance.h"
 #include "base/compiler_specific.h"
 
@@ -12,24 +14,30 @@ namespace sippet {
 
 namespace {
 
+const int64 kDefaultT1Milliseconds = 500;
+const int64 kT2Milliseconds = 4000;
+
+base::TimeDelta GetDefaultT1() {
+  return base::TimeDelta::FromMilliseconds(kDefaultT1Milliseconds);
+}
+
+// Timers B and F are 64*T1, never less than with the default T1.
+base::TimeDelta GetClientTimeout(base::TimeDelta t1) {
+  return std::max(t1, GetDefaultT1()) * 64;
+}
+
 class ClientNonInvite : public TimeDeltaProvider {
  public:
-  ClientNonInvite() : count_(0) {}
+  explicit ClientNonInvite(base::TimeDelta t1) : t1_(t1), count_(0) {}
   ~ClientNonInvite() override {}
   base::TimeDelta GetNextRetryDelay() override {
-    // Implement the exponential backoff up to 4 seconds
-    int64 seconds;
-    switch (count_++) {
-      case 0: seconds = 500; break;
-      case 1: seconds = 1000; break;
-      case 2: seconds = 2000; break;
-      default: seconds = 4000; break;
-    }
-    return base::TimeDelta::FromMilliseconds(seconds);
+    // Implement the exponential backoff up to T2 = 4 seconds
+    base::TimeDelta delay = t1_ * (1 << std::min(count_++, 3));
+    return std::min(delay, base::TimeDelta::FromMilliseconds(kT2Milliseconds));
   }
   base::TimeDelta GetTimeoutDelay() override {
-    // This is 64*T1, where T1 = 500ms
-    return base::TimeDelta::FromSeconds(32);
+    // This is 64*T1
+    return GetClientTimeout(t1_);
   }
   base::TimeDelta GetTerminateDelay() override {
     // Timer K equal to 5s
@@ -37,29 +45,31 @@ class ClientNonInvite : public TimeDeltaProvider {
   }
 
  private:
+  base::TimeDelta t1_;
   int count_;
 };
 
 class ClientInvite : public TimeDeltaProvider {
  public:
-  ClientInvite() : multiply_(1) {}
+  explicit ClientInvite(base::TimeDelta t1) : t1_(t1), multiply_(1) {}
   ~ClientInvite() override {}
   base::TimeDelta GetNextRetryDelay() override {
     // Implement the exponential backoff *2 at each retransmission
-    int64 seconds = multiply_ * 500;
+    base::TimeDelta delay = t1_ * multiply_;
     multiply_ <<= 1;
-    return base::TimeDelta::FromMilliseconds(seconds);
+    return delay;
   }
   base::TimeDelta GetTimeoutDelay() override {
-    // This is 64*T1, where T1 = 500ms
-    return base::TimeDelta::FromSeconds(32);
+    // This is 64*T1
+    return GetClientTimeout(t1_);
   }
   base::TimeDelta GetTerminateDelay() override {
     // Timer D is greater than 32s (35 is greater than 32s)
     return base::TimeDelta::FromSeconds(35);
   }
  private:
-  int multiply_;
+  base::TimeDelta t1_;
+  int64 multiply_;
 };
 
 class ServerNonInvite : public TimeDeltaProvider {
@@ -114,11 +124,11 @@ class DefaultTimeDeltaFactory : public TimeDeltaFactory {
   ~DefaultTimeDeltaFactory() override {}
 
   TimeDeltaProvider* CreateClientNonInvite() override {
-    return new ClientNonInvite;
+    return new ClientNonInvite(GetDefaultT1());
   }
 
   TimeDeltaProvider* CreateClientInvite() override {
-    return new ClientInvite;
+    return new ClientInvite(GetDefaultT1());
   }
 
   TimeDeltaProvider* CreateServerNonInvite() override {
@@ -135,6 +145,28 @@ static base::LazyInstance<DefaultTimeDeltaFactory>::Leaky
 
 }  // namespace
 
+TimeDeltaProvider* TimeDeltaFactory::CreateClientNonInviteTo(
+    const EndPoint &destination) {
+  return CreateClientNonInvite();
+}
+
+TimeDeltaProvider* TimeDeltaFactory::CreateClientInviteTo(
+    const EndPoint &destination) {
+  return CreateClientInvite();
+}
+
+// static
+TimeDeltaProvider* TimeDeltaFactory::CreateClientNonInviteWithT1(
+    base::TimeDelta t1) {
+  return new ClientNonInvite(t1);
+}
+
+// static
+TimeDeltaProvider* TimeDeltaFactory::CreateClientInviteWithT1(
+    base::TimeDelta t1) {
+  return new ClientInvite(t1);
+}
+
 TimeDeltaFactory *TimeDeltaFactory::GetDefaultFactory() {
   return g_default_time_delta_factory.Pointer();
 }
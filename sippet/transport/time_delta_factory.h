@@ -6,6 +6,8 @@
 #define SIPPET_TRANSPORT_TIME_DELTA_FACTORY_H_
 
 #include "base/basictypes.h"
+#include "base/time/time.h"
+#include "sippet/transport/end_point.h"
 
 namespace sippet {
 
@@ -23,6 +25,27 @@ class TimeDeltaFactory {
   virtual TimeDeltaProvider* CreateServerNonInvite() = 0;
   virtual TimeDeltaProvider* CreateServerInvite() = 0;
 
+  // Providers for client transactions sent to |destination|. By default,
+  // all destinations share the same timers.
+  virtual TimeDeltaProvider* CreateClientNonInviteTo(
+      const EndPoint &destination);
+  virtual TimeDeltaProvider* CreateClientInviteTo(
+      const EndPoint &destination);
+
+  // Called by client transactions with the time elapsed between sending a
+  // request to |destination| and receiving its first response. Requests
+  // retransmitted before that are not measured, as the response could be
+  // to any of the copies.
+  virtual void OnRoundTripTime(const EndPoint &destination,
+                               base::TimeDelta rtt) {}
+
+  // Client providers with timers derived from |t1|, the round-trip time
+  // estimate, instead of the 500 ms of RFC 3261. Retransmissions start at
+  // |t1|, but timeouts are never shortened below 64*500 ms, to give slow
+  // servers on fast networks the same time to answer.
+  static TimeDeltaProvider* CreateClientNonInviteWithT1(base::TimeDelta t1);
+  static TimeDeltaProvider* CreateClientInviteWithT1(base::TimeDelta t1);
+
   static TimeDeltaFactory *GetDefaultFactory();
 };
 
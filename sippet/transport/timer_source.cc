@@ -0,0 +1,46 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/timer_source.h"
+
+#include "base/lazy_instance.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/timer/timer.h"
+
+namespace sippet {
+
+namespace {
+
+class DefaultTimerSource : public TimerSource {
+ public:
+  DefaultTimerSource() {}
+  ~DefaultTimerSource() override {}
+
+  base::TimeTicks NowTicks() override {
+    return base::TimeTicks::Now();
+  }
+
+  scoped_refptr<base::SingleThreadTaskRunner> GetTaskRunner() override {
+    return base::ThreadTaskRunnerHandle::Get();
+  }
+
+  void Attach(base::Timer *timer) override {
+    // Timers run on the current thread already.
+  }
+};
+
+static base::LazyInstance<DefaultTimerSource>::Leaky
+  g_default_timer_source = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+void TimerSource::Attach(base::Timer *timer) {
+  timer->SetTaskRunner(GetTaskRunner());
+}
+
+TimerSource *TimerSource::GetDefault() {
+  return g_default_timer_source.Pointer();
+}
+
+}  // namespace sippet
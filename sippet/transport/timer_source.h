@@ -0,0 +1,48 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_TIMER_SOURCE_H_
+#define SIPPET_TRANSPORT_TIMER_SOURCE_H_
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/single_thread_task_runner.h"
+#include "base/time/time.h"
+
+namespace base {
+class Timer;
+}
+
+namespace sippet {
+
+// TimerSource gives the time seen by the transaction, channel and
+// registration timers, and runs them. The default source follows the
+// system clock and runs the timers on the current thread; simulations
+// replace it by one whose time advances in jumps, from a timer to the next,
+// so that hours of retransmissions and expirations take seconds.
+class TimerSource {
+ public:
+  TimerSource() {}
+  virtual ~TimerSource() {}
+
+  // The current time.
+  virtual base::TimeTicks NowTicks() = 0;
+
+  // The task runner timers and deferred tasks are posted to. It must run
+  // its tasks on the current thread.
+  virtual scoped_refptr<base::SingleThreadTaskRunner> GetTaskRunner() = 0;
+
+  // Makes |timer| run on |GetTaskRunner|. To be called before the timer is
+  // started for the first time.
+  virtual void Attach(base::Timer *timer);
+
+  static TimerSource *GetDefault();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TimerSource);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_TRANSPORT_TIMER_SOURCE_H_
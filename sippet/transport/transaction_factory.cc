@@ -22,9 +22,10 @@ class DefaultTransactionFactory : public TransactionFactory {
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) override {
     return new ClientTransactionImpl(transaction_id, channel,
-        delegate, time_delta_factory);
+        delegate, time_delta_factory, timer_source);
   }
 
   ServerTransaction *CreateServerTransaction(
@@ -32,9 +33,10 @@ class DefaultTransactionFactory : public TransactionFactory {
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) override {
     return new ServerTransactionImpl(transaction_id, channel,
-        delegate, time_delta_factory);
+        delegate, time_delta_factory, timer_source);
   }
 };
 
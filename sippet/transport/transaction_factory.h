@@ -16,6 +16,7 @@ class ClientTransaction;
 class ServerTransaction;
 class TransactionDelegate;
 class TimeDeltaFactory;
+class TimerSource;
 
 class TransactionFactory {
  public:
@@ -26,6 +27,7 @@ class TransactionFactory {
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) = 0;
 
   virtual ServerTransaction *CreateServerTransaction(
@@ -33,6 +35,7 @@ class TransactionFactory {
       const std::string &transaction_id,
       const scoped_refptr<Channel> &channel,
       TimeDeltaFactory *time_delta_factory,
+      TimerSource *timer_source,
       TransactionDelegate *delegate) = 0;
 
   // Returns the default TransactionFactory.
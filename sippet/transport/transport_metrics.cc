@@ -0,0 +1,135 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/transport_metrics.h"
+
+#include <vector>
+
+#include "base/lazy_instance.h"
+#include "base/strings/stringprintf.h"
+#include "sippet/message/message.h"
+
+namespace sippet {
+
+namespace {
+
+static base::LazyInstance<TransportMetrics>::Leaky
+  g_transport_metrics = LAZY_INSTANCE_INITIALIZER;
+
+std::vector<base::TimeDelta> GetLatencyBounds() {
+  static const int kBoundsInMilliseconds[] = {
+    5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 32000
+  };
+  std::vector<base::TimeDelta> bounds;
+  for (size_t i = 0; i < arraysize(kBoundsInMilliseconds); ++i) {
+    bounds.push_back(
+        base::TimeDelta::FromMilliseconds(kBoundsInMilliseconds[i]));
+  }
+  return bounds;
+}
+
+}  // namespace
+
+TransportMetrics::TransportMetrics() {
+  MetricsRegistry *registry = MetricsRegistry::GetInstance();
+  for (int i = 0; i <= Method::Unknown; ++i) {
+    std::string labels(base::StringPrintf("method=\"%s\"",
+        i == Method::Unknown ? "other"
+            : Method(static_cast<Method::Type>(i)).str()));
+    requests_received[i] = registry->GetCounter(
+        "sippet_requests_received_total", "Requests received.", labels);
+    requests_sent[i] = registry->GetCounter(
+        "sippet_requests_sent_total", "Requests sent.", labels);
+  }
+  for (int i = 0; i < kStatusClassCount; ++i) {
+    std::string labels(base::StringPrintf("status_class=\"%dxx\"", i + 1));
+    responses_received[i] = registry->GetCounter(
+        "sippet_responses_received_total", "Responses received.", labels);
+    responses_sent[i] = registry->GetCounter(
+        "sippet_responses_sent_total", "Responses sent.", labels);
+  }
+  parse_failures = registry->GetCounter("sippet_parse_failures_total",
+      "Received messages that couldn't be parsed.", "");
+
+  const char kRetransmissionsSent[] = "sippet_retransmissions_sent_total";
+  const char kRetransmissionsSentHelp[] =
+      "Messages retransmitted by the transactions.";
+  request_retransmissions_sent = registry->GetCounter(kRetransmissionsSent,
+      kRetransmissionsSentHelp, "message=\"request\"");
+  response_retransmissions_sent = registry->GetCounter(kRetransmissionsSent,
+      kRetransmissionsSentHelp, "message=\"response\"");
+  const char kRetransmissionsReceived[] =
+      "sippet_retransmissions_received_total";
+  const char kRetransmissionsReceivedHelp[] =
+      "Retransmissions absorbed by the transactions.";
+  request_retransmissions_received = registry->GetCounter(
+      kRetransmissionsReceived, kRetransmissionsReceivedHelp,
+      "message=\"request\"");
+  response_retransmissions_received = registry->GetCounter(
+      kRetransmissionsReceived, kRetransmissionsReceivedHelp,
+      "message=\"response\"");
+
+  const char kTimeouts[] = "sippet_transaction_timeouts_total";
+  const char kTimeoutsHelp[] = "Transactions timed out, by RFC 3261 timer.";
+  timer_b_timeouts = registry->GetCounter(kTimeouts, kTimeoutsHelp,
+      "timer=\"B\"");
+  timer_f_timeouts = registry->GetCounter(kTimeouts, kTimeoutsHelp,
+      "timer=\"F\"");
+  timer_h_timeouts = registry->GetCounter(kTimeouts, kTimeoutsHelp,
+      "timer=\"H\"");
+
+  overload_rejections = registry->GetCounter(
+      "sippet_overload_rejections_total",
+      "Requests rejected with 503 by the overload control.", "");
+  stray_responses = registry->GetCounter("sippet_stray_responses_total",
+      "Responses discarded for not matching any client transaction.", "");
+
+  client_transactions = registry->GetGauge("sippet_client_transactions",
+      "Live client transactions.", "");
+  server_transactions = registry->GetGauge("sippet_server_transactions",
+      "Live server transactions.", "");
+  channels = registry->GetGauge("sippet_channels",
+      "Channels open in the network layers.", "");
+  pending_writes = registry->GetGauge("sippet_pending_writes",
+      "Messages waiting to be written to the sockets.", "");
+
+  std::vector<base::TimeDelta> bounds(GetLatencyBounds());
+  const char kClientLatency[] = "sippet_client_transaction_latency_seconds";
+  const char kClientLatencyHelp[] =
+      "Time from sending a request to receiving its final response.";
+  client_invite_latency = registry->GetHistogram(kClientLatency,
+      kClientLatencyHelp, "type=\"invite\"", bounds);
+  client_non_invite_latency = registry->GetHistogram(kClientLatency,
+      kClientLatencyHelp, "type=\"non_invite\"", bounds);
+  const char kServerLatency[] = "sippet_server_transaction_latency_seconds";
+  const char kServerLatencyHelp[] =
+      "Time from receiving a request to sending its final response.";
+  server_invite_latency = registry->GetHistogram(kServerLatency,
+      kServerLatencyHelp, "type=\"invite\"", bounds);
+  server_non_invite_latency = registry->GetHistogram(kServerLatency,
+      kServerLatencyHelp, "type=\"non_invite\"", bounds);
+}
+
+TransportMetrics::~TransportMetrics() {
+}
+
+TransportMetrics *TransportMetrics::Get() {
+  return g_transport_metrics.Pointer();
+}
+
+void TransportMetrics::CountMessage(const scoped_refptr<Message> &message) {
+  bool incoming = Message::Incoming == message->direction();
+  if (isa<Request>(message)) {
+    Method::Type method = dyn_cast<Request>(message)->method().type();
+    (incoming ? requests_received : requests_sent)[method]->Increment();
+  } else {
+    int status_class = dyn_cast<Response>(message)->response_code() / 100;
+    if (status_class < 1 || status_class > kStatusClassCount)
+      return;
+    (incoming ? responses_received : responses_sent)[status_class - 1]
+        ->Increment();
+  }
+}
+
+} // namespace sippet
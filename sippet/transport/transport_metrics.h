@@ -0,0 +1,64 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_TRANSPORT_METRICS_H_
+#define SIPPET_TRANSPORT_TRANSPORT_METRICS_H_
+
+#include "base/memory/ref_counted.h"
+#include "sippet/base/metrics.h"
+#include "sippet/message/method.h"
+
+namespace sippet {
+
+class Message;
+
+// The metrics of the channels, the network layer and the transactions, in
+// the default |MetricsRegistry|.
+struct TransportMetrics {
+  // Responses are counted by status class, from 1xx to 6xx.
+  enum { kStatusClassCount = 6 };
+
+  TransportMetrics();
+  ~TransportMetrics();
+
+  static TransportMetrics *Get();
+
+  // Counts |message| as received or sent on the wire, by its direction.
+  void CountMessage(const scoped_refptr<Message> &message);
+
+  // Requests by method. Unknown methods are counted last.
+  Counter *requests_received[Method::Unknown + 1];
+  Counter *requests_sent[Method::Unknown + 1];
+  Counter *responses_received[kStatusClassCount];
+  Counter *responses_sent[kStatusClassCount];
+  Counter *parse_failures;
+
+  Counter *request_retransmissions_sent;
+  Counter *response_retransmissions_sent;
+  Counter *request_retransmissions_received;
+  Counter *response_retransmissions_received;
+  // Timer B (client INVITE), F (client non-INVITE) and H (server INVITE).
+  Counter *timer_b_timeouts;
+  Counter *timer_f_timeouts;
+  Counter *timer_h_timeouts;
+
+  Counter *overload_rejections;
+  Counter *stray_responses;
+
+  Gauge *client_transactions;
+  Gauge *server_transactions;
+  Gauge *channels;
+  // Messages waiting to be written to the sockets.
+  Gauge *pending_writes;
+
+  // From the request to the final response.
+  Histogram *client_invite_latency;
+  Histogram *client_non_invite_latency;
+  Histogram *server_invite_latency;
+  Histogram *server_non_invite_latency;
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TRANSPORT_TRANSPORT_METRICS_H_
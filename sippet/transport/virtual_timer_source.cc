@@ -0,0 +1,34 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/transport/virtual_timer_source.h"
+
+namespace sippet {
+
+VirtualTimerSource::VirtualTimerSource()
+  : task_runner_(new base::TestMockTimeTaskRunner),
+    tick_clock_(task_runner_->GetMockTickClock()) {
+}
+
+VirtualTimerSource::~VirtualTimerSource() {
+}
+
+void VirtualTimerSource::FastForwardBy(base::TimeDelta delta) {
+  task_runner_->FastForwardBy(delta);
+}
+
+void VirtualTimerSource::RunUntilIdle() {
+  task_runner_->RunUntilIdle();
+}
+
+base::TimeTicks VirtualTimerSource::NowTicks() {
+  return task_runner_->NowTicks();
+}
+
+scoped_refptr<base::SingleThreadTaskRunner>
+VirtualTimerSource::GetTaskRunner() {
+  return task_runner_;
+}
+
+}  // namespace sippet
@@ -0,0 +1,60 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_TRANSPORT_VIRTUAL_TIMER_SOURCE_H_
+#define SIPPET_TRANSPORT_VIRTUAL_TIMER_SOURCE_H_
+
+#include "base/memory/scoped_ptr.h"
+#include "base/test/test_mock_time_task_runner.h"
+#include "base/time/tick_clock.h"
+#include "sippet/transport/timer_source.h"
+
+namespace sippet {
+
+// VirtualTimerSource runs timers on a virtual clock, which only advances
+// when told to: |FastForwardBy| jumps from a timer to the next, running
+// them in order, so that a Timer F of 32 seconds takes no time at all.
+//
+// Everything else posted to its task runner, such as the deliveries of a
+// |SimulatedNetwork|, runs on the same clock:
+//
+//   VirtualTimerSource timer_source;
+//   SimulatedNetwork network(timer_source.task_runner(),
+//                            timer_source.tick_clock(), seed);
+//   NetworkSettings settings;
+//   settings.set_timer_source(&timer_source);
+//   ...
+//   timer_source.FastForwardBy(base::TimeDelta::FromHours(1));
+class VirtualTimerSource : public TimerSource {
+ public:
+  VirtualTimerSource();
+  ~VirtualTimerSource() override;
+
+  const scoped_refptr<base::TestMockTimeTaskRunner> &task_runner() const {
+    return task_runner_;
+  }
+
+  // A clock following the virtual time.
+  base::TickClock *tick_clock() const { return tick_clock_.get(); }
+
+  // Runs the tasks due within |delta|, advancing the virtual time.
+  void FastForwardBy(base::TimeDelta delta);
+
+  // Runs the tasks due now, without advancing the virtual time.
+  void RunUntilIdle();
+
+  // TimerSource methods:
+  base::TimeTicks NowTicks() override;
+  scoped_refptr<base::SingleThreadTaskRunner> GetTaskRunner() override;
+
+ private:
+  scoped_refptr<base::TestMockTimeTaskRunner> task_runner_;
+  scoped_ptr<base::TickClock> tick_clock_;
+
+  DISALLOW_COPY_AND_ASSIGN(VirtualTimerSource);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_TRANSPORT_VIRTUAL_TIMER_SOURCE_H_
@@ -88,24 +88,28 @@ Challenge& Auth::GetChallengeFromHeader(Header* header) {
   return *challenge;
 }
 
-GURL Auth::GetResponseOrigin(const scoped_refptr<Response>& response) {
+GURL Auth::GetRequestOrigin(const scoped_refptr<Request>& request) {
   std::ostringstream spec;
-  if (response->refer_to() != nullptr) {
-    GURL request_uri(response->refer_to()->request_uri());
-    if (request_uri.SchemeIs("sip") || request_uri.SchemeIs("sips")) {
-      SipURI uri(request_uri);
-      spec << uri.scheme() << ":"
-           << uri.host() << ":"
-           << uri.EffectiveIntPort();
-      std::pair<bool, std::string> result = uri.parameter("transport");
-      if (result.first)
-        spec << ";transport=" << result.second;
-    }
+  GURL request_uri(request->request_uri());
+  if (request_uri.SchemeIs("sip") || request_uri.SchemeIs("sips")) {
+    SipURI uri(request_uri);
+    spec << uri.scheme() << ":"
+         << uri.host() << ":"
+         << uri.EffectiveIntPort();
+    std::pair<bool, std::string> result = uri.parameter("transport");
+    if (result.first)
+      spec << ";transport=" << result.second;
   }
   // else return empty GURL
   return GURL(spec.str());
 }
 
+GURL Auth::GetResponseOrigin(const scoped_refptr<Response>& response) {
+  if (response->refer_to() == nullptr)
+    return GURL();
+  return GetRequestOrigin(response->refer_to());
+}
+
 void Auth::ChooseBestChallenge(
     AuthHandlerFactory* auth_handler_factory,
     const scoped_refptr<Response> &response,
@@ -19,6 +19,7 @@ namespace sippet {
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+class Request;
 class Response;
 class AuthHandler;
 class AuthHandlerFactory;
@@ -61,6 +62,9 @@ struct Auth {
   // Returns the challenge from a given authenticate header.
   static Challenge& GetChallengeFromHeader(Header* header);
 
+  // Returns the request origin, built from the request URI.
+  static GURL GetRequestOrigin(const scoped_refptr<Request>& request);
+
   // Returns the response origin.
   static GURL GetResponseOrigin(const scoped_refptr<Response>& response);
 
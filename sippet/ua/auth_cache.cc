@@ -6,6 +6,8 @@
 
 #include <string>
 
+#include "base/strings/utf_string_conversions.h"
+#include "sippet/base/memory_usage.h"
 #include "sippet/uri/uri.h"
 
 namespace sippet {
@@ -30,7 +32,8 @@ void CheckOriginIsValid(const GURL& origin) {
 }  // namespace
 
 AuthCache::Entry::Entry()
-  : scheme_(net::HttpAuth::AUTH_SCHEME_MAX),
+  : target_(net::HttpAuth::AUTH_NONE),
+    scheme_(net::HttpAuth::AUTH_SCHEME_MAX),
     nonce_count_(0) {
 }
 
@@ -41,6 +44,11 @@ void AuthCache::Entry::UpdateStaleChallenge() {
   nonce_count_ = 1;
 }
 
+void AuthCache::Entry::UpdateChallenge(const Challenge& auth_challenge) {
+  auth_challenge_ = auth_challenge;
+  nonce_count_ = 1;
+}
+
 AuthCache::AuthCache() {
 }
 
@@ -57,9 +65,23 @@ AuthCache::Entry* AuthCache::Lookup(const std::string& realm,
   return nullptr;  // No realm entry found.
 }
 
-AuthCache::Entry* AuthCache::Add(const std::string& realm,
+AuthCache::Entry* AuthCache::LookupByOrigin(const GURL& origin,
+                                            Auth::Target target) {
+  // Linear scan through the realm entries.
+  for (EntryList::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->origin() == origin && it->target() == target)
+      return &(*it);
+  }
+  return nullptr;  // No entry found.
+}
+
+AuthCache::Entry* AuthCache::Add(const GURL& origin,
+                                 Auth::Target target,
+                                 const std::string& realm,
                                  Auth::Scheme scheme,
+                                 const Challenge& auth_challenge,
                                  const net::AuthCredentials& credentials) {
+
   // Check for existing entry (we will re-use it if present).
   AuthCache::Entry* entry = Lookup(realm, scheme);
   if (!entry) {
@@ -77,9 +99,31 @@ AuthCache::Entry* AuthCache::Add(const std::string& realm,
   DCHECK_EQ(realm, entry->realm_);
   DCHECK_EQ(scheme, entry->scheme_);
 
-  entry->credentials_ = credentials;
+  entry->origin_ = origin;
+  entry->target_ = target;
+  entry->auth_challenge_ = auth_challenge;
   entry->nonce_count_ = 1;
 
+  if (net::HttpAuth::AUTH_SCHEME_DIGEST != scheme) {
+    entry->credentials_ = credentials;
+    return entry;
+  }
+
+  // Digest entries keep the hashed credentials only. An identity taken
+  // from the cache comes back without password, and keeps its hashes.
+  bool same_identity = !entry->digest_ha1_.empty()
+      && credentials.password().empty()
+      && credentials.username() == entry->credentials_.username();
+  if (!same_identity) {
+    std::string original_realm;
+    if (auth_challenge.HasRealm())
+      original_realm = auth_challenge.realm();
+    entry->digest_ha1_ = DigestHA1::Compute(
+        base::UTF16ToUTF8(credentials.username()), original_realm,
+        base::UTF16ToUTF8(credentials.password()));
+  }
+  entry->credentials_.Set(credentials.username(), base::string16());
+
   return entry;
 }
 
@@ -110,10 +154,23 @@ bool AuthCache::UpdateStaleChallenge(const std::string& realm,
 void AuthCache::UpdateAllFrom(const AuthCache& other) {
   for (EntryList::const_iterator it = other.entries_.begin();
        it != other.entries_.end(); ++it) {
-    Entry* entry = Add(it->realm(), it->scheme(), it->credentials());
-    // Copy nonce count (for digest authentication).
+    Entry* entry = Add(it->origin(), it->target(), it->realm(), it->scheme(),
+                       it->auth_challenge(), it->credentials());
+    // Copy nonce count and hashed credentials (for digest authentication).
     entry->nonce_count_ = it->nonce_count_;
+    entry->digest_ha1_ = it->digest_ha1_;
+  }
+}
+
+void AuthCache::DumpMemoryUsage(MemoryUsageDump* dump) const {
+  size_t bytes = 0;
+  for (EntryList::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    bytes += kListNodeOverhead + sizeof(Entry)
+        + EstimateStringMemoryUsage(it->origin().spec())
+        + EstimateStringMemoryUsage(it->realm());
   }
+  dump->Add("ua/auth_cache", entries_.size(), bytes);
 }
 
 }  // namespace sippet
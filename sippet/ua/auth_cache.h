@@ -8,11 +8,15 @@
 #include <list>
 
 #include "net/base/auth.h"
+#include "sippet/message/headers/www_authenticate.h"
 #include "sippet/ua/auth.h"
+#include "sippet/ua/digest_hash.h"
 #include "url/gurl.h"
 
 namespace sippet {
 
+class MemoryUsageDump;
+
 // Based on net/http/http_auth_cache.h,
 // revision 238260
 
@@ -24,15 +28,26 @@ namespace sippet {
 // For each (origin, realm, scheme) triple the cache stores a
 // AuthCache::Entry, which holds:
 //   - the origin server {protocol scheme, host, port}
-//   - the last identity used (username/password)
+//   - the last identity used (username, and H(A1) for digest entries)
 //   - the last auth handler used (contains realm and authentication scheme)
-// Entries can be looked up by (origin, realm, scheme).
+//   - the last challenge received, used for preemptive authentication
+// Entries can be looked up by (realm, scheme) or by (origin, target).
 class AuthCache {
  public:
   class Entry {
    public:
     ~Entry();
 
+    // The {protocol, host, port} of the server that issued the challenge.
+    const GURL& origin() const {
+      return origin_;
+    }
+
+    // Whether the challenge came from a proxy or from the origin server.
+    Auth::Target target() const {
+      return target_;
+    }
+
     // The case-sensitive realm string of the challenge.
     const std::string realm() const {
       return realm_;
@@ -43,11 +58,22 @@ class AuthCache {
       return scheme_;
     }
 
-    // The login credentials.
+    // The login credentials. The password of digest entries is not kept,
+    // as |digest_ha1()| is enough to authenticate.
     const net::AuthCredentials& credentials() const {
       return credentials_;
     }
 
+    // The H(username:realm:password) values of digest entries.
+    const DigestHA1& digest_ha1() const {
+      return digest_ha1_;
+    }
+
+    // The last challenge received for this entry.
+    const Challenge& auth_challenge() const {
+      return auth_challenge_;
+    }
+
     // Increment the nonce count.
     int IncrementNonceCount() {
       return ++nonce_count_;
@@ -55,17 +81,27 @@ class AuthCache {
 
     void UpdateStaleChallenge();
 
+    // Replaces the cached challenge with a newer one, issued by the server
+    // for the same realm, and resets the nonce count.
+    void UpdateChallenge(const Challenge& auth_challenge);
+
    private:
     friend class AuthCache;
 
     Entry();
 
     // |origin_| contains the {protocol, host, port} of the server.
+    GURL origin_;
+    Auth::Target target_;
     std::string realm_;
     Auth::Scheme scheme_;
 
+    // Challenge.
+    Challenge auth_challenge_;
+
     // Identity.
     net::AuthCredentials credentials_;
+    DigestHA1 digest_ha1_;
 
     // Nonce count.
     int nonce_count_;
@@ -88,15 +124,29 @@ class AuthCache {
   Entry* Lookup(const std::string& realm,
                 Auth::Scheme scheme);
 
+  // Find an entry for server |origin| acting as |target|. Used to
+  // authenticate requests preemptively.
+  //   returns  - the matched entry or NULL.
+  Entry* LookupByOrigin(const GURL& origin,
+                        Auth::Target target);
+
   // Add an entry on server |origin| for realm |handler->realm()| and
   // scheme |handler->scheme()|.  If an entry for this (realm,scheme)
   // already exists, update it rather than replace it.
+  //   |origin|   - the {protocol, host, port} of the server.
+  //   |target|   - whether the server is a proxy or the origin server.
   //   |realm|    - the auth realm for the challenge.
   //   |scheme|   - the authentication scheme (i.e. basic, negotiate).
-  //   |credentials| - login information for the realm.
+  //   |auth_challenge| - the challenge issued by the server.
+  //   |credentials| - login information for the realm. For digest entries
+  //                 an empty password keeps the H(A1) already cached for
+  //                 the same username.
   //   returns    - the entry that was just added/updated.
-  Entry* Add(const std::string& realm,
+  Entry* Add(const GURL& origin,
+             Auth::Target target,
+             const std::string& realm,
              Auth::Scheme scheme,
+             const Challenge& auth_challenge,
              const net::AuthCredentials& credentials);
 
   // Remove entry on server |origin| for realm |realm| and scheme |scheme|
@@ -120,6 +170,10 @@ class AuthCache {
   // Copies all entries from |other| cache.
   void UpdateAllFrom(const AuthCache& other);
 
+  // Adds the approximate memory held by the cached entries to |dump|, under
+  // "ua/auth_cache".
+  void DumpMemoryUsage(MemoryUsageDump* dump) const;
+
  private:
   typedef std::list<Entry> EntryList;
   EntryList entries_;
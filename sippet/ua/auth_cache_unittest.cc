@@ -0,0 +1,46 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/auth_cache.h"
+
+#include "base/strings/utf_string_conversions.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/message/header.h"
+#include "sippet/message/headers.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+TEST(AuthCacheTest, DumpMemoryUsage) {
+  AuthCache cache;
+  scoped_ptr<Header> header(
+      Header::Parse("WWW-Authenticate: Digest realm=\"biloxi.com\","
+                    " nonce=\"0a4f113b\""));
+  ASSERT_TRUE(header.get() != nullptr);
+  WwwAuthenticate *www_authenticate = dyn_cast<WwwAuthenticate>(header);
+  ASSERT_TRUE(www_authenticate != nullptr);
+  GURL origin("sip:biloxi.com:5060");
+  net::AuthCredentials credentials(base::ASCIIToUTF16("bob"),
+                                   base::ASCIIToUTF16("zanzibar"));
+  cache.Add(origin, net::HttpAuth::AUTH_SERVER, "biloxi.com",
+      net::HttpAuth::AUTH_SCHEME_DIGEST, *www_authenticate, credentials);
+  cache.Add(origin, net::HttpAuth::AUTH_SERVER, "atlanta.com",
+      net::HttpAuth::AUTH_SCHEME_DIGEST, *www_authenticate, credentials);
+
+  MemoryUsageDump dump;
+  cache.DumpMemoryUsage(&dump);
+  const MemoryUsage &usage = dump.usages().find("ua/auth_cache")->second;
+  EXPECT_EQ(2u, usage.object_count);
+  EXPECT_LT(2 * sizeof(AuthCache::Entry), usage.bytes);
+
+  // Digest entries keep the username only.
+  EXPECT_TRUE(cache.Remove("atlanta.com", net::HttpAuth::AUTH_SCHEME_DIGEST,
+      net::AuthCredentials(base::ASCIIToUTF16("bob"), base::string16())));
+  MemoryUsageDump after_remove;
+  cache.DumpMemoryUsage(&after_remove);
+  EXPECT_EQ(1u,
+      after_remove.usages().find("ua/auth_cache")->second.object_count);
+}
+
+} // namespace sippet
@@ -5,6 +5,7 @@
 #include "sippet/ua/auth_controller.h"
 #include "sippet/ua/auth_handler.h"
 #include "sippet/ua/auth_cache.h"
+#include "sippet/ua/auth_handler_factory.h"
 #include "sippet/message/message.h"
 #include "sippet/message/status_code.h"
 #include "net/base/net_errors.h"
@@ -202,13 +203,52 @@ void AuthController::ResetAuth(const net::AuthCredentials& credentials) {
     case net::HttpAuth::IDENT_SRC_NONE:
     case net::HttpAuth::IDENT_SRC_DEFAULT_CREDENTIALS:
       break;
-    default:
-      auth_cache_->Add(handler_->realm(), handler_->auth_scheme(),
-                       identity_.credentials);
+    default: {
+      AuthCache::Entry* entry = auth_cache_->Add(auth_origin_, target_,
+          handler_->realm(), handler_->auth_scheme(), handler_->challenge(),
+          identity_.credentials);
+      // Continue with the credentials as cached, so that they still match
+      // the entry if it has to be invalidated.
+      identity_.credentials = entry->credentials();
+      handler_->set_digest_ha1(entry->digest_ha1());
       break;
+    }
   }
 }
 
+bool AuthController::SelectPreemptiveAuth(const GURL& origin,
+                                          const net::BoundNetLog& net_log) {
+  DCHECK(!HaveAuth());
+  static const Auth::Target kTargets[] = {
+    net::HttpAuth::AUTH_PROXY,
+    net::HttpAuth::AUTH_SERVER,
+  };
+  for (size_t i = 0; i < arraysize(kTargets); ++i) {
+    AuthCache::Entry* entry = auth_cache_->LookupByOrigin(origin, kTargets[i]);
+    if (!entry || IsAuthSchemeDisabled(entry->scheme()))
+      continue;
+
+    // Try to create a handler using the previous auth challenge.
+    scoped_ptr<AuthHandler> handler_preemptive;
+    int rv = auth_handler_factory_->CreatePreemptiveAuthHandler(
+        entry->auth_challenge(), kTargets[i], origin,
+        entry->IncrementNonceCount(), net_log, &handler_preemptive);
+    if (rv != net::OK)
+      continue;
+
+    // Set the state.
+    target_ = kTargets[i];
+    auth_origin_ = origin;
+    identity_.source = net::HttpAuth::IDENT_SRC_PATH_LOOKUP;
+    identity_.invalid = false;
+    identity_.credentials = entry->credentials();
+    handler_.swap(handler_preemptive);
+    handler_->set_digest_ha1(entry->digest_ha1());
+    return true;
+  }
+  return false;
+}
+
 int AuthController::AddAuthorizationHeaders(
     const scoped_refptr<Request> &request,
     const net::CompletionCallback& callback,
@@ -283,6 +323,10 @@ bool AuthController::SelectNextAuthIdentityToTry() {
     identity_.source = net::HttpAuth::IDENT_SRC_REALM_LOOKUP;
     identity_.invalid = false;
     identity_.credentials = entry->credentials();
+    // Digest entries keep the HA1 rather than the password.
+    handler_->set_digest_ha1(entry->digest_ha1());
+    // Keep the newest challenge for preemptive authentication.
+    entry->UpdateChallenge(handler_->challenge());
     return true;
   }
 
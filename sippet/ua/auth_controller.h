@@ -41,6 +41,14 @@ class AuthController :
   // Store the supplied credentials and prepare to restart the auth.
   void ResetAuth(const net::AuthCredentials& credentials);
 
+  // Selects an auth handler and identity from the |AuthCache| entries of
+  // |origin|, so that |AddAuthorizationHeaders()| can be called before any
+  // challenge is received. The cached nonce count is incremented. Returns
+  // true if cached credentials were found. Proxy entries are preferred, as
+  // the proxy is the first to challenge an unauthenticated request.
+  bool SelectPreemptiveAuth(const GURL& origin,
+                            const net::BoundNetLog& net_log);
+
   // Adds either the proxy auth header, or the origin server auth header to
   // the given request. The return value is a net error code. |OK| will be
   // returned both in the case that a token is correctly generated
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "sippet/ua/auth_handler_digest.h"
 #include "sippet/ua/auth_handler_mock.h"
 #include "sippet/ua/auth_controller.h"
 #include "sippet/ua/auth_cache.h"
@@ -36,6 +37,10 @@ class AuthControllerTest : public testing::Test {
     return *controller_;
   }
 
+  AuthCache &auth_cache() {
+    return dummy_auth_cache_;
+  }
+
   enum HandlerRunMode {
     RUN_HANDLER_SYNC,
     RUN_HANDLER_ASYNC
@@ -385,4 +390,86 @@ TEST_F(AuthControllerTest, NoExplicitCredentialsAllowed) {
       request, net::CompletionCallback(), dummy_log));
 }
 
+// A cached entry allows authenticating the next request to the same origin
+// without waiting for a new challenge.
+TEST_F(AuthControllerTest, PreemptiveAuthFromCache) {
+  net::BoundNetLog dummy_log;
+  scoped_refptr<Request> request(dyn_cast<Request>(
+    Message::Parse("REGISTER sip:some.domain.com SIP/2.0\r\n"
+                   "\r\n")));
+  request->set_direction(Message::Outgoing);
+  GURL origin(Auth::GetRequestOrigin(request));
+
+  // Nothing cached yet.
+  EXPECT_FALSE(controller().SelectPreemptiveAuth(origin, dummy_log));
+
+  scoped_ptr<Header> header(
+    Header::Parse("WWW-Authenticate: MOCK realm=\"foo\""));
+  ASSERT_TRUE(header.get() != nullptr);
+  WwwAuthenticate *www_authenticate = dyn_cast<WwwAuthenticate>(header);
+  ASSERT_TRUE(www_authenticate != nullptr);
+  auth_cache().Add(origin, net::HttpAuth::AUTH_SERVER, "foo",
+      net::HttpAuth::AUTH_SCHEME_MOCK, *www_authenticate,
+      net::AuthCredentials(base::ASCIIToUTF16("Hello"), base::string16()));
+
+  factory().AddMockHandler(
+      new NiceMock<MockHandler>(net::OK, net::HttpAuth::AUTH_SCHEME_MOCK),
+      net::HttpAuth::AUTH_SERVER, true);
+
+  ASSERT_TRUE(controller().SelectPreemptiveAuth(origin, dummy_log));
+  EXPECT_EQ(net::HttpAuth::AUTH_SERVER, controller().target());
+  EXPECT_TRUE(controller().HaveAuth());
+  EXPECT_EQ(net::OK, controller().AddAuthorizationHeaders(
+      request, net::CompletionCallback(), dummy_log));
+}
+
+// Digest entries don't keep the password, so a challenge answered from the
+// cache must be answered with the cached H(A1).
+TEST_F(AuthControllerTest, DigestChallengeAnsweredFromCache) {
+  net::BoundNetLog dummy_log;
+  AuthHandlerDigest::Factory digest_factory;
+  digest_factory.set_nonce_generator(
+      new AuthHandlerDigest::FixedNonceGenerator("0a4f113b"));
+  const char kChallenge[] =
+      "SIP/2.0 401 Unauthorized\r\n"
+      "WWW-Authenticate: Digest realm=\"biloxi.com\", qop=\"auth\", "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\"\r\n"
+      "\r\n";
+
+  // The first challenge is answered with the password of the user.
+  scoped_refptr<AuthController> first_controller(
+      new AuthController(&auth_cache(), &digest_factory));
+  scoped_refptr<Request> request(
+      new Request(Method::INVITE, GURL("sip:bob@biloxi.com")));
+  scoped_refptr<Response> response(
+      dyn_cast<Response>(Message::Parse(kChallenge)));
+  response->set_refer_to(request);
+  ASSERT_EQ(net::OK,
+            first_controller->HandleAuthChallenge(response, dummy_log));
+  ASSERT_TRUE(first_controller->auth_info().get());
+  first_controller->ResetAuth(net::AuthCredentials(
+      base::ASCIIToUTF16("bob"), base::ASCIIToUTF16("zanzibar")));
+  ASSERT_EQ(net::OK, first_controller->AddAuthorizationHeaders(
+      request, net::CompletionCallback(), dummy_log));
+  ASSERT_TRUE(request->get<Authorization>());
+  EXPECT_EQ("89eb0059246c02b2f6ee02c7961d5ea3",
+            request->get<Authorization>()->response());
+
+  // The second one is answered from the cache, without asking for it.
+  scoped_refptr<AuthController> second_controller(
+      new AuthController(&auth_cache(), &digest_factory));
+  request = new Request(Method::INVITE, GURL("sip:bob@biloxi.com"));
+  response = dyn_cast<Response>(Message::Parse(kChallenge));
+  response->set_refer_to(request);
+  ASSERT_EQ(net::OK,
+            second_controller->HandleAuthChallenge(response, dummy_log));
+  EXPECT_FALSE(second_controller->auth_info().get());
+  EXPECT_TRUE(second_controller->HaveAuth());
+  ASSERT_EQ(net::OK, second_controller->AddAuthorizationHeaders(
+      request, net::CompletionCallback(), dummy_log));
+  ASSERT_TRUE(request->get<Authorization>());
+  EXPECT_EQ("89eb0059246c02b2f6ee02c7961d5ea3",
+            request->get<Authorization>()->response());
+}
+
 }  // namespace sippet
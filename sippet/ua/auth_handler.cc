@@ -49,6 +49,7 @@ bool AuthHandler::InitFromChallenge(
   target_ = target;
   score_ = -1;
   net_log_ = net_log;
+  auth_challenge_ = challenge;
 
   bool ok = Init(challenge);
 
@@ -6,6 +6,8 @@
 #define SIPPET_UA_AUTH_HANDLER_H_
 
 #include "sippet/ua/auth.h"
+#include "sippet/ua/digest_hash.h"
+#include "sippet/message/headers/www_authenticate.h"
 #include "net/log/net_log.h"
 #include "net/base/completion_callback.h"
 
@@ -84,6 +86,19 @@ class AuthHandler {
     return realm_;
   }
 
+  // The challenge which was issued when creating the handler. It is kept in
+  // the |AuthCache| so that later requests can be authenticated preemptively.
+  const Challenge& challenge() const {
+    return auth_challenge_;
+  }
+
+  // Hashed credentials of the current identity, taken from the |AuthCache|.
+  // Digest handlers use them instead of hashing the password on every
+  // |GenerateAuth()|. Other schemes ignore them.
+  void set_digest_ha1(const DigestHA1& digest_ha1) {
+    digest_ha1_ = digest_ha1;
+  }
+
   // Numeric rank based on the challenge's security level. Higher
   // numbers are better. Used by Auth::ChooseBestChallenge().
   int score() const {
@@ -136,6 +151,12 @@ class AuthHandler {
   // The realm, encoded as UTF-8. Used by "basic" and "digest".
   std::string realm_;
 
+  // The challenge used to initialize this handler.
+  Challenge auth_challenge_;
+
+  // The H(A1) values of the current identity, if known.
+  DigestHA1 digest_ha1_;
+
   // The {scheme, host, port} for the authentication target.  Used by "ntlm"
   // and "negotiate" to construct the service principal name.
   GURL origin_;
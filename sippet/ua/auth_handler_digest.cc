@@ -8,13 +8,13 @@
 
 #include "base/i18n/icu_string_conversions.h"
 #include "base/logging.h"
-#include "base/md5.h"
 #include "base/rand_util.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
+#include "sippet/base/tracing.h"
 #include "sippet/ua/auth.h"
 #include "sippet/message/request.h"
 #include "url/gurl.h"
@@ -28,30 +28,35 @@ namespace sippet {
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// Digest authentication is specified in RFC 2617.
+// Digest authentication is specified in RFC 2617, and the SHA-256 and
+// SHA-512/256 algorithms in RFC 8760. H is the hash function of the
+// algorithm: MD5, SHA-256 or SHA-512/256.
 // The expanded derivations are listed in the tables below.
 
 //==========+==========+==========================================+
 //    qop   |algorithm |               response                   |
 //==========+==========+==========================================+
-//    ?     |  ?, md5, | MD5(MD5(A1):nonce:MD5(A2))               |
-//          | md5-sess |                                          |
+//    ?     |  ?, H,   | H(H(A1):nonce:H(A2))                     |
+//          |  H-sess  |                                          |
 //--------- +----------+------------------------------------------+
-//   auth,  |  ?, md5, | MD5(MD5(A1):nonce:nc:cnonce:qop:MD5(A2)) |
-// auth-int | md5-sess |                                          |
+//   auth,  |  ?, H,   | H(H(A1):nonce:nc:cnonce:qop:H(A2))       |
+// auth-int |  H-sess  |                                          |
 //==========+==========+==========================================+
 //    qop   |algorithm |                  A1                      |
 //==========+==========+==========================================+
-//          | ?, md5   | user:realm:password                      |
+//          | ?, H     | user:realm:password                      |
 //----------+----------+------------------------------------------+
-//          | md5-sess | MD5(user:realm:password):nonce:cnonce    |
+//          | H-sess   | H(user:realm:password):nonce:cnonce      |
 //==========+==========+==========================================+
 //    qop   |algorithm |                  A2                      |
 //==========+==========+==========================================+
 //  ?, auth |          | req-method:req-uri                       |
 //----------+----------+------------------------------------------+
-// auth-int |          | req-method:req-uri:MD5(req-entity-body)  |
+// auth-int |          | req-method:req-uri:H(req-entity-body)    |
 //=====================+==========================================+
+//
+// H(user:realm:password) is taken from the |AuthCache| entry when it is
+// available, so the password is hashed only once per identity.
 
 AuthHandlerDigest::NonceGenerator::NonceGenerator() {
 }
@@ -138,6 +143,10 @@ int AuthHandlerDigest::GenerateAuthImpl(
     const net::AuthCredentials* credentials,
     const scoped_refptr<Request> &request,
     const net::CompletionCallback& callback) {
+  // Authenticated requests are clones still carrying the Via of the
+  // challenged one, so this is traced in the flow of the challenge.
+  SIPPET_TRACE_EVENT_WITH_FLOW0("AuthHandlerDigest::GenerateAuth",
+                                request->GetTransactionTraceId());
   // Generate a random client nonce.
   std::string cnonce = nonce_generator_->GenerateNonce();
 
@@ -223,6 +232,14 @@ bool AuthHandlerDigest::ParseChallenge(
       algorithm_ = ALGORITHM_MD5;
     } else if (base::LowerCaseEqualsASCII(algorithm, "md5-sess")) {
       algorithm_ = ALGORITHM_MD5_SESS;
+    } else if (base::LowerCaseEqualsASCII(algorithm, "sha-256")) {
+      algorithm_ = ALGORITHM_SHA256;
+    } else if (base::LowerCaseEqualsASCII(algorithm, "sha-256-sess")) {
+      algorithm_ = ALGORITHM_SHA256_SESS;
+    } else if (base::LowerCaseEqualsASCII(algorithm, "sha-512-256")) {
+      algorithm_ = ALGORITHM_SHA512_256;
+    } else if (base::LowerCaseEqualsASCII(algorithm, "sha-512-256-sess")) {
+      algorithm_ = ALGORITHM_SHA512_256_SESS;
     } else {
       DVLOG(1) << "Unknown value of algorithm";
       return false;  // FAIL -- unsupported value of algorithm.
@@ -249,6 +266,19 @@ bool AuthHandlerDigest::ParseChallenge(
   if (nonce_.empty())
     return false;
 
+  // RFC 8760 asks clients to prefer the strongest algorithm when the
+  // server offers several challenges.
+  switch (AlgorithmToHash(algorithm_)) {
+    case DigestHash::SHA256:
+      score_ = 3;
+      break;
+    case DigestHash::SHA512_256:
+      score_ = 4;
+      break;
+    default:
+      break;
+  }
+
   return true;
 }
 
@@ -275,12 +305,42 @@ Credentials::Algorithm AuthHandlerDigest::AlgorithmToCredentials(
       return Credentials::MD5;
     case ALGORITHM_MD5_SESS:
       return Credentials::MD5_sess;
+    case ALGORITHM_SHA256:
+      return Credentials::SHA_256;
+    case ALGORITHM_SHA256_SESS:
+      return Credentials::SHA_256_sess;
+    case ALGORITHM_SHA512_256:
+      return Credentials::SHA_512_256;
+    case ALGORITHM_SHA512_256_SESS:
+      return Credentials::SHA_512_256_sess;
     default:
       NOTREACHED();
       return Credentials::Algorithm(-1);
   }
 }
 
+// static
+DigestHash::Algorithm AuthHandlerDigest::AlgorithmToHash(
+    DigestAlgorithm algorithm) {
+  switch (algorithm) {
+    case ALGORITHM_SHA256:
+    case ALGORITHM_SHA256_SESS:
+      return DigestHash::SHA256;
+    case ALGORITHM_SHA512_256:
+    case ALGORITHM_SHA512_256_SESS:
+      return DigestHash::SHA512_256;
+    default:
+      return DigestHash::MD5;
+  }
+}
+
+// static
+bool AuthHandlerDigest::IsSessionAlgorithm(DigestAlgorithm algorithm) {
+  return algorithm == ALGORITHM_MD5_SESS
+      || algorithm == ALGORITHM_SHA256_SESS
+      || algorithm == ALGORITHM_SHA512_256_SESS;
+}
+
 void AuthHandlerDigest::GetRequestMethodAndRequestUri(
     const scoped_refptr<Request> &request,
     std::string* method,
@@ -303,26 +363,33 @@ std::string AuthHandlerDigest::AssembleResponseDigest(
   // the nonce-count is an 8 digit hex string.
   std::string nc = base::StringPrintf("%08x", nonce_count);
 
-  // ha1 = MD5(A1)
-  std::string ha1 = base::MD5String(base::UTF16ToUTF8(credentials.username())
-      + ":" + original_realm_ + ":" +
-      base::UTF16ToUTF8(credentials.password()));
-  if (algorithm_ == AuthHandlerDigest::ALGORITHM_MD5_SESS)
-    ha1 = base::MD5String(ha1 + ":" + nonce_ + ":" + cnonce);
+  DigestHash::Algorithm hash = AlgorithmToHash(algorithm_);
+
+  // ha1 = H(A1), from the cache if it was computed for this realm.
+  std::string ha1;
+  if (!digest_ha1_.empty() && digest_ha1_.realm() == original_realm_) {
+    ha1 = digest_ha1_.get(hash);
+  } else {
+    ha1 = DigestHash::HexString(hash,
+        base::UTF16ToUTF8(credentials.username()) + ":" + original_realm_ +
+        ":" + base::UTF16ToUTF8(credentials.password()));
+  }
+  if (IsSessionAlgorithm(algorithm_))
+    ha1 = DigestHash::HexString(hash, ha1 + ":" + nonce_ + ":" + cnonce);
 
-  // ha2 = MD5(A2)
+  // ha2 = H(A2)
   std::string a2 = method + ":" + request_uri;
   if (qop_ == AuthHandlerDigest::QOP_AUTH_INT)
-    a2 += ":" + base::MD5String(body);
+    a2 += ":" + DigestHash::HexString(hash, body);
 
-  std::string ha2 = base::MD5String(a2);
+  std::string ha2 = DigestHash::HexString(hash, a2);
 
   std::string nc_part;
   if (qop_ != AuthHandlerDigest::QOP_UNSPECIFIED) {
     nc_part = nc + ":" + cnonce + ":" + QopToString(qop_) + ":";
   }
 
-  return base::MD5String(ha1 + ":" + nonce_ + ":" + nc_part + ha2);
+  return DigestHash::HexString(hash, ha1 + ":" + nonce_ + ":" + nc_part + ha2);
 }
 
 void AuthHandlerDigest::AssembleCredentials(
@@ -107,6 +107,12 @@ class AuthHandlerDigest : public AuthHandler {
     // Hash is run only once during the first WWW-Authenticate handshake.
     // (SESS means session).
     ALGORITHM_MD5_SESS,
+
+    // RFC 8760 algorithms.
+    ALGORITHM_SHA256,
+    ALGORITHM_SHA256_SESS,
+    ALGORITHM_SHA512_256,
+    ALGORITHM_SHA512_256_SESS,
   };
 
   // Possible values for QualityOfProtection.
@@ -138,6 +144,12 @@ class AuthHandlerDigest : public AuthHandler {
   static Credentials::Algorithm AlgorithmToCredentials(
     DigestAlgorithm algorithm);
 
+  // Returns the hash function H used by |algorithm|.
+  static DigestHash::Algorithm AlgorithmToHash(DigestAlgorithm algorithm);
+
+  // Returns true for the session variants of the algorithms.
+  static bool IsSessionAlgorithm(DigestAlgorithm algorithm);
+
   // Extract the method and path of the request, as needed by
   // the 'A2' production. (path may be a hostname for proxy).
   void GetRequestMethodAndRequestUri(const scoped_refptr<Request> &request,
@@ -0,0 +1,81 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/utf_string_conversions.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "sippet/message/request.h"
+#include "sippet/test/microbenchmark.h"
+#include "sippet/ua/auth_handler_digest.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+void GenerateResponse(AuthHandler *handler,
+                      const net::AuthCredentials *credentials,
+                      const net::CompletionCallback &callback) {
+  scoped_refptr<Request> request(
+      new Request(Method::REGISTER, GURL("sip:biloxi.com")));
+  CHECK_EQ(net::OK,
+      handler->GenerateAuth(credentials, request.get(), callback));
+}
+
+// Measures the generation of digest responses for |algorithm|. When
+// |cached_ha1| is set, the handler uses H(A1) as the |AuthCache| would
+// provide it.
+void RunDigestPerfTest(const std::string& algorithm, bool cached_ha1) {
+  AuthHandlerDigest::Factory factory;
+  factory.set_nonce_generator(
+      new AuthHandlerDigest::FixedNonceGenerator("0a4f113b"));
+  scoped_ptr<Header> header(Header::Parse(
+      "WWW-Authenticate: Digest realm=\"biloxi.com\", qop=\"auth\", "
+      "algorithm=" + algorithm + ", "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\""));
+  WwwAuthenticate *www_authenticate = dyn_cast<WwwAuthenticate>(header);
+  ASSERT_TRUE(www_authenticate != nullptr);
+  scoped_ptr<AuthHandler> handler;
+  ASSERT_EQ(net::OK, factory.CreateAuthHandler(
+      *www_authenticate, net::HttpAuth::AUTH_SERVER,
+      GURL("sip:biloxi.com:5060"), AuthHandlerFactory::CREATE_CHALLENGE, 1,
+      net::BoundNetLog(), &handler));
+
+  net::AuthCredentials credentials(base::ASCIIToUTF16("bob"),
+                                   base::ASCIIToUTF16("zanzibar"));
+  if (cached_ha1) {
+    handler->set_digest_ha1(
+        DigestHA1::Compute("bob", "biloxi.com", "zanzibar"));
+    credentials.Set(credentials.username(), base::string16());
+  }
+
+  net::TestCompletionCallback callback;
+  Microbenchmark benchmark("digest_response",
+      cached_ha1 ? algorithm + "_cached_ha1" : algorithm);
+  benchmark.Run(base::Bind(&GenerateResponse, handler.get(), &credentials,
+                           callback.callback()));
+}
+
+}  // namespace
+
+TEST(AuthHandlerDigestPerfTest, MD5) {
+  RunDigestPerfTest("MD5", false);
+  RunDigestPerfTest("MD5", true);
+}
+
+TEST(AuthHandlerDigestPerfTest, SHA256) {
+  RunDigestPerfTest("SHA-256", false);
+  RunDigestPerfTest("SHA-256", true);
+}
+
+TEST(AuthHandlerDigestPerfTest, SHA512_256) {
+  RunDigestPerfTest("SHA-512-256", false);
+  RunDigestPerfTest("SHA-512-256", true);
+}
+
+}  // namespace sippet
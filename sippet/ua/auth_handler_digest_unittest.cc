@@ -255,6 +255,145 @@ TEST(AuthHandlerDigest, AuthIntAndMd5Sess) {
             auth_token);
 }
 
+TEST(AuthHandlerDigest, AuthAndSha256) {
+  std::string auth_token;
+  EXPECT_TRUE(RespondToChallenge(
+      "Digest realm=\"biloxi.com\", "
+      "qop=\"auth,auth-int\", "
+      "algorithm=SHA-256, "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+      "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\"",
+      Method::INVITE,
+      "sip:bob@biloxi.com",
+      "",
+      "0a4f113b",
+      &auth_token));
+  EXPECT_EQ("Authorization: Digest username=\"bob\", "
+            "realm=\"biloxi.com\", "
+            "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+            "uri=\"sip:bob@biloxi.com\", "
+            "algorithm=SHA-256, "
+            "response=\"b3b5a6c69453abafaab9ae4dccdac90a"
+            "076b6c80615d5f3498e7433b6e93bf4f\", "
+            "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\", "
+            "qop=auth, "
+            "nc=00000001, "
+            "cnonce=\"0a4f113b\"",
+            auth_token);
+}
+
+TEST(AuthHandlerDigest, AuthAndSha256Sess) {
+  std::string auth_token;
+  EXPECT_TRUE(RespondToChallenge(
+      "Digest realm=\"biloxi.com\", "
+      "qop=\"auth,auth-int\", "
+      "algorithm=SHA-256-sess, "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+      "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\"",
+      Method::INVITE,
+      "sip:bob@biloxi.com",
+      "",
+      "0a4f113b",
+      &auth_token));
+  EXPECT_EQ("Authorization: Digest username=\"bob\", "
+            "realm=\"biloxi.com\", "
+            "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+            "uri=\"sip:bob@biloxi.com\", "
+            "algorithm=SHA-256-sess, "
+            "response=\"5da59c9ca40954be9d5063a15a174066"
+            "c8251be2c10cf47c144c366dc7daf792\", "
+            "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\", "
+            "qop=auth, "
+            "nc=00000001, "
+            "cnonce=\"0a4f113b\"",
+            auth_token);
+}
+
+TEST(AuthHandlerDigest, AuthAndSha512_256) {
+  std::string auth_token;
+  EXPECT_TRUE(RespondToChallenge(
+      "Digest realm=\"biloxi.com\", "
+      "qop=\"auth,auth-int\", "
+      "algorithm=SHA-512-256, "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+      "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\"",
+      Method::INVITE,
+      "sip:bob@biloxi.com",
+      "",
+      "0a4f113b",
+      &auth_token));
+  EXPECT_EQ("Authorization: Digest username=\"bob\", "
+            "realm=\"biloxi.com\", "
+            "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+            "uri=\"sip:bob@biloxi.com\", "
+            "algorithm=SHA-512-256, "
+            "response=\"7f1a09de0f19af0a1eac2b28d33e3f2f"
+            "b89cca1ad8fb01bba5e1883b288bac14\", "
+            "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\", "
+            "qop=auth, "
+            "nc=00000001, "
+            "cnonce=\"0a4f113b\"",
+            auth_token);
+}
+
+TEST(AuthHandlerDigest, AuthAndSha512_256Sess) {
+  std::string auth_token;
+  EXPECT_TRUE(RespondToChallenge(
+      "Digest realm=\"biloxi.com\", "
+      "qop=\"auth,auth-int\", "
+      "algorithm=SHA-512-256-sess, "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+      "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\"",
+      Method::INVITE,
+      "sip:bob@biloxi.com",
+      "",
+      "0a4f113b",
+      &auth_token));
+  EXPECT_EQ("Authorization: Digest username=\"bob\", "
+            "realm=\"biloxi.com\", "
+            "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+            "uri=\"sip:bob@biloxi.com\", "
+            "algorithm=SHA-512-256-sess, "
+            "response=\"077d9677be83f41f162d1a4453dc1633"
+            "89919f81e5927391d972f477da767633\", "
+            "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\", "
+            "qop=auth, "
+            "nc=00000001, "
+            "cnonce=\"0a4f113b\"",
+            auth_token);
+}
+
+TEST(AuthHandlerDigest, CachedHA1) {
+  scoped_ptr<AuthHandlerDigest::Factory> factory(
+      new AuthHandlerDigest::Factory());
+  factory->set_nonce_generator(
+      new AuthHandlerDigest::FixedNonceGenerator("0a4f113b"));
+  scoped_ptr<Header> header(Header::Parse(
+      "WWW-Authenticate: Digest realm=\"biloxi.com\", "
+      "qop=\"auth\", "
+      "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\""));
+  WwwAuthenticate *www_authenticate = dyn_cast<WwwAuthenticate>(header);
+  ASSERT_TRUE(www_authenticate != nullptr);
+  scoped_ptr<AuthHandler> handler;
+  ASSERT_EQ(net::OK, factory->CreateAuthHandler(
+      *www_authenticate, net::HttpAuth::AUTH_SERVER,
+      GURL("sip:biloxi.com:5060"), AuthHandlerFactory::CREATE_CHALLENGE, 1,
+      net::BoundNetLog(), &handler));
+
+  // Only the username is known, the password is replaced by H(A1).
+  handler->set_digest_ha1(DigestHA1::Compute("bob", "biloxi.com", "zanzibar"));
+  net::AuthCredentials credentials(base::ASCIIToUTF16("bob"),
+                                   base::string16());
+  scoped_refptr<Request> request(
+      new Request(Method::INVITE, GURL("sip:bob@biloxi.com")));
+  net::TestCompletionCallback callback;
+  ASSERT_EQ(net::OK, handler->GenerateAuth(
+      &credentials, request.get(), callback.callback()));
+  Authorization *authorization = request->get<Authorization>();
+  ASSERT_TRUE(authorization != nullptr);
+  EXPECT_EQ("89eb0059246c02b2f6ee02c7961d5ea3", authorization->response());
+}
+
 TEST(AuthHandlerDigest, HandleAnotherChallenge) {
   scoped_ptr<AuthHandlerDigest::Factory> factory(
       new AuthHandlerDigest::Factory());
@@ -6,6 +6,7 @@
 
 #include "net/base/net_errors.h"
 #include "sippet/message/message.h"
+#include "sippet/ua/auth.h"
 #include "sippet/ua/auth_controller.h"
 #include "sippet/ua/dialog.h"
 
@@ -37,6 +38,23 @@ int AuthTransaction::HandleChallengeAuthentication(
   return DoLoop(net::OK);
 }
 
+int AuthTransaction::AddPreemptiveAuthorization(
+    const scoped_refptr<Request> &outgoing_request,
+    const net::CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  if (!auth_controller_->SelectPreemptiveAuth(
+          Auth::GetRequestOrigin(outgoing_request), bound_net_log_))
+    return net::OK;
+  callback_ = callback;
+  outgoing_request_ = outgoing_request;
+  next_state_ = STATE_ADD_AUTHORIZATION_HEADERS;
+  return DoLoop(net::OK);
+}
+
+bool AuthTransaction::HaveAuth() const {
+  return auth_controller_->HaveAuth();
+}
+
 void AuthTransaction::OnIOComplete(int result) {
   DCHECK_NE(STATE_NONE, next_state_);
   int rv = DoLoop(result);
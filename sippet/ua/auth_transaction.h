@@ -36,6 +36,17 @@ class AuthTransaction {
       const scoped_refptr<Response> &incoming_response,
       const net::CompletionCallback& callback);
 
+  // Adds credentials to |outgoing_request| using the cached challenge of its
+  // origin, before any challenge is received. Returns |net::OK| without
+  // touching the request when there are no cached credentials; check
+  // |HaveAuth()| to tell both cases apart.
+  int AddPreemptiveAuthorization(
+      const scoped_refptr<Request> &outgoing_request,
+      const net::CompletionCallback& callback);
+
+  // Whether the transaction has credentials to authenticate with.
+  bool HaveAuth() const;
+
  private:
   enum State {
     STATE_HANDLE_AUTH_CHALLENGE,
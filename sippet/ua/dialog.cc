@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <string>
 
+#include "sippet/base/memory_usage.h"
 #include "sippet/base/sequences.h"
 #include "sippet/message/request.h"
 #include "sippet/message/response.h"
@@ -45,19 +46,25 @@ Dialog::Dialog(
         const GURL &remote_target,
         bool is_secure,
         const std::vector<GURL> &route_set)
-  : state_(state),
-    call_id_(call_id),
-    local_tag_(local_tag),
-    remote_tag_(remote_tag),
-    has_local_sequence_(has_local_sequence),
+  : local_uri_(InternedURL::Intern(local_uri)),
+    remote_uri_(InternedURL::Intern(remote_uri)),
+    remote_target_(InternedURL::Intern(remote_target)),
+    route_set_(InternedURLList::Intern(route_set)),
     local_sequence_(local_sequence),
-    has_remote_sequence_(has_remote_sequence),
     remote_sequence_(remote_sequence),
-    local_uri_(local_uri),
-    remote_uri_(remote_uri),
-    remote_target_(remote_target),
-    is_secure_(is_secure),
-    route_set_(route_set) {
+    call_id_length_(call_id.size()),
+    local_tag_length_(local_tag.size()),
+    state_(static_cast<uint8>(state)),
+    has_local_sequence_(has_local_sequence),
+    has_remote_sequence_(has_remote_sequence),
+    is_secure_(is_secure) {
+  // Pack all strings in a single allocation, which is the dialog id as well.
+  id_.reserve(call_id.size() + local_tag.size() + remote_tag.size() + 2);
+  id_.append(call_id);
+  id_.push_back(':');
+  id_.append(local_tag);
+  id_.push_back(':');
+  id_.append(remote_tag);
 }
 
 Dialog::~Dialog() {
@@ -79,7 +86,7 @@ scoped_refptr<Response> Dialog::CreateResponse(
     int response_code,
     const std::string &reason_phrase,
     const scoped_refptr<Request> &request) {
-  return request->CreateResponse(response_code, reason_phrase, remote_tag_);
+  return request->CreateResponse(response_code, reason_phrase, remote_tag());
 }
 
 scoped_refptr<Response> Dialog::CreateResponse(
@@ -100,7 +107,7 @@ scoped_refptr<Request> Dialog::CreateAck(
       CreateRequestInternal(Method::ACK, local_sequence));
   Via *via = invite->get<Via>();
   if (via)  // Copy topmost Via from INVITE
-    ack->insert(ack->begin(), via->Clone().Pass());
+    ack->push_front(via->Clone().Pass());
   invite->CloneTo<WwwAuthenticate>(ack.get());
   invite->CloneTo<ProxyAuthenticate>(ack.get());
   return ack;
@@ -149,6 +156,10 @@ scoped_refptr<Dialog> Dialog::Create(
       local_uri, remote_uri, remote_target, is_secure, route_set);
 }
 
+size_t Dialog::EstimateMemoryUsage() const {
+  return sizeof(*this) + EstimateStringMemoryUsage(id_);
+}
+
 unsigned Dialog::GetNewLocalSequence() {
   if (!has_local_sequence_) {
     local_sequence_ = Create16BitRandomInteger();
@@ -161,6 +172,9 @@ unsigned Dialog::GetNewLocalSequence() {
 
 scoped_refptr<Request> Dialog::CreateRequestInternal(
     const Method &method, unsigned local_sequence) {
+  // Requests are built from the dialog state each time rather than from a
+  // cached |RequestTemplate|: most dialogs send only a few requests, and a
+  // template per dialog would keep a whole request alive for each of them.
   GURL request_uri;
   scoped_ptr<Route> route;
   if (route_set().empty()) {
@@ -5,12 +5,14 @@
 #ifndef SIPPET_UA_DIALOG_H_
 #define SIPPET_UA_DIALOG_H_
 
+#include <string>
 #include <vector>
 
 #include "url/gurl.h"
 #include "base/memory/ref_counted.h"
 #include "sippet/message/method.h"
 #include "sippet/message/status_code.h"
+#include "sippet/ua/interned_url.h"
 
 namespace sippet {
 
@@ -53,29 +55,28 @@ class Dialog :
 
   // The dialog state.
   State state() {
-    return state_;
+    return static_cast<State>(state_);
   }
 
-  // Unique value used to identify the dialog.
-  std::string id() {
-    std::ostringstream oss;
-    oss << call_id() << ":" << local_tag() << ":" << remote_tag();
-    return oss.str();
+  // Unique value used to identify the dialog. It is also the storage of the
+  // Call-Id, local tag and remote tag, packed as "call-id:local:remote".
+  const std::string &id() const {
+    return id_;
   }
 
   // The Call-Id of the dialog.
   std::string call_id() const {
-    return call_id_;
+    return id_.substr(0, call_id_length_);
   }
 
   // The Local Tag of the dialog.
   std::string local_tag() const {
-    return local_tag_;
+    return id_.substr(call_id_length_ + 1, local_tag_length_);
   }
 
   // The Remote Tag of the dialog.
   std::string remote_tag() const {
-    return remote_tag_;
+    return id_.substr(call_id_length_ + local_tag_length_ + 2);
   }
 
   // Used to order requests from the User Agent to its peer.
@@ -94,19 +95,19 @@ class Dialog :
   }
 
   // The address of the local party.
-  GURL local_uri() const {
-    return local_uri_;
+  const GURL &local_uri() const {
+    return local_uri_->url();
   }
 
   // The address of the remote party.
-  GURL remote_uri() const {
-    return remote_uri_;
+  const GURL &remote_uri() const {
+    return remote_uri_->url();
   }
 
   // The address from the Contact header field of the request or response or
   // refresh request or response.
-  GURL remote_target() const {
-    return remote_target_;
+  const GURL &remote_target() const {
+    return remote_target_->url();
   }
 
   // Determines if the dialog is secure i.e. use the sips: scheme.
@@ -117,7 +118,7 @@ class Dialog :
   // An ordered list of URIs. The route set is the list of servers that need to
   // be traversed to send a request to the peer.
   const std::vector<GURL> &route_set() const {
-    return route_set_;
+    return route_set_->urls();
   }
 
   // Create a |Request| whithin a dialog.
@@ -136,6 +137,10 @@ class Dialog :
   // request being acknowledged.
   scoped_refptr<Request> CreateAck(const scoped_refptr<Request> &invite);
 
+  // Approximate bytes taken by the dialog. Interned URIs are shared among
+  // dialogs, and aren't counted.
+  size_t EstimateMemoryUsage() const;
+
  private:
   friend class base::RefCountedThreadSafe<Dialog>;
   friend class DialogStore;
@@ -156,19 +161,22 @@ class Dialog :
 
   virtual ~Dialog();
 
-  State state_;
-  std::string call_id_;
-  std::string local_tag_;
-  std::string remote_tag_;
-  bool has_local_sequence_;
+  // Fields are ordered to avoid padding; dialogs may count by the hundreds
+  // of thousands in gateways. URIs and the route set are interned, so
+  // dialogs of the same account or trunk share them.
+  std::string id_;
+  scoped_refptr<InternedURL> local_uri_;
+  scoped_refptr<InternedURL> remote_uri_;
+  scoped_refptr<InternedURL> remote_target_;
+  scoped_refptr<InternedURLList> route_set_;
   unsigned local_sequence_;
-  bool has_remote_sequence_;
   unsigned remote_sequence_;
-  GURL local_uri_;
-  GURL remote_uri_;
-  GURL remote_target_;
+  uint32 call_id_length_;
+  uint32 local_tag_length_;
+  uint8 state_;
+  bool has_local_sequence_;
+  bool has_remote_sequence_;
   bool is_secure_;
-  std::vector<GURL> route_set_;
 
   // Create a |Dialog|.
   static scoped_refptr<Dialog> Create(
@@ -176,7 +184,7 @@ class Dialog :
 
   // Set the dialog state (ControllerStore only).
   void set_state(State state) {
-    state_ = state;
+    state_ = static_cast<uint8>(state);
   }
 
   // Set the dialog remote sequence (UserAgent only).
@@ -0,0 +1,99 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process/process_metrics.h"
+#include "base/strings/string_number_conversions.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/ua/dialog.h"
+#include "sippet/test/microbenchmark.h"
+#include "sippet/ua/dialog_store.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace sippet {
+
+namespace {
+
+const size_t kDialogCount = 100000;
+
+// All dialogs are established through the same trunk, so they share the
+// local URI, remote URI, remote target and route set.
+const char kTrunkInvite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP gw1.atlanta.com;branch=z9hG4bK74bf9\r\n"
+  "Max-Forwards: 70\r\n"
+  "Record-Route: <sip:p1.atlanta.com;lr>, <sip:p2.biloxi.com;lr>\r\n"
+  "From: <sip:trunk@atlanta.com>;tag=9fxced76sl\r\n"
+  "To: <sip:bob@biloxi.com>\r\n"
+  "Call-ID: 3848276298220188511@atlanta.com\r\n"
+  "CSeq: 1 INVITE\r\n"
+  "Contact: <sip:trunk@gw1.atlanta.com>\r\n"
+  "\r\n";
+
+size_t GetWorkingSetSize() {
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+  return metrics->GetWorkingSetSize();
+}
+
+void GetDialogId(const scoped_refptr<Request> &request) {
+  std::string dialog_id(request->GetDialogId());
+  CHECK(!dialog_id.empty());
+}
+
+void GetDialog(DialogStore *store, const scoped_refptr<Request> &request) {
+  CHECK(store->GetDialog(request.get()));
+}
+
+}  // namespace
+
+TEST(DialogPerfTest, MemoryPerDialog) {
+  scoped_refptr<Request> invite(dyn_cast<Request>(
+      Message::Parse(kTrunkInvite)));
+  ASSERT_TRUE(invite);
+
+  DialogStore store;
+  size_t working_set_before = GetWorkingSetSize();
+  for (size_t i = 0; i < kDialogCount; ++i) {
+    invite->get<CallId>()->set_value(
+        base::SizeTToString(i) + "@atlanta.com");
+    scoped_refptr<Response> response(invite->CreateResponse(SIP_OK));
+    ASSERT_TRUE(store.GenerateDialog(response));
+  }
+  size_t working_set_after = GetWorkingSetSize();
+
+  perf_test::PrintResult("dialog", "", "memory_per_dialog",
+      static_cast<double>(working_set_after - working_set_before)
+          / kDialogCount, "bytes", true);
+}
+
+TEST(DialogPerfTest, Lookup) {
+  scoped_refptr<Request> invite(dyn_cast<Request>(
+      Message::Parse(kTrunkInvite)));
+  ASSERT_TRUE(invite);
+
+  DialogStore store;
+  scoped_refptr<Dialog> dialog;
+  for (size_t i = 0; i < kDialogCount; ++i) {
+    invite->get<CallId>()->set_value(
+        base::SizeTToString(i) + "@atlanta.com");
+    scoped_refptr<Response> response(invite->CreateResponse(SIP_OK));
+    dialog = store.GenerateDialog(response);
+    ASSERT_TRUE(dialog);
+  }
+  scoped_refptr<Request> bye(dialog->CreateRequest(Method::BYE));
+
+  Microbenchmark get_dialog_id("dialog_lookup", "get_dialog_id");
+  get_dialog_id.Run(base::Bind(&GetDialogId, bye));
+
+  Microbenchmark get_dialog("dialog_lookup", "get_dialog");
+  get_dialog.Run(base::Bind(&GetDialog, base::Unretained(&store), bye));
+}
+
+}  // namespace sippet
@@ -4,9 +4,12 @@
 
 #include "sippet/ua/dialog_store.h"
 
+#include "sippet/base/memory_usage.h"
 #include "sippet/base/stl_extras.h"
+#include "sippet/base/tracing.h"
 #include "sippet/message/message.h"
 #include "sippet/ua/dialog.h"
+#include "sippet/ua/ua_metrics.h"
 
 namespace sippet {
 
@@ -14,6 +17,7 @@ DialogStore::DialogStore() {
 }
 
 DialogStore::~DialogStore() {
+  UaMetrics::Get()->dialogs->Add(-static_cast<int64>(dialogs_.size()));
 }
 
 scoped_refptr<Dialog> DialogStore::GenerateDialog(
@@ -22,8 +26,10 @@ scoped_refptr<Dialog> DialogStore::GenerateDialog(
   if (dialogs_.end() != i)
     return i->second;
   scoped_refptr<Dialog> dialog(Dialog::Create(response));
-  if (dialog)
+  if (dialog) {
     dialogs_.insert(std::make_pair(dialog->id(), dialog));
+    UaMetrics::Get()->dialogs->Increment();
+  }
   return dialog;
 }
 
@@ -35,6 +41,7 @@ scoped_refptr<Dialog> DialogStore::TerminateDialog(
   scoped_refptr<Dialog> dialog(i->second);
   dialog->set_state(Dialog::STATE_TERMINATED);
   dialogs_.erase(i);
+  UaMetrics::Get()->dialogs->Decrement();
   return dialog;
 }
 
@@ -43,6 +50,7 @@ void DialogStore::TerminateDialog(const scoped_refptr<Dialog> &dialog) {
   if (dialogs_.end() != i) {
     dialog->set_state(Dialog::STATE_TERMINATED);
     dialogs_.erase(i);
+    UaMetrics::Get()->dialogs->Decrement();
   }
 }
 
@@ -52,10 +60,21 @@ void DialogStore::ConfirmDialog(const scoped_refptr<Dialog> &dialog) {
 }
 
 scoped_refptr<Dialog> DialogStore::GetDialog(const Message *message) {
+  SIPPET_TRACE_EVENT_WITH_FLOW0("DialogStore::GetDialog",
+                                message->GetTransactionTraceId());
   DialogMapType::iterator i = dialogs_.find(message->GetDialogId());
   if (dialogs_.end() == i)
     return nullptr;
   return i->second;
 }
 
+void DialogStore::DumpMemoryUsage(MemoryUsageDump *dump) const {
+  size_t bytes = 0;
+  for (const auto &entry : dialogs_) {
+    bytes += kTreeNodeOverhead + sizeof(entry)
+        + entry.second->EstimateMemoryUsage();
+  }
+  dump->Add("ua/dialogs", dialogs_.size(), bytes);
+}
+
 }  // namespace sippet
@@ -9,10 +9,12 @@
 #include <string>
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
+#include "base/strings/string_piece.h"
 
 namespace sippet {
 
 class Dialog;
+class MemoryUsageDump;
 class Message;
 class Request;
 class Response;
@@ -45,8 +47,17 @@ class DialogStore {
   // Given any message, retrieves the matching dialog.
   scoped_refptr<Dialog> GetDialog(const Message *message);
 
+  // The number of stored dialogs.
+  size_t size() const { return dialogs_.size(); }
+
+  // Adds the approximate memory held by the stored dialogs to |dump|, under
+  // "ua/dialogs".
+  void DumpMemoryUsage(MemoryUsageDump *dump) const;
+
  private:
-  typedef std::map<std::string, scoped_refptr<Dialog> > DialogMapType;
+  // Keys point to the dialog id owned by the stored |Dialog|, so the id
+  // isn't duplicated for each dialog.
+  typedef std::map<base::StringPiece, scoped_refptr<Dialog> > DialogMapType;
 
   DialogMapType dialogs_;
 
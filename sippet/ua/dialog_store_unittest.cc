@@ -0,0 +1,51 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/dialog_store.h"
+
+#include "sippet/base/memory_usage.h"
+#include "sippet/message/message.h"
+#include "sippet/ua/dialog.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kInvite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bKnashds8\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+}  // namespace
+
+TEST(DialogStoreTest, DumpMemoryUsage) {
+  DialogStore store;
+  scoped_refptr<Request> invite(dyn_cast<Request>(Message::Parse(kInvite)));
+  invite->set_direction(Message::Incoming);
+  scoped_refptr<Dialog> dialog(
+      store.GenerateDialog(invite->CreateResponse(SIP_RINGING)));
+  ASSERT_TRUE(dialog);
+
+  MemoryUsageDump dump;
+  store.DumpMemoryUsage(&dump);
+  const MemoryUsage &usage = dump.usages().find("ua/dialogs")->second;
+  EXPECT_EQ(1u, usage.object_count);
+  EXPECT_LE(dialog->EstimateMemoryUsage(), usage.bytes);
+
+  store.TerminateDialog(dialog);
+  MemoryUsageDump after_terminate;
+  store.DumpMemoryUsage(&after_terminate);
+  EXPECT_EQ(0u,
+      after_terminate.usages().find("ua/dialogs")->second.object_count);
+}
+
+} // namespace sippet
@@ -0,0 +1,315 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/digest_authenticator.h"
+
+#include <openssl/hmac.h>
+#include <openssl/mem.h>
+
+#include <algorithm>
+
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/clock.h"
+#include "base/time/default_clock.h"
+#include "sippet/base/tracing.h"
+#include "sippet/message/headers.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+
+namespace sippet {
+
+namespace {
+
+const int kDefaultNonceLifetimeSeconds = 300;
+
+// Nonces are made of a 16 digit hex timestamp followed by the first 16 bytes
+// of the HMAC-SHA256, hex encoded.
+const size_t kTimestampLength = 16;
+const size_t kMacLength = 16;
+const size_t kNonceLength = kTimestampLength + kMacLength * 2;
+
+const uint32 kReplayWindowSize = 64;
+
+// Names of |DigestHash::Algorithm| values, as sent in challenges.
+const char* const kAlgorithmNames[] = {
+  "MD5",
+  "SHA-256",
+  "SHA-512-256",
+};
+
+// Lowercase versions of |kAlgorithmNames|.
+const char* const kLowerCaseAlgorithmNames[] = {
+  "md5",
+  "sha-256",
+  "sha-512-256",
+};
+
+static_assert(arraysize(kAlgorithmNames) == DigestHash::ALGORITHM_MAX,
+              "kAlgorithmNames must match DigestHash::Algorithm");
+
+template <class HeaderType>
+const Credentials* FindDigestCredentials(
+    const scoped_refptr<Request>& request,
+    const std::string& realm) {
+  for (Message::iterator i = request->find_first<HeaderType>(),
+       ie = request->end(); i != ie; i = request->find_next<HeaderType>(i)) {
+    HeaderType* header = dyn_cast<HeaderType>(i);
+    if (header->HasScheme()
+        && base::LowerCaseEqualsASCII(header->scheme(), "digest")
+        && header->HasRealm()
+        && header->realm() == realm)
+      return header;
+  }
+  return nullptr;
+}
+
+void SetChallenge(Challenge* challenge,
+                  const std::string& realm,
+                  const std::string& nonce,
+                  DigestHash::Algorithm algorithm,
+                  bool stale) {
+  challenge->set_realm(realm);
+  challenge->set_nonce(nonce);
+  challenge->set_algorithm(kAlgorithmNames[algorithm]);
+  challenge->set_qop("auth");
+  if (stale)
+    challenge->set_stale(true);
+}
+
+bool EqualsConstantTime(const std::string& a, const std::string& b) {
+  return a.size() == b.size()
+      && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+}  // namespace
+
+DigestAuthenticator::NonceState::NonceState()
+  : timestamp(0),
+    highest_nc(0),
+    window(0) {
+}
+
+DigestAuthenticator::DigestAuthenticator(Auth::Target target,
+                                         const std::string& realm,
+                                         const std::string& secret,
+                                         const HA1LookupCallback& ha1_lookup)
+  : target_(target),
+    realm_(realm),
+    secret_(secret),
+    ha1_lookup_(ha1_lookup),
+    algorithm_(DigestHash::MD5),
+    nonce_lifetime_(
+        base::TimeDelta::FromSeconds(kDefaultNonceLifetimeSeconds)),
+    max_tracked_nonces_(kMaxTrackedNonces),
+    clock_(new base::DefaultClock) {
+  stale_watermark_ = clock_->Now().ToInternalValue() - 1;
+  DCHECK(net::HttpAuth::AUTH_SERVER == target_
+      || net::HttpAuth::AUTH_PROXY == target_);
+  DCHECK(!secret_.empty());
+  DCHECK(!ha1_lookup_.is_null());
+}
+
+DigestAuthenticator::~DigestAuthenticator() {
+}
+
+void DigestAuthenticator::set_clock_for_testing(
+    scoped_ptr<base::Clock> clock) {
+  clock_ = clock.Pass();
+  stale_watermark_ = clock_->Now().ToInternalValue() - 1;
+}
+
+DigestAuthenticator::Result DigestAuthenticator::Verify(
+    const scoped_refptr<Request>& request, std::string* username) {
+  SIPPET_TRACE_EVENT_WITH_FLOW0("DigestAuthenticator::Verify",
+                                request->GetTransactionTraceId());
+  const Credentials* credentials = FindCredentials(request);
+  if (!credentials)
+    return RESULT_NO_CREDENTIALS;
+  if (!credentials->HasUsername()
+      || !credentials->HasNonce()
+      || !credentials->HasUri()
+      || !credentials->HasResponse()
+      || !credentials->HasCnonce()
+      || !credentials->HasNc()
+      || !credentials->HasQop())
+    return RESULT_REJECTED;
+
+  std::string algorithm(credentials->HasAlgorithm() ?
+      credentials->algorithm() : kAlgorithmNames[DigestHash::MD5]);
+  if (!base::LowerCaseEqualsASCII(algorithm,
+                                  kLowerCaseAlgorithmNames[algorithm_]))
+    return RESULT_REJECTED;
+
+  std::string qop(credentials->qop());
+  bool auth_int = base::LowerCaseEqualsASCII(qop, "auth-int");
+  if (!auth_int && !base::LowerCaseEqualsASCII(qop, "auth"))
+    return RESULT_REJECTED;
+
+  // The digest covers the uri parameter, which must designate the same
+  // resource as the Request-URI.
+  std::string uri(credentials->uri());
+  if (GURL(uri) != request->request_uri())
+    return RESULT_REJECTED;
+
+  std::string nonce(credentials->nonce());
+  int64 timestamp;
+  if (!ParseNonce(nonce, GetClientAddress(request), &timestamp))
+    return RESULT_REJECTED;
+
+  std::string user(credentials->username());
+  std::string ha1;
+  if (!ha1_lookup_.Run(user, realm_, algorithm_, &ha1))
+    return RESULT_REJECTED;
+
+  std::string a2(request->method().str() + ":" + uri);
+  if (auth_int)
+    a2 += ":" + DigestHash::HexString(algorithm_, request->content());
+  uint32 nc = credentials->nc();
+  std::string expected = DigestHash::HexString(algorithm_,
+      base::StringToLowerASCII(ha1) + ":" + nonce + ":" +
+      base::StringPrintf("%08x", nc) + ":" + credentials->cnonce() + ":" +
+      qop + ":" + DigestHash::HexString(algorithm_, a2));
+  if (!EqualsConstantTime(expected,
+                          base::StringToLowerASCII(credentials->response())))
+    return RESULT_REJECTED;
+
+  // The credentials are right; the nonce may still be too old.
+  base::Time created = base::Time::FromInternalValue(timestamp);
+  if (clock_->Now() - created > nonce_lifetime_)
+    return RESULT_STALE_NONCE;
+
+  Result result = CheckNonceCount(nonce, timestamp, nc);
+  if (RESULT_ACCEPTED == result && username)
+    *username = user;
+  return result;
+}
+
+scoped_refptr<Response> DigestAuthenticator::CreateChallengeResponse(
+    const scoped_refptr<Request>& request, bool stale) {
+  std::string nonce(GenerateNonce(GetClientAddress(request)));
+  scoped_refptr<Response> response;
+  if (net::HttpAuth::AUTH_PROXY == target_) {
+    response = request->CreateResponse(SIP_PROXY_AUTHENTICATION_REQUIRED);
+    scoped_ptr<ProxyAuthenticate> proxy_authenticate(
+        new ProxyAuthenticate(Challenge::Digest));
+    SetChallenge(proxy_authenticate.get(), realm_, nonce, algorithm_, stale);
+    response->push_back(proxy_authenticate.Pass());
+  } else {
+    response = request->CreateResponse(SIP_UNAUTHORIZED);
+    scoped_ptr<WwwAuthenticate> www_authenticate(
+        new WwwAuthenticate(Challenge::Digest));
+    SetChallenge(www_authenticate.get(), realm_, nonce, algorithm_, stale);
+    response->push_back(www_authenticate.Pass());
+  }
+  return response;
+}
+
+// static
+std::string DigestAuthenticator::GetClientAddress(
+    const scoped_refptr<Request>& request) {
+  Via* via = request->get<Via>();
+  if (!via || via->empty())
+    return std::string();
+  if (via->front().HasReceived())
+    return via->front().received();
+  return via->front().sent_by().host();
+}
+
+const Credentials* DigestAuthenticator::FindCredentials(
+    const scoped_refptr<Request>& request) const {
+  if (net::HttpAuth::AUTH_PROXY == target_)
+    return FindDigestCredentials<ProxyAuthorization>(request, realm_);
+  return FindDigestCredentials<Authorization>(request, realm_);
+}
+
+std::string DigestAuthenticator::GenerateNonce(
+    const std::string& client_address) const {
+  std::string timestamp(base::StringPrintf("%016" PRIx64,
+      clock_->Now().ToInternalValue()));
+  return timestamp + ComputeNonceMac(timestamp, client_address);
+}
+
+bool DigestAuthenticator::ParseNonce(const std::string& nonce,
+                                     const std::string& client_address,
+                                     int64* timestamp) const {
+  if (nonce.size() != kNonceLength)
+    return false;
+  std::string timestamp_hex(nonce.substr(0, kTimestampLength));
+  if (!base::HexStringToInt64(timestamp_hex, timestamp))
+    return false;
+  return EqualsConstantTime(nonce.substr(kTimestampLength),
+                            ComputeNonceMac(timestamp_hex, client_address));
+}
+
+std::string DigestAuthenticator::ComputeNonceMac(
+    const std::string& timestamp,
+    const std::string& client_address) const {
+  std::string data(timestamp + ":" + client_address + ":" + realm_);
+  uint8_t mac[EVP_MAX_MD_SIZE];
+  unsigned int mac_length = 0;
+  if (!HMAC(EVP_sha256(), secret_.data(), secret_.size(),
+            reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+            mac, &mac_length)) {
+    NOTREACHED();
+    return std::string();
+  }
+  DCHECK_GE(mac_length, kMacLength);
+  return base::StringToLowerASCII(base::HexEncode(mac, kMacLength));
+}
+
+DigestAuthenticator::Result DigestAuthenticator::CheckNonceCount(
+    const std::string& nonce, int64 timestamp, uint32 nc) {
+  if (nc == 0)
+    return RESULT_REJECTED;
+
+  NonceMap::iterator i = nonces_.find(nonce);
+  if (nonces_.end() == i) {
+    // Either the nonce is new, or its state is unknown: discarded, or kept by
+    // a previous instance. In the latter case the nonce-counts already seen
+    // are unknown, so the client is asked for a fresh nonce.
+    if (nc != 1 || timestamp <= stale_watermark_)
+      return RESULT_STALE_NONCE;
+    RemoveOldestNonces();
+    NonceState state;
+    state.timestamp = timestamp;
+    state.highest_nc = nc;
+    state.window = 1;
+    nonces_.insert(std::make_pair(nonce, state));
+    return RESULT_ACCEPTED;
+  }
+
+  NonceState& state = i->second;
+  if (nc > state.highest_nc) {
+    uint32 shift = nc - state.highest_nc;
+    state.window = (shift < kReplayWindowSize) ? state.window << shift : 0;
+    state.window |= 1;
+    state.highest_nc = nc;
+    return RESULT_ACCEPTED;
+  }
+  uint32 offset = state.highest_nc - nc;
+  if (offset >= kReplayWindowSize)
+    return RESULT_REPLAYED;
+  uint64 bit = static_cast<uint64>(1) << offset;
+  if (state.window & bit)
+    return RESULT_REPLAYED;
+  state.window |= bit;
+  return RESULT_ACCEPTED;
+}
+
+void DigestAuthenticator::RemoveOldestNonces() {
+  int64 expired = (clock_->Now() - nonce_lifetime_).ToInternalValue();
+  while (!nonces_.empty() && nonces_.begin()->second.timestamp < expired)
+    nonces_.erase(nonces_.begin());
+  while (nonces_.size() >= max_tracked_nonces_) {
+    stale_watermark_ = std::max(stale_watermark_,
+                                nonces_.begin()->second.timestamp);
+    nonces_.erase(nonces_.begin());
+  }
+}
+
+} // namespace sippet
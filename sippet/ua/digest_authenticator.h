@@ -0,0 +1,184 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_DIGEST_AUTHENTICATOR_H_
+#define SIPPET_UA_DIGEST_AUTHENTICATOR_H_
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "sippet/ua/auth.h"
+#include "sippet/ua/digest_hash.h"
+
+namespace base {
+class Clock;
+}
+
+namespace sippet {
+
+class Credentials;
+class Request;
+class Response;
+
+// Server side of the Digest authentication scheme: challenges incoming
+// requests and verifies their Authorization (or Proxy-Authorization)
+// headers.
+//
+// Nonces are stateless: each one carries its creation time and an HMAC of
+// that time, the realm and the client address, keyed by a server secret. No
+// table of issued nonces is kept, so a registration storm costs no memory
+// until clients actually answer the challenges. Once a nonce is used, a small
+// sliding bitmap of the nonce-counts already seen is kept until the nonce
+// expires, to reject replayed requests.
+//
+// A nonce whose state isn't known is only accepted as new if it was issued
+// after the authenticator started and after the newest nonce whose state was
+// discarded to make room; older ones are stale. Otherwise a request captured
+// with nc=1 could be replayed once the state of its nonce is gone.
+//
+// Passwords are never seen by the authenticator: H(username:realm:password) is
+// obtained through the |HA1LookupCallback| given at construction.
+class DigestAuthenticator {
+ public:
+  // Looks up H(username:realm:password) of |username|, lowercase hex encoded,
+  // for the given |algorithm|. Returns false if the user is unknown.
+  typedef base::Callback<bool(const std::string& username,
+                              const std::string& realm,
+                              DigestHash::Algorithm algorithm,
+                              std::string* ha1)> HA1LookupCallback;
+
+  enum Result {
+    // The request carries valid credentials.
+    RESULT_ACCEPTED,
+    // There are no Digest credentials for this realm.
+    RESULT_NO_CREDENTIALS,
+    // The credentials are valid but the nonce has expired, or its state was
+    // already discarded. The client should retry using a fresh nonce.
+    RESULT_STALE_NONCE,
+    // The nonce-count was already used with this nonce.
+    RESULT_REPLAYED,
+    // Unknown user, forged nonce or wrong response.
+    RESULT_REJECTED,
+  };
+
+  // Limits the memory used to detect replays by default. When exceeded, the
+  // state of the oldest nonces is discarded and they are considered stale.
+  enum { kMaxTrackedNonces = 4096 };
+
+  // |target| selects between 401/WWW-Authenticate/Authorization and
+  // 407/Proxy-Authenticate/Proxy-Authorization. |secret| keys the nonce
+  // HMAC, and should be random and shared by all servers that can receive
+  // requests from the same client.
+  DigestAuthenticator(Auth::Target target,
+                      const std::string& realm,
+                      const std::string& secret,
+                      const HA1LookupCallback& ha1_lookup);
+  ~DigestAuthenticator();
+
+  const std::string& realm() const {
+    return realm_;
+  }
+
+  // The algorithm requested in challenges and accepted in credentials.
+  // Defaults to MD5, which most SIP clients support.
+  void set_algorithm(DigestHash::Algorithm algorithm) {
+    algorithm_ = algorithm;
+  }
+  DigestHash::Algorithm algorithm() const {
+    return algorithm_;
+  }
+
+  // For how long a nonce can be used. Defaults to 5 minutes.
+  void set_nonce_lifetime(const base::TimeDelta& nonce_lifetime) {
+    nonce_lifetime_ = nonce_lifetime;
+  }
+
+  // Maximum number of nonces for which nonce-counts are tracked. Defaults to
+  // |kMaxTrackedNonces|.
+  void set_max_tracked_nonces(size_t max_tracked_nonces) {
+    DCHECK_GT(max_tracked_nonces, 0u);
+    max_tracked_nonces_ = max_tracked_nonces;
+  }
+
+  // Verifies the credentials carried by |request|. On success, |username|,
+  // if not NULL, receives the authenticated user name.
+  Result Verify(const scoped_refptr<Request>& request, std::string* username);
+
+  // Creates a 401 (or 407) response to |request| carrying a new challenge.
+  // Set |stale| when answering a |RESULT_STALE_NONCE|.
+  scoped_refptr<Response> CreateChallengeResponse(
+      const scoped_refptr<Request>& request, bool stale);
+
+  // Number of nonces for which nonce-counts are currently tracked.
+  size_t tracked_nonces() const {
+    return nonces_.size();
+  }
+
+  void set_clock_for_testing(scoped_ptr<base::Clock> clock);
+
+ private:
+  // The nonce-counts seen for a nonce, as a window of 64 bits ending at the
+  // highest nonce-count received.
+  struct NonceState {
+    NonceState();
+
+    int64 timestamp;
+    uint32 highest_nc;
+    uint64 window;
+  };
+
+  // Nonces start with their fixed-width hex timestamp, so the map is sorted
+  // by creation time and the oldest nonce comes first.
+  typedef std::map<std::string, NonceState> NonceMap;
+
+  // Returns the address the request was received from, as stamped in the
+  // topmost Via header.
+  static std::string GetClientAddress(const scoped_refptr<Request>& request);
+
+  // Returns the first Digest credentials of |realm_| in |request|.
+  const Credentials* FindCredentials(
+      const scoped_refptr<Request>& request) const;
+
+  std::string GenerateNonce(const std::string& client_address) const;
+
+  // Checks the nonce HMAC, and returns its creation time.
+  bool ParseNonce(const std::string& nonce,
+                  const std::string& client_address,
+                  int64* timestamp) const;
+
+  std::string ComputeNonceMac(const std::string& timestamp,
+                              const std::string& client_address) const;
+
+  // Records |nc| for |nonce|, checking for replays.
+  Result CheckNonceCount(const std::string& nonce, int64 timestamp, uint32 nc);
+
+  // Discards the state of expired nonces and, if still full, of the oldest
+  // one, which becomes stale.
+  void RemoveOldestNonces();
+
+  Auth::Target target_;
+  std::string realm_;
+  std::string secret_;
+  HA1LookupCallback ha1_lookup_;
+  DigestHash::Algorithm algorithm_;
+  base::TimeDelta nonce_lifetime_;
+  size_t max_tracked_nonces_;
+  NonceMap nonces_;
+  // Unknown nonces created up to this time are stale: they were issued
+  // before the authenticator started, or their state was discarded.
+  int64 stale_watermark_;
+  scoped_ptr<base::Clock> clock_;
+
+  DISALLOW_COPY_AND_ASSIGN(DigestAuthenticator);
+};
+
+} // namespace sippet
+
+#endif // SIPPET_UA_DIGEST_AUTHENTICATOR_H_
@@ -0,0 +1,257 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/digest_authenticator.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/test/simple_test_clock.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "sippet/message/headers.h"
+#include "sippet/message/request.h"
+#include "sippet/message/response.h"
+#include "sippet/ua/auth_handler_digest.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+const char kRegister[] =
+  "REGISTER sip:biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Bob <sip:bob@biloxi.com>;tag=456248\r\n"
+  "Call-ID: 843817637684230@998sdasdh09\r\n"
+  "CSeq: 1826 REGISTER\r\n"
+  "Contact: <sip:bob@192.0.2.4>\r\n"
+  "Expires: 7200\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+bool LookupHA1(const std::string& username,
+               const std::string& realm,
+               DigestHash::Algorithm algorithm,
+               std::string* ha1) {
+  if (username != "bob")
+    return false;
+  *ha1 = DigestHA1::Compute(username, realm, "zanzibar").get(algorithm);
+  return true;
+}
+
+}  // namespace
+
+class DigestAuthenticatorTest : public testing::Test {
+ public:
+  void SetUp() override {
+    clock_ = new base::SimpleTestClock;
+    clock_->SetNow(base::Time::Now());
+    authenticator_.reset(new DigestAuthenticator(net::HttpAuth::AUTH_SERVER,
+        "biloxi.com", "secret", base::Bind(&LookupHA1)));
+    authenticator_->set_clock_for_testing(scoped_ptr<base::Clock>(clock_));
+  }
+
+  scoped_refptr<Request> CreateRegister() {
+    return dyn_cast<Request>(Message::Parse(kRegister));
+  }
+
+  // Answers |challenge| the way a client would, using |nonce_count|.
+  scoped_refptr<Request> Authenticate(
+      const scoped_refptr<Response>& challenge,
+      const std::string& password,
+      int nonce_count) {
+    AuthHandlerDigest::Factory factory;
+    factory.set_nonce_generator(
+        new AuthHandlerDigest::FixedNonceGenerator("0a4f113b"));
+    WwwAuthenticate* www_authenticate = challenge->get<WwwAuthenticate>();
+    EXPECT_TRUE(www_authenticate != nullptr);
+    scoped_ptr<AuthHandler> handler;
+    EXPECT_EQ(net::OK, factory.CreateAuthHandler(*www_authenticate,
+        net::HttpAuth::AUTH_SERVER, GURL("sip:biloxi.com:5060"),
+        AuthHandlerFactory::CREATE_CHALLENGE, nonce_count,
+        net::BoundNetLog(), &handler));
+    scoped_refptr<Request> request(CreateRegister());
+    net::AuthCredentials credentials(base::ASCIIToUTF16("bob"),
+                                     base::ASCIIToUTF16(password));
+    net::TestCompletionCallback callback;
+    EXPECT_EQ(net::OK, handler->GenerateAuth(&credentials, request.get(),
+                                             callback.callback()));
+    return request;
+  }
+
+  DigestAuthenticator::Result Verify(const scoped_refptr<Request>& request) {
+    return authenticator_->Verify(request, nullptr);
+  }
+
+ protected:
+  base::SimpleTestClock* clock_;
+  scoped_ptr<DigestAuthenticator> authenticator_;
+};
+
+TEST_F(DigestAuthenticatorTest, ChallengeWithoutCredentials) {
+  scoped_refptr<Request> request(CreateRegister());
+  EXPECT_EQ(DigestAuthenticator::RESULT_NO_CREDENTIALS, Verify(request));
+
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(request, false));
+  EXPECT_EQ(SIP_UNAUTHORIZED, challenge->response_code());
+  WwwAuthenticate* www_authenticate = challenge->get<WwwAuthenticate>();
+  ASSERT_TRUE(www_authenticate != nullptr);
+  EXPECT_EQ("Digest", www_authenticate->scheme());
+  EXPECT_EQ("biloxi.com", www_authenticate->realm());
+  EXPECT_EQ("MD5", www_authenticate->algorithm());
+  EXPECT_EQ("auth", www_authenticate->qop());
+  EXPECT_EQ(48u, www_authenticate->nonce().size());
+  EXPECT_FALSE(www_authenticate->HasStale());
+}
+
+TEST_F(DigestAuthenticatorTest, AcceptValidCredentials) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  scoped_refptr<Request> request(Authenticate(challenge, "zanzibar", 1));
+  std::string username;
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            authenticator_->Verify(request, &username));
+  EXPECT_EQ("bob", username);
+  EXPECT_EQ(1u, authenticator_->tracked_nonces());
+}
+
+TEST_F(DigestAuthenticatorTest, RejectWrongPassword) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  EXPECT_EQ(DigestAuthenticator::RESULT_REJECTED,
+            Verify(Authenticate(challenge, "wrong", 1)));
+  EXPECT_EQ(0u, authenticator_->tracked_nonces());
+}
+
+TEST_F(DigestAuthenticatorTest, RejectNonceFromAnotherClient) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  scoped_refptr<Request> request(Authenticate(challenge, "zanzibar", 1));
+  request->get<Via>()->front().set_received("192.0.2.99");
+  EXPECT_EQ(DigestAuthenticator::RESULT_REJECTED, Verify(request));
+}
+
+TEST_F(DigestAuthenticatorTest, DetectReplays) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 1)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_REPLAYED,
+            Verify(Authenticate(challenge, "zanzibar", 1)));
+
+  // Nonce counts may arrive out of order, but only once.
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 3)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 2)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_REPLAYED,
+            Verify(Authenticate(challenge, "zanzibar", 2)));
+
+  // Too old to be tracked.
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 100)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_REPLAYED,
+            Verify(Authenticate(challenge, "zanzibar", 4)));
+}
+
+TEST_F(DigestAuthenticatorTest, ExpiredNonceIsStale) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  clock_->Advance(base::TimeDelta::FromMinutes(6));
+  scoped_refptr<Request> request(Authenticate(challenge, "zanzibar", 1));
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE, Verify(request));
+
+  scoped_refptr<Response> stale_challenge(
+      authenticator_->CreateChallengeResponse(request, true));
+  WwwAuthenticate* www_authenticate = stale_challenge->get<WwwAuthenticate>();
+  ASSERT_TRUE(www_authenticate != nullptr);
+  EXPECT_TRUE(www_authenticate->stale());
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(stale_challenge, "zanzibar", 1)));
+}
+
+TEST_F(DigestAuthenticatorTest, UnknownNonceStateIsStale) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  // A valid nonce never seen with nc=1, e.g. after a restart.
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE,
+            Verify(Authenticate(challenge, "zanzibar", 2)));
+}
+
+TEST_F(DigestAuthenticatorTest, NonceIssuedBeforeStartIsStale) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  scoped_refptr<Request> request(Authenticate(challenge, "zanzibar", 1));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED, Verify(request));
+
+  // A restarted server doesn't know which nonce-counts were used.
+  clock_->Advance(base::TimeDelta::FromSeconds(1));
+  base::SimpleTestClock* clock = new base::SimpleTestClock;
+  clock->SetNow(clock_->Now());
+  authenticator_.reset(new DigestAuthenticator(net::HttpAuth::AUTH_SERVER,
+      "biloxi.com", "secret", base::Bind(&LookupHA1)));
+  authenticator_->set_clock_for_testing(scoped_ptr<base::Clock>(clock));
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE, Verify(request));
+
+  scoped_refptr<Response> fresh_challenge(
+      authenticator_->CreateChallengeResponse(request, true));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(fresh_challenge, "zanzibar", 1)));
+}
+
+TEST_F(DigestAuthenticatorTest, EvictOldestNonces) {
+  authenticator_->set_max_tracked_nonces(2);
+  std::vector<scoped_refptr<Response> > challenges;
+  for (int i = 0; i < 3; ++i) {
+    clock_->Advance(base::TimeDelta::FromMicroseconds(1));
+    challenges.push_back(
+        authenticator_->CreateChallengeResponse(CreateRegister(), false));
+    EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+              Verify(Authenticate(challenges.back(), "zanzibar", 1)));
+  }
+  EXPECT_EQ(2u, authenticator_->tracked_nonces());
+
+  // The evicted nonce can't be used again, not even replaying nc=1.
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE,
+            Verify(Authenticate(challenges[0], "zanzibar", 1)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE,
+            Verify(Authenticate(challenges[0], "zanzibar", 2)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenges[1], "zanzibar", 2)));
+  EXPECT_EQ(DigestAuthenticator::RESULT_REPLAYED,
+            Verify(Authenticate(challenges[2], "zanzibar", 1)));
+}
+
+TEST_F(DigestAuthenticatorTest, DiscardExpiredNonces) {
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 1)));
+  EXPECT_EQ(1u, authenticator_->tracked_nonces());
+
+  clock_->Advance(base::TimeDelta::FromMinutes(6));
+  scoped_refptr<Response> fresh_challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(fresh_challenge, "zanzibar", 1)));
+  EXPECT_EQ(1u, authenticator_->tracked_nonces());
+  EXPECT_EQ(DigestAuthenticator::RESULT_STALE_NONCE,
+            Verify(Authenticate(challenge, "zanzibar", 2)));
+}
+
+TEST_F(DigestAuthenticatorTest, Sha256) {
+  authenticator_->set_algorithm(DigestHash::SHA256);
+  scoped_refptr<Response> challenge(
+      authenticator_->CreateChallengeResponse(CreateRegister(), false));
+  EXPECT_EQ("SHA-256", challenge->get<WwwAuthenticate>()->algorithm());
+  EXPECT_EQ(DigestAuthenticator::RESULT_ACCEPTED,
+            Verify(Authenticate(challenge, "zanzibar", 1)));
+}
+
+} // namespace sippet
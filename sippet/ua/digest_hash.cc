@@ -0,0 +1,87 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/digest_hash.h"
+
+#include <openssl/sha.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/md5.h"
+
+namespace sippet {
+
+namespace {
+
+// SHA-512/256 is SHA-512 started from a different initial hash value and
+// truncated to 256 bits (FIPS 180-4, section 5.3.6.2).
+const uint64_t kSHA512_256InitialHashValue[8] = {
+  0x22312194fc2bf72cULL, 0x9f555fa3c84c64c2ULL,
+  0x2393b86b6f53b151ULL, 0x963877195940eabdULL,
+  0x96283ee2a88effe3ULL, 0xbe5e1e2553863992ULL,
+  0x2b0199fc2c85b8aaULL, 0x0eb72ddc81c52ca2ULL,
+};
+
+const size_t kSHA512_256DigestLength = 32;
+
+std::string ToLowerHex(const uint8_t* data, size_t length) {
+  static const char kHexChars[] = "0123456789abcdef";
+  std::string result(length * 2, '\0');
+  for (size_t i = 0; i < length; ++i) {
+    result[i * 2] = kHexChars[data[i] >> 4];
+    result[i * 2 + 1] = kHexChars[data[i] & 0xf];
+  }
+  return result;
+}
+
+}  // namespace
+
+// static
+std::string DigestHash::HexString(Algorithm algorithm,
+                                  const base::StringPiece& input) {
+  switch (algorithm) {
+    case MD5:
+      return base::MD5String(input);
+    case SHA256: {
+      uint8_t digest[SHA256_DIGEST_LENGTH];
+      SHA256(reinterpret_cast<const uint8_t*>(input.data()), input.size(),
+             digest);
+      return ToLowerHex(digest, sizeof(digest));
+    }
+    case SHA512_256: {
+      SHA512_CTX ctx;
+      SHA512_Init(&ctx);
+      memcpy(ctx.h, kSHA512_256InitialHashValue, sizeof(ctx.h));
+      SHA512_Update(&ctx, input.data(), input.size());
+      uint8_t digest[SHA512_DIGEST_LENGTH];
+      SHA512_Final(digest, &ctx);
+      return ToLowerHex(digest, kSHA512_256DigestLength);
+    }
+    default:
+      NOTREACHED();
+      return std::string();
+  }
+}
+
+DigestHA1::DigestHA1() {
+}
+
+DigestHA1::~DigestHA1() {
+}
+
+// static
+DigestHA1 DigestHA1::Compute(const std::string& username,
+                             const std::string& realm,
+                             const std::string& password) {
+  std::string a1(username + ":" + realm + ":" + password);
+  DigestHA1 result;
+  result.realm_ = realm;
+  for (int i = 0; i < DigestHash::ALGORITHM_MAX; ++i) {
+    DigestHash::Algorithm algorithm = static_cast<DigestHash::Algorithm>(i);
+    result.ha1_[i] = DigestHash::HexString(algorithm, a1);
+  }
+  return result;
+}
+
+} // namespace sippet
@@ -0,0 +1,71 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_DIGEST_HASH_H_
+#define SIPPET_UA_DIGEST_HASH_H_
+
+#include <string>
+
+#include "base/strings/string_piece.h"
+
+namespace sippet {
+
+// Hash functions used by the Digest authentication scheme (RFC 2617 and
+// RFC 8760). SHA-256 and SHA-512/256 are computed by BoringSSL, which
+// selects at runtime the implementation using the CPU hash extensions
+// (Intel SHA, ARMv8 Crypto) when available.
+class DigestHash {
+ public:
+  enum Algorithm {
+    MD5 = 0,
+    SHA256,
+    SHA512_256,
+    ALGORITHM_MAX
+  };
+
+  // Returns the lowercase hex encoded hash of |input|.
+  static std::string HexString(Algorithm algorithm,
+                               const base::StringPiece& input);
+
+ private:
+  DigestHash();
+};
+
+// Holds H(A1) = H(username:realm:password) for each |DigestHash::Algorithm|,
+// so that digest responses can be generated without keeping the plaintext
+// password nor hashing it again on every request.
+class DigestHA1 {
+ public:
+  DigestHA1();
+  ~DigestHA1();
+
+  // Computes the H(A1) values of all supported algorithms. |realm| is the
+  // realm as sent over the wire.
+  static DigestHA1 Compute(const std::string& username,
+                           const std::string& realm,
+                           const std::string& password);
+
+  // True if no value was computed.
+  bool empty() const {
+    return ha1_[DigestHash::MD5].empty();
+  }
+
+  // The realm used to compute the values.
+  const std::string& realm() const {
+    return realm_;
+  }
+
+  // The lowercase hex encoded H(A1) for |algorithm|.
+  const std::string& get(DigestHash::Algorithm algorithm) const {
+    return ha1_[algorithm];
+  }
+
+ private:
+  std::string realm_;
+  std::string ha1_[DigestHash::ALGORITHM_MAX];
+};
+
+} // namespace sippet
+
+#endif // SIPPET_UA_DIGEST_HASH_H_
@@ -0,0 +1,39 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/digest_hash.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+TEST(DigestHashTest, KnownAnswers) {
+  EXPECT_EQ("900150983cd24fb0d6963f7d28e17f72",
+            DigestHash::HexString(DigestHash::MD5, "abc"));
+  EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223"
+            "b00361a396177a9cb410ff61f20015ad",
+            DigestHash::HexString(DigestHash::SHA256, "abc"));
+  EXPECT_EQ("53048e2681941ef99b2e29b76b4c7dab"
+            "e4c2d0c634fc6d46e0e2f13107e7af23",
+            DigestHash::HexString(DigestHash::SHA512_256, "abc"));
+}
+
+TEST(DigestHashTest, ComputeHA1) {
+  DigestHA1 empty;
+  EXPECT_TRUE(empty.empty());
+
+  DigestHA1 ha1(DigestHA1::Compute("bob", "biloxi.com", "zanzibar"));
+  EXPECT_FALSE(ha1.empty());
+  EXPECT_EQ("biloxi.com", ha1.realm());
+  EXPECT_EQ("12af60467a33e8518da5c68bbff12b11",
+            ha1.get(DigestHash::MD5));
+  EXPECT_EQ("e65db393e748c5228939a6b4b2879e9e"
+            "a5625cd79fd5267868cb568d69f6b97e",
+            ha1.get(DigestHash::SHA256));
+  EXPECT_EQ("a969680ab364e333ec5c93ff823d570a"
+            "79841c8d40270655dd42f37b755dfc38",
+            ha1.get(DigestHash::SHA512_256));
+}
+
+} // namespace sippet
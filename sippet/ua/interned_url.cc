@@ -0,0 +1,142 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/interned_url.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/containers/hash_tables.h"
+#include "base/lazy_instance.h"
+#include "base/synchronization/lock.h"
+
+namespace sippet {
+
+namespace {
+
+// Entries only referenced by the pool are released once the pool doubles its
+// size since the last sweep, keeping the cost of sweeping amortized.
+const size_t kMinSweepThreshold = 64;
+
+// The pool keeps a reference to every interned value, keyed by a string
+// piece owned by the value itself. An entry whose only reference is the
+// pool's own can't be reached by anyone else, so it is safe to drop it while
+// holding the lock.
+template <typename T>
+class InternPool {
+ public:
+  InternPool() : sweep_threshold_(kMinSweepThreshold) {}
+
+  base::Lock &lock() { return lock_; }
+
+  // The following methods must be called with |lock_| held.
+  scoped_refptr<T> Find(const base::StringPiece &key) {
+    lock_.AssertAcquired();
+    typename MapType::iterator i = map_.find(key);
+    return map_.end() != i ? i->second : nullptr;
+  }
+
+  void Insert(const scoped_refptr<T> &value) {
+    lock_.AssertAcquired();
+    map_.insert(std::make_pair(value->key(), value));
+    if (map_.size() >= sweep_threshold_)
+      Sweep();
+  }
+
+  size_t size() const {
+    lock_.AssertAcquired();
+    return map_.size();
+  }
+
+ private:
+  typedef base::hash_map<base::StringPiece, scoped_refptr<T> > MapType;
+
+  void Sweep() {
+    for (typename MapType::iterator i = map_.begin(); i != map_.end();) {
+      if (i->second->HasOneRef())
+        map_.erase(i++);
+      else
+        ++i;
+    }
+    sweep_threshold_ = std::max(kMinSweepThreshold, map_.size() * 2);
+  }
+
+  base::Lock lock_;
+  MapType map_;
+  size_t sweep_threshold_;
+};
+
+base::LazyInstance<InternPool<InternedURL> >::Leaky
+  g_url_pool = LAZY_INSTANCE_INITIALIZER;
+
+base::LazyInstance<InternPool<InternedURLList> >::Leaky
+  g_url_list_pool = LAZY_INSTANCE_INITIALIZER;
+
+std::string JoinSpecs(const std::vector<GURL> &urls) {
+  std::string result;
+  for (std::vector<GURL>::const_iterator i = urls.begin(), ie = urls.end();
+       i != ie; ++i) {
+    result.append(i->spec());
+    result.push_back('\n');
+  }
+  return result;
+}
+
+}  // namespace
+
+InternedURL::InternedURL(const GURL &url)
+  : url_(url) {
+}
+
+InternedURL::~InternedURL() {
+}
+
+scoped_refptr<InternedURL> InternedURL::Intern(const GURL &url) {
+  InternPool<InternedURL> *pool = g_url_pool.Pointer();
+  base::AutoLock lock(pool->lock());
+  scoped_refptr<InternedURL> value(pool->Find(url.spec()));
+  if (!value) {
+    value = new InternedURL(url);
+    pool->Insert(value);
+  }
+  return value;
+}
+
+// static
+size_t InternedURL::GetPoolSizeForTesting() {
+  InternPool<InternedURL> *pool = g_url_pool.Pointer();
+  base::AutoLock lock(pool->lock());
+  return pool->size();
+}
+
+InternedURLList::InternedURLList(const std::vector<GURL> &urls,
+                                 const std::string &key)
+  : urls_(urls),
+    key_(key) {
+}
+
+InternedURLList::~InternedURLList() {
+}
+
+scoped_refptr<InternedURLList> InternedURLList::Intern(
+    const std::vector<GURL> &urls) {
+  std::string key(JoinSpecs(urls));
+  InternPool<InternedURLList> *pool = g_url_list_pool.Pointer();
+  base::AutoLock lock(pool->lock());
+  scoped_refptr<InternedURLList> value(pool->Find(key));
+  if (!value) {
+    value = new InternedURLList(urls, key);
+    pool->Insert(value);
+  }
+  return value;
+}
+
+// static
+size_t InternedURLList::GetPoolSizeForTesting() {
+  InternPool<InternedURLList> *pool = g_url_list_pool.Pointer();
+  base::AutoLock lock(pool->lock());
+  return pool->size();
+}
+
+}  // namespace sippet
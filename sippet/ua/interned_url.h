@@ -0,0 +1,89 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_INTERNED_URL_H_
+#define SIPPET_UA_INTERNED_URL_H_
+
+#include <string>
+#include <vector>
+
+#include "url/gurl.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_piece.h"
+
+namespace sippet {
+
+// An immutable, reference counted |GURL| shared by every holder of the same
+// URL spec. Dialogs belonging to the same account or trunk usually carry the
+// same local URI, remote URI and route set, so interning them avoids keeping
+// one canonical spec and |url::Parsed| per dialog.
+//
+// URLs unique to a dialog, such as remote targets carrying ;ob or ;gr
+// parameters, aren't shared: each one costs a pool entry and a lock on top
+// of the |GURL| it would take anyway. The pool only keeps them while a
+// dialog refers to them; released entries are swept once the pool doubles.
+class InternedURL :
+  public base::RefCountedThreadSafe<InternedURL> {
+ public:
+  // Returns the shared instance for |url|, creating it if needed.
+  static scoped_refptr<InternedURL> Intern(const GURL &url);
+
+  const GURL &url() const {
+    return url_;
+  }
+
+  // The key used for interning.
+  base::StringPiece key() const {
+    return url_.spec();
+  }
+
+  // Number of entries in the pool, released or not.
+  static size_t GetPoolSizeForTesting();
+
+ private:
+  friend class base::RefCountedThreadSafe<InternedURL>;
+
+  explicit InternedURL(const GURL &url);
+  ~InternedURL();
+
+  const GURL url_;
+
+  DISALLOW_COPY_AND_ASSIGN(InternedURL);
+};
+
+// An immutable, reference counted list of URLs, used to share a dialog route
+// set among all dialogs established through the same set of proxies.
+class InternedURLList :
+  public base::RefCountedThreadSafe<InternedURLList> {
+ public:
+  // Returns the shared instance for |urls|, creating it if needed.
+  static scoped_refptr<InternedURLList> Intern(const std::vector<GURL> &urls);
+
+  const std::vector<GURL> &urls() const {
+    return urls_;
+  }
+
+  // The key used for interning.
+  base::StringPiece key() const {
+    return key_;
+  }
+
+  // Number of entries in the pool, released or not.
+  static size_t GetPoolSizeForTesting();
+
+ private:
+  friend class base::RefCountedThreadSafe<InternedURLList>;
+
+  InternedURLList(const std::vector<GURL> &urls, const std::string &key);
+  ~InternedURLList();
+
+  const std::vector<GURL> urls_;
+  const std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(InternedURLList);
+};
+
+} // End of sippet namespace
+
+#endif // SIPPET_UA_INTERNED_URL_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/interned_url.h"
+
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+GURL GetUniqueTarget(int i) {
+  return GURL(base::StringPrintf(
+      "sip:alice@192.0.2.4:5060;ob;gr=urn:uuid:%08d", i));
+}
+
+}  // namespace
+
+TEST(InternedURLTest, SharesEqualURLs) {
+  scoped_refptr<InternedURL> a(
+      InternedURL::Intern(GURL("sip:alice@atlanta.com")));
+  scoped_refptr<InternedURL> b(
+      InternedURL::Intern(GURL("sip:alice@atlanta.com")));
+  scoped_refptr<InternedURL> c(
+      InternedURL::Intern(GURL("sip:bob@biloxi.com")));
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_NE(a.get(), c.get());
+  EXPECT_EQ("sip:alice@atlanta.com", a->url().spec());
+}
+
+TEST(InternedURLTest, ReleasesUnreferencedURLs) {
+  size_t size_before = InternedURL::GetPoolSizeForTesting();
+  // Per-dialog-unique targets are dropped once their dialogs are gone.
+  for (int i = 0; i < 1000; ++i)
+    InternedURL::Intern(GetUniqueTarget(i));
+  EXPECT_LT(InternedURL::GetPoolSizeForTesting(), size_before + 128);
+
+  // But kept, one entry each, while referenced.
+  std::vector<scoped_refptr<InternedURL> > targets;
+  for (int i = 0; i < 1000; ++i)
+    targets.push_back(InternedURL::Intern(GetUniqueTarget(i)));
+  EXPECT_LE(1000u, InternedURL::GetPoolSizeForTesting());
+
+  scoped_refptr<InternedURL> held(targets.front());
+  targets.clear();
+  for (int i = 1000; i < 3000; ++i)
+    InternedURL::Intern(GetUniqueTarget(i));
+  EXPECT_EQ(held.get(), InternedURL::Intern(GetUniqueTarget(0)).get());
+}
+
+TEST(InternedURLListTest, SharesEqualLists) {
+  std::vector<GURL> route_set;
+  route_set.push_back(GURL("sip:p1.example.com;lr"));
+  route_set.push_back(GURL("sip:p2.example.com;lr"));
+  scoped_refptr<InternedURLList> a(InternedURLList::Intern(route_set));
+  scoped_refptr<InternedURLList> b(InternedURLList::Intern(route_set));
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_EQ(route_set, a->urls());
+
+  // Order matters in a route set.
+  std::vector<GURL> reversed(route_set.rbegin(), route_set.rend());
+  EXPECT_NE(a.get(), InternedURLList::Intern(reversed).get());
+
+  // A single URL doesn't match a list that starts with it.
+  std::vector<GURL> first(1, route_set.front());
+  EXPECT_NE(a.get(), InternedURLList::Intern(first).get());
+}
+
+TEST(InternedURLListTest, ReleasesUnreferencedLists) {
+  size_t size_before = InternedURLList::GetPoolSizeForTesting();
+  for (int i = 0; i < 1000; ++i)
+    InternedURLList::Intern(std::vector<GURL>(1, GetUniqueTarget(i)));
+  EXPECT_LT(InternedURLList::GetPoolSizeForTesting(), size_before + 128);
+}
+
+} // namespace sippet
@@ -0,0 +1,277 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/location_service.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "sippet/uri/uri.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+// Registrations usually last one hour, that fit in a single turn.
+const size_t kWheelSlots = 4096;
+
+bool HasHigherQvalue(const LocationService::Binding &a,
+                     const LocationService::Binding &b) {
+  return a.q > b.q;
+}
+
+std::vector<LocationService::Binding>::iterator FindContact(
+    std::vector<LocationService::Binding> *bindings, const GURL &contact) {
+  for (std::vector<LocationService::Binding>::iterator i = bindings->begin(),
+       ie = bindings->end(); i != ie; ++i) {
+    if (i->contact == contact)
+      return i;
+  }
+  return bindings->end();
+}
+
+}  // namespace
+
+LocationService::Binding::Binding()
+  : q(1.0),
+    cseq(0),
+    timer_id(0) {
+}
+
+LocationService::Binding::~Binding() {
+}
+
+LocationService::Snapshot::Snapshot(std::vector<Binding> *bindings) {
+  bindings_.swap(*bindings);
+}
+
+LocationService::Snapshot::~Snapshot() {
+}
+
+LocationService::Change::Change()
+  : q(1.0),
+    expires(0) {
+}
+
+LocationService::Change::Change(const GURL &contact, double q,
+                                unsigned expires)
+  : contact(contact),
+    q(q),
+    expires(expires) {
+}
+
+LocationService::Change::~Change() {
+}
+
+LocationService::Shard::Shard() {
+}
+
+LocationService::Shard::~Shard() {
+}
+
+LocationService::LocationService()
+  : binding_count_(0),
+    aor_count_(0),
+    wheel_(kWheelSlots) {
+}
+
+LocationService::~LocationService() {
+}
+
+// static
+std::string LocationService::GetAddressOfRecord(const GURL &uri) {
+  if (!uri.SchemeIs("sip") && !uri.SchemeIs("sips"))
+    return uri.spec();
+  SipURI sip_uri(uri);
+  if (!sip_uri.is_valid())
+    return uri.spec();
+  std::string aor(sip_uri.scheme());
+  aor.push_back(':');
+  if (sip_uri.has_username()) {
+    aor.append(sip_uri.username());
+    aor.push_back('@');
+  }
+  aor.append(sip_uri.host());
+  if (sip_uri.has_port()) {
+    aor.push_back(':');
+    aor.append(sip_uri.port());
+  }
+  return aor;
+}
+
+scoped_refptr<const LocationService::Snapshot> LocationService::Lookup(
+    const std::string &aor) const {
+  const Shard &shard = GetShard(aor);
+  base::AutoLock lock(shard.lock);
+  AorMap::const_iterator i = shard.aors.find(aor);
+  return shard.aors.end() != i ? i->second : nullptr;
+}
+
+LocationService::Result LocationService::Update(
+    const std::string &aor,
+    const std::string &call_id,
+    uint32 cseq,
+    const std::vector<Change> &changes) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  Shard &shard = GetShard(aor);
+  std::vector<Binding> bindings;
+  GetBindings(shard, aor, &bindings);
+
+  for (std::vector<Change>::const_iterator i = changes.begin(),
+       ie = changes.end(); i != ie; ++i) {
+    std::vector<Binding>::iterator binding =
+        FindContact(&bindings, i->contact);
+    if (bindings.end() != binding && binding->call_id == call_id
+        && binding->cseq >= cseq)
+      return RESULT_OUT_OF_ORDER;
+  }
+
+  base::Time now(base::Time::Now());
+  for (std::vector<Change>::const_iterator i = changes.begin(),
+       ie = changes.end(); i != ie; ++i) {
+    std::vector<Binding>::iterator binding =
+        FindContact(&bindings, i->contact);
+    if (0 == i->expires) {
+      if (bindings.end() != binding) {
+        FreeTimer(binding->timer_id);
+        bindings.erase(binding);
+        --binding_count_;
+      }
+      continue;
+    }
+    if (bindings.end() == binding) {
+      bindings.push_back(Binding());
+      binding = bindings.end() - 1;
+      binding->contact = i->contact;
+      binding->timer_id = AllocateTimer(aor);
+      ++binding_count_;
+    }
+    binding->q = i->q;
+    binding->expires = now + base::TimeDelta::FromSeconds(i->expires);
+    binding->call_id = call_id;
+    binding->cseq = cseq;
+    wheel_.Schedule(binding->timer_id, i->expires);
+  }
+
+  std::stable_sort(bindings.begin(), bindings.end(), &HasHigherQvalue);
+  Publish(&shard, aor, &bindings);
+  return RESULT_OK;
+}
+
+LocationService::Result LocationService::RemoveAll(
+    const std::string &aor,
+    const std::string &call_id,
+    uint32 cseq) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  Shard &shard = GetShard(aor);
+  std::vector<Binding> bindings;
+  GetBindings(shard, aor, &bindings);
+  for (std::vector<Binding>::const_iterator i = bindings.begin(),
+       ie = bindings.end(); i != ie; ++i) {
+    if (i->call_id == call_id && i->cseq >= cseq)
+      return RESULT_OUT_OF_ORDER;
+  }
+  for (std::vector<Binding>::const_iterator i = bindings.begin(),
+       ie = bindings.end(); i != ie; ++i) {
+    FreeTimer(i->timer_id);
+  }
+  binding_count_ -= bindings.size();
+  bindings.clear();
+  Publish(&shard, aor, &bindings);
+  return RESULT_OK;
+}
+
+void LocationService::Advance() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  std::vector<uint32> expired;
+  wheel_.Advance(&expired);
+  for (std::vector<uint32>::const_iterator i = expired.begin(),
+       ie = expired.end(); i != ie; ++i) {
+    // Copied, as freeing the timer releases it.
+    std::string aor(timer_aors_[*i]);
+    Shard &shard = GetShard(aor);
+    std::vector<Binding> bindings;
+    GetBindings(shard, aor, &bindings);
+    for (std::vector<Binding>::iterator j = bindings.begin(),
+         je = bindings.end(); j != je; ++j) {
+      if (j->timer_id == *i) {
+        bindings.erase(j);
+        --binding_count_;
+        break;
+      }
+    }
+    FreeTimer(*i);
+    Publish(&shard, aor, &bindings);
+  }
+}
+
+LocationService::Shard &LocationService::GetShard(const std::string &aor) {
+  return shards_[BASE_HASH_NAMESPACE::hash<std::string>()(aor)
+      % kShardCount];
+}
+
+const LocationService::Shard &LocationService::GetShard(
+    const std::string &aor) const {
+  return shards_[BASE_HASH_NAMESPACE::hash<std::string>()(aor)
+      % kShardCount];
+}
+
+void LocationService::GetBindings(const Shard &shard,
+                                  const std::string &aor,
+                                  std::vector<Binding> *bindings) const {
+  // No lock needed: only this thread modifies the shard.
+  AorMap::const_iterator i = shard.aors.find(aor);
+  if (shard.aors.end() != i)
+    *bindings = i->second->bindings();
+}
+
+void LocationService::Publish(Shard *shard,
+                              const std::string &aor,
+                              std::vector<Binding> *bindings) {
+  scoped_refptr<const Snapshot> snapshot;
+  if (!bindings->empty())
+    snapshot = new Snapshot(bindings);
+
+  // The previous snapshot is released out of the lock.
+  scoped_refptr<const Snapshot> previous;
+  base::AutoLock lock(shard->lock);
+  AorMap::iterator i = shard->aors.find(aor);
+  if (shard->aors.end() == i) {
+    if (snapshot.get()) {
+      shard->aors.insert(std::make_pair(aor, snapshot));
+      ++aor_count_;
+    }
+    return;
+  }
+  previous.swap(i->second);
+  if (snapshot.get()) {
+    i->second = snapshot;
+  } else {
+    shard->aors.erase(i);
+    --aor_count_;
+  }
+}
+
+uint32 LocationService::AllocateTimer(const std::string &aor) {
+  uint32 timer_id;
+  if (free_timers_.empty()) {
+    timer_id = static_cast<uint32>(timer_aors_.size());
+    timer_aors_.push_back(aor);
+  } else {
+    timer_id = free_timers_.back();
+    free_timers_.pop_back();
+    timer_aors_[timer_id] = aor;
+  }
+  return timer_id;
+}
+
+void LocationService::FreeTimer(uint32 timer_id) {
+  wheel_.Cancel(timer_id);
+  timer_aors_[timer_id].clear();
+  free_timers_.push_back(timer_id);
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,182 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_LOCATION_SERVICE_H_
+#define SIPPET_UA_LOCATION_SERVICE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "sippet/base/timer_wheel.h"
+#include "url/gurl.h"
+
+namespace sippet {
+namespace ua {
+
+// Keeps the contacts registered to each address-of-record (AOR), as the
+// location service of RFC 3261 section 10.
+//
+// Contacts are updated by a single thread, usually by the |Registrar| on the
+// network thread, while lookups can be made from any thread. Each AOR maps
+// to an immutable |Snapshot| of its contacts that is replaced, never
+// modified, by updates. A lookup only holds the lock of one of the shards of
+// the AOR index for as long as it takes to reference the snapshot, so
+// readers don't contend with each other, nor with updates of other shards.
+//
+// Contact expirations are driven by a |TimerWheel| with one second ticks,
+// advanced by calling |Advance| once per second.
+class LocationService :
+  public base::RefCountedThreadSafe<LocationService> {
+ public:
+  struct Binding {
+    Binding();
+    ~Binding();
+
+    GURL contact;
+    // Contacts without a q-value are preferred, as if they had 1.0.
+    double q;
+    base::Time expires;
+    // Call-ID and CSeq of the REGISTER that last updated the binding.
+    std::string call_id;
+    uint32 cseq;
+    // The binding's timer in the expiration wheel.
+    uint32 timer_id;
+  };
+
+  // The contacts bound to an AOR, sorted by decreasing q-value. Contacts
+  // with the same q-value keep the order they were registered in.
+  class Snapshot :
+    public base::RefCountedThreadSafe<Snapshot> {
+   public:
+    const std::vector<Binding> &bindings() const {
+      return bindings_;
+    }
+
+   private:
+    friend class LocationService;
+    friend class base::RefCountedThreadSafe<Snapshot>;
+
+    // Takes the contents of |bindings|.
+    explicit Snapshot(std::vector<Binding> *bindings);
+    ~Snapshot();
+
+    std::vector<Binding> bindings_;
+
+    DISALLOW_COPY_AND_ASSIGN(Snapshot);
+  };
+
+  // A contact of a REGISTER request.
+  struct Change {
+    Change();
+    Change(const GURL &contact, double q, unsigned expires);
+    ~Change();
+
+    GURL contact;
+    double q;
+    // Zero removes the binding.
+    unsigned expires;
+  };
+
+  enum Result {
+    RESULT_OK,
+    // A binding was last updated by a request with the same Call-ID and an
+    // equal or higher CSeq. Nothing was changed.
+    RESULT_OUT_OF_ORDER,
+  };
+
+  LocationService();
+
+  // Returns the canonical AOR of |uri|, used to index the bindings. SIP
+  // URIs keep only their scheme, user, host and port.
+  static std::string GetAddressOfRecord(const GURL &uri);
+
+  // Returns the contacts bound to |aor|, or NULL if there are none. Can be
+  // called from any thread.
+  scoped_refptr<const Snapshot> Lookup(const std::string &aor) const;
+
+  // Applies the contacts of a REGISTER request to |aor|, as described in
+  // RFC 3261 section 10.3, step 7. Either all or none of |changes| are
+  // applied.
+  Result Update(const std::string &aor,
+                const std::string &call_id,
+                uint32 cseq,
+                const std::vector<Change> &changes);
+
+  // Removes all bindings of |aor|, as requested by a "Contact: *".
+  Result RemoveAll(const std::string &aor,
+                   const std::string &call_id,
+                   uint32 cseq);
+
+  // Moves the expiration wheel one second forward, removing the bindings
+  // that expired.
+  void Advance();
+
+  // Number of bindings and of AORs with at least one binding. Must be called
+  // from the updating thread.
+  size_t binding_count() const {
+    return binding_count_;
+  }
+  size_t aor_count() const {
+    return aor_count_;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<LocationService>;
+
+  enum { kShardCount = 64 };
+
+  typedef base::hash_map<std::string, scoped_refptr<const Snapshot> > AorMap;
+
+  struct Shard {
+    Shard();
+    ~Shard();
+
+    // Held by the updating thread only to modify |aors|, as nobody else
+    // does.
+    mutable base::Lock lock;
+    AorMap aors;
+  };
+
+  ~LocationService();
+
+  Shard &GetShard(const std::string &aor);
+  const Shard &GetShard(const std::string &aor) const;
+
+  // Copies the current bindings of |aor| into |bindings|.
+  void GetBindings(const Shard &shard,
+                   const std::string &aor,
+                   std::vector<Binding> *bindings) const;
+
+  // Replaces the snapshot of |aor| by |bindings|, erasing it if empty.
+  void Publish(Shard *shard,
+               const std::string &aor,
+               std::vector<Binding> *bindings);
+
+  uint32 AllocateTimer(const std::string &aor);
+  void FreeTimer(uint32 timer_id);
+
+  Shard shards_[kShardCount];
+  size_t binding_count_;
+  size_t aor_count_;
+
+  TimerWheel wheel_;
+  // The AOR of each timer, indexed by timer ID.
+  std::vector<std::string> timer_aors_;
+  std::vector<uint32> free_timers_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocationService);
+};
+
+} // namespace ua
+} // namespace sippet
+
+#endif // SIPPET_UA_LOCATION_SERVICE_H_
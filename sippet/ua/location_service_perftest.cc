@@ -0,0 +1,70 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "sippet/ua/location_service.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const size_t kBindingCount = 1000000;
+
+}  // namespace
+
+// Registers one contact for each of |kBindingCount| AORs, then refreshes and
+// looks them all up, reporting the number of operations per second.
+TEST(LocationServicePerfTest, MillionBindings) {
+  std::vector<std::string> aors;
+  std::vector<std::vector<LocationService::Change> > changes;
+  aors.reserve(kBindingCount);
+  changes.reserve(kBindingCount);
+  for (size_t i = 0; i < kBindingCount; ++i) {
+    std::string user(base::SizeTToString(i));
+    aors.push_back("sip:" + user + "@biloxi.com");
+    changes.push_back(std::vector<LocationService::Change>(1,
+        LocationService::Change(GURL("sip:" + user + "@192.0.2.4"), 1.0,
+                                3600)));
+  }
+
+  scoped_refptr<LocationService> service(new LocationService);
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kBindingCount; ++i) {
+    ASSERT_EQ(LocationService::RESULT_OK,
+              service->Update(aors[i], "call-id", 1, changes[i]));
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  ASSERT_EQ(kBindingCount, service->binding_count());
+  perf_test::PrintResult("location_service", "", "register",
+      kBindingCount / elapsed.InSecondsF(), "registers/s", true);
+
+  start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kBindingCount; ++i) {
+    ASSERT_EQ(LocationService::RESULT_OK,
+              service->Update(aors[i], "call-id", 2, changes[i]));
+  }
+  elapsed = base::TimeTicks::Now() - start;
+  perf_test::PrintResult("location_service", "", "refresh",
+      kBindingCount / elapsed.InSecondsF(), "registers/s", true);
+
+  start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kBindingCount; ++i) {
+    scoped_refptr<const LocationService::Snapshot> snapshot(
+        service->Lookup(aors[i]));
+    ASSERT_TRUE(snapshot);
+  }
+  elapsed = base::TimeTicks::Now() - start;
+  perf_test::PrintResult("location_service", "", "lookup",
+      kBindingCount / elapsed.InSecondsF(), "lookups/s", true);
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,122 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/location_service.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const char kAor[] = "sip:bob@biloxi.com";
+const char kCallId[] = "843817637684230@998sdasdh09";
+
+std::vector<LocationService::Change> OneChange(const char *contact,
+                                               double q,
+                                               unsigned expires) {
+  return std::vector<LocationService::Change>(1,
+      LocationService::Change(GURL(contact), q, expires));
+}
+
+}  // namespace
+
+TEST(LocationServiceTest, AddressOfRecord) {
+  EXPECT_EQ("sip:bob@biloxi.com", LocationService::GetAddressOfRecord(
+      GURL("sip:bob@BILOXI.com;transport=tcp")));
+  EXPECT_EQ("sips:bob@biloxi.com:5071", LocationService::GetAddressOfRecord(
+      GURL("sips:bob@biloxi.com:5071?subject=project")));
+}
+
+TEST(LocationServiceTest, SortsByQvalue) {
+  scoped_refptr<LocationService> service(new LocationService);
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor, kCallId, 1,
+      OneChange("sip:bob@192.0.2.4", 0.5, 3600)));
+  scoped_refptr<const LocationService::Snapshot> first(
+      service->Lookup(kAor));
+
+  std::vector<LocationService::Change> changes;
+  changes.push_back(LocationService::Change(
+      GURL("sip:bob@192.0.2.5"), 0.5, 3600));
+  changes.push_back(LocationService::Change(
+      GURL("sip:bob@192.0.2.6"), 0.9, 3600));
+  EXPECT_EQ(LocationService::RESULT_OK,
+            service->Update(kAor, kCallId, 2, changes));
+  EXPECT_EQ(3u, service->binding_count());
+  EXPECT_EQ(1u, service->aor_count());
+
+  scoped_refptr<const LocationService::Snapshot> snapshot(
+      service->Lookup(kAor));
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(3u, snapshot->bindings().size());
+  EXPECT_EQ(GURL("sip:bob@192.0.2.6"), snapshot->bindings()[0].contact);
+  EXPECT_EQ(GURL("sip:bob@192.0.2.4"), snapshot->bindings()[1].contact);
+  EXPECT_EQ(GURL("sip:bob@192.0.2.5"), snapshot->bindings()[2].contact);
+
+  // Previous snapshots aren't modified.
+  EXPECT_EQ(1u, first->bindings().size());
+}
+
+TEST(LocationServiceTest, RejectsOutOfOrder) {
+  scoped_refptr<LocationService> service(new LocationService);
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor, kCallId, 2,
+      OneChange("sip:bob@192.0.2.4", 1.0, 3600)));
+  EXPECT_EQ(LocationService::RESULT_OUT_OF_ORDER, service->Update(kAor,
+      kCallId, 2, OneChange("sip:bob@192.0.2.4", 1.0, 0)));
+  EXPECT_EQ(LocationService::RESULT_OUT_OF_ORDER,
+            service->RemoveAll(kAor, kCallId, 1));
+
+  // Another client may remove the binding.
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor,
+      "a84b4c76e66710", 1, OneChange("sip:bob@192.0.2.4", 1.0, 0)));
+  EXPECT_FALSE(service->Lookup(kAor));
+  EXPECT_EQ(0u, service->binding_count());
+  EXPECT_EQ(0u, service->aor_count());
+}
+
+TEST(LocationServiceTest, RemoveAll) {
+  scoped_refptr<LocationService> service(new LocationService);
+  std::vector<LocationService::Change> changes;
+  changes.push_back(LocationService::Change(
+      GURL("sip:bob@192.0.2.4"), 1.0, 3600));
+  changes.push_back(LocationService::Change(
+      GURL("sip:bob@192.0.2.5"), 1.0, 3600));
+  EXPECT_EQ(LocationService::RESULT_OK,
+            service->Update(kAor, kCallId, 1, changes));
+  EXPECT_EQ(LocationService::RESULT_OK,
+            service->RemoveAll(kAor, kCallId, 2));
+  EXPECT_FALSE(service->Lookup(kAor));
+  EXPECT_EQ(0u, service->binding_count());
+}
+
+TEST(LocationServiceTest, Expires) {
+  scoped_refptr<LocationService> service(new LocationService);
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor, kCallId, 1,
+      OneChange("sip:bob@192.0.2.4", 1.0, 2)));
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor, kCallId, 2,
+      OneChange("sip:bob@192.0.2.5", 1.0, 3)));
+
+  service->Advance();
+  EXPECT_EQ(2u, service->binding_count());
+  service->Advance();
+  scoped_refptr<const LocationService::Snapshot> snapshot(
+      service->Lookup(kAor));
+  ASSERT_TRUE(snapshot);
+  ASSERT_EQ(1u, snapshot->bindings().size());
+  EXPECT_EQ(GURL("sip:bob@192.0.2.5"), snapshot->bindings()[0].contact);
+
+  // Refreshing restarts the expiration.
+  EXPECT_EQ(LocationService::RESULT_OK, service->Update(kAor, kCallId, 3,
+      OneChange("sip:bob@192.0.2.5", 1.0, 3)));
+  service->Advance();
+  EXPECT_EQ(1u, service->binding_count());
+  service->Advance();
+  service->Advance();
+  EXPECT_EQ(0u, service->binding_count());
+  EXPECT_FALSE(service->Lookup(kAor));
+}
+
+} // namespace ua
+} // namespace sippet
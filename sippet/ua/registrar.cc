@@ -0,0 +1,165 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/registrar.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/logging.h"
+#include "sippet/message/message.h"
+#include "sippet/ua/digest_authenticator.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const unsigned kDefaultMinExpires = 60;
+const unsigned kDefaultMaxExpires = 7200;
+const unsigned kDefaultExpires = 3600;
+
+}  // namespace
+
+Registrar::Registrar(UserAgent *user_agent,
+                     const scoped_refptr<LocationService> &location_service)
+  : user_agent_(user_agent),
+    location_service_(location_service),
+    authenticator_(nullptr),
+    min_expires_(kDefaultMinExpires),
+    max_expires_(kDefaultMaxExpires),
+    default_expires_(kDefaultExpires) {
+  DCHECK(user_agent_);
+  DCHECK(location_service_);
+  tick_timer_.Start(FROM_HERE, base::TimeDelta::FromSeconds(1),
+      this, &Registrar::OnTick);
+}
+
+Registrar::~Registrar() {
+}
+
+void Registrar::OnChannelConnected(const EndPoint &destination, int err) {
+}
+
+void Registrar::OnChannelClosed(const EndPoint &destination) {
+}
+
+void Registrar::OnIncomingRequest(
+    const scoped_refptr<Request> &incoming_request,
+    const scoped_refptr<Dialog> &dialog) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (Method::REGISTER != incoming_request->method())
+    return;
+  scoped_refptr<Response> response(HandleRegister(incoming_request));
+  user_agent_->Send(response, net::CompletionCallback());
+}
+
+void Registrar::OnIncomingResponse(
+    const scoped_refptr<Response> &incoming_response,
+    const scoped_refptr<Dialog> &dialog) {
+}
+
+void Registrar::OnTimedOut(
+    const scoped_refptr<Request> &request,
+    const scoped_refptr<Dialog> &dialog) {
+}
+
+void Registrar::OnTransportError(
+    const scoped_refptr<Request> &request, int error,
+    const scoped_refptr<Dialog> &dialog) {
+}
+
+scoped_refptr<Response> Registrar::HandleRegister(
+    const scoped_refptr<Request> &request) {
+  if (authenticator_) {
+    DigestAuthenticator::Result result =
+        authenticator_->Verify(request, nullptr);
+    if (DigestAuthenticator::RESULT_ACCEPTED != result) {
+      return authenticator_->CreateChallengeResponse(request,
+          DigestAuthenticator::RESULT_STALE_NONCE == result);
+    }
+  }
+
+  To *to = request->get<To>();
+  CallId *call_id = request->get<CallId>();
+  Cseq *cseq = request->get<Cseq>();
+  if (!to || !call_id || !cseq)
+    return request->CreateResponse(SIP_BAD_REQUEST);
+  std::string aor(LocationService::GetAddressOfRecord(to->address()));
+
+  unsigned default_expires = default_expires_;
+  Expires *expires = request->get<Expires>();
+  if (expires)
+    default_expires = expires->value();
+
+  bool remove_all = false;
+  std::vector<LocationService::Change> changes;
+  for (Message::iterator i = request->find_first<Contact>(),
+       ie = request->end(); i != ie; i = request->find_next<Contact>(i)) {
+    Contact *contact = dyn_cast<Contact>(i);
+    if (contact->is_all()) {
+      remove_all = true;
+      continue;
+    }
+    for (Contact::const_iterator j = contact->begin(), je = contact->end();
+         j != je; ++j) {
+      unsigned contact_expires =
+          j->HasExpires() ? j->expires() : default_expires;
+      if (0 != contact_expires && contact_expires < min_expires_) {
+        scoped_refptr<Response> response(
+            request->CreateResponse(SIP_INTERVAL_TOO_BRIEF));
+        response->push_back(scoped_ptr<Header>(new MinExpires(min_expires_)));
+        return response;
+      }
+      changes.push_back(LocationService::Change(j->address(),
+          j->HasQvalue() ? j->qvalue() : 1.0,
+          std::min(contact_expires, max_expires_)));
+    }
+  }
+
+  LocationService::Result result = LocationService::RESULT_OK;
+  if (remove_all) {
+    // "Contact: *" must be alone, and with "Expires: 0".
+    if (!changes.empty() || !expires || 0 != expires->value())
+      return request->CreateResponse(SIP_BAD_REQUEST);
+    result = location_service_->RemoveAll(aor, call_id->value(),
+                                          cseq->sequence());
+  } else if (!changes.empty()) {
+    result = location_service_->Update(aor, call_id->value(),
+                                       cseq->sequence(), changes);
+  }
+  if (LocationService::RESULT_OK != result)
+    return request->CreateResponse(SIP_SERVER_INTERNAL_ERROR);
+  return CreateOkResponse(request, aor);
+}
+
+scoped_refptr<Response> Registrar::CreateOkResponse(
+    const scoped_refptr<Request> &request, const std::string &aor) {
+  scoped_refptr<Response> response(request->CreateResponse(SIP_OK));
+  scoped_refptr<const LocationService::Snapshot> snapshot(
+      location_service_->Lookup(aor));
+  if (!snapshot)
+    return response;
+
+  base::Time now(base::Time::Now());
+  scoped_ptr<Contact> contact(new Contact);
+  for (std::vector<LocationService::Binding>::const_iterator i =
+       snapshot->bindings().begin(), ie = snapshot->bindings().end();
+       i != ie; ++i) {
+    ContactInfo info(i->contact);
+    int64 remaining = std::max<int64>((i->expires - now).InSeconds(), 0);
+    info.set_expires(static_cast<unsigned>(remaining));
+    contact->push_back(info);
+  }
+  response->push_back(contact.Pass());
+  return response;
+}
+
+void Registrar::OnTick() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  location_service_->Advance();
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,107 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_REGISTRAR_H_
+#define SIPPET_UA_REGISTRAR_H_
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/threading/thread_checker.h"
+#include "base/timer/timer.h"
+#include "sippet/ua/location_service.h"
+#include "sippet/ua/ua_user_agent.h"
+
+namespace sippet {
+
+class DigestAuthenticator;
+
+namespace ua {
+
+// Answers the REGISTER requests received by a |UserAgent|, keeping the
+// bindings in a |LocationService| that can be shared with routing code
+// running on other threads.
+//
+// The registrar must be appended to the handlers of the |UserAgent|, and
+// all its methods must be called on the network thread.
+class Registrar : public UserAgent::Delegate {
+ public:
+  // The |user_agent| must outlive the registrar.
+  Registrar(UserAgent *user_agent,
+            const scoped_refptr<LocationService> &location_service);
+  ~Registrar() override;
+
+  LocationService *location_service() const {
+    return location_service_.get();
+  }
+
+  // Requests to register for less than |min_expires| seconds are answered
+  // with 423 (Interval Too Brief). Defaults to 60 seconds.
+  void set_min_expires(unsigned min_expires) {
+    min_expires_ = min_expires;
+  }
+
+  // Longer registrations are shortened to |max_expires| seconds. Defaults
+  // to 7200 seconds.
+  void set_max_expires(unsigned max_expires) {
+    max_expires_ = max_expires;
+  }
+
+  // Used when the request doesn't say. Defaults to 3600 seconds.
+  void set_default_expires(unsigned default_expires) {
+    default_expires_ = default_expires;
+  }
+
+  // Challenges requests without valid credentials. Not owned, may be NULL,
+  // which is the default.
+  void set_authenticator(DigestAuthenticator *authenticator) {
+    authenticator_ = authenticator;
+  }
+
+  // UserAgent::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override;
+  void OnChannelClosed(const EndPoint &destination) override;
+  void OnIncomingRequest(
+      const scoped_refptr<Request> &incoming_request,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnIncomingResponse(
+      const scoped_refptr<Response> &incoming_response,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnTimedOut(
+      const scoped_refptr<Request> &request,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnTransportError(
+      const scoped_refptr<Request> &request, int error,
+      const scoped_refptr<Dialog> &dialog) override;
+
+ private:
+  // Processes |request| and returns the response to be sent.
+  scoped_refptr<Response> HandleRegister(
+      const scoped_refptr<Request> &request);
+
+  // Creates a 200 (OK) listing the contacts bound to |aor|.
+  scoped_refptr<Response> CreateOkResponse(
+      const scoped_refptr<Request> &request, const std::string &aor);
+
+  void OnTick();
+
+  // Just for testing purposes
+  friend class RegistrarTest;
+
+  UserAgent *user_agent_;
+  scoped_refptr<LocationService> location_service_;
+  DigestAuthenticator *authenticator_;
+  unsigned min_expires_;
+  unsigned max_expires_;
+  unsigned default_expires_;
+
+  base::RepeatingTimer<Registrar> tick_timer_;
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(Registrar);
+};
+
+} // namespace ua
+} // namespace sippet
+
+#endif // SIPPET_UA_REGISTRAR_H_
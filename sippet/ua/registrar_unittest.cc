@@ -0,0 +1,203 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/registrar.h"
+
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "sippet/message/message.h"
+#include "sippet/ua/auth_handler_digest.h"
+#include "sippet/ua/auth_handler_mock.h"
+#include "sippet/ua/dialog_controller.h"
+#include "sippet/ua/digest_authenticator.h"
+#include "sippet/ua/password_handler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const char kAor[] = "sip:bob@biloxi.com";
+
+const char kRegisterFormat[] =
+  "REGISTER sip:biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Bob <sip:bob@biloxi.com>;tag=456248\r\n"
+  "Call-ID: 843817637684230@998sdasdh09\r\n"
+  "CSeq: %u REGISTER\r\n"
+  "%s"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+bool LookupHA1(const std::string& username,
+               const std::string& realm,
+               DigestHash::Algorithm algorithm,
+               std::string* ha1) {
+  if (username != "bob")
+    return false;
+  *ha1 = DigestHA1::Compute(username, realm, "zanzibar").get(algorithm);
+  return true;
+}
+
+class NullPasswordHandlerFactory : public PasswordHandler::Factory {
+ public:
+  scoped_ptr<PasswordHandler> CreatePasswordHandler() override {
+    return scoped_ptr<PasswordHandler>();
+  }
+};
+
+}  // namespace
+
+class RegistrarTest : public testing::Test {
+ public:
+  void SetUp() override {
+    user_agent_.reset(new UserAgent(&auth_handler_factory_,
+        &password_handler_factory_,
+        DialogController::GetDefaultDialogController(),
+        net::BoundNetLog()));
+    location_service_ = new LocationService;
+    registrar_.reset(new Registrar(user_agent_.get(), location_service_));
+  }
+
+  // A REGISTER with |headers| between its CSeq and Content-Length.
+  scoped_refptr<Request> CreateRegister(unsigned sequence,
+                                        const char *headers) {
+    return dyn_cast<Request>(Message::Parse(
+        base::StringPrintf(kRegisterFormat, sequence, headers)));
+  }
+
+  scoped_refptr<Response> HandleRegister(
+      const scoped_refptr<Request> &request) {
+    return registrar_->HandleRegister(request);
+  }
+
+  // The bindings of |kAor|, or zero if there are none.
+  size_t binding_count() {
+    scoped_refptr<const LocationService::Snapshot> snapshot(
+        location_service_->Lookup(kAor));
+    return snapshot ? snapshot->bindings().size() : 0;
+  }
+
+  base::MessageLoop message_loop_;
+  AuthHandlerMock::Factory auth_handler_factory_;
+  NullPasswordHandlerFactory password_handler_factory_;
+  scoped_ptr<UserAgent> user_agent_;
+  scoped_refptr<LocationService> location_service_;
+  scoped_ptr<Registrar> registrar_;
+};
+
+TEST_F(RegistrarTest, IntervalTooBrief) {
+  scoped_refptr<Response> response(HandleRegister(CreateRegister(1,
+      "Contact: <sip:bob@192.0.2.4>\r\n"
+      "Expires: 30\r\n")));
+  EXPECT_EQ(SIP_INTERVAL_TOO_BRIEF, response->response_code());
+  const MinExpires *min_expires = response->get<MinExpires>();
+  ASSERT_TRUE(min_expires);
+  EXPECT_EQ(60u, min_expires->value());
+  EXPECT_EQ(0u, binding_count());
+
+  // The expires parameter of the contact takes precedence.
+  registrar_->set_min_expires(120);
+  response = HandleRegister(CreateRegister(2,
+      "Contact: <sip:bob@192.0.2.4>;expires=90\r\n"
+      "Expires: 3600\r\n"));
+  EXPECT_EQ(SIP_INTERVAL_TOO_BRIEF, response->response_code());
+  ASSERT_TRUE(response->get<MinExpires>());
+  EXPECT_EQ(120u, response->get<MinExpires>()->value());
+  EXPECT_EQ(0u, binding_count());
+}
+
+TEST_F(RegistrarTest, CapsExpiration) {
+  scoped_refptr<Response> response(HandleRegister(CreateRegister(1,
+      "Contact: <sip:bob@192.0.2.4>\r\n"
+      "Expires: 86400\r\n")));
+  EXPECT_EQ(SIP_OK, response->response_code());
+  const Contact *contact = response->get<Contact>();
+  ASSERT_TRUE(contact);
+  ASSERT_FALSE(contact->empty());
+  EXPECT_EQ(GURL("sip:bob@192.0.2.4"), contact->front().address());
+  EXPECT_GE(7200u, contact->front().expires());
+  EXPECT_LE(7199u, contact->front().expires());
+
+  // Requests not saying are given the default.
+  registrar_->set_default_expires(1800);
+  response = HandleRegister(CreateRegister(2,
+      "Contact: <sip:bob@192.0.2.5>\r\n"));
+  EXPECT_EQ(SIP_OK, response->response_code());
+  EXPECT_EQ(2u, binding_count());
+  contact = response->get<Contact>();
+  ASSERT_TRUE(contact);
+  for (Contact::const_iterator i = contact->begin(), ie = contact->end();
+       i != ie; ++i) {
+    if (i->address() == GURL("sip:bob@192.0.2.5"))
+      EXPECT_GE(1800u, i->expires());
+  }
+}
+
+TEST_F(RegistrarTest, RemoveAllBindings) {
+  HandleRegister(CreateRegister(1,
+      "Contact: <sip:bob@192.0.2.4>, <sip:bob@192.0.2.5>\r\n"));
+  EXPECT_EQ(2u, binding_count());
+
+  // "Contact: *" requires "Expires: 0", and no other contacts.
+  EXPECT_EQ(SIP_BAD_REQUEST, HandleRegister(CreateRegister(2,
+      "Contact: *\r\n"))->response_code());
+  EXPECT_EQ(SIP_BAD_REQUEST, HandleRegister(CreateRegister(3,
+      "Contact: *\r\n"
+      "Expires: 3600\r\n"))->response_code());
+  EXPECT_EQ(SIP_BAD_REQUEST, HandleRegister(CreateRegister(4,
+      "Contact: *\r\n"
+      "Contact: <sip:bob@192.0.2.6>\r\n"
+      "Expires: 0\r\n"))->response_code());
+  EXPECT_EQ(2u, binding_count());
+
+  scoped_refptr<Response> response(HandleRegister(CreateRegister(5,
+      "Contact: *\r\n"
+      "Expires: 0\r\n")));
+  EXPECT_EQ(SIP_OK, response->response_code());
+  EXPECT_FALSE(response->get<Contact>());
+  EXPECT_EQ(0u, binding_count());
+}
+
+TEST_F(RegistrarTest, ChallengeWithoutCredentials) {
+  DigestAuthenticator authenticator(net::HttpAuth::AUTH_SERVER,
+      "biloxi.com", "secret", base::Bind(&LookupHA1));
+  registrar_->set_authenticator(&authenticator);
+
+  scoped_refptr<Response> challenge(HandleRegister(CreateRegister(1,
+      "Contact: <sip:bob@192.0.2.4>\r\n")));
+  EXPECT_EQ(SIP_UNAUTHORIZED, challenge->response_code());
+  WwwAuthenticate *www_authenticate = challenge->get<WwwAuthenticate>();
+  ASSERT_TRUE(www_authenticate);
+  EXPECT_EQ(0u, binding_count());
+
+  // Answering the challenge registers the contact.
+  AuthHandlerDigest::Factory factory;
+  factory.set_nonce_generator(
+      new AuthHandlerDigest::FixedNonceGenerator("0a4f113b"));
+  scoped_ptr<AuthHandler> handler;
+  ASSERT_EQ(net::OK, factory.CreateAuthHandler(*www_authenticate,
+      net::HttpAuth::AUTH_SERVER, GURL("sip:biloxi.com:5060"),
+      AuthHandlerFactory::CREATE_CHALLENGE, 1, net::BoundNetLog(),
+      &handler));
+  scoped_refptr<Request> request(CreateRegister(2,
+      "Contact: <sip:bob@192.0.2.4>\r\n"));
+  net::AuthCredentials credentials(base::ASCIIToUTF16("bob"),
+                                   base::ASCIIToUTF16("zanzibar"));
+  net::TestCompletionCallback callback;
+  ASSERT_EQ(net::OK, handler->GenerateAuth(&credentials, request.get(),
+                                           callback.callback()));
+  EXPECT_EQ(SIP_OK, HandleRegister(request)->response_code());
+  EXPECT_EQ(1u, binding_count());
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,396 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/registration_manager.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/rand_util.h"
+#include "net/base/net_errors.h"
+#include "sippet/base/sequences.h"
+#include "sippet/message/message.h"
+#include "sippet/message/request_template.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const int kTickMilliseconds = 100;
+
+// One turn of the wheel is a bit more than 400 seconds; longer timers take
+// more turns.
+const size_t kWheelSlots = 4096;
+
+const double kDefaultMaxRequestsPerSecond = 50;
+
+// Bindings are refreshed at a random point between 60% and 90% of their
+// expiration.
+const double kMinRefreshFraction = 0.6;
+const double kMaxRefreshFraction = 0.9;
+
+// Retries back off exponentially from 30 seconds up to 30 minutes, waiting
+// a random time between 50% and 100% of that.
+const int kBaseRetrySeconds = 30;
+const int kMaxRetrySeconds = 1800;
+
+base::TimeDelta SecondsToTimeDelta(double seconds) {
+  return base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(seconds * base::Time::kMicrosecondsPerSecond));
+}
+
+}  // namespace
+
+RegistrationManager::Binding::Binding()
+  : registrar(0),
+    expires(0),
+    local_sequence(0),
+    failures(0),
+    state(STATE_WAITING),
+    in_use(false),
+    queued(false),
+    removing(false) {
+}
+
+RegistrationManager::Binding::~Binding() {
+}
+
+RegistrationManager::Registrar::Registrar()
+  : tokens(0) {
+}
+
+RegistrationManager::Registrar::~Registrar() {
+}
+
+RegistrationManager::RegistrationManager(UserAgent *user_agent,
+                                         Delegate *delegate)
+  : user_agent_(user_agent),
+    delegate_(delegate),
+    max_requests_per_second_(kDefaultMaxRequestsPerSecond),
+    binding_count_(0),
+    wheel_(kWheelSlots),
+    weak_factory_(this) {
+  DCHECK(user_agent_);
+}
+
+RegistrationManager::~RegistrationManager() {
+}
+
+RegistrationManager::BindingId RegistrationManager::AddBinding(
+    const GURL &aor,
+    const GURL &registrar,
+    unsigned expires) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  BindingId id;
+  if (free_bindings_.empty()) {
+    id = static_cast<BindingId>(bindings_.size());
+    bindings_.push_back(Binding());
+  } else {
+    id = free_bindings_.back();
+    free_bindings_.pop_back();
+  }
+  Binding &binding = bindings_[id];
+  binding.request_template =
+      user_agent_->CreateRequestTemplate(Method::REGISTER, registrar, aor, aor);
+  binding.registrar = GetRegistrar(registrar);
+  binding.expires = expires;
+  binding.local_sequence = Create16BitRandomInteger();
+  binding.in_use = true;
+  ++binding_count_;
+  Enqueue(id);
+
+  if (!tick_timer_.IsRunning()) {
+    tick_timer_.Start(FROM_HERE,
+        base::TimeDelta::FromMilliseconds(kTickMilliseconds),
+        this, &RegistrationManager::OnTick);
+  }
+  return id;
+}
+
+void RegistrationManager::RemoveBinding(BindingId id) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(id < bindings_.size() && bindings_[id].in_use);
+  Binding &binding = bindings_[id];
+  if (binding.removing)
+    return;
+  binding.removing = true;
+  wheel_.Cancel(id);
+  switch (binding.state) {
+    case STATE_REGISTERED:
+      Enqueue(id);
+      break;
+    case STATE_WAITING:
+      // Never registered, or registration lost: nothing to remove.
+      FreeBinding(id);
+      if (delegate_)
+        delegate_->OnUnregistered(id);
+      break;
+    default:
+      // Unregistered once the pending request completes.
+      break;
+  }
+}
+
+RegistrationManager::State RegistrationManager::state(BindingId id) const {
+  DCHECK(id < bindings_.size() && bindings_[id].in_use);
+  return static_cast<State>(bindings_[id].state);
+}
+
+unsigned RegistrationManager::expires(BindingId id) const {
+  DCHECK(id < bindings_.size() && bindings_[id].in_use);
+  return bindings_[id].expires;
+}
+
+void RegistrationManager::OnChannelConnected(const EndPoint &destination,
+                                             int err) {
+}
+
+void RegistrationManager::OnChannelClosed(const EndPoint &destination) {
+}
+
+void RegistrationManager::OnIncomingRequest(
+    const scoped_refptr<Request> &incoming_request,
+    const scoped_refptr<Dialog> &dialog) {
+}
+
+void RegistrationManager::OnIncomingResponse(
+    const scoped_refptr<Response> &incoming_response,
+    const scoped_refptr<Dialog> &dialog) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  int response_code = incoming_response->response_code();
+  if (response_code / 100 == 1)
+    return;
+  BindingId id;
+  if (!TakePendingBinding(incoming_response->refer_to(), &id))
+    return;
+  Binding &binding = bindings_[id];
+
+  // Requests resent for authentication have a higher CSeq.
+  const Cseq *cseq = incoming_response->refer_to()->get<Cseq>();
+  if (cseq)
+    binding.local_sequence = std::max(binding.local_sequence,
+                                      cseq->sequence());
+
+  if (response_code / 100 == 2) {
+    if (binding.removing) {
+      FreeBinding(id);
+      if (delegate_)
+        delegate_->OnUnregistered(id);
+      return;
+    }
+    unsigned granted =
+        GetGrantedExpiration(incoming_response, binding.expires);
+    binding.state = STATE_REGISTERED;
+    binding.failures = 0;
+    ScheduleTimer(id, GetRefreshDelay(granted));
+    if (delegate_) {
+      delegate_->OnRegistered(id,
+          base::Time::Now() + base::TimeDelta::FromSeconds(granted));
+    }
+    return;
+  }
+
+  if (SIP_INTERVAL_TOO_BRIEF == response_code && !binding.removing) {
+    const MinExpires *min_expires = incoming_response->get<MinExpires>();
+    if (min_expires && min_expires->value() > binding.expires) {
+      binding.expires = min_expires->value();
+      binding.state = STATE_WAITING;
+      Enqueue(id);
+      return;
+    }
+  }
+
+  HandleFailure(id, response_code, net::OK);
+}
+
+void RegistrationManager::OnTimedOut(
+    const scoped_refptr<Request> &request,
+    const scoped_refptr<Dialog> &dialog) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  BindingId id;
+  if (TakePendingBinding(request, &id))
+    HandleFailure(id, 0, net::ERR_TIMED_OUT);
+}
+
+void RegistrationManager::OnTransportError(
+    const scoped_refptr<Request> &request, int error,
+    const scoped_refptr<Dialog> &dialog) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  BindingId id;
+  if (TakePendingBinding(request, &id))
+    HandleFailure(id, 0, error);
+}
+
+// static
+base::TimeDelta RegistrationManager::GetRefreshDelay(unsigned expires) {
+  double fraction = kMinRefreshFraction
+      + base::RandDouble() * (kMaxRefreshFraction - kMinRefreshFraction);
+  return SecondsToTimeDelta(expires * fraction);
+}
+
+// static
+base::TimeDelta RegistrationManager::GetRetryDelay(unsigned failures) {
+  DCHECK_GT(failures, 0u);
+  int seconds = kMaxRetrySeconds;
+  if (failures < 16)
+    seconds = std::min(kMaxRetrySeconds, kBaseRetrySeconds << (failures - 1));
+  double fraction = 0.5 + base::RandDouble() * 0.5;
+  return SecondsToTimeDelta(seconds * fraction);
+}
+
+// static
+unsigned RegistrationManager::GetGrantedExpiration(
+    const scoped_refptr<Response> &response, unsigned requested) {
+  unsigned header_expires = requested;
+  const Expires *expires = response->get<Expires>();
+  if (expires)
+    header_expires = expires->value();
+
+  const Contact *request_contact = response->refer_to()->get<Contact>();
+  if (!request_contact || request_contact->empty())
+    return header_expires;
+
+  // The registrar returns all contacts bound to the AOR; ours is the one
+  // sent in the request.
+  GURL local_uri(request_contact->front().address());
+  for (Message::iterator i = response->find_first<Contact>(),
+       ie = response->end(); i != ie; i = response->find_next<Contact>(i)) {
+    const Contact *contact = dyn_cast<Contact>(i);
+    for (Contact::const_iterator j = contact->begin(), je = contact->end();
+         j != je; ++j) {
+      if (j->address() == local_uri)
+        return j->HasExpires() ? j->expires() : header_expires;
+    }
+  }
+  return header_expires;
+}
+
+uint32 RegistrationManager::GetRegistrar(const GURL &registrar) {
+  std::pair<RegistrarMap::iterator, bool> result =
+      registrar_indexes_.insert(std::make_pair(registrar.spec(),
+          static_cast<uint32>(registrars_.size())));
+  if (result.second)
+    registrars_.push_back(Registrar());
+  return result.first->second;
+}
+
+void RegistrationManager::ScheduleTimer(BindingId id,
+                                        const base::TimeDelta &delay) {
+  int64 ticks = delay.InMilliseconds() / kTickMilliseconds;
+  wheel_.Schedule(id, static_cast<uint32>(std::max<int64>(ticks, 1)));
+}
+
+void RegistrationManager::Enqueue(BindingId id) {
+  Binding &binding = bindings_[id];
+  if (binding.queued)
+    return;
+  binding.queued = true;
+  registrars_[binding.registrar].queue.push_back(id);
+}
+
+void RegistrationManager::OnTick() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  std::vector<uint32> expired;
+  wheel_.Advance(&expired);
+  for (std::vector<uint32>::const_iterator i = expired.begin(),
+       ie = expired.end(); i != ie; ++i) {
+    Enqueue(*i);
+  }
+
+  // Token buckets holding at most one tick of requests spread the sending
+  // evenly over the second.
+  double tokens_per_tick = max_requests_per_second_ * kTickMilliseconds / 1000;
+  double max_tokens = std::max(1.0, tokens_per_tick);
+  for (std::vector<Registrar>::iterator i = registrars_.begin(),
+       ie = registrars_.end(); i != ie; ++i) {
+    i->tokens = std::min(max_tokens, i->tokens + tokens_per_tick);
+    while (i->tokens >= 1 && !i->queue.empty()) {
+      BindingId id = i->queue.front();
+      i->queue.pop_front();
+      DCHECK(bindings_[id].in_use && bindings_[id].queued);
+      bindings_[id].queued = false;
+      i->tokens -= 1;
+      SendRegister(id);
+    }
+  }
+
+  if (binding_count_ == 0)
+    tick_timer_.Stop();
+}
+
+void RegistrationManager::SendRegister(BindingId id) {
+  Binding &binding = bindings_[id];
+  scoped_refptr<Request> request(binding.request_template->CreateRequest(
+      Method::REGISTER, ++binding.local_sequence));
+  request->push_back(scoped_ptr<Header>(
+      new Expires(binding.removing ? 0 : binding.expires)));
+  binding.state = binding.removing ? STATE_UNREGISTERING : STATE_REGISTERING;
+  pending_[request->id()] = id;
+  int rv = user_agent_->Send(request,
+      base::Bind(&RegistrationManager::OnRequestSent,
+                 weak_factory_.GetWeakPtr(), request->id()));
+  if (net::ERR_IO_PENDING != rv)
+    OnRequestSent(request->id(), rv);
+}
+
+void RegistrationManager::OnRequestSent(const std::string &request_id,
+                                        int rv) {
+  if (net::OK == rv)
+    return;
+  PendingMap::iterator i = pending_.find(request_id);
+  if (pending_.end() == i)
+    return;
+  BindingId id = i->second;
+  pending_.erase(i);
+  HandleFailure(id, 0, rv);
+}
+
+void RegistrationManager::HandleFailure(BindingId id,
+                                        int response_code,
+                                        int error) {
+  Binding &binding = bindings_[id];
+  if (binding.removing) {
+    // Give up: the binding will expire at the registrar.
+    FreeBinding(id);
+    if (delegate_)
+      delegate_->OnUnregistered(id);
+    return;
+  }
+  binding.state = STATE_WAITING;
+  if (binding.failures < kuint16max)
+    ++binding.failures;
+  ScheduleTimer(id, GetRetryDelay(binding.failures));
+  if (delegate_)
+    delegate_->OnRegistrationFailed(id, response_code, error);
+}
+
+void RegistrationManager::FreeBinding(BindingId id) {
+  wheel_.Cancel(id);
+  Binding &binding = bindings_[id];
+  if (binding.queued) {
+    // The slot may be reused, even for another registrar.
+    std::deque<BindingId> &queue = registrars_[binding.registrar].queue;
+    queue.erase(std::find(queue.begin(), queue.end(), id));
+  }
+  binding = Binding();
+  free_bindings_.push_back(id);
+  --binding_count_;
+}
+
+bool RegistrationManager::TakePendingBinding(
+    const scoped_refptr<Request> &request, BindingId *id) {
+  if (!request || Method::REGISTER != request->method())
+    return false;
+  PendingMap::iterator i = pending_.find(request->id());
+  if (pending_.end() == i)
+    return false;
+  *id = i->second;
+  pending_.erase(i);
+  return true;
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,203 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_REGISTRATION_MANAGER_H_
+#define SIPPET_UA_REGISTRATION_MANAGER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/gtest_prod_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "sippet/base/timer_wheel.h"
+#include "sippet/ua/ua_user_agent.h"
+#include "url/gurl.h"
+
+namespace sippet {
+
+class RequestTemplate;
+
+namespace ua {
+
+// Keeps a large number of registrations, or bindings, alive through a single
+// |UserAgent|, as a registration agent for a fleet of endpoints would.
+//
+// Bindings are kept in a compact table, and their refreshes are driven by a
+// single timer wheel. Refreshes are jittered so that bindings registered
+// together don't refresh together, and the requests sent to each registrar
+// are capped to a configurable rate, queueing the excess. 423 (Interval Too
+// Brief) responses are handled per binding, by retrying with the
+// |MinExpires| requested by the registrar. Other failures are retried with
+// exponential backoff.
+//
+// All methods must be called on the network thread.
+class RegistrationManager : public UserAgent::Delegate {
+ public:
+  typedef uint32 BindingId;
+
+  enum State {
+    // Waiting to be sent, or for a retry after a failure.
+    STATE_WAITING,
+    STATE_REGISTERING,
+    STATE_REGISTERED,
+    STATE_UNREGISTERING,
+  };
+
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // The binding was registered or refreshed, and expires at |expires|.
+    virtual void OnRegistered(BindingId id, const base::Time &expires) = 0;
+
+    // The registration failed, and will be retried. |response_code| is the
+    // final response received, or zero if the request failed with |error|.
+    virtual void OnRegistrationFailed(BindingId id,
+                                      int response_code,
+                                      int error) = 0;
+
+    // The binding was removed from the registrar, or given up.
+    virtual void OnUnregistered(BindingId id) = 0;
+  };
+
+  // The |user_agent| must outlive the manager, and the manager must be
+  // appended to its handlers. |delegate| may be NULL.
+  RegistrationManager(UserAgent *user_agent, Delegate *delegate);
+  ~RegistrationManager() override;
+
+  // Caps the REGISTER requests sent to each registrar. Defaults to 50 per
+  // second.
+  void set_max_requests_per_second(double max_requests_per_second) {
+    max_requests_per_second_ = max_requests_per_second;
+  }
+
+  // Registers |aor| at |registrar|, requesting |expires| seconds. The
+  // binding is kept refreshed until removed.
+  BindingId AddBinding(const GURL &aor,
+                       const GURL &registrar,
+                       unsigned expires);
+
+  // Unregisters the binding. |Delegate::OnUnregistered| is called once the
+  // registrar confirms, or right away if the binding wasn't registered.
+  void RemoveBinding(BindingId id);
+
+  State state(BindingId id) const;
+
+  // The expiration requested for the binding, as raised by 423 responses.
+  unsigned expires(BindingId id) const;
+
+  // Number of bindings in the table.
+  size_t binding_count() const {
+    return binding_count_;
+  }
+
+  // UserAgent::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override;
+  void OnChannelClosed(const EndPoint &destination) override;
+  void OnIncomingRequest(
+      const scoped_refptr<Request> &incoming_request,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnIncomingResponse(
+      const scoped_refptr<Response> &incoming_response,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnTimedOut(
+      const scoped_refptr<Request> &request,
+      const scoped_refptr<Dialog> &dialog) override;
+  void OnTransportError(
+      const scoped_refptr<Request> &request, int error,
+      const scoped_refptr<Dialog> &dialog) override;
+
+ private:
+  FRIEND_TEST_ALL_PREFIXES(RegistrationManagerTest, RefreshDelay);
+  FRIEND_TEST_ALL_PREFIXES(RegistrationManagerTest, RetryDelay);
+  FRIEND_TEST_ALL_PREFIXES(RegistrationManagerTest, GrantedExpiration);
+
+  // Just for testing purposes
+  friend class RegistrationManagerTest;
+
+  struct Binding {
+    Binding();
+    ~Binding();
+
+    scoped_refptr<RequestTemplate> request_template;
+    uint32 registrar;
+    uint32 expires;
+    uint32 local_sequence;
+    uint16 failures;
+    uint8 state;
+    bool in_use;
+    bool queued;
+    bool removing;
+  };
+
+  struct Registrar {
+    Registrar();
+    ~Registrar();
+
+    // Requests that can be sent right now.
+    double tokens;
+    std::deque<BindingId> queue;
+  };
+
+  typedef base::hash_map<std::string, uint32> RegistrarMap;
+  typedef base::hash_map<std::string, BindingId> PendingMap;
+
+  // Delay before refreshing a binding granted for |expires| seconds.
+  static base::TimeDelta GetRefreshDelay(unsigned expires);
+
+  // Delay before retrying after |failures| consecutive failures.
+  static base::TimeDelta GetRetryDelay(unsigned failures);
+
+  // The expiration granted to the binding of the request answered by
+  // |response|, or |requested| if the registrar didn't say.
+  static unsigned GetGrantedExpiration(
+      const scoped_refptr<Response> &response, unsigned requested);
+
+  uint32 GetRegistrar(const GURL &registrar);
+  void ScheduleTimer(BindingId id, const base::TimeDelta &delay);
+  void Enqueue(BindingId id);
+  void OnTick();
+  void SendRegister(BindingId id);
+  void OnRequestSent(const std::string &request_id, int rv);
+  void HandleFailure(BindingId id, int response_code, int error);
+  void FreeBinding(BindingId id);
+
+  // Finds and forgets the binding waiting for a response to |request|.
+  bool TakePendingBinding(const scoped_refptr<Request> &request,
+                          BindingId *id);
+
+  UserAgent *user_agent_;
+  Delegate *delegate_;
+  double max_requests_per_second_;
+
+  std::vector<Binding> bindings_;
+  std::vector<BindingId> free_bindings_;
+  size_t binding_count_;
+
+  std::vector<Registrar> registrars_;
+  RegistrarMap registrar_indexes_;
+
+  // Bindings waiting for a response, by request ID.
+  PendingMap pending_;
+
+  TimerWheel wheel_;
+  base::RepeatingTimer<RegistrationManager> tick_timer_;
+
+  base::ThreadChecker thread_checker_;
+  base::WeakPtrFactory<RegistrationManager> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegistrationManager);
+};
+
+} // namespace ua
+} // namespace sippet
+
+#endif // SIPPET_UA_REGISTRATION_MANAGER_H_
@@ -0,0 +1,365 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/registration_manager.h"
+
+#include <vector>
+
+#include "base/message_loop/message_loop.h"
+#include "net/base/net_errors.h"
+#include "sippet/message/message.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/transport/simulated_network.h"
+#include "sippet/transport/virtual_timer_source.h"
+#include "sippet/ua/auth_handler_mock.h"
+#include "sippet/ua/dialog_controller.h"
+#include "sippet/ua/password_handler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const char kClientAddress[] = "10.0.0.1";
+const char kRegistrarAddress[] = "10.0.0.2";
+const char kRegistrarURI[] = "sip:10.0.0.2";
+const uint16 kPort = 5060;
+
+// Refreshes of bindings granted for an hour happen between 2160 and 3240
+// seconds later, that is, between these numbers of 100ms ticks.
+const int kMinRefreshTicks = 21600;
+const int kMaxRefreshTicks = 32400;
+
+const char kRegister[] =
+  "REGISTER sip:registrar.biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Bob <sip:bob@biloxi.com>;tag=456248\r\n"
+  "Call-ID: 843817637684230@998sdasdh09\r\n"
+  "CSeq: 1826 REGISTER\r\n"
+  "Contact: <sip:bob@192.0.2.4>\r\n"
+  "Expires: 7200\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+scoped_refptr<Response> CreateOk() {
+  scoped_refptr<Request> request(
+      dyn_cast<Request>(Message::Parse(kRegister)));
+  return request->CreateResponse(SIP_OK);
+}
+
+NetworkSettings CreateSettings(TimerSource *timer_source) {
+  NetworkSettings settings;
+  settings.set_timer_source(timer_source);
+  return settings;
+}
+
+class NullPasswordHandlerFactory : public PasswordHandler::Factory {
+ public:
+  scoped_ptr<PasswordHandler> CreatePasswordHandler() override {
+    return scoped_ptr<PasswordHandler>();
+  }
+};
+
+// Records the REGISTER requests it receives, to be answered by the test.
+class FakeRegistrar : public NetworkLayer::Delegate {
+ public:
+  FakeRegistrar(SimulatedNetwork *network, TimerSource *timer_source)
+    : network_layer_(new NetworkLayer(this, CreateSettings(timer_source))),
+      channel_factory_(network, net::HostPortPair(kRegistrarAddress, kPort),
+                       network_layer_.get()) {
+    network_layer_->RegisterChannelFactory(Protocol::UDP, &channel_factory_);
+  }
+  ~FakeRegistrar() override {}
+
+  const std::vector<scoped_refptr<Request> > &requests() const {
+    return requests_;
+  }
+
+  unsigned expires(size_t index) const {
+    return requests_[index]->get<Expires>()->value();
+  }
+
+  void Answer(size_t index, int response_code, scoped_ptr<Header> header) {
+    scoped_refptr<Response> response(
+        requests_[index]->CreateResponse(response_code));
+    if (header)
+      response->push_back(header.Pass());
+    network_layer_->Send(response, net::CompletionCallback());
+  }
+
+  // NetworkLayer::Delegate methods:
+  void OnChannelConnected(const EndPoint &destination, int err) override {}
+  void OnChannelClosed(const EndPoint &destination) override {}
+  void OnIncomingRequest(const scoped_refptr<Request> &request) override {
+    requests_.push_back(request);
+  }
+  void OnIncomingResponse(const scoped_refptr<Response> &response) override {}
+  void OnTimedOut(const scoped_refptr<Request> &request) override {}
+  void OnTransportError(const scoped_refptr<Request> &request,
+                        int error) override {}
+
+ private:
+  scoped_ptr<NetworkLayer> network_layer_;
+  SimulatedChannelFactory channel_factory_;
+  std::vector<scoped_refptr<Request> > requests_;
+};
+
+class RecordingDelegate : public RegistrationManager::Delegate {
+ public:
+  RecordingDelegate() {}
+  ~RecordingDelegate() override {}
+
+  typedef RegistrationManager::BindingId BindingId;
+
+  const std::vector<BindingId> &registered() const { return registered_; }
+  const std::vector<BindingId> &failed() const { return failed_; }
+  const std::vector<BindingId> &unregistered() const { return unregistered_; }
+
+  // RegistrationManager::Delegate methods:
+  void OnRegistered(BindingId id, const base::Time &expires) override {
+    registered_.push_back(id);
+  }
+  void OnRegistrationFailed(BindingId id, int response_code,
+                            int error) override {
+    failed_.push_back(id);
+  }
+  void OnUnregistered(BindingId id) override {
+    unregistered_.push_back(id);
+  }
+
+ private:
+  std::vector<BindingId> registered_;
+  std::vector<BindingId> failed_;
+  std::vector<BindingId> unregistered_;
+};
+
+}  // namespace
+
+class RegistrationManagerTest : public testing::Test {
+ public:
+  typedef RegistrationManager::BindingId BindingId;
+
+  RegistrationManagerTest()
+    : network_(timer_source_.task_runner(), timer_source_.tick_clock(), 1),
+      registrar_(&network_, &timer_source_) {
+  }
+
+  void SetUp() override {
+    user_agent_.reset(new UserAgent(&auth_handler_factory_,
+        &password_handler_factory_,
+        DialogController::GetDefaultDialogController(),
+        net::BoundNetLog()));
+    network_layer_.reset(new NetworkLayer(user_agent_.get(),
+        CreateSettings(&timer_source_)));
+    channel_factory_.reset(new SimulatedChannelFactory(&network_,
+        net::HostPortPair(kClientAddress, kPort), network_layer_.get()));
+    network_layer_->RegisterChannelFactory(Protocol::UDP,
+                                           channel_factory_.get());
+    user_agent_->SetNetworkLayer(network_layer_.get());
+    manager_.reset(new RegistrationManager(user_agent_.get(), &delegate_));
+    user_agent_->AppendHandler(manager_.get());
+  }
+
+  BindingId AddBinding(unsigned expires) {
+    return manager_->AddBinding(GURL("sip:bob@biloxi.com"),
+                                GURL(kRegistrarURI), expires);
+  }
+
+  // Runs |count| ticks of the manager, and delivers what was sent.
+  void Tick(int count) {
+    for (int i = 0; i < count; ++i)
+      manager_->OnTick();
+    timer_source_.RunUntilIdle();
+  }
+
+  // Bindings waiting in the queues of the registrars.
+  size_t queued_count() const {
+    size_t count = 0;
+    for (const RegistrationManager::Registrar &registrar :
+         manager_->registrars_) {
+      count += registrar.queue.size();
+    }
+    return count;
+  }
+
+  void Answer(size_t index, int response_code) {
+    Answer(index, response_code, scoped_ptr<Header>());
+  }
+  void Answer(size_t index, int response_code, scoped_ptr<Header> header) {
+    registrar_.Answer(index, response_code, header.Pass());
+    timer_source_.RunUntilIdle();
+  }
+
+  base::MessageLoop message_loop_;
+  VirtualTimerSource timer_source_;
+  SimulatedNetwork network_;
+  FakeRegistrar registrar_;
+  AuthHandlerMock::Factory auth_handler_factory_;
+  NullPasswordHandlerFactory password_handler_factory_;
+  scoped_ptr<UserAgent> user_agent_;
+  scoped_ptr<NetworkLayer> network_layer_;
+  scoped_ptr<SimulatedChannelFactory> channel_factory_;
+  RecordingDelegate delegate_;
+  scoped_ptr<RegistrationManager> manager_;
+};
+
+TEST_F(RegistrationManagerTest, RefreshDelay) {
+  for (int i = 0; i < 100; ++i) {
+    base::TimeDelta delay(RegistrationManager::GetRefreshDelay(3600));
+    EXPECT_LE(2160, delay.InSeconds());
+    EXPECT_GE(3240, delay.InSeconds());
+  }
+}
+
+TEST_F(RegistrationManagerTest, RetryDelay) {
+  for (int i = 0; i < 100; ++i) {
+    base::TimeDelta delay(RegistrationManager::GetRetryDelay(1));
+    EXPECT_LE(15, delay.InSeconds());
+    EXPECT_GE(30, delay.InSeconds());
+
+    delay = RegistrationManager::GetRetryDelay(3);
+    EXPECT_LE(60, delay.InSeconds());
+    EXPECT_GE(120, delay.InSeconds());
+
+    delay = RegistrationManager::GetRetryDelay(40);
+    EXPECT_LE(900, delay.InSeconds());
+    EXPECT_GE(1800, delay.InSeconds());
+  }
+}
+
+TEST_F(RegistrationManagerTest, GrantedExpiration) {
+  // Nothing said by the registrar.
+  scoped_refptr<Response> response(CreateOk());
+  EXPECT_EQ(7200u, RegistrationManager::GetGrantedExpiration(response, 7200));
+
+  // The Expires header applies to all contacts.
+  response->push_back(scoped_ptr<Header>(new Expires(1800)));
+  EXPECT_EQ(1800u, RegistrationManager::GetGrantedExpiration(response, 7200));
+
+  // Unless the contact has its own expiration.
+  scoped_ptr<Contact> contact(new Contact(GURL("sip:carol@192.0.2.5")));
+  contact->front().set_expires(600);
+  contact->push_back(ContactInfo(GURL("sip:bob@192.0.2.4")));
+  contact->back().set_expires(900);
+  response->push_back(contact.Pass());
+  EXPECT_EQ(900u, RegistrationManager::GetGrantedExpiration(response, 7200));
+}
+
+TEST_F(RegistrationManagerTest, RateCapPerTick) {
+  // 20 requests per second are 2 per tick of 100ms.
+  manager_->set_max_requests_per_second(20);
+  for (int i = 0; i < 5; ++i)
+    AddBinding(3600);
+
+  Tick(1);
+  EXPECT_EQ(2u, registrar_.requests().size());
+  Tick(1);
+  EXPECT_EQ(4u, registrar_.requests().size());
+  Tick(1);
+  EXPECT_EQ(5u, registrar_.requests().size());
+
+  // Idle ticks don't save requests for later.
+  Tick(10);
+  for (int i = 0; i < 3; ++i)
+    AddBinding(3600);
+  Tick(1);
+  EXPECT_EQ(7u, registrar_.requests().size());
+}
+
+TEST_F(RegistrationManagerTest, IntervalTooBrief) {
+  BindingId id = AddBinding(60);
+  Tick(1);
+  ASSERT_EQ(1u, registrar_.requests().size());
+  EXPECT_EQ(60u, registrar_.expires(0));
+  EXPECT_EQ(RegistrationManager::STATE_REGISTERING, manager_->state(id));
+
+  // Retried right away, with the expiration asked by the registrar.
+  Answer(0, SIP_INTERVAL_TOO_BRIEF,
+         scoped_ptr<Header>(new MinExpires(3600)));
+  EXPECT_EQ(RegistrationManager::STATE_WAITING, manager_->state(id));
+  EXPECT_EQ(3600u, manager_->expires(id));
+  EXPECT_TRUE(delegate_.failed().empty());
+  Tick(1);
+  ASSERT_EQ(2u, registrar_.requests().size());
+  EXPECT_EQ(3600u, registrar_.expires(1));
+  EXPECT_EQ(registrar_.requests()[0]->get<CallId>()->value(),
+            registrar_.requests()[1]->get<CallId>()->value());
+  EXPECT_EQ(registrar_.requests()[0]->get<Cseq>()->sequence() + 1,
+            registrar_.requests()[1]->get<Cseq>()->sequence());
+
+  Answer(1, SIP_OK);
+  EXPECT_EQ(RegistrationManager::STATE_REGISTERED, manager_->state(id));
+  EXPECT_EQ(1u, delegate_.registered().size());
+}
+
+TEST_F(RegistrationManagerTest, RefreshOnTimerWheel) {
+  BindingId id = AddBinding(3600);
+  Tick(1);
+  Answer(0, SIP_OK);
+  EXPECT_EQ(RegistrationManager::STATE_REGISTERED, manager_->state(id));
+  EXPECT_EQ(1u, delegate_.registered().size());
+
+  Tick(kMinRefreshTicks - 1);
+  EXPECT_EQ(1u, registrar_.requests().size());
+  Tick(kMaxRefreshTicks - kMinRefreshTicks + 1);
+  ASSERT_EQ(2u, registrar_.requests().size());
+  EXPECT_EQ(3600u, registrar_.expires(1));
+  EXPECT_EQ(RegistrationManager::STATE_REGISTERING, manager_->state(id));
+
+  // The next refresh is scheduled once this one is answered.
+  Answer(1, SIP_OK);
+  EXPECT_EQ(2u, delegate_.registered().size());
+  Tick(kMinRefreshTicks - 1);
+  EXPECT_EQ(2u, registrar_.requests().size());
+}
+
+TEST_F(RegistrationManagerTest, RemoveBinding) {
+  // Bindings never registered are just forgotten.
+  BindingId id = AddBinding(3600);
+  manager_->RemoveBinding(id);
+  ASSERT_EQ(1u, delegate_.unregistered().size());
+  EXPECT_EQ(0u, manager_->binding_count());
+  Tick(1);
+  EXPECT_TRUE(registrar_.requests().empty());
+
+  // Registered ones are removed from the registrar.
+  id = AddBinding(3600);
+  Tick(1);
+  Answer(0, SIP_OK);
+  manager_->RemoveBinding(id);
+  Tick(1);
+  ASSERT_EQ(2u, registrar_.requests().size());
+  EXPECT_EQ(0u, registrar_.expires(1));
+  EXPECT_EQ(RegistrationManager::STATE_UNREGISTERING, manager_->state(id));
+  EXPECT_EQ(1u, delegate_.unregistered().size());
+
+  Answer(1, SIP_OK);
+  ASSERT_EQ(2u, delegate_.unregistered().size());
+  EXPECT_EQ(id, delegate_.unregistered()[1]);
+  EXPECT_EQ(0u, manager_->binding_count());
+
+  // And aren't refreshed anymore.
+  Tick(kMaxRefreshTicks);
+  EXPECT_EQ(2u, registrar_.requests().size());
+}
+
+TEST_F(RegistrationManagerTest, FreedBindingLeavesQueue) {
+  BindingId id = AddBinding(3600);
+  EXPECT_EQ(1u, queued_count());
+  manager_->RemoveBinding(id);
+  EXPECT_EQ(0u, queued_count());
+
+  // The freed slot is reused, and queued once.
+  EXPECT_EQ(id, AddBinding(3600));
+  EXPECT_EQ(1u, queued_count());
+  Tick(1);
+  EXPECT_EQ(1u, registrar_.requests().size());
+  EXPECT_EQ(0u, queued_count());
+}
+
+} // namespace ua
+} // namespace sippet
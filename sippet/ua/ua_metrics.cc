@@ -0,0 +1,40 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/ua_metrics.h"
+
+#include "base/lazy_instance.h"
+
+namespace sippet {
+
+namespace {
+
+static base::LazyInstance<UaMetrics>::Leaky
+  g_ua_metrics = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+UaMetrics::UaMetrics() {
+  MetricsRegistry *registry = MetricsRegistry::GetInstance();
+  dialogs = registry->GetGauge("sippet_dialogs",
+      "Early and confirmed dialogs.", "");
+  requests_challenged = registry->GetCounter(
+      "sippet_ua_requests_challenged_total",
+      "Incoming requests answered with a digest challenge.", "");
+  authenticated_resends = registry->GetCounter(
+      "sippet_ua_authenticated_resends_total",
+      "Requests resent with credentials after a challenge.", "");
+  authentication_failures = registry->GetCounter(
+      "sippet_ua_authentication_failures_total",
+      "Challenges that couldn't be answered.", "");
+}
+
+UaMetrics::~UaMetrics() {
+}
+
+UaMetrics *UaMetrics::Get() {
+  return g_ua_metrics.Pointer();
+}
+
+} // namespace sippet
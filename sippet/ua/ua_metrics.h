@@ -0,0 +1,33 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SIPPET_UA_UA_METRICS_H_
+#define SIPPET_UA_UA_METRICS_H_
+
+#include "sippet/base/metrics.h"
+
+namespace sippet {
+
+// The metrics of the dialogs and the user agents, in the default
+// |MetricsRegistry|.
+struct UaMetrics {
+  UaMetrics();
+  ~UaMetrics();
+
+  static UaMetrics *Get();
+
+  // Dialogs held by the dialog stores, early or confirmed.
+  Gauge *dialogs;
+
+  // Incoming requests answered with a digest challenge.
+  Counter *requests_challenged;
+  // Outgoing requests resent with credentials after a challenge.
+  Counter *authenticated_resends;
+  // Challenges left unanswered for lack of credentials.
+  Counter *authentication_failures;
+};
+
+} // namespace sippet
+
+#endif // SIPPET_UA_UA_METRICS_H_
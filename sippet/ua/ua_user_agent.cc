@@ -8,22 +8,62 @@
 
 #include "base/md5.h"
 #include "base/build_time.h"
+#include "base/lazy_instance.h"
 #include "base/stl_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/i18n/time_formatting.h"
 #include "net/base/net_errors.h"
+#include "sippet/message/request_template.h"
 #include "sippet/ua/dialog.h"
 #include "sippet/uri/uri.h"
+#include "sippet/base/memory_usage.h"
 #include "sippet/base/tags.h"
 #include "sippet/base/sequences.h"
 #include "sippet/base/stl_extras.h"
 #include "sippet/ua/dialog_store.h"
+#include "sippet/ua/ua_metrics.h"
 #include "sippet/ua/dialog_controller.h"
+#include "sippet/ua/digest_authenticator.h"
 
 namespace sippet {
 namespace ua {
 
+namespace {
+
+// Credentials are generated again on every challenge round, so the ones
+// copied from the previous attempt (such as preemptive ones) are dropped.
+void RemoveCredentials(const scoped_refptr<Request> &request) {
+  Message::iterator i;
+  while ((i = request->find_first<Authorization>()) != request->end())
+    request->erase(i);
+  while ((i = request->find_first<ProxyAuthorization>()) != request->end())
+    request->erase(i);
+}
+
+// The +sip.instance Contact parameter is generated from the build time, so it
+// is computed only once.
+struct InstanceId {
+  InstanceId() {
+    base::string16 build_time =
+      base::TimeFormatShortDateAndTime(base::GetBuildTime());
+    std::string instance = base::MD5String(base::UTF16ToUTF8(build_time));
+    value = base::StringPrintf("\"<urn:uuid:%s-%s-%s-%s-%s>\"",
+      instance.substr(0, 8).c_str(),
+      instance.substr(8, 4).c_str(),
+      instance.substr(12, 4).c_str(),
+      instance.substr(16, 4).c_str(),
+      instance.substr(20, 12).c_str());
+  }
+
+  std::string value;
+};
+
+base::LazyInstance<InstanceId>::Leaky g_instance_id =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
 UserAgent::OutgoingRequestContext::OutgoingRequestContext(
       const scoped_refptr<Request>& original_request)
     : original_request_(original_request) {
@@ -40,6 +80,8 @@ UserAgent::UserAgent(AuthHandlerFactory *auth_handler_factory,
     : auth_handler_factory_(auth_handler_factory),
       net_log_(net_log),
       password_handler_factory_(password_handler_factory),
+      preemptive_auth_enabled_(false),
+      server_authenticator_(nullptr),
       weak_factory_(this),
       dialog_store_(new DialogStore),
       dialog_controller_(dialog_controller) {
@@ -99,17 +141,7 @@ scoped_refptr<Request> UserAgent::CreateRequest(
   std::string contact_address("sip:");
   contact_address += "domain.invalid";
   scoped_ptr<Contact> contact(new Contact(GURL(contact_address)));
-  // Now uses the build time to generate a single instance ID
-  base::string16 build_time =
-    base::TimeFormatShortDateAndTime(base::GetBuildTime());
-  std::string instance = base::MD5String(base::UTF16ToUTF8(build_time));
-  std::string instance_id = base::StringPrintf("\"<urn:uuid:%s-%s-%s-%s-%s>\"",
-    instance.substr(0, 8).c_str(),
-    instance.substr(8, 4).c_str(),
-    instance.substr(12, 4).c_str(),
-    instance.substr(16, 4).c_str(),
-    instance.substr(20, 12).c_str());
-  contact->front().param_set("+sip.instance", instance_id);
+  contact->front().param_set("+sip.instance", g_instance_id.Get().value);
   if (Method::REGISTER == method) {
     contact->front().param_set("reg-id", "1");
   }
@@ -144,6 +176,14 @@ scoped_refptr<Request> UserAgent::CreateRequest(
   return request;
 }
 
+scoped_refptr<RequestTemplate> UserAgent::CreateRequestTemplate(
+    const Method &method,
+    const GURL &request_uri,
+    const GURL &from,
+    const GURL &to) {
+  return new RequestTemplate(CreateRequest(method, request_uri, from, to));
+}
+
 int UserAgent::Send(
     const scoped_refptr<Message> &message,
     const net::CompletionCallback& callback) {
@@ -153,10 +193,82 @@ int UserAgent::Send(
   } else {
     scoped_refptr<Request> request = dyn_cast<Request>(message);
     dialog_controller_->HandleRequest(dialog_store_.get(), request);
+    if (preemptive_auth_enabled_) {
+      int rv = AddPreemptiveAuthorization(request, callback);
+      if (net::ERR_IO_PENDING == rv)
+        return rv;
+    }
   }
   return network_layer_->Send(message, callback);
 }
 
+void UserAgent::DumpMemoryUsage(MemoryUsageDump *dump) const {
+  // Requests are also held by their client transactions while pending, and
+  // counted by both.
+  size_t bytes = 0;
+  for (OutgoingRequestMap::const_iterator i = outgoing_requests_.begin(),
+       ie = outgoing_requests_.end(); i != ie; ++i) {
+    const OutgoingRequestContext *context = i->second;
+    bytes += kTreeNodeOverhead + sizeof(*i) + sizeof(OutgoingRequestContext)
+        + EstimateStringMemoryUsage(i->first)
+        + context->original_request_->EstimateMemoryUsage()
+        + context->outgoing_requests_.capacity()
+            * sizeof(scoped_refptr<Request>);
+    for (const scoped_refptr<Request> &request : context->outgoing_requests_)
+      bytes += request->EstimateMemoryUsage();
+    if (context->last_response_.get())
+      bytes += context->last_response_->EstimateMemoryUsage();
+  }
+  dump->Add("ua/outgoing_requests", outgoing_requests_.size(), bytes);
+
+  dialog_store_->DumpMemoryUsage(dump);
+  auth_cache_.DumpMemoryUsage(dump);
+}
+
+int UserAgent::AddPreemptiveAuthorization(
+    const scoped_refptr<Request> &request,
+    const net::CompletionCallback& callback) {
+  // ACK and CANCEL requests cannot be challenged.
+  if (Method::ACK == request->method()
+      || Method::CANCEL == request->method())
+    return net::OK;
+  if (outgoing_requests_.end() != outgoing_requests_.find(request->id()))
+    return net::OK;
+  scoped_ptr<OutgoingRequestContext> outgoing_request_context(
+      new OutgoingRequestContext(request));
+  outgoing_request_context->auth_transaction_.reset(
+      new AuthTransaction(&auth_cache_, auth_handler_factory_,
+          password_handler_factory_, net_log_));
+  AuthTransaction *auth_transaction =
+      outgoing_request_context->auth_transaction_.get();
+  int rv = auth_transaction->AddPreemptiveAuthorization(request,
+      base::Bind(&UserAgent::OnPreemptiveAuthorizationComplete,
+          weak_factory_.GetWeakPtr(), request, callback));
+  if (!auth_transaction->HaveAuth()
+      || (net::OK != rv && net::ERR_IO_PENDING != rv)) {
+    // Nothing cached, or unable to generate credentials: the request will
+    // be sent as is and handled through the regular challenge path.
+    return net::OK;
+  }
+  outgoing_requests_.insert(std::make_pair(request->id(),
+      outgoing_request_context.release()));
+  return rv;
+}
+
+void UserAgent::OnPreemptiveAuthorizationComplete(
+    const scoped_refptr<Request> &request,
+    const net::CompletionCallback& callback,
+    int rv) {
+  DCHECK_NE(rv, net::ERR_IO_PENDING);
+  if (net::OK != rv) {
+    // Send without credentials and wait for a challenge.
+    RemoveOutgoingRequestContext(request->id());
+  }
+  rv = network_layer_->Send(request, callback);
+  if (net::ERR_IO_PENDING != rv && !callback.is_null())
+    callback.Run(rv);
+}
+
 bool UserAgent::HandleChallengeAuthentication(
     const scoped_refptr<Response> &incoming_response,
     const scoped_refptr<Dialog> &dialog) {
@@ -184,6 +296,7 @@ bool UserAgent::HandleChallengeAuthentication(
   outgoing_request_context->last_dialog_ = dialog;
   outgoing_request_context->last_response_ = incoming_response;
   scoped_refptr<Request> outgoing_request(original_request->CloneRequest());
+  RemoveCredentials(outgoing_request);
   if (dialog) {
     // Update the dialog sequence for each authenticated request
     Message::iterator i = outgoing_request->find_first<Cseq>();
@@ -222,6 +335,7 @@ void UserAgent::OnAuthenticationComplete(
     if (current_outgoing_request->end() != j) {
       current_outgoing_request->erase(j);
     }
+    UaMetrics::Get()->authenticated_resends->Increment();
     rv = network_layer_->Send(current_outgoing_request,
         base::Bind(&UserAgent::OnResendRequestComplete,
             weak_factory_.GetWeakPtr(), request_id));
@@ -229,6 +343,7 @@ void UserAgent::OnAuthenticationComplete(
       OnResendRequestComplete(request_id, rv);
     }
   } else {
+    UaMetrics::Get()->authentication_failures->Increment();
     RunUserIncomingResponseCallback(outgoing_request_context->last_response_,
         outgoing_request_context->last_dialog_);
   }
@@ -263,6 +378,8 @@ void UserAgent::OnChannelClosed(const EndPoint &destination) {
 
 void UserAgent::OnIncomingRequest(
     const scoped_refptr<Request> &request) {
+  if (!AuthenticateIncomingRequest(request))
+    return;
   scoped_refptr<Dialog> dialog =
       dialog_controller_->HandleRequest(dialog_store_.get(), request);
   RunUserIncomingRequestCallback(request, dialog);
@@ -276,28 +393,55 @@ void UserAgent::OnIncomingResponse(
     return;
   if (200 <= response->response_code()
       && nullptr != response->refer_to()) {
-    OutgoingRequestMap::iterator i =
-        outgoing_requests_.find(response->refer_to()->id());
-    if (outgoing_requests_.end() != i) {
-      OutgoingRequestContext *outgoing_request_context = i->second;
-      // Remove the original request first
-      outgoing_requests_.erase(
-          outgoing_request_context->original_request_->id());
-      // Remove children authenticating requests
-      std::vector<scoped_refptr<Request> >& outgoing_requests =
-          outgoing_request_context->outgoing_requests_;
-      for (std::vector<scoped_refptr<Request> >::iterator j =
-          outgoing_requests.begin(); j != outgoing_requests.end(); ++j) {
-        outgoing_requests_.erase((*j)->id());
-      }
-      // Finally delete context
-      delete outgoing_request_context;
-    }
+    RemoveOutgoingRequestContext(response->refer_to()->id());
   }
   RunUserIncomingResponseCallback(response, dialog);
 }
 
+bool UserAgent::AuthenticateIncomingRequest(
+    const scoped_refptr<Request> &request) {
+  if (!server_authenticator_)
+    return true;
+  if (Method::REGISTER != request->method()
+      && Method::INVITE != request->method())
+    return true;
+  DigestAuthenticator::Result result =
+      server_authenticator_->Verify(request, nullptr);
+  if (DigestAuthenticator::RESULT_ACCEPTED == result)
+    return true;
+  DVLOG(1) << "Challenging request " << request->id()
+           << ", verification result " << result;
+  UaMetrics::Get()->requests_challenged->Increment();
+  // Challenges are sent straight to the network layer, as they must not
+  // create dialogs.
+  scoped_refptr<Response> response =
+      server_authenticator_->CreateChallengeResponse(request,
+          DigestAuthenticator::RESULT_STALE_NONCE == result);
+  network_layer_->Send(response, net::CompletionCallback());
+  return false;
+}
+
+void UserAgent::RemoveOutgoingRequestContext(const std::string &request_id) {
+  OutgoingRequestMap::iterator i = outgoing_requests_.find(request_id);
+  if (outgoing_requests_.end() == i)
+    return;
+  OutgoingRequestContext *outgoing_request_context = i->second;
+  // Remove the original request first
+  outgoing_requests_.erase(
+      outgoing_request_context->original_request_->id());
+  // Remove children authenticating requests
+  std::vector<scoped_refptr<Request> >& outgoing_requests =
+      outgoing_request_context->outgoing_requests_;
+  for (std::vector<scoped_refptr<Request> >::iterator j =
+      outgoing_requests.begin(); j != outgoing_requests.end(); ++j) {
+    outgoing_requests_.erase((*j)->id());
+  }
+  // Finally delete context
+  delete outgoing_request_context;
+}
+
 void UserAgent::OnTimedOut(const scoped_refptr<Request> &request) {
+  RemoveOutgoingRequestContext(request->id());
   scoped_refptr<Dialog> dialog =
       dialog_controller_->HandleRequestError(dialog_store_.get(), request);
   for (std::vector<Delegate*>::iterator i = handlers_.begin();
@@ -308,6 +452,7 @@ void UserAgent::OnTimedOut(const scoped_refptr<Request> &request) {
 
 void UserAgent::OnTransportError(
     const scoped_refptr<Request> &request, int err) {
+  RemoveOutgoingRequestContext(request->id());
   scoped_refptr<Dialog> dialog =
       dialog_controller_->HandleRequestError(dialog_store_.get(), request);
   for (std::vector<Delegate*>::iterator i = handlers_.begin();
@@ -17,9 +17,12 @@ namespace sippet {
 
 class Message;
 class Request;
+class RequestTemplate;
 class Response;
 class DialogStore;
 class DialogController;
+class DigestAuthenticator;
+class MemoryUsageDump;
 
 namespace ua {
 
@@ -102,6 +105,25 @@ class UserAgent :
     return route_set_;
   }
 
+  // When enabled, outgoing requests carry Authorization/Proxy-Authorization
+  // headers computed from the last challenge cached for the request origin,
+  // saving the 401/407 round trip. A rejection with a stale nonce falls back
+  // to the regular challenge handling. Disabled by default.
+  void set_preemptive_auth_enabled(bool enabled) {
+    preemptive_auth_enabled_ = enabled;
+  }
+  bool preemptive_auth_enabled() const {
+    return preemptive_auth_enabled_;
+  }
+
+  // Incoming REGISTER and INVITE requests are verified by |authenticator|
+  // before reaching the delegates, and the ones lacking valid credentials
+  // are answered with a challenge. The authenticator is not owned; NULL
+  // (the default) disables the verification.
+  void set_server_authenticator(DigestAuthenticator *authenticator) {
+    server_authenticator_ = authenticator;
+  }
+
   // Append an User Agent handler. Handlers receive events in the same order
   // they were registered.
   void AppendHandler(Delegate *delegate);
@@ -117,12 +139,28 @@ class UserAgent :
       const GURL &to,
       unsigned local_sequence=0);
 
+  // Creates a template for series of requests, such as registration
+  // refreshes or keepalives, with the same headers |CreateRequest| would
+  // add. Requests are then created by |RequestTemplate::CreateRequest|, that
+  // only stamps their |Cseq| and, optionally, a new |From| tag and |CallId|.
+  // Requests of a same registration should keep the |CallId|.
+  scoped_refptr<RequestTemplate> CreateRequestTemplate(
+      const Method &method,
+      const GURL &request_uri,
+      const GURL &from,
+      const GURL &to);
+
   // Send a message throughout the nextwork layer. This function encapsulates
   // the dialog creation/destruction handling.
   int Send(
       const scoped_refptr<Message> &message,
       const net::CompletionCallback& callback);
 
+  // Adds the approximate memory held by the outgoing requests waiting for
+  // their final responses, the dialogs and the authentication cache to
+  // |dump|, under "ua/".
+  void DumpMemoryUsage(MemoryUsageDump *dump) const;
+
  private:
   friend struct base::DefaultDeleter<UserAgent>;
   ~UserAgent() override;
@@ -151,11 +189,20 @@ class UserAgent :
   typedef std::map<std::string, OutgoingRequestContext*>
       OutgoingRequestMap;
 
+  int AddPreemptiveAuthorization(
+      const scoped_refptr<Request> &request,
+      const net::CompletionCallback& callback);
+  void OnPreemptiveAuthorizationComplete(
+      const scoped_refptr<Request> &request,
+      const net::CompletionCallback& callback,
+      int rv);
   bool HandleChallengeAuthentication(
       const scoped_refptr<Response> &incoming_response,
       const scoped_refptr<Dialog> &dialog);
   void OnAuthenticationComplete(const std::string &request_id, int rv);
   void OnResendRequestComplete(const std::string &request_id, int rv);
+  void RemoveOutgoingRequestContext(const std::string &request_id);
+  bool AuthenticateIncomingRequest(const scoped_refptr<Request> &request);
 
   // sippet::NetworkLayer::Delegate methods:
   void OnChannelConnected(const EndPoint &destination, int err) override;
@@ -184,7 +231,9 @@ class UserAgent :
   AuthHandlerFactory *auth_handler_factory_;
   net::BoundNetLog net_log_;
   PasswordHandler::Factory *password_handler_factory_;
-  
+  bool preemptive_auth_enabled_;
+  DigestAuthenticator *server_authenticator_;
+
   scoped_ptr<DialogStore> dialog_store_;
   DialogController *dialog_controller_;
   OutgoingRequestMap outgoing_requests_;
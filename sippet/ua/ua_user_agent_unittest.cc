@@ -0,0 +1,79 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/ua/ua_user_agent.h"
+
+#include "base/message_loop/message_loop.h"
+#include "net/base/test_completion_callback.h"
+#include "sippet/base/memory_usage.h"
+#include "sippet/message/message.h"
+#include "sippet/transport/network_layer.h"
+#include "sippet/ua/auth_handler_mock.h"
+#include "sippet/ua/dialog_controller.h"
+#include "sippet/ua/password_handler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+namespace ua {
+
+namespace {
+
+const char kInvite[] =
+  "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bKnashds8\r\n"
+  "Max-Forwards: 70\r\n"
+  "To: Bob <sip:bob@biloxi.com>\r\n"
+  "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+  "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+  "CSeq: 314159 INVITE\r\n"
+  "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n";
+
+class NullPasswordHandlerFactory : public PasswordHandler::Factory {
+ public:
+  scoped_ptr<PasswordHandler> CreatePasswordHandler() override {
+    return scoped_ptr<PasswordHandler>();
+  }
+};
+
+}  // namespace
+
+TEST(UserAgentTest, DumpMemoryUsage) {
+  base::MessageLoop message_loop;
+  AuthHandlerMock::Factory auth_handler_factory;
+  NullPasswordHandlerFactory password_handler_factory;
+  scoped_ptr<UserAgent> user_agent(new UserAgent(&auth_handler_factory,
+      &password_handler_factory,
+      DialogController::GetDefaultDialogController(),
+      net::BoundNetLog()));
+  scoped_ptr<NetworkLayer> network_layer(
+      new NetworkLayer(user_agent.get(), NetworkSettings()));
+  user_agent->SetNetworkLayer(network_layer.get());
+
+  MemoryUsageDump dump;
+  user_agent->DumpMemoryUsage(&dump);
+  const MemoryUsageDump::UsageMap &usages = dump.usages();
+  EXPECT_EQ(0u, usages.find("ua/outgoing_requests")->second.object_count);
+  EXPECT_EQ(0u, usages.find("ua/dialogs")->second.object_count);
+  EXPECT_EQ(0u, usages.find("ua/auth_cache")->second.object_count);
+
+  // Answering an INVITE with a 180 creates an early dialog, even if the
+  // answer can't be sent, as there's no channel.
+  scoped_refptr<Request> invite(dyn_cast<Request>(Message::Parse(kInvite)));
+  invite->set_direction(Message::Incoming);
+  net::TestCompletionCallback callback;
+  EXPECT_NE(net::OK, user_agent->Send(invite->CreateResponse(SIP_RINGING),
+                                      callback.callback()));
+
+  MemoryUsageDump after_answer;
+  user_agent->DumpMemoryUsage(&after_answer);
+  const MemoryUsage &dialogs =
+      after_answer.usages().find("ua/dialogs")->second;
+  EXPECT_EQ(1u, dialogs.object_count);
+  EXPECT_LT(0u, dialogs.bytes);
+}
+
+} // namespace ua
+} // namespace sippet
@@ -0,0 +1,51 @@
+// Copyright (c) 2015 The Sippet Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sippet/uri/uri.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "sippet/test/microbenchmark.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace sippet {
+
+namespace {
+
+void CanonicalizeSipURI(const std::string &spec) {
+  SipURI uri(spec);
+  CHECK(uri.is_valid());
+}
+
+}  // namespace
+
+TEST(SipURIPerfTest, Canonicalize) {
+  struct {
+    const char *name;
+    const char *spec;
+  } cases[] = {
+    // Already canonical.
+    { "canonical", "sip:alice@atlanta.com" },
+    // Scheme and host are lowercased.
+    { "mixed_case", "SIP:Alice@AtLanta.COM:5060;Transport=TCP" },
+    { "escaped",
+      "sip:cal%6Cer@host5.example.net;%6C%72;n%61me=v%61lue%25%34%31" },
+    { "ipv4", "sips:bob@192.0.2.4:5061;transport=tls;lr" },
+    // The address is compressed to [2001:db8::10].
+    { "ipv6", "sip:[2001:DB8:0:0:0:0:0:10]:5070;transport=udp" },
+    { "headers",
+      "sip:carol@chicago.com?Subject=next%20meeting&Priority=urgent" },
+  };
+
+  for (size_t i = 0; i < arraysize(cases); ++i) {
+    ASSERT_TRUE(SipURI(cases[i].spec).is_valid()) << cases[i].spec;
+    Microbenchmark benchmark("sip_uri_canonicalize", cases[i].name);
+    benchmark.Run(base::Bind(&CanonicalizeSipURI,
+                             std::string(cases[i].spec)));
+  }
+}
+
+}  // namespace sippet